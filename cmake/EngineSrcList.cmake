@@ -10,10 +10,20 @@ foreach(fname
 "../../lib/src/jsoncpp/dist/jsoncpp.cpp"
 "Addons.cpp"
 "Addons.hpp"
+"BlockCompression.cpp"
+"BlockCompression.hpp"
+"BoundingVolume.cpp"
+"BoundingVolume.hpp"
 "Camera.cpp"
 "Camera.hpp"
 "DebugFPControllerEListe.cpp"
 "DebugFPControllerEListe.hpp"
+"DescriptorAllocatorVulkan.cpp"
+"DescriptorAllocatorVulkan.hpp"
+"DescriptorSetCacheVulkan.cpp"
+"DescriptorSetCacheVulkan.hpp"
+"DeviceMemoryAllocatorVulkan.cpp"
+"DeviceMemoryAllocatorVulkan.hpp"
 "Engine.cpp"
 "Engine.hpp"
 "EntitySignal.cpp"
@@ -33,6 +43,10 @@ foreach(fname
 "GeometryResourceOpenGL.hpp"
 "GeometryResourceVulkan.cpp"
 "GeometryResourceVulkan.hpp"
+"GLBackend.cpp"
+"GLBackend.hpp"
+"GLStateCache.cpp"
+"GLStateCache.hpp"
 "GraphicsApiLibrary.hpp"
 "HardValueStuff.hpp"
 "Image.cpp"
@@ -45,6 +59,10 @@ foreach(fname
 "InputInteractESignal.hpp"
 "InputMoveESignal.cpp"
 "InputMoveESignal.hpp"
+"InstanceBuffer.cpp"
+"InstanceBuffer.hpp"
+"Jobs.cpp"
+"Jobs.hpp"
 "Logger.cpp"
 "Logger.hpp"
 "Material.cpp"
@@ -53,6 +71,8 @@ foreach(fname
 "MaterialResource.hpp"
 "MathUtil.cpp"
 "MathUtil.hpp"
+"MipChain.cpp"
+"MipChain.hpp"
 "MiscResource.cpp"
 "MiscResource.hpp"
 "MissionGamelayer.cpp"
@@ -61,6 +81,7 @@ foreach(fname
 "Model.hpp"
 "ModelInstance.cpp"
 "ModelInstance.hpp"
+"ModelMatrixUniforms.hpp"
 "ModelResource.cpp"
 "ModelResource.hpp"
 "NRES.hpp"
@@ -68,12 +89,20 @@ foreach(fname
 "PhysicsLocationUpdateESignal.hpp"
 "PhysicsOrientationUpdateESignal.cpp"
 "PhysicsOrientationUpdateESignal.hpp"
+"PipelineStateCacheVulkan.cpp"
+"PipelineStateCacheVulkan.hpp"
 "Quate.cpp"
 "Quate.hpp"
 "ReferenceCounted.cpp"
 "ReferenceCounted.hpp"
 "Renderable.cpp"
 "Renderable.hpp"
+"RenderCommandExecutorVulkan.cpp"
+"RenderCommandExecutorVulkan.hpp"
+"RenderCommandList.cpp"
+"RenderCommandList.hpp"
+"RenderQueue.cpp"
+"RenderQueue.hpp"
 "Resource.cpp"
 "Resource.hpp"
 "Resources.cpp"
@@ -104,6 +133,7 @@ foreach(fname
 "SimpleScenegraph.hpp"
 "SineWaveform.cpp"
 "SineWaveform.hpp"
+"SnapshotBuffer.hpp"
 "SoundContext.cpp"
 "SoundContext.hpp"
 "SoundEndpoint.cpp"
@@ -128,6 +158,14 @@ foreach(fname
 "Texture.hpp"
 "TextureResource.cpp"
 "TextureResource.hpp"
+"TextureStreamerVulkan.cpp"
+"TextureStreamerVulkan.hpp"
+"TlsfRangeAllocator.cpp"
+"TlsfRangeAllocator.hpp"
+"TransferBatcherVulkan.cpp"
+"TransferBatcherVulkan.hpp"
+"TransformStore.cpp"
+"TransformStore.hpp"
 "Vec2.cpp"
 "Vec2.hpp"
 "Vec3.cpp"
@@ -0,0 +1,109 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+/* Measures the fixed overhead of the job system: submitting and finishing empty jobs from outside the
+ * pool, from inside a worker (where the rest of the pool has to steal them), and splitting a range with
+ * parallelFor. The jobs do no work, so the timings are entirely scheduling cost.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+#include "Jobs.hpp"
+#include "Logger.hpp"
+
+using namespace pgg;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Best of several repetitions, in nanoseconds per item
+double timeNsPerItem(std::function<void()> body, std::size_t items, uint32_t repetitions = 5) {
+    double best = -1.0;
+    for(uint32_t i = 0; i < repetitions; ++ i) {
+        Clock::time_point start = Clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+        double perItem = elapsed.count() / items;
+        if(best < 0.0 || perItem < best) {
+            best = perItem;
+        }
+    }
+    return best;
+}
+
+void report(const std::string& name, double nsPerItem) {
+    Logger::log(Logger::INFO) << name << ": " << nsPerItem << " ns" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t numWorkers = argc > 1 ? (uint32_t) std::atoi(argv[1]) : 0;
+    const std::size_t numJobs = 100000;
+    
+    Jobs::initialize(numWorkers);
+    
+    // Submitted from a non-worker thread, so every job goes through the shared queue
+    report("Spawn from main thread, per job", timeNsPerItem([numJobs]() {
+        Jobs::Counter counter;
+        for(std::size_t i = 0; i < numJobs; ++ i) {
+            Jobs::run([]() { }, &counter);
+        }
+        Jobs::wait(&counter);
+    }, numJobs));
+    
+    // Submitted from a worker onto its own deque; everything not run by that worker is stolen
+    Jobs::resetStats();
+    report("Spawn from worker, per job", timeNsPerItem([numJobs]() {
+        Jobs::Counter outer;
+        Jobs::run([numJobs]() {
+            Jobs::Counter inner;
+            for(std::size_t i = 0; i < numJobs; ++ i) {
+                Jobs::run([]() { }, &inner);
+                
+                // Stay below the deque capacity so that nothing overflows into the shared queue
+                if(inner.getPending() >= 2048) {
+                    Jobs::wait(&inner);
+                }
+            }
+            Jobs::wait(&inner);
+        }, &outer);
+        Jobs::wait(&outer);
+    }, numJobs));
+    Jobs::Stats stats = Jobs::getStats();
+    Logger::log(Logger::INFO) << "\tStolen: " << stats.mJobsStolen << " of " << stats.mJobsRun << std::endl;
+    
+    // Cost of one call over a range with an empty body, for a few grain sizes
+    const std::size_t rangeSize = 1 << 16;
+    const uint32_t numCalls = 1000;
+    std::size_t grainSizes[] = { 0, 64, 1024, 16384 };
+    for(std::size_t grainSize : grainSizes) {
+        report("parallelFor over " + std::to_string(rangeSize) + ", grain " + std::to_string(grainSize) + ", per call",
+            timeNsPerItem([rangeSize, grainSize, numCalls]() {
+                for(uint32_t i = 0; i < numCalls; ++ i) {
+                    Jobs::parallelFor(0, rangeSize, [](std::size_t begin, std::size_t end) { }, grainSize);
+                }
+            }, numCalls));
+    }
+    
+    Jobs::cleanup();
+    return EXIT_SUCCESS;
+}
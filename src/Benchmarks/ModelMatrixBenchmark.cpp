@@ -0,0 +1,193 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+/* Measures the per-draw matrix work of a shader program (ModelMatrixUniforms::upload) with the uniform
+ * upload replaced by a checksum, against the general products and 4x4 inverse it replaced. Also checks
+ * Math::inverseAffine against glm::inverse for affine matrices and for matrices which must fall back.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Logger.hpp"
+#include "MathUtil.hpp"
+#include "ModelMatrixUniforms.hpp"
+
+using namespace pgg;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+std::mt19937 sRandom(1234);
+
+float randomFloat(float min, float max) {
+    return std::uniform_real_distribution<float>(min, max)(sRandom);
+}
+
+// Rotation, non-uniform scale and translation
+glm::mat4 randomAffine() {
+    glm::vec3 axis(randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f) + 2.f);
+    glm::mat4 matrix = glm::translate(glm::mat4(), glm::vec3(randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f)));
+    matrix = glm::rotate(matrix, randomFloat(0.f, 6.28f), glm::normalize(axis));
+    return glm::scale(matrix, glm::vec3(randomFloat(0.1f, 10.f), randomFloat(0.1f, 10.f), randomFloat(0.1f, 10.f)));
+}
+
+// Largest difference between elements, relative to the size of the expected element
+float maxRelativeError(const glm::mat4& actual, const glm::mat4& expected) {
+    float worst = 0.f;
+    for(uint32_t col = 0; col < 4; ++ col) {
+        for(uint32_t row = 0; row < 4; ++ row) {
+            float scale = std::max(1.f, std::abs(expected[col][row]));
+            worst = std::max(worst, std::abs(actual[col][row] - expected[col][row]) / scale);
+        }
+    }
+    return worst;
+}
+
+bool checkInverse(const std::string& name, const std::vector<glm::mat4>& matrices) {
+    const float tolerance = 1e-4f;
+    float worst = 0.f;
+    for(const glm::mat4& matrix : matrices) {
+        worst = std::max(worst, maxRelativeError(Math::inverseAffine(matrix), glm::inverse(matrix)));
+    }
+    bool passed = worst <= tolerance;
+    Logger::log(passed ? Logger::INFO : Logger::SEVERE) << "inverseAffine, " << name << ": max relative error " << worst << (passed ? "" : " FAILED") << std::endl;
+    return passed;
+}
+
+// Stands in for glUniformMatrix4fv, touching every element so that nothing is optimized away
+struct ChecksumUploader {
+    float* mSum;
+    void operator()(GLuint location, const glm::mat4& matrix) const {
+        for(uint32_t col = 0; col < 4; ++ col) {
+            *mSum += matrix[col][0] + matrix[col][1] + matrix[col][2] + matrix[col][3];
+        }
+    }
+};
+
+// Best of several repetitions, in nanoseconds per model matrix
+template<typename Body>
+double timeNsPerDraw(Body body, std::size_t draws, uint32_t repetitions = 5) {
+    double best = -1.0;
+    for(uint32_t i = 0; i < repetitions; ++ i) {
+        Clock::time_point start = Clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+        double perDraw = elapsed.count() / draws;
+        if(best < 0.0 || perDraw < best) {
+            best = perDraw;
+        }
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    bool passed = true;
+    
+    // Correctness
+    {
+        std::vector<glm::mat4> affine;
+        std::vector<glm::mat4> projective;
+        for(uint32_t i = 0; i < 1000; ++ i) {
+            affine.push_back(randomAffine());
+            
+            // Perspective projections, and affine matrices with a disturbed bottom row
+            glm::mat4 proj = glm::perspective(randomFloat(0.5f, 2.f), randomFloat(0.5f, 2.f), randomFloat(0.01f, 1.f), randomFloat(10.f, 1000.f));
+            projective.push_back(proj * randomAffine());
+            glm::mat4 disturbed = randomAffine();
+            disturbed[1][3] = randomFloat(0.1f, 1.f);
+            disturbed[3][3] = randomFloat(0.5f, 2.f);
+            projective.push_back(disturbed);
+        }
+        passed = checkInverse("affine", affine) && passed;
+        passed = checkInverse("non-affine", projective) && passed;
+    }
+    
+    // Timing
+    {
+        const std::size_t numDraws = 1 << 16;
+        std::vector<glm::mat4> models;
+        for(std::size_t i = 0; i < numDraws; ++ i) {
+            models.push_back(randomAffine());
+        }
+        glm::mat4 viewMat = glm::lookAt(glm::vec3(10.f, 20.f, 30.f), glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f));
+        glm::mat4 projMat = glm::perspective(1.2f, 16.f / 9.f, 0.1f, 500.f);
+        glm::mat4 viewProjMat = projMat * viewMat;
+        glm::mat4 invViewMat = glm::inverse(viewMat);
+        glm::mat4 invViewProjMat = glm::inverse(viewProjMat);
+        
+        float sum = 0.f;
+        ChecksumUploader uploader = { &sum };
+        
+        struct Config {
+            std::string mName;
+            bool mMV;
+            bool mMVP;
+            bool mInverses;
+        };
+        Config configs[] = {
+            { "M", false, false, false },
+            { "M, MVP", false, true, false },
+            { "M, MV, MVP and inverses", true, true, true }
+        };
+        for(const Config& config : configs) {
+            ModelMatrixUniforms uniforms;
+            uniforms.mUseMMat = true;
+            uniforms.mUseMVMat = config.mMV;
+            uniforms.mUseMVPMat = config.mMVP;
+            uniforms.mUseIMMat = config.mInverses;
+            uniforms.mUseIMVMat = config.mInverses;
+            uniforms.mUseIMVPMat = config.mInverses;
+            
+            double uploadNs = timeNsPerDraw([&]() {
+                for(const glm::mat4& model : models) {
+                    uniforms.upload(model, viewMat, viewProjMat, invViewMat, invViewProjMat, uploader);
+                }
+            }, numDraws);
+            
+            // The same products with plain glm and a general inverse
+            double generalNs = timeNsPerDraw([&]() {
+                for(const glm::mat4& model : models) {
+                    uploader(0, model);
+                    if(config.mMV) uploader(0, viewMat * model);
+                    if(config.mMVP) uploader(0, viewProjMat * model);
+                    if(config.mInverses) {
+                        glm::mat4 invModel = glm::inverse(model);
+                        uploader(0, invModel);
+                        uploader(0, invModel * invViewMat);
+                        uploader(0, invModel * invViewProjMat);
+                    }
+                }
+            }, numDraws);
+            
+            Logger::log(Logger::INFO) << config.mName << ": " << uploadNs << " ns per draw, general " << generalNs << " ns" << std::endl;
+        }
+        Logger::log(Logger::VERBOSE) << "Checksum " << sum << std::endl;
+    }
+    
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
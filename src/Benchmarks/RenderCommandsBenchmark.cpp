@@ -0,0 +1,174 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+/* Measures the CPU side of preparing a frame: recording a synthetic scene into RenderCommandLists the
+ * way ShoRendererVk records its opaque pass, serially and split across slots with Jobs::parallelFor,
+ * then walking the lists with NullRenderCommandExecutor. Needs no device or window.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Jobs.hpp"
+#include "Logger.hpp"
+#include "RenderCommandList.hpp"
+
+using namespace pgg;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Instances per slot before the scene is split further, as in ShoRendererVk
+const std::size_t sMinInstancesPerSlot = 512;
+
+const uint32_t sPipelineId = 1;
+
+// Lists only compare and pass on geometry pointers, so distinct addresses are all the scene needs
+const std::size_t sNumGeometries = 32;
+char sGeometryStorage[sNumGeometries];
+
+struct Instance {
+    Geometry* mGeometry;
+    glm::mat4 mModelMatr;
+};
+
+// Best of several repetitions, in nanoseconds per item
+double timeNsPerItem(std::function<void()> body, std::size_t items, uint32_t repetitions = 5) {
+    double best = -1.0;
+    for(uint32_t i = 0; i < repetitions; ++ i) {
+        Clock::time_point start = Clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+        double perItem = elapsed.count() / items;
+        if(best < 0.0 || perItem < best) {
+            best = perItem;
+        }
+    }
+    return best;
+}
+
+void report(const std::string& name, double nsPerItem) {
+    Logger::log(Logger::INFO) << name << ": " << nsPerItem << " ns" << std::endl;
+}
+
+std::vector<Instance> buildScene(std::size_t numInstances, bool sortedByGeometry) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> coord(-500.f, 500.f);
+    std::vector<Instance> scene(numInstances);
+    for(std::size_t i = 0; i < numInstances; ++ i) {
+        Instance& instance = scene[i];
+        instance.mGeometry = reinterpret_cast<Geometry*>(&sGeometryStorage[random() % sNumGeometries]);
+        instance.mModelMatr = glm::translate(glm::mat4(), glm::vec3(coord(random), coord(random), coord(random)));
+    }
+    if(sortedByGeometry) {
+        std::sort(scene.begin(), scene.end(), [](const Instance& a, const Instance& b) { return a.mGeometry < b.mGeometry; });
+    }
+    return scene;
+}
+
+// Same commands per instance as ShoRendererVk::modelimapOpaque()
+void recordRange(const std::vector<Instance>& scene, std::size_t begin, std::size_t end, RenderCommandList& commands) {
+    commands.clear();
+    commands.bindPipeline(sPipelineId);
+    for(std::size_t i = begin; i < end; ++ i) {
+        const Instance& instance = scene[i];
+        commands.bindGeometry(instance.mGeometry);
+        commands.setModelMatrix(instance.mModelMatr);
+        commands.drawIndexed();
+    }
+}
+
+// Same split as ShoRendererVk::recordSecondaries(); returns the number of slots used
+std::size_t recordSlots(const std::vector<Instance>& scene, std::vector<RenderCommandList>& slots) {
+    std::size_t numInstances = scene.size();
+    std::size_t numSlots = (numInstances + sMinInstancesPerSlot - 1) / sMinInstancesPerSlot;
+    if(numSlots > slots.size()) numSlots = slots.size();
+    if(numSlots == 0) numSlots = 1;
+    std::size_t instancesPerSlot = (numInstances + numSlots - 1) / numSlots;
+    
+    Jobs::parallelFor(0, numSlots, [&scene, &slots, numInstances, instancesPerSlot](std::size_t begin, std::size_t end) {
+        for(std::size_t i = begin; i < end; ++ i) {
+            std::size_t first = std::min(i * instancesPerSlot, numInstances);
+            std::size_t last = std::min(first + instancesPerSlot, numInstances);
+            recordRange(scene, first, last, slots[i]);
+        }
+    }, 1);
+    return numSlots;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t numInstances = argc > 1 ? (std::size_t) std::atoi(argv[1]) : 100000;
+    uint32_t numWorkers = argc > 2 ? (uint32_t) std::atoi(argv[2]) : 0;
+    
+    Jobs::initialize(numWorkers);
+    Logger::log(Logger::INFO) << numInstances << " instances of " << sNumGeometries << " geometries, "
+        << Jobs::getNumWorkers() << " workers" << std::endl;
+    
+    bool passed = true;
+    bool sortings[] = { false, true };
+    for(bool sorted : sortings) {
+        std::vector<Instance> scene = buildScene(numInstances, sorted);
+        std::string sceneName = sorted ? "sorted by geometry" : "unsorted";
+        
+        RenderCommandList serial;
+        report("Record, serial, " + sceneName + ", per instance", timeNsPerItem([&scene, &serial]() {
+            recordRange(scene, 0, scene.size(), serial);
+        }, numInstances));
+        const RenderCommandList::Stats& stats = serial.getStats();
+        Logger::log(Logger::INFO) << "\t" << serial.size() << " commands, " << stats.mCommands[RenderCommandList::BIND_GEOMETRY]
+            << " geometry binds, " << stats.mRedundantBinds << " redundant binds dropped" << std::endl;
+        
+        // ShoRendererVk keeps two slots per thread
+        std::vector<RenderCommandList> slots((Jobs::getNumWorkers() + 1) * 2);
+        std::size_t numSlots = 0;
+        report("Record, up to " + std::to_string(slots.size()) + " slots, " + sceneName + ", per instance", timeNsPerItem([&scene, &slots, &numSlots]() {
+            numSlots = recordSlots(scene, slots);
+        }, numInstances));
+        
+        NullRenderCommandExecutor executor;
+        report("Execute, null executor, " + sceneName + ", per instance", timeNsPerItem([&slots, &numSlots, &executor]() {
+            for(std::size_t i = 0; i < numSlots; ++ i) {
+                executor.execute(slots[i]);
+            }
+        }, numInstances));
+        
+        // Every repetition must have drawn each instance exactly once
+        executor.reset();
+        for(std::size_t i = 0; i < numSlots; ++ i) {
+            executor.execute(slots[i]);
+        }
+        if(executor.getNumInstances() != numInstances || executor.getNumExecuted(RenderCommandList::SET_MODEL_MATRIX) != numInstances) {
+            Logger::log(Logger::SEVERE) << "Executed " << executor.getNumInstances() << " instances, expected " << numInstances << std::endl;
+            passed = false;
+        }
+        Logger::log(Logger::VERBOSE) << "Checksum " << executor.getChecksum() << std::endl;
+    }
+    
+    Jobs::cleanup();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -219,7 +219,7 @@ void AxesModel::unload() {
 
     delete this;
 }
-void AxesModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void AxesModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
 
     if(rendPass.mType != Renderable::Pass::Type::GEOMETRY && rendPass.mType != Renderable::Pass::Type::SHADOW) {
         return;
@@ -227,7 +227,7 @@ void AxesModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
     
     glUseProgram(mShaderProg->getHandle());
 
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
 
     glBindVertexArray(mVertexArrayObject);
 
@@ -0,0 +1,549 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "BlockCompression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "Jobs.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PGG_BLOCKCOMPRESSION_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace pgg {
+namespace BlockCompression {
+
+namespace {
+    
+    // One block of texels, expanded to RGBA and split into channels
+    struct Block {
+        uint8_t mChannels[4][16];
+    };
+    
+    void expandTexel(const uint8_t* texel, uint32_t numComponents, uint8_t* rgba) {
+        switch(numComponents) {
+            case 1: {
+                rgba[0] = texel[0];
+                rgba[1] = texel[0];
+                rgba[2] = texel[0];
+                rgba[3] = 255;
+                break;
+            }
+            case 2: {
+                rgba[0] = texel[0];
+                rgba[1] = texel[1];
+                rgba[2] = 0;
+                rgba[3] = 255;
+                break;
+            }
+            case 3: {
+                rgba[0] = texel[0];
+                rgba[1] = texel[1];
+                rgba[2] = texel[2];
+                rgba[3] = 255;
+                break;
+            }
+            default: {
+                rgba[0] = texel[0];
+                rgba[1] = texel[1];
+                rgba[2] = texel[2];
+                rgba[3] = texel[3];
+                break;
+            }
+        }
+    }
+    
+    // Texels past the right and bottom edges repeat the edge
+    void fetchBlock(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t numComponents, uint32_t blockX, uint32_t blockY, Block& block) {
+        for(uint32_t y = 0; y < 4; ++ y) {
+            uint32_t srcY = blockY * 4 + y;
+            if(srcY >= height) srcY = height - 1;
+            for(uint32_t x = 0; x < 4; ++ x) {
+                uint32_t srcX = blockX * 4 + x;
+                if(srcX >= width) srcX = width - 1;
+                
+                uint8_t rgba[4];
+                expandTexel(texels + (((std::size_t) srcY) * width + srcX) * numComponents, numComponents, rgba);
+                for(uint32_t c = 0; c < 4; ++ c) {
+                    block.mChannels[c][y * 4 + x] = rgba[c];
+                }
+            }
+        }
+    }
+    
+    uint16_t packColor565(float red, float green, float blue) {
+        int r = static_cast<int>(red * (31.f / 255.f) + 0.5f);
+        int g = static_cast<int>(green * (63.f / 255.f) + 0.5f);
+        int b = static_cast<int>(blue * (31.f / 255.f) + 0.5f);
+        r = r < 0 ? 0 : (r > 31 ? 31 : r);
+        g = g < 0 ? 0 : (g > 63 ? 63 : g);
+        b = b < 0 ? 0 : (b > 31 ? 31 : b);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+    
+    // Same expansion and interpolation as hardware decoders, so the encoder measures error against what is sampled
+    void decodeColorPalette(uint16_t color0, uint16_t color1, bool fourColor, uint8_t palette[4][4]) {
+        uint16_t colors[2] = {color0, color1};
+        for(uint32_t i = 0; i < 2; ++ i) {
+            uint32_t r = (colors[i] >> 11) & 31;
+            uint32_t g = (colors[i] >> 5) & 63;
+            uint32_t b = colors[i] & 31;
+            palette[i][0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+            palette[i][1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+            palette[i][2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+            palette[i][3] = 255;
+        }
+        for(uint32_t c = 0; c < 3; ++ c) {
+            if(fourColor) {
+                palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+                palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+            } else {
+                palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+                palette[3][c] = 0;
+            }
+        }
+        palette[2][3] = 255;
+        palette[3][3] = fourColor ? 255 : 0;
+    }
+    
+    // Picks the nearest palette entry for each texel, returning the total squared error
+    float selectColorIndices(const float* red, const float* green, const float* blue, const uint8_t palette[4][4], uint8_t* indices) {
+        float totalError = 0.f;
+        
+        #ifdef PGG_BLOCKCOMPRESSION_SSE
+        // Four texels at a time, against each palette entry in turn
+        for(uint32_t i = 0; i < 16; i += 4) {
+            __m128 r = _mm_loadu_ps(red + i);
+            __m128 g = _mm_loadu_ps(green + i);
+            __m128 b = _mm_loadu_ps(blue + i);
+            
+            __m128 bestError = _mm_set1_ps(std::numeric_limits<float>::max());
+            __m128 bestIndex = _mm_setzero_ps();
+            for(uint32_t p = 0; p < 4; ++ p) {
+                __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+                __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+                __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+                __m128 error = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+                
+                __m128 closer = _mm_cmplt_ps(error, bestError);
+                bestError = _mm_min_ps(error, bestError);
+                bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(static_cast<float>(p))), _mm_andnot_ps(closer, bestIndex));
+            }
+            
+            float errors[4];
+            float bestIndices[4];
+            _mm_storeu_ps(errors, bestError);
+            _mm_storeu_ps(bestIndices, bestIndex);
+            for(uint32_t j = 0; j < 4; ++ j) {
+                indices[i + j] = static_cast<uint8_t>(bestIndices[j]);
+                totalError += errors[j];
+            }
+        }
+        #else
+        for(uint32_t i = 0; i < 16; ++ i) {
+            float bestError = std::numeric_limits<float>::max();
+            for(uint32_t p = 0; p < 4; ++ p) {
+                float dr = red[i] - palette[p][0];
+                float dg = green[i] - palette[p][1];
+                float db = blue[i] - palette[p][2];
+                float error = dr * dr + dg * dg + db * db;
+                if(error < bestError) {
+                    bestError = error;
+                    indices[i] = static_cast<uint8_t>(p);
+                }
+            }
+            totalError += bestError;
+        }
+        #endif
+        
+        return totalError;
+    }
+    
+    // Orders the endpoints for four-color mode and chooses indices for them
+    float fitColorIndices(const float* red, const float* green, const float* blue, uint16_t& color0, uint16_t& color1, uint8_t* indices) {
+        if(color0 < color1) {
+            uint16_t swap = color0;
+            color0 = color1;
+            color1 = swap;
+        }
+        
+        uint8_t palette[4][4];
+        decodeColorPalette(color0, color1, true, palette);
+        
+        // Equal endpoints select three-color mode, in which only the first entry is still the same
+        if(color0 == color1) {
+            float totalError = 0.f;
+            for(uint32_t i = 0; i < 16; ++ i) {
+                float dr = red[i] - palette[0][0];
+                float dg = green[i] - palette[0][1];
+                float db = blue[i] - palette[0][2];
+                totalError += dr * dr + dg * dg + db * db;
+                indices[i] = 0;
+            }
+            return totalError;
+        }
+        
+        return selectColorIndices(red, green, blue, palette, indices);
+    }
+    
+    void writeColorBlock(uint16_t color0, uint16_t color1, const uint8_t* indices, uint8_t* output) {
+        output[0] = static_cast<uint8_t>(color0);
+        output[1] = static_cast<uint8_t>(color0 >> 8);
+        output[2] = static_cast<uint8_t>(color1);
+        output[3] = static_cast<uint8_t>(color1 >> 8);
+        
+        uint32_t bits = 0;
+        for(uint32_t i = 0; i < 16; ++ i) {
+            bits |= static_cast<uint32_t>(indices[i]) << (i * 2);
+        }
+        for(uint32_t i = 0; i < 4; ++ i) {
+            output[4 + i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+    }
+    
+    void encodeColorBlock(const Block& block, uint8_t* output) {
+        float channels[3][16];
+        float mean[3] = {0.f, 0.f, 0.f};
+        float minimum[3] = {255.f, 255.f, 255.f};
+        float maximum[3] = {0.f, 0.f, 0.f};
+        for(uint32_t c = 0; c < 3; ++ c) {
+            for(uint32_t i = 0; i < 16; ++ i) {
+                float value = block.mChannels[c][i];
+                channels[c][i] = value;
+                mean[c] += value;
+                if(value < minimum[c]) minimum[c] = value;
+                if(value > maximum[c]) maximum[c] = value;
+            }
+            mean[c] /= 16.f;
+        }
+        
+        // Endpoints go along the principal axis of the colors, found by power iteration on their covariance
+        float covariance[3][3] = {};
+        for(uint32_t i = 0; i < 16; ++ i) {
+            float d[3] = {channels[0][i] - mean[0], channels[1][i] - mean[1], channels[2][i] - mean[2]};
+            for(uint32_t a = 0; a < 3; ++ a) {
+                for(uint32_t b = 0; b < 3; ++ b) {
+                    covariance[a][b] += d[a] * d[b];
+                }
+            }
+        }
+        float axis[3] = {maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2]};
+        for(uint32_t iteration = 0; iteration < 8; ++ iteration) {
+            float next[3];
+            for(uint32_t a = 0; a < 3; ++ a) {
+                next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+            }
+            float largest = std::max(std::abs(next[0]), std::max(std::abs(next[1]), std::abs(next[2])));
+            if(largest < 1e-6f) {
+                break;
+            }
+            for(uint32_t a = 0; a < 3; ++ a) {
+                axis[a] = next[a] / largest;
+            }
+        }
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        
+        float end0[3];
+        float end1[3];
+        if(axisLength < 1e-6f) {
+            // Every texel is the same color
+            for(uint32_t c = 0; c < 3; ++ c) {
+                end0[c] = mean[c];
+                end1[c] = mean[c];
+            }
+        } else {
+            float minProj = std::numeric_limits<float>::max();
+            float maxProj = -std::numeric_limits<float>::max();
+            for(uint32_t i = 0; i < 16; ++ i) {
+                float proj = 0.f;
+                for(uint32_t c = 0; c < 3; ++ c) {
+                    proj += (channels[c][i] - mean[c]) * axis[c] / axisLength;
+                }
+                if(proj < minProj) minProj = proj;
+                if(proj > maxProj) maxProj = proj;
+            }
+            
+            // Inset slightly, since the extreme texels rarely deserve a palette entry to themselves
+            for(uint32_t c = 0; c < 3; ++ c) {
+                end0[c] = mean[c] + axis[c] / axisLength * maxProj;
+                end1[c] = mean[c] + axis[c] / axisLength * minProj;
+                float inset = (end0[c] - end1[c]) / 16.f;
+                end0[c] -= inset;
+                end1[c] += inset;
+            }
+        }
+        
+        uint16_t color0 = packColor565(end0[0], end0[1], end0[2]);
+        uint16_t color1 = packColor565(end1[0], end1[1], end1[2]);
+        uint8_t indices[16];
+        float error = fitColorIndices(channels[0], channels[1], channels[2], color0, color1, indices);
+        
+        // One round of least squares, solving for the endpoints which best fit the chosen indices
+        if(color0 != color1) {
+            static const float sWeights[4] = {1.f, 0.f, 2.f / 3.f, 1.f / 3.f};
+            float aa = 0.f;
+            float bb = 0.f;
+            float ab = 0.f;
+            float ax[3] = {0.f, 0.f, 0.f};
+            float bx[3] = {0.f, 0.f, 0.f};
+            for(uint32_t i = 0; i < 16; ++ i) {
+                float a = sWeights[indices[i]];
+                float b = 1.f - a;
+                aa += a * a;
+                bb += b * b;
+                ab += a * b;
+                for(uint32_t c = 0; c < 3; ++ c) {
+                    ax[c] += a * channels[c][i];
+                    bx[c] += b * channels[c][i];
+                }
+            }
+            float det = aa * bb - ab * ab;
+            if(std::abs(det) > 1e-6f) {
+                float refined0[3];
+                float refined1[3];
+                for(uint32_t c = 0; c < 3; ++ c) {
+                    refined0[c] = (bb * ax[c] - ab * bx[c]) / det;
+                    refined1[c] = (aa * bx[c] - ab * ax[c]) / det;
+                }
+                uint16_t refinedColor0 = packColor565(refined0[0], refined0[1], refined0[2]);
+                uint16_t refinedColor1 = packColor565(refined1[0], refined1[1], refined1[2]);
+                uint8_t refinedIndices[16];
+                float refinedError = fitColorIndices(channels[0], channels[1], channels[2], refinedColor0, refinedColor1, refinedIndices);
+                if(refinedError < error) {
+                    color0 = refinedColor0;
+                    color1 = refinedColor1;
+                    for(uint32_t i = 0; i < 16; ++ i) {
+                        indices[i] = refinedIndices[i];
+                    }
+                }
+            }
+        }
+        
+        writeColorBlock(color0, color1, indices, output);
+    }
+    
+    void decodeAlphaPalette(uint8_t alpha0, uint8_t alpha1, uint8_t palette[8]) {
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        if(alpha0 > alpha1) {
+            for(uint32_t i = 2; i < 8; ++ i) {
+                palette[i] = static_cast<uint8_t>(((8 - i) * alpha0 + (i - 1) * alpha1) / 7);
+            }
+        } else {
+            for(uint32_t i = 2; i < 6; ++ i) {
+                palette[i] = static_cast<uint8_t>(((6 - i) * alpha0 + (i - 1) * alpha1) / 5);
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+    
+    // A single channel in the BC4 layout, as used for BC3 alpha and both BC5 channels
+    void encodeAlphaBlock(const uint8_t* values, uint8_t* output) {
+        uint8_t minimum = 255;
+        uint8_t maximum = 0;
+        for(uint32_t i = 0; i < 16; ++ i) {
+            if(values[i] < minimum) minimum = values[i];
+            if(values[i] > maximum) maximum = values[i];
+        }
+        
+        // With the larger value first, all eight entries are interpolated between the two
+        uint8_t palette[8];
+        decodeAlphaPalette(maximum, minimum, palette);
+        
+        uint64_t bits = 0;
+        for(uint32_t i = 0; i < 16; ++ i) {
+            uint32_t bestIndex = 0;
+            int bestError = 256;
+            for(uint32_t p = 0; p < 8; ++ p) {
+                int error = std::abs(static_cast<int>(values[i]) - static_cast<int>(palette[p]));
+                if(error < bestError) {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+            bits |= static_cast<uint64_t>(bestIndex) << (i * 3);
+        }
+        
+        output[0] = maximum;
+        output[1] = minimum;
+        for(uint32_t i = 0; i < 6; ++ i) {
+            output[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+    }
+    
+    void decodeColorBlock(const uint8_t* input, bool forceFourColor, uint8_t rgba[16][4]) {
+        uint16_t color0 = static_cast<uint16_t>(input[0] | (input[1] << 8));
+        uint16_t color1 = static_cast<uint16_t>(input[2] | (input[3] << 8));
+        uint8_t palette[4][4];
+        decodeColorPalette(color0, color1, forceFourColor || color0 > color1, palette);
+        
+        uint32_t bits = input[4] | (input[5] << 8) | (input[6] << 16) | (static_cast<uint32_t>(input[7]) << 24);
+        for(uint32_t i = 0; i < 16; ++ i) {
+            uint32_t index = (bits >> (i * 2)) & 3;
+            for(uint32_t c = 0; c < 4; ++ c) {
+                rgba[i][c] = palette[index][c];
+            }
+        }
+    }
+    
+    void decodeAlphaBlock(const uint8_t* input, uint8_t rgba[16][4], uint32_t channel) {
+        uint8_t palette[8];
+        decodeAlphaPalette(input[0], input[1], palette);
+        
+        uint64_t bits = 0;
+        for(uint32_t i = 0; i < 6; ++ i) {
+            bits |= static_cast<uint64_t>(input[2 + i]) << (i * 8);
+        }
+        for(uint32_t i = 0; i < 16; ++ i) {
+            rgba[i][channel] = palette[(bits >> (i * 3)) & 7];
+        }
+    }
+    
+    // Channels each format stores, as a bitmask of RGBA
+    uint32_t getStoredChannels(Format format) {
+        switch(format) {
+            case BC1: return 0x7;
+            case BC3: return 0xf;
+            case BC5: return 0x3;
+            default: return 0;
+        }
+    }
+    
+} // namespace
+
+uint32_t getBytesPerBlock(Format format) {
+    return format == BC1 ? 8 : 16;
+}
+
+uint64_t calcCompressedSize(Format format, uint32_t width, uint32_t height) {
+    uint64_t blocksX = (width + 3) / 4;
+    uint64_t blocksY = (height + 3) / 4;
+    return blocksX * blocksY * getBytesPerBlock(format);
+}
+
+void compress(Format format, const uint8_t* texels, uint32_t width, uint32_t height, uint32_t numComponents, uint8_t* output) {
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    uint32_t bytesPerBlock = getBytesPerBlock(format);
+    
+    Jobs::parallelFor(0, blocksY, [=](std::size_t begin, std::size_t end) {
+        Block block;
+        for(std::size_t blockY = begin; blockY < end; ++ blockY) {
+            uint8_t* blockOutput = output + blockY * blocksX * bytesPerBlock;
+            for(uint32_t blockX = 0; blockX < blocksX; ++ blockX) {
+                fetchBlock(texels, width, height, numComponents, blockX, blockY, block);
+                switch(format) {
+                    case BC1: {
+                        encodeColorBlock(block, blockOutput);
+                        break;
+                    }
+                    case BC3: {
+                        encodeAlphaBlock(block.mChannels[3], blockOutput);
+                        encodeColorBlock(block, blockOutput + 8);
+                        break;
+                    }
+                    case BC5: {
+                        encodeAlphaBlock(block.mChannels[0], blockOutput);
+                        encodeAlphaBlock(block.mChannels[1], blockOutput + 8);
+                        break;
+                    }
+                    default: break;
+                }
+                blockOutput += bytesPerBlock;
+            }
+        }
+    });
+}
+
+void decompress(Format format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgbaOutput) {
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    uint32_t bytesPerBlock = getBytesPerBlock(format);
+    
+    for(uint32_t blockY = 0; blockY < blocksY; ++ blockY) {
+        for(uint32_t blockX = 0; blockX < blocksX; ++ blockX) {
+            const uint8_t* input = blocks + (((std::size_t) blockY) * blocksX + blockX) * bytesPerBlock;
+            
+            uint8_t rgba[16][4];
+            switch(format) {
+                case BC1: {
+                    decodeColorBlock(input, false, rgba);
+                    break;
+                }
+                case BC3: {
+                    decodeColorBlock(input + 8, true, rgba);
+                    decodeAlphaBlock(input, rgba, 3);
+                    break;
+                }
+                case BC5: {
+                    for(uint32_t i = 0; i < 16; ++ i) {
+                        rgba[i][2] = 0;
+                        rgba[i][3] = 255;
+                    }
+                    decodeAlphaBlock(input, rgba, 0);
+                    decodeAlphaBlock(input + 8, rgba, 1);
+                    break;
+                }
+                default: return;
+            }
+            
+            for(uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++ y) {
+                for(uint32_t x = 0; x < 4 && blockX * 4 + x < width; ++ x) {
+                    uint8_t* dest = rgbaOutput + (((std::size_t) blockY * 4 + y) * width + blockX * 4 + x) * 4;
+                    for(uint32_t c = 0; c < 4; ++ c) {
+                        dest[c] = rgba[y * 4 + x][c];
+                    }
+                }
+            }
+        }
+    }
+}
+
+double calcPsnr(Format format, const uint8_t* texels, uint32_t width, uint32_t height, uint32_t numComponents, const uint8_t* blocks) {
+    std::vector<uint8_t> decoded(((std::size_t) width) * height * 4);
+    decompress(format, blocks, width, height, decoded.data());
+    
+    uint32_t stored = getStoredChannels(format);
+    double sumSquares = 0.0;
+    uint64_t count = 0;
+    for(std::size_t i = 0; i < ((std::size_t) width) * height; ++ i) {
+        uint8_t original[4];
+        expandTexel(texels + i * numComponents, numComponents, original);
+        for(uint32_t c = 0; c < 4; ++ c) {
+            if(stored & (1 << c)) {
+                double diff = static_cast<double>(original[c]) - decoded[i * 4 + c];
+                sumSquares += diff * diff;
+                ++ count;
+            }
+        }
+    }
+    
+    if(count == 0 || sumSquares == 0.0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double meanSquare = sumSquares / count;
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquare);
+}
+
+} // BlockCompression
+} // pgg
@@ -0,0 +1,58 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_BLOCKCOMPRESSION_HPP
+#define PGG_BLOCKCOMPRESSION_HPP
+
+#include <stdint.h>
+
+/* Encoding of 8-bit texels into the BC1, BC3 and BC5 block-compressed formats.
+ *
+ * Each 4x4 block of texels is encoded independently: BC1 stores color in 8 bytes, BC3 adds 8 bytes of
+ * alpha, and BC5 stores two independent channels (e.g. the X and Y of a tangent-space normal) in 8 bytes
+ * each. Blocks are laid out in rows from the top left. Images whose sizes are not multiples of four get
+ * partial blocks at the right and bottom edges, padded by repeating the edge texels.
+ *
+ * Texels are given tightly packed with 1 to 4 components, read as grey, red-green, RGB or RGBA.
+ */
+
+namespace pgg {
+namespace BlockCompression {
+
+    enum Format {
+        BC1, // RGB
+        BC3, // RGBA
+        BC5, // RG
+        
+        NUM_FORMATS
+    };
+    
+    uint32_t getBytesPerBlock(Format format);
+    uint64_t calcCompressedSize(Format format, uint32_t width, uint32_t height);
+    
+    // Compresses rows of blocks in parallel on the job system; output must have room for calcCompressedSize()
+    void compress(Format format, const uint8_t* texels, uint32_t width, uint32_t height, uint32_t numComponents, uint8_t* output);
+    
+    // Decodes to tightly packed RGBA; channels the format does not store are 0, except alpha which is 255
+    void decompress(Format format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgbaOutput);
+    
+    // Peak signal-to-noise ratio in decibels, over only the channels the format stores. Infinite if lossless.
+    double calcPsnr(Format format, const uint8_t* texels, uint32_t width, uint32_t height, uint32_t numComponents, const uint8_t* blocks);
+
+} // BlockCompression
+} // pgg
+
+#endif // PGG_BLOCKCOMPRESSION_HPP
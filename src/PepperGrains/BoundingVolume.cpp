@@ -0,0 +1,266 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "BoundingVolume.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PGG_BOUNDINGVOLUME_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace pgg {
+
+BoundingBox BoundingBox::getInfinite() {
+    BoundingBox box;
+    box.mMin = glm::vec3(-std::numeric_limits<float>::infinity());
+    box.mMax = glm::vec3(std::numeric_limits<float>::infinity());
+    return box;
+}
+
+BoundingBox BoundingBox::fromPositions(const float* positions, uint32_t count, uint32_t stride) {
+    BoundingBox box;
+    if(count == 0) {
+        box.mMin = glm::vec3(0.f);
+        box.mMax = glm::vec3(0.f);
+        return box;
+    }
+    box.mMin = glm::vec3(positions[0], positions[1], positions[2]);
+    box.mMax = box.mMin;
+    for(uint32_t i = 1; i < count; ++ i) {
+        glm::vec3 pos(positions[i * stride], positions[i * stride + 1], positions[i * stride + 2]);
+        box.mMin = glm::min(box.mMin, pos);
+        box.mMax = glm::max(box.mMax, pos);
+    }
+    return box;
+}
+
+BoundingSphere BoundingSphere::getEmpty() {
+    BoundingSphere sphere;
+    sphere.mCenter = glm::vec3(0.f);
+    sphere.mRadius = -1.f;
+    return sphere;
+}
+
+BoundingSphere BoundingSphere::getInfinite() {
+    BoundingSphere sphere;
+    sphere.mCenter = glm::vec3(0.f);
+    sphere.mRadius = std::numeric_limits<float>::infinity();
+    return sphere;
+}
+
+BoundingSphere BoundingSphere::fromPositions(const float* positions, uint32_t count, uint32_t stride, const BoundingBox& box) {
+    if(count == 0) {
+        return getEmpty();
+    }
+    BoundingSphere sphere;
+    sphere.mCenter = (box.mMin + box.mMax) * 0.5f;
+    float radiusSq = 0.f;
+    for(uint32_t i = 0; i < count; ++ i) {
+        glm::vec3 offset = glm::vec3(positions[i * stride], positions[i * stride + 1], positions[i * stride + 2]) - sphere.mCenter;
+        float distSq = glm::dot(offset, offset);
+        if(distSq > radiusSq) {
+            radiusSq = distSq;
+        }
+    }
+    sphere.mRadius = std::sqrt(radiusSq);
+    return sphere;
+}
+
+bool BoundingSphere::isEmpty() const {
+    return mRadius < 0.f;
+}
+
+bool BoundingSphere::isInfinite() const {
+    return mRadius == std::numeric_limits<float>::infinity();
+}
+
+BoundingSphere BoundingSphere::transformed(const glm::mat4& transform) const {
+    if(this->isEmpty() || this->isInfinite()) {
+        return *this;
+    }
+    BoundingSphere sphere;
+    sphere.mCenter = glm::vec3(transform * glm::vec4(mCenter, 1.f));
+
+    // Radius grows by the largest scale along any axis
+    float scaleSq = glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0]));
+    scaleSq = std::max(scaleSq, glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])));
+    scaleSq = std::max(scaleSq, glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])));
+    sphere.mRadius = mRadius * std::sqrt(scaleSq);
+    return sphere;
+}
+
+BoundingSphere BoundingSphere::merge(const BoundingSphere& a, const BoundingSphere& b) {
+    if(a.isEmpty() || b.isInfinite()) return b;
+    if(b.isEmpty() || a.isInfinite()) return a;
+
+    glm::vec3 offset = b.mCenter - a.mCenter;
+    float dist = glm::length(offset);
+
+    // One contains the other
+    if(dist + b.mRadius <= a.mRadius) return a;
+    if(dist + a.mRadius <= b.mRadius) return b;
+
+    BoundingSphere sphere;
+    sphere.mRadius = (dist + a.mRadius + b.mRadius) * 0.5f;
+    sphere.mCenter = a.mCenter + offset * ((sphere.mRadius - a.mRadius) / dist);
+    return sphere;
+}
+
+Frustum::Frustum() {
+    this->clear();
+}
+
+void Frustum::clear() {
+    // Unused planes are infinitely far behind everything, so they always pass
+    for(uint32_t i = 0; i < sMaxPlanes; ++ i) {
+        mPlaneX[i] = 0.f;
+        mPlaneY[i] = 0.f;
+        mPlaneZ[i] = 0.f;
+        mPlaneW[i] = FLT_MAX;
+    }
+    mNumPlanes = 0;
+}
+
+bool Frustum::addPlane(const glm::vec3& normal, float distance) {
+    if(mNumPlanes >= sMaxPlanes) {
+        return false;
+    }
+    float invLength = 1.f / glm::length(normal);
+    mPlaneX[mNumPlanes] = normal.x * invLength;
+    mPlaneY[mNumPlanes] = normal.y * invLength;
+    mPlaneZ[mNumPlanes] = normal.z * invLength;
+    mPlaneW[mNumPlanes] = distance * invLength;
+    ++ mNumPlanes;
+    return true;
+}
+
+void Frustum::setViewProj(const glm::mat4& viewProj) {
+    this->clear();
+
+    // Gribb-Hartmann: each plane is the fourth row of the matrix plus or minus one of the other rows
+    glm::vec4 rowX(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+    glm::vec4 rowY(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+    glm::vec4 rowZ(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+    glm::vec4 rowW(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+    glm::vec4 planes[6] = {
+        rowW + rowX, rowW - rowX, // Left, right
+        rowW + rowY, rowW - rowY, // Bottom, top
+        rowW + rowZ, rowW - rowZ  // Near, far
+    };
+    for(uint32_t i = 0; i < 6; ++ i) {
+        this->addPlane(glm::vec3(planes[i]), planes[i].w);
+    }
+}
+
+uint32_t Frustum::getNumPlanes() const {
+    return mNumPlanes;
+}
+
+glm::vec4 Frustum::getPlane(uint32_t index) const {
+    return glm::vec4(mPlaneX[index], mPlaneY[index], mPlaneZ[index], mPlaneW[index]);
+}
+
+Frustum::Result Frustum::testSphere(const BoundingSphere& sphere) const {
+    if(sphere.isEmpty()) return OUTSIDE;
+    if(sphere.isInfinite()) return INTERSECT;
+
+    #ifdef PGG_BOUNDINGVOLUME_SSE
+    __m128 cx = _mm_set1_ps(sphere.mCenter.x);
+    __m128 cy = _mm_set1_ps(sphere.mCenter.y);
+    __m128 cz = _mm_set1_ps(sphere.mCenter.z);
+    __m128 radius = _mm_set1_ps(sphere.mRadius);
+    __m128 negRadius = _mm_set1_ps(-sphere.mRadius);
+    int insideMask = 0xF;
+    for(uint32_t i = 0; i < sMaxPlanes; i += 4) {
+        __m128 dist = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(mPlaneX + i), cx), _mm_mul_ps(_mm_load_ps(mPlaneY + i), cy)),
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(mPlaneZ + i), cz), _mm_load_ps(mPlaneW + i)));
+        if(_mm_movemask_ps(_mm_cmplt_ps(dist, negRadius))) {
+            return OUTSIDE;
+        }
+        insideMask &= _mm_movemask_ps(_mm_cmpge_ps(dist, radius));
+    }
+    return insideMask == 0xF ? INSIDE : INTERSECT;
+    #else
+    bool inside = true;
+    for(uint32_t i = 0; i < mNumPlanes; ++ i) {
+        float dist = mPlaneX[i] * sphere.mCenter.x + mPlaneY[i] * sphere.mCenter.y + mPlaneZ[i] * sphere.mCenter.z + mPlaneW[i];
+        if(dist < -sphere.mRadius) {
+            return OUTSIDE;
+        }
+        if(dist < sphere.mRadius) {
+            inside = false;
+        }
+    }
+    return inside ? INSIDE : INTERSECT;
+    #endif
+}
+
+bool Frustum::testBox(const BoundingBox& box, const glm::mat4& transform) const {
+    if(std::isinf(box.mMin.x)) return true;
+
+    // Transform the box's center and half-extents, giving the world-space box which contains it
+    glm::vec3 localCenter = (box.mMin + box.mMax) * 0.5f;
+    glm::vec3 localExtent = (box.mMax - box.mMin) * 0.5f;
+    glm::vec3 center = glm::vec3(transform * glm::vec4(localCenter, 1.f));
+    glm::vec3 extent =
+        glm::abs(glm::vec3(transform[0])) * localExtent.x +
+        glm::abs(glm::vec3(transform[1])) * localExtent.y +
+        glm::abs(glm::vec3(transform[2])) * localExtent.z;
+
+    #ifdef PGG_BOUNDINGVOLUME_SSE
+    __m128 cx = _mm_set1_ps(center.x);
+    __m128 cy = _mm_set1_ps(center.y);
+    __m128 cz = _mm_set1_ps(center.z);
+    __m128 ex = _mm_set1_ps(extent.x);
+    __m128 ey = _mm_set1_ps(extent.y);
+    __m128 ez = _mm_set1_ps(extent.z);
+    __m128 signMask = _mm_set1_ps(-0.f);
+    for(uint32_t i = 0; i < sMaxPlanes; i += 4) {
+        __m128 px = _mm_load_ps(mPlaneX + i);
+        __m128 py = _mm_load_ps(mPlaneY + i);
+        __m128 pz = _mm_load_ps(mPlaneZ + i);
+        __m128 dist = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+            _mm_add_ps(_mm_mul_ps(pz, cz), _mm_load_ps(mPlaneW + i)));
+
+        // Projected radius of the box onto each plane normal
+        __m128 radius = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex), _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+            _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+        if(_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()))) {
+            return false;
+        }
+    }
+    return true;
+    #else
+    for(uint32_t i = 0; i < mNumPlanes; ++ i) {
+        float dist = mPlaneX[i] * center.x + mPlaneY[i] * center.y + mPlaneZ[i] * center.z + mPlaneW[i];
+        float radius = std::abs(mPlaneX[i]) * extent.x + std::abs(mPlaneY[i]) * extent.y + std::abs(mPlaneZ[i]) * extent.z;
+        if(dist + radius < 0.f) {
+            return false;
+        }
+    }
+    return true;
+    #endif
+}
+
+}
@@ -0,0 +1,106 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_BOUNDINGVOLUME_HPP
+#define PGG_BOUNDINGVOLUME_HPP
+
+#include <stdint.h>
+
+#include <GraphicsApiLibrary.hpp>
+
+namespace pgg {
+
+/// Axis-aligned bounding box
+struct BoundingBox {
+    glm::vec3 mMin;
+    glm::vec3 mMax;
+
+    /// A box which contains everything, for things which should never be culled
+    static BoundingBox getInfinite();
+
+    /// Positions are three floats, spaced apart by stride floats
+    static BoundingBox fromPositions(const float* positions, uint32_t count, uint32_t stride);
+};
+
+/// Bounding sphere; negative radius for empty, infinite radius to contain everything
+struct BoundingSphere {
+    glm::vec3 mCenter;
+    float mRadius;
+
+    static BoundingSphere getEmpty();
+    static BoundingSphere getInfinite();
+
+    /// Centered on the given box, just large enough to contain all of the positions
+    static BoundingSphere fromPositions(const float* positions, uint32_t count, uint32_t stride, const BoundingBox& box);
+
+    bool isEmpty() const;
+    bool isInfinite() const;
+
+    /// Sphere containing this sphere after the transformation is applied (assuming no shear)
+    BoundingSphere transformed(const glm::mat4& transform) const;
+
+    /// Smallest sphere containing both spheres
+    static BoundingSphere merge(const BoundingSphere& a, const BoundingSphere& b);
+};
+
+/**
+ * Convex volume bounded by up to eight inward-facing planes, usually the six planes of a view frustum.
+ *
+ * Planes are stored as a structure of arrays so that a volume can be tested against four planes at a
+ * time. Unused plane slots always pass.
+ */
+class Frustum {
+public:
+    static const uint32_t sMaxPlanes = 8;
+
+    enum Result {
+        OUTSIDE,
+        INTERSECT,
+        INSIDE
+    };
+
+    Frustum();
+
+    /// Extract the six planes from a view-projection matrix (OpenGL clip space)
+    void setViewProj(const glm::mat4& viewProj);
+
+    /// Add a plane, given as a normal pointing into the volume and the signed distance from the origin
+    /// Returns false if there is no room left
+    bool addPlane(const glm::vec3& normal, float distance);
+
+    uint32_t getNumPlanes() const;
+    glm::vec4 getPlane(uint32_t index) const;
+
+    /// Remove all planes, leaving a volume which contains everything
+    void clear();
+
+    Result testSphere(const BoundingSphere& sphere) const;
+
+    /// Tests the world-space box of a local-space box after transformation
+    bool testBox(const BoundingBox& box, const glm::mat4& transform) const;
+
+private:
+    // Aligned for SSE loads
+    alignas(16) float mPlaneX[sMaxPlanes];
+    alignas(16) float mPlaneY[sMaxPlanes];
+    alignas(16) float mPlaneZ[sMaxPlanes];
+    alignas(16) float mPlaneW[sMaxPlanes];
+    uint32_t mNumPlanes;
+};
+
+}
+
+#endif // PGG_BOUNDINGVOLUME_HPP
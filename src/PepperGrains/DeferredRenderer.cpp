@@ -16,6 +16,7 @@
 
 #include "DeferredRenderer.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 #include "ResourceManager.hpp"
@@ -239,18 +240,11 @@ void DeferredRenderer::load() {
                 }
             }
             */
-            {
-                const std::vector<ShaderProgramResource::Control>& controlVector = mSSIPG.inst.shaderProg->getInstancedVec3s();
-                for(std::vector<ShaderProgramResource::Control>::const_iterator iter = controlVector.begin(); iter != controlVector.end(); ++ iter) {
-                    const ShaderProgramResource::Control& entry = *iter;
-                    if(entry.name == "location") {
-                        mSSIPG.inst.partLocationHandle = entry.handle;
-                        std::cout << entry.name << std::endl;
-                    } else if(entry.name == "diffuse") {
-                        mSSIPG.inst.partDiffuseHandle = entry.handle;
-                        std::cout << entry.name << std::endl;
-                    }
-                }
+            if(mSSIPG.inst.shaderProg->findHandle(ShaderProgramResource::INSTANCED_VEC3, "location", mSSIPG.inst.partLocationHandle)) {
+                std::cout << "location" << std::endl;
+            }
+            if(mSSIPG.inst.shaderProg->findHandle(ShaderProgramResource::INSTANCED_VEC3, "diffuse", mSSIPG.inst.partDiffuseHandle)) {
+                std::cout << "diffuse" << std::endl;
             }
             
             glGenVertexArrays(1, &mSSIPG.inst.vao);
@@ -303,47 +297,18 @@ void DeferredRenderer::load() {
     {
         mScreenShader.shaderProg = resman->findShaderProgram("GBuffer.shaderProgram");
         mScreenShader.shaderProg->grab();
-        const std::vector<ShaderProgramResource::Control>& sampler2DControls = mScreenShader.shaderProg->getUniformSampler2Ds();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = sampler2DControls.begin(); iter != sampler2DControls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            
-            if(entry.name == "diffuse") {
-                mScreenShader.diffuseHandle = entry.handle;
-            }
-            else if(entry.name == "bright") {
-                mScreenShader.brightHandle = entry.handle;
-            }
-        }
+        mScreenShader.shaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "diffuse", mScreenShader.diffuseHandle);
+        mScreenShader.shaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "bright", mScreenShader.brightHandle);
     }
     // Debug shader
     {
         mDebugScreenShader.shaderProg = resman->findShaderProgram("GBufferDebug.shaderProgram");
         mDebugScreenShader.shaderProg->grab();
-        const std::vector<ShaderProgramResource::Control>& sampler2DControls = mDebugScreenShader.shaderProg->getUniformSampler2Ds();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = sampler2DControls.begin(); iter != sampler2DControls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            
-            if(entry.name == "diffuse") {
-                mDebugScreenShader.diffuseHandle = entry.handle;
-            }
-            else if(entry.name == "normal") {
-                mDebugScreenShader.normalHandle = entry.handle;
-            }
-            else if(entry.name == "depth") {
-                mDebugScreenShader.depthHandle = entry.handle;
-            }
-            else if(entry.name == "bright") {
-                mDebugScreenShader.brightHandle = entry.handle;
-            }
-        }
-        const std::vector<ShaderProgramResource::Control>& vec4Controls = mDebugScreenShader.shaderProg->getUniformVec4s();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = vec4Controls.begin(); iter != vec4Controls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            
-            if(entry.name == "showWhat") {
-                mDebugScreenShader.viewHandle = entry.handle;
-            }
-        }
+        mDebugScreenShader.shaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "diffuse", mDebugScreenShader.diffuseHandle);
+        mDebugScreenShader.shaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "normal", mDebugScreenShader.normalHandle);
+        mDebugScreenShader.shaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "depth", mDebugScreenShader.depthHandle);
+        mDebugScreenShader.shaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "bright", mDebugScreenShader.brightHandle);
+        mDebugScreenShader.shaderProg->findHandle(ShaderProgramResource::UNIFORM_VEC4, "showWhat", mDebugScreenShader.viewHandle);
         
         assert(mDebugScreenShader.shaderProg->needsInvViewProjMatrix() && "Debug G-buffer shader does not accept inverse view projection matrix");
     }
@@ -356,14 +321,7 @@ void DeferredRenderer::load() {
     {
         mFillScreenShader.shaderProg = resman->findShaderProgram("FillScreen.shaderProgram");
         mFillScreenShader.shaderProg->grab();
-        const std::vector<ShaderProgramResource::Control>& vec3Controls = mFillScreenShader.shaderProg->getUniformVec3s();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = vec3Controls.begin(); iter != vec3Controls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            
-            if(entry.name == "color") {
-                mFillScreenShader.colorHandle = entry.handle;
-            }
-        }
+        mFillScreenShader.shaderProg->findHandle(ShaderProgramResource::UNIFORM_VEC3, "color", mFillScreenShader.colorHandle);
     }
     // Fullscreen quad
     {
@@ -484,7 +442,21 @@ void DeferredRenderer::unload() {
     delete this;
 }
 
+void DeferredRenderer::submitRenderQueue(const Renderable::Pass& rendPass) {
+    mRenderQueue.sort();
+    mRenderQueue.submit(rendPass);
+    mFrameStats.renderQueue += mRenderQueue.getStats();
+}
+
 void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bool wireframe) {
+    // Bring all world transforms up to date before any pass reads them
+    mFrameStats = FrameStats();
+    mFrameStats.transformsUpdated = SceneNode::updateAllTransforms();
+    
+    // Anything could have changed GL state since the last frame
+    mGLState.invalidate();
+    mGLState.resetStats();
+
     // Calculate shadow map cascades
     {
         mSun.viewMatrix = glm::lookAt(mSun.location - mSun.direction, mSun.location, glm::vec3(0.f, 1.f, 0.f));
@@ -493,6 +465,10 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
     // Shadow-related stuff
     if(mSun.shadowsEnabled) {
         
+        // Volumes which can contain shadow casters for each cascade
+        Frustum casterVolumes[PGG_NUM_SUN_CASCADES];
+        glm::mat4 sunViewTranspose = glm::transpose(mSun.viewMatrix);
+        
         // Determine the shape of the cascades
         for(uint8_t i = 0; i < PGG_NUM_SUN_CASCADES; ++ i) {
             
@@ -531,24 +507,52 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
             }
             
             mSun.projectionMatrices[i] = glm::ortho(minBB.x, maxBB.x, minBB.y, maxBB.y, -50.f, 50.f);
+            
+            // Casters must lie within the receivers' extent across the sun's rays, and no further from the
+            // sun than the furthest receiver. Toward the sun, the volume is extruded as far as the shadow
+            // map's depth range allows, so that casters outside of the view still shadow what is inside it.
+            // Planes are given in sun space (which looks down -z) and then transformed into world space.
+            glm::vec4 sunSpacePlanes[] = {
+                glm::vec4( 1.f,  0.f,  0.f, -minBB.x),
+                glm::vec4(-1.f,  0.f,  0.f,  maxBB.x),
+                glm::vec4( 0.f,  1.f,  0.f, -minBB.y),
+                glm::vec4( 0.f, -1.f,  0.f,  maxBB.y),
+                glm::vec4( 0.f,  0.f,  1.f, -std::max(minBB.z, -50.f)),
+                glm::vec4( 0.f,  0.f, -1.f,  50.f)
+            };
+            for(const glm::vec4& sunSpacePlane : sunSpacePlanes) {
+                glm::vec4 worldPlane = sunViewTranspose * sunSpacePlane;
+                casterVolumes[i].addPlane(glm::vec3(worldPlane), worldPlane.w);
+            }
+        }
+        
+        // Cull for all cascades in a single traversal
+        for(uint8_t i = 0; i < PGG_NUM_SUN_CASCADES; ++ i) {
+            mSun.casters[i].clear();
         }
+        mRootNode->collectVisible(casterVolumes, PGG_NUM_SUN_CASCADES, mSun.casters, mFrameStats.shadowCull);
         
         // Perform shadow pass
         for(uint8_t i = 0; i < PGG_NUM_SUN_CASCADES; ++ i) {
             glViewport(0, 0, mSun.shadowMapResolution, mSun.shadowMapResolution);
             glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mSun.framebuffers[i]);
-            glDepthMask(GL_TRUE);
-            glEnable(GL_DEPTH_TEST);
-            glDepthFunc(GL_LESS);
-            glEnable(GL_CULL_FACE);
-            glCullFace(GL_BACK);
-            glDisable(GL_BLEND);
+            mGLState.depthMask(true);
+            mGLState.enable(GL_DEPTH_TEST);
+            mGLState.depthFunc(GL_LESS);
+            mGLState.enable(GL_CULL_FACE);
+            mGLState.cullFace(GL_BACK);
+            mGLState.disable(GL_BLEND);
             glClear(GL_DEPTH_BUFFER_BIT);
             
             Renderable::Pass sunRPC(Renderable::Pass::Type::SHADOW);
+            sunRPC.mGLState = &mGLState;
             sunRPC.mCamera.setViewMatrix(mSun.viewMatrix);
             sunRPC.mCamera.setProjMatrix(mSun.projectionMatrices[i]);
-            mRootNode->render(sunRPC);
+            mRenderQueue.begin(sunRPC);
+            for(SceneNode* caster : mSun.casters[i]) {
+                caster->enqueueModel(mRenderQueue, sunRPC);
+            }
+            this->submitRenderQueue(sunRPC);
         }
     }
     
@@ -565,20 +569,24 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
         }
         GLuint colorAttachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
         glDrawBuffers(4, colorAttachments);
-        glDepthMask(GL_TRUE);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
-        glDisable(GL_STENCIL_TEST);
-        glDisable(GL_CULL_FACE);
-        glDisable(GL_BLEND);
+        mGLState.depthMask(true);
+        mGLState.enable(GL_DEPTH_TEST);
+        mGLState.depthFunc(GL_LESS);
+        mGLState.disable(GL_STENCIL_TEST);
+        mGLState.disable(GL_CULL_FACE);
+        mGLState.disable(GL_BLEND);
         glClear(GL_DEPTH_BUFFER_BIT);
         
         Renderable::Pass ssipgRenderPass(Renderable::Pass::Type::SSIPG);
+        ssipgRenderPass.mGLState = &mGLState;
         ssipgRenderPass.mCamera.setViewMatrix(mCamera.viewMat);
         ssipgRenderPass.mCamera.setProjMatrix(mCamera.fov, mCamera.aspect, mCamera.nearDepth, mCamera.farDepth);
         ssipgRenderPass.mScreenWidth = mSSIPG.textureWidth;
         ssipgRenderPass.mScreenHeight = mSSIPG.textureHeight;
-        mRootNode->render(ssipgRenderPass);
+        ssipgRenderPass.enableCulling(&mFrameStats.ssipgCull);
+        mRenderQueue.begin(ssipgRenderPass);
+        mRootNode->enqueue(mRenderQueue, ssipgRenderPass);
+        this->submitRenderQueue(ssipgRenderPass);
         
         // Reset counter
         GLuint count = 0;
@@ -587,7 +595,7 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
         glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
         
         //
-        glUseProgram(mSSIPG.comp.prog);
+        mGLState.useProgram(mSSIPG.comp.prog);
         
         glUniform2fv(mSSIPG.comp.pixelSizeHandle, 1, glm::value_ptr(glm::vec2(1.f / (float) mSSIPG.textureWidth, 1.f / (float) mSSIPG.textureHeight)));
         
@@ -603,7 +611,6 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
         /*
         glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
         */
-        glUseProgram(0);
         
         //
     }
@@ -617,29 +624,32 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
         };
         glDrawBuffers(2, colorAttachments);
         glClearColor(0.f, 0.f, 0.f, 1.f);
-        glDepthMask(GL_TRUE);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
-        glDisable(GL_STENCIL_TEST);
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-        glDisable(GL_BLEND);
+        mGLState.depthMask(true);
+        mGLState.enable(GL_DEPTH_TEST);
+        mGLState.depthFunc(GL_LESS);
+        mGLState.disable(GL_STENCIL_TEST);
+        mGLState.enable(GL_CULL_FACE);
+        mGLState.cullFace(GL_BACK);
+        mGLState.disable(GL_BLEND);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
         if(wireframe) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            mGLState.polygonMode(GL_LINE);
         }
         else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            mGLState.polygonMode(GL_FILL);
         }
         
         Renderable::Pass geometryRenderPass(Renderable::Pass::Type::GEOMETRY);
+        geometryRenderPass.mGLState = &mGLState;
         geometryRenderPass.mCamera.setViewMatrix(mCamera.viewMat);
         geometryRenderPass.mCamera.setProjMatrix(mCamera.fov, mCamera.aspect, mCamera.nearDepth, mCamera.farDepth);
         geometryRenderPass.mScreenWidth = mScreenWidth;
         geometryRenderPass.mScreenHeight = mScreenHeight;
-        mRootNode->render(geometryRenderPass);
-        
+        geometryRenderPass.enableCulling(&mFrameStats.geometryCull);
+        mRenderQueue.begin(geometryRenderPass);
+        mRootNode->enqueue(mRenderQueue, geometryRenderPass);
+        this->submitRenderQueue(geometryRenderPass);
         
         glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, mSSIPG.counterBuffer);
         GLvoid* untimely = glMapBuffer(GL_ATOMIC_COUNTER_BUFFER, GL_READ_ONLY);
@@ -659,18 +669,17 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
         glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
         geometryRenderPass.mScreenWidth = mSSIPG.textureWidth;
         geometryRenderPass.mScreenHeight = mSSIPG.textureHeight;
+        geometryRenderPass.updateConstants();
         
-        glDisable(GL_CULL_FACE);
-        glUseProgram(mSSIPG.inst.shaderProg->getHandle());
+        mGLState.disable(GL_CULL_FACE);
+        mGLState.useProgram(mSSIPG.inst.shaderProg->getHandle());
         mSSIPG.inst.shaderProg->bindRenderPass(geometryRenderPass, glm::mat4());
-        glBindVertexArray(mSSIPG.inst.vao);
+        mGLState.bindVertexArray(mSSIPG.inst.vao);
         if(count > mSSIPG.maxInstances) {
             count = mSSIPG.maxInstances;
         }
         mSSIPG.inst.geometry->drawElementsInstanced(count);
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glEnable(GL_CULL_FACE);
+        mGLState.enable(GL_CULL_FACE);
     }
     
     // Brightness Render
@@ -691,15 +700,16 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
         }
         
         // Do not write to the depth buffer
-        glDepthMask(GL_FALSE);
+        mGLState.depthMask(false);
         
         // Filled polygons
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        mGLState.polygonMode(GL_FILL);
         
         // glm::mat4 sunViewProjMat = mSky.sunBasicProjectionMatrix * mSky.sunBasicViewMatrix;
         
         // Render pass config
         Renderable::Pass brightRPC(Renderable::Pass::Type::LOCAL_LIGHTS);
+        brightRPC.mGLState = &mGLState;
         brightRPC.mCamera.setViewMatrix(mCamera.viewMat);
         brightRPC.mCamera.setProjMatrix(mCamera.fov, mCamera.aspect, mCamera.nearDepth, mCamera.farDepth);
         // TODO: something else
@@ -716,7 +726,10 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
         }
         
         // Render local lights (This must come before global lights because the stencil buffer is not preserved)
-        mRootNode->render(brightRPC);
+        brightRPC.enableCulling(&mFrameStats.localLightsCull);
+        mRenderQueue.begin(brightRPC);
+        mRootNode->enqueue(mRenderQueue, brightRPC);
+        this->submitRenderQueue(brightRPC);
         
         // Render global lights
         {
@@ -724,29 +737,26 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
             // This also fills the diffuse buffer with white where the sky is
             {
                 glDrawBuffer(GL_COLOR_ATTACHMENT0);
-                glEnable(GL_DEPTH_TEST);
-                glDepthFunc(GL_LESS);
-                glEnable(GL_STENCIL_TEST);
-                glDisable(GL_CULL_FACE);
+                mGLState.enable(GL_DEPTH_TEST);
+                mGLState.depthFunc(GL_LESS);
+                mGLState.enable(GL_STENCIL_TEST);
+                mGLState.disable(GL_CULL_FACE);
                 glClearStencil(1);
                 glClear(GL_STENCIL_BUFFER_BIT);
                 
-                glStencilFunc(GL_ALWAYS, 0, 0);
+                mGLState.stencilFunc(GL_ALWAYS, 0, 0);
                 
                 // 1 = sky
                 // 0 = ground
                 glStencilOpSeparate(GL_FRONT_AND_BACK, GL_KEEP, GL_ZERO, GL_KEEP);
                 
-                glUseProgram(mSkyStencilShader.shaderProg->getHandle());
+                mGLState.useProgram(mSkyStencilShader.shaderProg->getHandle());
                 
-                glBindVertexArray(mFullscreenVao);
+                mGLState.bindVertexArray(mFullscreenVao);
                 glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-                glBindVertexArray(0);
-                
-                glUseProgram(0);
                 
                 // Only keep pixels that are not a part of the sky
-                glStencilFunc(GL_EQUAL, 0, 0xff);
+                mGLState.stencilFunc(GL_EQUAL, 0, 0xff);
             }
             
             // Prepare blending
@@ -756,17 +766,21 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
                 };
                 glDrawBuffers(1, colorAttachments);
                 
-                glDisable(GL_DEPTH_TEST);
-                glDisable(GL_CULL_FACE);
-                glEnable(GL_BLEND);
-                glBlendEquation(GL_FUNC_ADD);
-                glBlendFunc(GL_ONE, GL_ONE);
+                mGLState.disable(GL_DEPTH_TEST);
+                mGLState.disable(GL_CULL_FACE);
+                mGLState.enable(GL_BLEND);
+                mGLState.blendEquation(GL_FUNC_ADD);
+                mGLState.blendFunc(GL_ONE, GL_ONE);
             }
             
             // Actual rendering
             {    
+                // Global lights affect the whole screen regardless of where they are
                 brightRPC.mType = Renderable::Pass::Type::GLOBAL_LIGHTS;
-                mRootNode->render(brightRPC);
+                brightRPC.mCullingEnabled = false;
+                mRenderQueue.begin(brightRPC);
+                mRootNode->enqueue(mRenderQueue, brightRPC);
+                this->submitRenderQueue(brightRPC);
                 if(mSun.shadowsEnabled) {
                     mSun.sunModel->render(brightRPC, glm::inverse(mSun.viewMatrix));
                 } else {
@@ -777,6 +791,9 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
                 if(mSSAO.enabled) {
                     mSSAO.ssaoModel->render(brightRPC, glm::mat4());
                 }
+                
+                // These set their state directly
+                mGLState.invalidate();
             }
         }
     }
@@ -785,96 +802,87 @@ void DeferredRenderer::renderFrame(SceneNode* mRootNode, glm::vec4 debugShow, bo
     {
         // Note: this makes use of the stencil created during the global brightness render
         
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
-        glDisable(GL_BLEND);
-        glEnable(GL_STENCIL_TEST);
+        mGLState.disable(GL_DEPTH_TEST);
+        mGLState.disable(GL_CULL_FACE);
+        mGLState.disable(GL_BLEND);
+        mGLState.enable(GL_STENCIL_TEST);
         
         // Only keep pixels that are a part of the sky
-        glStencilFunc(GL_EQUAL, 1, 0xff);
+        mGLState.stencilFunc(GL_EQUAL, 1, 0xff);
         
         // Populate the brightness buffer
         glDrawBuffer(GL_COLOR_ATTACHMENT2);
         
-        glUseProgram(mFillScreenShader.shaderProg->getHandle());
+        mGLState.useProgram(mFillScreenShader.shaderProg->getHandle());
         
         glUniform3fv(mFillScreenShader.colorHandle, 1, glm::value_ptr(mSun.color));
         
-        glBindVertexArray(mFullscreenVao);
+        mGLState.bindVertexArray(mFullscreenVao);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-        
-        glUseProgram(0);
         
     }
     
     // Screen render
     glViewport(0, 0, mScreenWidth, mScreenHeight);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    glDepthMask(GL_FALSE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_STENCIL_TEST);
-    glDepthFunc(GL_EQUAL);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    mGLState.depthMask(false);
+    mGLState.disable(GL_DEPTH_TEST);
+    mGLState.disable(GL_STENCIL_TEST);
+    mGLState.depthFunc(GL_EQUAL);
+    mGLState.disable(GL_CULL_FACE);
+    mGLState.disable(GL_BLEND);
+    mGLState.polygonMode(GL_FILL);
     if(debugShow != glm::vec4(0.f)) {
-        glUseProgram(mDebugScreenShader.shaderProg->getHandle());
+        mGLState.useProgram(mDebugScreenShader.shaderProg->getHandle());
         
         glm::mat4 invViewProjMat = glm::inverse(mCamera.projMat * mCamera.viewMat);
         glUniformMatrix4fv(mDebugScreenShader.shaderProg->getInvViewProjMatrixUnif(), 1, GL_FALSE, glm::value_ptr(invViewProjMat));
         glUniform4fv(mDebugScreenShader.viewHandle, 1, glm::value_ptr(debugShow));
         
         // 1
-        glActiveTexture(GL_TEXTURE0 + 0);
-        glBindTexture(GL_TEXTURE_2D, mGBuff.diffuseTexture);
+        mGLState.bindTexture2D(0, mGBuff.diffuseTexture);
         glUniform1i(mDebugScreenShader.diffuseHandle, 0);
         
         // 2
-        glActiveTexture(GL_TEXTURE0 + 1);
-        glBindTexture(GL_TEXTURE_2D, mGBuff.normalTexture);
+        mGLState.bindTexture2D(1, mGBuff.normalTexture);
         glUniform1i(mDebugScreenShader.normalHandle, 1);
          
         // 3
-        glActiveTexture(GL_TEXTURE0 + 2);
-        glBindTexture(GL_TEXTURE_2D, mSSIPG.partDepthImageTexture);
+        mGLState.bindTexture2D(2, mSSIPG.partDepthImageTexture);
         glUniform1i(mDebugScreenShader.depthHandle, 2);
         
         // 4
-        glActiveTexture(GL_TEXTURE0 + 3);
-        glBindTexture(GL_TEXTURE_2D, mSSIPG.partDiffuseImageTexture);
+        mGLState.bindTexture2D(3, mSSIPG.partDiffuseImageTexture);
         glUniform1i(mDebugScreenShader.brightHandle, 3);
         
-        glBindVertexArray(mFullscreenVao);
+        mGLState.bindVertexArray(mFullscreenVao);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         
-        glBindVertexArray(0);
-        
-        glUseProgram(0);
-        
     }
     else {
-        glUseProgram(mScreenShader.shaderProg->getHandle());
+        mGLState.useProgram(mScreenShader.shaderProg->getHandle());
     
-        glActiveTexture(GL_TEXTURE0 + 0);
-        glBindTexture(GL_TEXTURE_2D, mGBuff.diffuseTexture);
+        mGLState.bindTexture2D(0, mGBuff.diffuseTexture);
         glUniform1i(mScreenShader.diffuseHandle, 0);
         
-        glActiveTexture(GL_TEXTURE0 + 1);
-        glBindTexture(GL_TEXTURE_2D, mGBuff.brightTexture);
+        mGLState.bindTexture2D(1, mGBuff.brightTexture);
         glUniform1i(mScreenShader.brightHandle, 1);
         
-        glBindVertexArray(mFullscreenVao);
+        mGLState.bindVertexArray(mFullscreenVao);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
         
-        glUseProgram(0);
     }
+    
+    // Leave nothing bound for code which runs between frames
+    mGLState.resetBindings();
+    mFrameStats.glState = mGLState.getStats();
 }
     
 DeferredRenderer::DeferredRenderer(uint32_t width, uint32_t height)
 : mScreenWidth(width)
-, mScreenHeight(height) {
+, mScreenHeight(height)
+, mGLState(&mGLBackend) {
+    mFrameStats = FrameStats();
 }
 
 DeferredRenderer::~DeferredRenderer() {
@@ -943,6 +951,15 @@ const glm::mat4& DeferredRenderer::getCameraProjectionMatrix() const {
 const glm::mat4& DeferredRenderer::getCameraViewMatrix() const {
     return mCamera.viewMat;
 }
+const DeferredRenderer::FrameStats& DeferredRenderer::getFrameStats() const {
+    return mFrameStats;
+}
+void DeferredRenderer::setGLBackend(GLBackend* backend) {
+    mGLState.setBackend(backend ? backend : &mGLBackend);
+}
+GLBackend* DeferredRenderer::getDefaultGLBackend() {
+    return &mGLBackend;
+}
 
 }
 
@@ -23,6 +23,9 @@
 #include "HardValueStuff.hpp"
 #include "ReferenceCounted.hpp"
 #include "GeometryResource.hpp"
+#include "GLBackend.hpp"
+#include "GLStateCache.hpp"
+#include "RenderQueue.hpp"
 #include "SceneNode.hpp"
 #include "ShaderProgramResource.hpp"
 #include "DirectionalLightModel.hpp"
@@ -194,6 +197,9 @@ private:
         
         glm::mat4 viewMatrix;
         
+        // Reused each frame
+        std::vector<SceneNode*> casters[PGG_NUM_SUN_CASCADES];
+        
         SunLightModel* sunModel;
         DirectionalLightModel* directionalModel;
         
@@ -211,6 +217,32 @@ private:
     };
     SSAO mSSAO;
     
+public:
+    struct FrameStats {
+        uint32_t transformsUpdated;
+        
+        Renderable::Pass::CullStats shadowCull[PGG_NUM_SUN_CASCADES];
+        Renderable::Pass::CullStats ssipgCull;
+        Renderable::Pass::CullStats geometryCull;
+        Renderable::Pass::CullStats localLightsCull;
+        
+        // Totals over every pass drawn through the render queue
+        RenderQueue::Stats renderQueue;
+        
+        // State changes requested during the frame, and how many reached the backend
+        GLStateCache::Stats glState;
+    };
+private:
+    FrameStats mFrameStats;
+    
+    // Reused by every scene pass to sort draws by state
+    RenderQueue mRenderQueue;
+    void submitRenderQueue(const Renderable::Pass& rendPass);
+    
+    // Pass setup and models which support it go through mGLState; anything else invalidates it
+    OpenGLBackend mGLBackend;
+    GLStateCache mGLState;
+    
 public:
     DeferredRenderer(uint32_t width, uint32_t height);
     ~DeferredRenderer();
@@ -242,6 +274,14 @@ public:
     // void resizeScreen(uint32_t width, uint32_t height);
     
     const glm::vec3& getCameraLocation() const;
+    
+    // Statistics from the most recent renderFrame()
+    const FrameStats& getFrameStats() const;
+    
+    // Send tracked state changes somewhere other than OpenGL, such as a RecordingGLBackend which forwards
+    // to getDefaultGLBackend(); nullptr restores the default
+    void setGLBackend(GLBackend* backend);
+    GLBackend* getDefaultGLBackend();
 };
 
 }
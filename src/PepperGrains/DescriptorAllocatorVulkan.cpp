@@ -0,0 +1,166 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef PGG_VULKAN
+
+#include "DescriptorAllocatorVulkan.hpp"
+
+#include "Logger.hpp"
+#include "Video.hpp"
+
+namespace pgg {
+
+DescriptorAllocatorVk::Stats::Stats()
+: mNumPools(0)
+, mNumAllocations(0)
+, mNumResets(0)
+, mNumFreeSets(0) { }
+
+DescriptorAllocatorVk::DescriptorAllocatorVk() { }
+DescriptorAllocatorVk::~DescriptorAllocatorVk() { }
+
+void DescriptorAllocatorVk::initialize(const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t setsPerPool) {
+    mSizesPerSet = sizesPerSet;
+    mNextSetsPerPool = setsPerPool > 0 ? setsPerPool : 1;
+}
+
+void DescriptorAllocatorVk::cleanup() {
+    // Sets are freed with their pools
+    for(Pool& pool : mUsedPools) {
+        vkDestroyDescriptorPool(Video::Vulkan::getLogicalDevice(), pool.mHandle, nullptr);
+    }
+    for(Pool& pool : mFreePools) {
+        vkDestroyDescriptorPool(Video::Vulkan::getLogicalDevice(), pool.mHandle, nullptr);
+    }
+    mUsedPools.clear();
+    mFreePools.clear();
+    mFreeSets.clear();
+}
+
+bool DescriptorAllocatorVk::nextPool() {
+    if(!mFreePools.empty()) {
+        mUsedPools.push_back(mFreePools.back());
+        mFreePools.pop_back();
+        return true;
+    }
+    
+    Pool pool;
+    pool.mMaxSets = mNextSetsPerPool;
+    
+    std::vector<VkDescriptorPoolSize> poolSizes = mSizesPerSet;
+    for(VkDescriptorPoolSize& poolSize : poolSizes) {
+        poolSize.descriptorCount *= pool.mMaxSets;
+    }
+    
+    VkDescriptorPoolCreateInfo descPoolCargs; {
+        descPoolCargs.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descPoolCargs.pNext = nullptr;
+        descPoolCargs.flags = 0;
+        descPoolCargs.poolSizeCount = poolSizes.size();
+        descPoolCargs.pPoolSizes = poolSizes.data();
+        descPoolCargs.maxSets = pool.mMaxSets;
+    }
+    
+    VkResult result = vkCreateDescriptorPool(Video::Vulkan::getLogicalDevice(), &descPoolCargs, nullptr, &(pool.mHandle));
+    if(result != VK_SUCCESS) {
+        Logger::log(Logger::WARN) << "Could not create descriptor pool for " << pool.mMaxSets << " sets" << std::endl;
+        return false;
+    }
+    
+    mUsedPools.push_back(pool);
+    if(mNextSetsPerPool < sMaxSetsPerPool) {
+        mNextSetsPerPool *= 2;
+    }
+    return true;
+}
+
+VkDescriptorSet DescriptorAllocatorVk::allocate(VkDescriptorSetLayout layout) {
+    for(std::vector<FreeSet>::iterator iter = mFreeSets.begin(); iter != mFreeSets.end(); ++ iter) {
+        if(iter->mLayout == layout) {
+            VkDescriptorSet descSet = iter->mSet;
+            *iter = mFreeSets.back();
+            mFreeSets.pop_back();
+            ++ mNumAllocations;
+            return descSet;
+        }
+    }
+    
+    if(mUsedPools.empty() || mUsedPools.back().mNumAllocated >= mUsedPools.back().mMaxSets) {
+        if(!this->nextPool()) {
+            return VK_NULL_HANDLE;
+        }
+    }
+    
+    VkDescriptorSetAllocateInfo descSetAargs; {
+        descSetAargs.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descSetAargs.pNext = nullptr;
+        descSetAargs.descriptorPool = mUsedPools.back().mHandle;
+        descSetAargs.descriptorSetCount = 1;
+        descSetAargs.pSetLayouts = &layout;
+    }
+    
+    VkDescriptorSet descSet = VK_NULL_HANDLE;
+    VkResult result = vkAllocateDescriptorSets(Video::Vulkan::getLogicalDevice(), &descSetAargs, &descSet);
+    
+    // The pool ran out of descriptors before sets, or is fragmented; either way a fresh pool will do
+    if(result != VK_SUCCESS && result != VK_ERROR_OUT_OF_HOST_MEMORY && result != VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+        if(!this->nextPool()) {
+            return VK_NULL_HANDLE;
+        }
+        descSetAargs.descriptorPool = mUsedPools.back().mHandle;
+        result = vkAllocateDescriptorSets(Video::Vulkan::getLogicalDevice(), &descSetAargs, &descSet);
+    }
+    
+    if(result != VK_SUCCESS) {
+        Logger::log(Logger::WARN) << "Could not allocate descriptor set" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    
+    ++ mUsedPools.back().mNumAllocated;
+    ++ mNumAllocations;
+    return descSet;
+}
+
+void DescriptorAllocatorVk::free(VkDescriptorSet descSet, VkDescriptorSetLayout layout) {
+    FreeSet freeSet;
+    freeSet.mLayout = layout;
+    freeSet.mSet = descSet;
+    mFreeSets.push_back(freeSet);
+}
+
+void DescriptorAllocatorVk::reset() {
+    for(Pool& pool : mUsedPools) {
+        vkResetDescriptorPool(Video::Vulkan::getLogicalDevice(), pool.mHandle, 0);
+        pool.mNumAllocated = 0;
+        mFreePools.push_back(pool);
+    }
+    mUsedPools.clear();
+    mFreeSets.clear();
+    ++ mNumResets;
+}
+
+DescriptorAllocatorVk::Stats DescriptorAllocatorVk::getStats() const {
+    Stats stats;
+    stats.mNumPools = mUsedPools.size() + mFreePools.size();
+    stats.mNumAllocations = mNumAllocations;
+    stats.mNumResets = mNumResets;
+    stats.mNumFreeSets = mFreeSets.size();
+    return stats;
+}
+
+}
+
+#endif // PGG_VULKAN
@@ -0,0 +1,112 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_DESCRIPTORALLOCATORVULKAN_HPP
+#define PGG_DESCRIPTORALLOCATORVULKAN_HPP
+
+#ifdef PGG_VULKAN
+
+#include <stdint.h>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+namespace pgg {
+
+/**
+ * @brief Allocates descriptor sets from pools which are created as they are needed
+ * 
+ * Sets are never returned to their pools one at a time. Instead, reset() returns every set at once and keeps the pools
+ * for reuse, so an allocator can be given to something with a known lifetime (such as a frame in flight) and reset
+ * once that is over. A single set which is no longer needed can be given back with free(), and is handed out again by
+ * a later allocate() with the same layout.
+ * 
+ * Every pool holds the same ratio of descriptor types, given per set. Layouts allocated from this must not need
+ * more of any type than that, since full pools are detected by counting sets. (Drivers without
+ * VK_KHR_maintenance1 need not report running out of descriptors.)
+ */
+class DescriptorAllocatorVk {
+public:
+    struct Stats {
+        Stats();
+        
+        uint32_t mNumPools;
+        uint32_t mNumAllocations;
+        uint32_t mNumResets;
+        
+        /// Freed sets waiting to be handed out again
+        uint32_t mNumFreeSets;
+    };
+    
+private:
+    struct Pool {
+        VkDescriptorPool mHandle = VK_NULL_HANDLE;
+        uint32_t mMaxSets = 0;
+        uint32_t mNumAllocated = 0;
+    };
+    
+    std::vector<VkDescriptorPoolSize> mSizesPerSet;
+    
+    /// Allocations come from the last pool; the others are full
+    std::vector<Pool> mUsedPools;
+    
+    /// Reset pools waiting to be used again
+    std::vector<Pool> mFreePools;
+    
+    struct FreeSet {
+        VkDescriptorSetLayout mLayout;
+        VkDescriptorSet mSet;
+    };
+    std::vector<FreeSet> mFreeSets;
+    
+    /// Each pool created has room for twice as many sets as the last, up to sMaxSetsPerPool
+    uint32_t mNextSetsPerPool = 0;
+    static const uint32_t sMaxSetsPerPool = 4096;
+    
+    uint32_t mNumAllocations = 0;
+    uint32_t mNumResets = 0;
+    
+    bool nextPool();
+    
+public:
+    DescriptorAllocatorVk();
+    ~DescriptorAllocatorVk();
+    
+    /**
+     * @brief Sets the descriptor types to make room for; no pools are created until the first allocation
+     * @param sizesPerSet how many of each type of descriptor one set may contain
+     * @param setsPerPool how many sets the first pool holds
+     */
+    void initialize(const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t setsPerPool);
+    void cleanup();
+    
+    /// Returns VK_NULL_HANDLE if no pool could be created; the set may have been freed before, so write all of it
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+    
+    /// Keeps the set to be allocated again; it must have been allocated with this layout and no longer be in use
+    void free(VkDescriptorSet descSet, VkDescriptorSetLayout layout);
+    
+    /// Returns every set allocated so far to the pools; none of them may still be in use by the device
+    void reset();
+    
+    Stats getStats() const;
+};
+
+}
+
+#endif // PGG_VULKAN
+
+#endif // PGG_DESCRIPTORALLOCATORVULKAN_HPP
@@ -0,0 +1,303 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef PGG_VULKAN
+
+#include "DescriptorSetCacheVulkan.hpp"
+
+#include <algorithm>
+
+#include "Video.hpp"
+
+namespace pgg {
+
+namespace {
+    
+    /// 64-bit FNV-1a, fed one field at a time since the info structs contain padding
+    class SetHasher {
+    public:
+        uint64_t mHash = 14695981039346656037ull;
+        
+        template<typename T>
+        void add(const T& value) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+            for(std::size_t i = 0; i < sizeof(value); ++ i) {
+                mHash = (mHash ^ bytes[i]) * 1099511628211ull;
+            }
+        }
+    };
+    
+    bool isImageDescriptor(VkDescriptorType type) {
+        return type == VK_DESCRIPTOR_TYPE_SAMPLER
+            || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+            || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+            || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+            || type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+    
+    /// Compares the same fields which are hashed
+    bool sameBinding(const DescriptorSetCacheVk::Binding& a, const DescriptorSetCacheVk::Binding& b) {
+        if(a.mBinding != b.mBinding || a.mType != b.mType) {
+            return false;
+        }
+        if(isImageDescriptor(a.mType)) {
+            return a.mImageInfo.sampler == b.mImageInfo.sampler
+                && a.mImageInfo.imageView == b.mImageInfo.imageView
+                && a.mImageInfo.imageLayout == b.mImageInfo.imageLayout;
+        } else {
+            return a.mBufferInfo.buffer == b.mBufferInfo.buffer
+                && a.mBufferInfo.offset == b.mBufferInfo.offset
+                && a.mBufferInfo.range == b.mBufferInfo.range;
+        }
+    }
+    
+} // namespace
+
+std::mutex DescriptorSetCacheVk::sInstancesMutex;
+std::vector<DescriptorSetCacheVk*> DescriptorSetCacheVk::sInstances;
+
+DescriptorSetCacheVk::Binding DescriptorSetCacheVk::makeBufferBinding(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    Binding retVal;
+    retVal.mBinding = binding;
+    retVal.mType = type;
+    retVal.mBufferInfo.buffer = buffer;
+    retVal.mBufferInfo.offset = offset;
+    retVal.mBufferInfo.range = range;
+    retVal.mImageInfo.sampler = VK_NULL_HANDLE;
+    retVal.mImageInfo.imageView = VK_NULL_HANDLE;
+    retVal.mImageInfo.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    return retVal;
+}
+
+DescriptorSetCacheVk::Binding DescriptorSetCacheVk::makeImageBinding(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout) {
+    Binding retVal;
+    retVal.mBinding = binding;
+    retVal.mType = type;
+    retVal.mBufferInfo.buffer = VK_NULL_HANDLE;
+    retVal.mBufferInfo.offset = 0;
+    retVal.mBufferInfo.range = 0;
+    retVal.mImageInfo.sampler = sampler;
+    retVal.mImageInfo.imageView = view;
+    retVal.mImageInfo.imageLayout = layout;
+    return retVal;
+}
+
+DescriptorSetCacheVk::Stats::Stats()
+: mNumSets(0)
+, mNumHits(0)
+, mNumMisses(0)
+, mNumRetired(0) { }
+
+DescriptorSetCacheVk::DescriptorSetCacheVk() { }
+DescriptorSetCacheVk::~DescriptorSetCacheVk() { }
+
+void DescriptorSetCacheVk::initialize(const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t setsPerPool) {
+    mAllocator.initialize(sizesPerSet, setsPerPool);
+    
+    std::lock_guard<std::mutex> lock(sInstancesMutex);
+    sInstances.push_back(this);
+}
+
+void DescriptorSetCacheVk::cleanup() {
+    {
+        std::lock_guard<std::mutex> lock(sInstancesMutex);
+        sInstances.erase(std::remove(sInstances.begin(), sInstances.end(), this), sInstances.end());
+    }
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSets.clear();
+    mSetsByView.clear();
+    mRetired.clear();
+    mAllocator.cleanup();
+}
+
+uint64_t DescriptorSetCacheVk::hashSet(VkDescriptorSetLayout layout, const std::vector<Binding>& bindings) {
+    SetHasher hasher;
+    hasher.add(layout);
+    for(const Binding& binding : bindings) {
+        hasher.add(binding.mBinding);
+        hasher.add(binding.mType);
+        if(isImageDescriptor(binding.mType)) {
+            hasher.add(binding.mImageInfo.sampler);
+            hasher.add(binding.mImageInfo.imageView);
+            hasher.add(binding.mImageInfo.imageLayout);
+        } else {
+            hasher.add(binding.mBufferInfo.buffer);
+            hasher.add(binding.mBufferInfo.offset);
+            hasher.add(binding.mBufferInfo.range);
+        }
+    }
+    return hasher.mHash;
+}
+
+bool DescriptorSetCacheVk::matches(const CachedSet& cached, VkDescriptorSetLayout layout, const std::vector<Binding>& bindings) {
+    if(cached.mLayout != layout || cached.mBindings.size() != bindings.size()) {
+        return false;
+    }
+    for(std::size_t i = 0; i < bindings.size(); ++ i) {
+        if(!sameBinding(cached.mBindings[i], bindings[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+VkDescriptorSet DescriptorSetCacheVk::findOrCreate(VkDescriptorSetLayout layout, const std::vector<Binding>& bindings) {
+    uint64_t hash = hashSet(layout, bindings);
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    std::pair<std::unordered_multimap<uint64_t, CachedSet>::iterator, std::unordered_multimap<uint64_t, CachedSet>::iterator> range = mSets.equal_range(hash);
+    for(std::unordered_multimap<uint64_t, CachedSet>::iterator iter = range.first; iter != range.second; ++ iter) {
+        if(matches(iter->second, layout, bindings)) {
+            ++ mNumHits;
+            return iter->second.mSet;
+        }
+    }
+    ++ mNumMisses;
+    
+    VkDescriptorSet descSet = mAllocator.allocate(layout);
+    if(descSet == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+    }
+    
+    std::vector<VkWriteDescriptorSet> writes(bindings.size());
+    for(std::size_t i = 0; i < bindings.size(); ++ i) {
+        const Binding& binding = bindings[i];
+        bool isImage = isImageDescriptor(binding.mType);
+        
+        VkWriteDescriptorSet& writeDescSet = writes[i]; {
+            writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescSet.pNext = nullptr;
+            writeDescSet.dstSet = descSet;
+            writeDescSet.dstBinding = binding.mBinding;
+            writeDescSet.dstArrayElement = 0;
+            writeDescSet.descriptorType = binding.mType;
+            writeDescSet.descriptorCount = 1;
+            writeDescSet.pBufferInfo = isImage ? nullptr : &(binding.mBufferInfo);
+            writeDescSet.pImageInfo = isImage ? &(binding.mImageInfo) : nullptr;
+            writeDescSet.pTexelBufferView = nullptr;
+        }
+    }
+    vkUpdateDescriptorSets(Video::Vulkan::getLogicalDevice(), writes.size(), writes.data(), 0, nullptr);
+    
+    CachedSet cached;
+    cached.mLayout = layout;
+    cached.mBindings = bindings;
+    cached.mSet = descSet;
+    mSets.insert(std::make_pair(hash, cached));
+    for(const Binding& binding : bindings) {
+        if(isImageDescriptor(binding.mType)) {
+            mSetsByView.insert(std::make_pair(binding.mImageInfo.imageView, std::make_pair(hash, descSet)));
+        }
+    }
+    return descSet;
+}
+
+void DescriptorSetCacheVk::forgetSet(uint64_t hash, VkDescriptorSet descSet) {
+    std::pair<std::unordered_multimap<uint64_t, CachedSet>::iterator, std::unordered_multimap<uint64_t, CachedSet>::iterator> range = mSets.equal_range(hash);
+    std::unordered_multimap<uint64_t, CachedSet>::iterator found = range.second;
+    for(std::unordered_multimap<uint64_t, CachedSet>::iterator iter = range.first; iter != range.second; ++ iter) {
+        if(iter->second.mSet == descSet) {
+            found = iter;
+            break;
+        }
+    }
+    if(found == range.second) {
+        return;
+    }
+    
+    // Also drop the entries for any other views in the same set
+    for(const Binding& binding : found->second.mBindings) {
+        if(!isImageDescriptor(binding.mType)) {
+            continue;
+        }
+        std::unordered_multimap<VkImageView, std::pair<uint64_t, VkDescriptorSet> >::iterator viewIter = mSetsByView.find(binding.mImageInfo.imageView);
+        while(viewIter != mSetsByView.end() && viewIter->first == binding.mImageInfo.imageView) {
+            if(viewIter->second.second == descSet) {
+                viewIter = mSetsByView.erase(viewIter);
+            } else {
+                ++ viewIter;
+            }
+        }
+    }
+    
+    RetiredSet retired;
+    retired.mLayout = found->second.mLayout;
+    retired.mSet = descSet;
+    retired.mUpdate = mUpdate;
+    mRetired.push_back(retired);
+    
+    mSets.erase(found);
+}
+
+void DescriptorSetCacheVk::forgetImageView(VkImageView view) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    // Copied out first, since forgetting a set removes its entries from mSetsByView
+    std::vector<std::pair<uint64_t, VkDescriptorSet> > forgotten;
+    std::pair<std::unordered_multimap<VkImageView, std::pair<uint64_t, VkDescriptorSet> >::iterator, std::unordered_multimap<VkImageView, std::pair<uint64_t, VkDescriptorSet> >::iterator> range = mSetsByView.equal_range(view);
+    for(std::unordered_multimap<VkImageView, std::pair<uint64_t, VkDescriptorSet> >::iterator iter = range.first; iter != range.second; ++ iter) {
+        forgotten.push_back(iter->second);
+    }
+    for(const std::pair<uint64_t, VkDescriptorSet>& set : forgotten) {
+        this->forgetSet(set.first, set.second);
+    }
+}
+
+void DescriptorSetCacheVk::forgetImageViewInAll(VkImageView view) {
+    if(view == VK_NULL_HANDLE) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(sInstancesMutex);
+    for(DescriptorSetCacheVk* cache : sInstances) {
+        cache->forgetImageView(view);
+    }
+}
+
+void DescriptorSetCacheVk::update(uint32_t framesInFlight) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    ++ mUpdate;
+    
+    // Frames recorded before a set was forgotten may still bind it until they complete
+    while(!mRetired.empty() && mRetired.front().mUpdate + framesInFlight <= mUpdate) {
+        mAllocator.free(mRetired.front().mSet, mRetired.front().mLayout);
+        mRetired.pop_front();
+    }
+}
+
+void DescriptorSetCacheVk::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSets.clear();
+    mSetsByView.clear();
+    mRetired.clear();
+    mAllocator.reset();
+}
+
+DescriptorSetCacheVk::Stats DescriptorSetCacheVk::getStats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Stats stats;
+    stats.mNumSets = mSets.size();
+    stats.mNumHits = mNumHits;
+    stats.mNumMisses = mNumMisses;
+    stats.mNumRetired = mRetired.size();
+    return stats;
+}
+
+}
+
+#endif // PGG_VULKAN
@@ -0,0 +1,148 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_DESCRIPTORSETCACHEVULKAN_HPP
+#define PGG_DESCRIPTORSETCACHEVULKAN_HPP
+
+#ifdef PGG_VULKAN
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+#include "DescriptorAllocatorVulkan.hpp"
+
+namespace pgg {
+
+/**
+ * @brief Descriptor sets which are written once, keyed by a hash of their layout and contents
+ * 
+ * Meant for materials: asking for a set which points at the same buffers, images and samplers as one already made
+ * returns that set, without allocating or writing anything. Sets are never updated after they are made, so they can
+ * be shared by any number of draws and frames.
+ * 
+ * Resources are hashed by handle, and a hit also compares the layout and every binding, so two different sets can
+ * never be confused by a hash collision. A destroyed object's handle may still be given to a new object, though. Clear
+ * the cache (once the device no longer uses any of its sets) before destroying buffers or samplers its sets point at.
+ * Image views come and go with images, so forget them in every cache with forgetImageViewInAll() before destroying
+ * them instead.
+ */
+class DescriptorSetCacheVk {
+public:
+    /// One descriptor to write; only the info matching the type is used
+    struct Binding {
+        uint32_t mBinding;
+        VkDescriptorType mType;
+        VkDescriptorBufferInfo mBufferInfo;
+        VkDescriptorImageInfo mImageInfo;
+    };
+    
+    static Binding makeBufferBinding(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    static Binding makeImageBinding(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout);
+    
+    struct Stats {
+        Stats();
+        
+        uint32_t mNumSets;
+        uint32_t mNumHits;
+        uint32_t mNumMisses;
+        
+        /// Forgotten sets which frames in flight may still use
+        uint32_t mNumRetired;
+    };
+    
+private:
+    /// What a set was written with, kept to rule out hash collisions
+    struct CachedSet {
+        VkDescriptorSetLayout mLayout;
+        std::vector<Binding> mBindings;
+        VkDescriptorSet mSet;
+    };
+    
+    DescriptorAllocatorVk mAllocator;
+    std::unordered_multimap<uint64_t, CachedSet> mSets;
+    
+    /// Hashes and handles of the sets pointing at each image view
+    std::unordered_multimap<VkImageView, std::pair<uint64_t, VkDescriptorSet> > mSetsByView;
+    
+    struct RetiredSet {
+        VkDescriptorSetLayout mLayout;
+        VkDescriptorSet mSet;
+        
+        /// Value of mUpdate when the set was forgotten
+        uint64_t mUpdate;
+    };
+    
+    /// Forgotten sets, oldest first; freed once no frame recorded before they were forgotten can still be in flight
+    std::deque<RetiredSet> mRetired;
+    uint64_t mUpdate = 0;
+    
+    uint32_t mNumHits = 0;
+    uint32_t mNumMisses = 0;
+    
+    /// Views may be forgotten from whichever thread destroys them
+    mutable std::mutex mMutex;
+    
+    /// Every initialized cache, for forgetImageViewInAll()
+    static std::mutex sInstancesMutex;
+    static std::vector<DescriptorSetCacheVk*> sInstances;
+    
+    static uint64_t hashSet(VkDescriptorSetLayout layout, const std::vector<Binding>& bindings);
+    static bool matches(const CachedSet& cached, VkDescriptorSetLayout layout, const std::vector<Binding>& bindings);
+    
+    /// Removes one set from the lookups and retires it; must hold mMutex
+    void forgetSet(uint64_t hash, VkDescriptorSet descSet);
+    
+public:
+    DescriptorSetCacheVk();
+    ~DescriptorSetCacheVk();
+    
+    /// See DescriptorAllocatorVk::initialize()
+    void initialize(const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t setsPerPool);
+    void cleanup();
+    
+    /// Returns VK_NULL_HANDLE if a new set was needed and could not be allocated
+    VkDescriptorSet findOrCreate(VkDescriptorSetLayout layout, const std::vector<Binding>& bindings);
+    
+    /**
+     * @brief Stops returning sets which point at the view, so that a later view given the same handle cannot match them
+     * The sets are freed by the update() framesInFlight calls later, and stay valid until then for as long as the view
+     * does.
+     */
+    void forgetImageView(VkImageView view);
+    
+    /// Calls forgetImageView() on every initialized cache; call before destroying any view that sets may point at
+    static void forgetImageViewInAll(VkImageView view);
+    
+    /// Call once per frame, after waiting for the frame being reused; frees sets forgotten framesInFlight updates ago
+    void update(uint32_t framesInFlight);
+    
+    /// Forgets every set and returns them to the pools
+    void clear();
+    
+    Stats getStats() const;
+};
+
+}
+
+#endif // PGG_VULKAN
+
+#endif // PGG_DESCRIPTORSETCACHEVULKAN_HPP
@@ -0,0 +1,299 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef PGG_VULKAN
+
+#include "DeviceMemoryAllocatorVulkan.hpp"
+
+#include <cassert>
+
+#include "Logger.hpp"
+
+namespace pgg {
+
+DeviceMemoryAllocatorVk::Stats::Stats()
+: mNumBlocks(0)
+, mBlockBytes(0)
+, mNumDedicated(0)
+, mDedicatedBytes(0) { }
+
+DeviceMemoryAllocatorVk::DeviceMemoryAllocatorVk() {
+    mMemoryProperties.memoryTypeCount = 0;
+    mMemoryProperties.memoryHeapCount = 0;
+}
+DeviceMemoryAllocatorVk::~DeviceMemoryAllocatorVk() { }
+
+bool DeviceMemoryAllocatorVk::initialize(
+    VkDevice device, 
+    const VkPhysicalDeviceMemoryProperties& memoryProperties, 
+    VkDeviceSize bufferImageGranularity, 
+    VkDeviceSize blockSize) {
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    mDevice = device;
+    mMemoryProperties = memoryProperties;
+    mBufferImageGranularity = bufferImageGranularity < 1 ? 1 : bufferImageGranularity;
+    mBlockSize = blockSize;
+    
+    mNumDedicated = 0;
+    mDedicatedBytes = 0;
+    
+    return true;
+}
+
+void DeviceMemoryAllocatorVk::cleanup() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    uint32_t leaked = 0;
+    for(uint32_t memoryType = 0; memoryType < VK_MAX_MEMORY_TYPES; ++ memoryType) {
+        for(Block& block : mBlocks[memoryType]) {
+            if(!block.mRanges) {
+                continue;
+            }
+            if(!block.mRanges->isEmpty()) {
+                leaked += block.mRanges->getStats().mNumAllocations;
+            }
+            delete block.mRanges;
+            
+            // Freeing memory implicitly unmaps it
+            vkFreeMemory(mDevice, block.mMemory, nullptr);
+        }
+        mBlocks[memoryType].clear();
+    }
+    
+    if(leaked > 0 || mNumDedicated > 0) {
+        Logger::log(Logger::WARN)
+            << leaked << " device memory allocations and "
+            << mNumDedicated << " dedicated allocations were not freed" << std::endl;
+    }
+    
+    mDevice = VK_NULL_HANDLE;
+}
+
+VkDeviceSize DeviceMemoryAllocatorVk::getBlockSize(uint32_t memoryType) const {
+    // Avoid taking a large share of small heaps (e.g. host visible device local memory) in one go
+    VkDeviceSize heapSize = mMemoryProperties.memoryHeaps[mMemoryProperties.memoryTypes[memoryType].heapIndex].size;
+    VkDeviceSize blockSize = mBlockSize;
+    while(blockSize > heapSize / 8 && blockSize > 1024 * 1024) {
+        blockSize /= 2;
+    }
+    return blockSize;
+}
+
+VkResult DeviceMemoryAllocatorVk::allocateMemory(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory* memory, void** mapped) {
+    VkMemoryAllocateInfo allocArgs; {
+        allocArgs.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocArgs.pNext = nullptr;
+        
+        allocArgs.allocationSize = size;
+        allocArgs.memoryTypeIndex = memoryType;
+    }
+    
+    VkResult result = vkAllocateMemory(mDevice, &allocArgs, nullptr, memory);
+    if(result != VK_SUCCESS) {
+        (*memory) = VK_NULL_HANDLE;
+        (*mapped) = nullptr;
+        return result;
+    }
+    
+    (*mapped) = nullptr;
+    if(mMemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        result = vkMapMemory(mDevice, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+        if(result != VK_SUCCESS) {
+            vkFreeMemory(mDevice, *memory, nullptr);
+            (*memory) = VK_NULL_HANDLE;
+            (*mapped) = nullptr;
+            return result;
+        }
+    }
+    
+    return VK_SUCCESS;
+}
+
+bool DeviceMemoryAllocatorVk::allocateFromType(uint32_t memoryType, const VkMemoryRequirements& requirements, Tiling tiling, Allocation* allocation) {
+    std::vector<Block>& blocks = mBlocks[memoryType];
+    
+    VkDeviceSize blockSize = this->getBlockSize(memoryType);
+    if(requirements.size > blockSize / 2) {
+        return this->allocateDedicated(memoryType, requirements, allocation);
+    }
+    
+    uint32_t unusedSlot = sDedicatedBlock;
+    for(uint32_t blockIndex = 0; blockIndex < blocks.size(); ++ blockIndex) {
+        Block& block = blocks[blockIndex];
+        if(!block.mRanges) {
+            unusedSlot = blockIndex;
+            continue;
+        }
+        
+        VkDeviceSize offset;
+        TlsfRangeAllocator::Handle range = block.mRanges->allocate(requirements.size, requirements.alignment, tiling, offset);
+        if(range != TlsfRangeAllocator::sInvalidHandle) {
+            allocation->mMemory = block.mMemory;
+            allocation->mOffset = offset;
+            allocation->mSize = requirements.size;
+            allocation->mMapped = block.mMapped ? static_cast<uint8_t*>(block.mMapped) + offset : nullptr;
+            allocation->mMemoryType = memoryType;
+            allocation->mBlock = blockIndex;
+            allocation->mRange = range;
+            return true;
+        }
+    }
+    
+    // No room in any existing block, so make a new one
+    Block block;
+    VkResult result = this->allocateMemory(memoryType, blockSize, &block.mMemory, &block.mMapped);
+    if(result != VK_SUCCESS) {
+        // Memory might be too tight for a whole block but not for just this
+        return this->allocateDedicated(memoryType, requirements, allocation);
+    }
+    block.mRanges = new TlsfRangeAllocator(blockSize, mBufferImageGranularity);
+    
+    uint32_t blockIndex;
+    if(unusedSlot != sDedicatedBlock) {
+        blockIndex = unusedSlot;
+        blocks[blockIndex] = block;
+    } else {
+        blockIndex = blocks.size();
+        blocks.push_back(block);
+    }
+    
+    VkDeviceSize offset;
+    TlsfRangeAllocator::Handle range = block.mRanges->allocate(requirements.size, requirements.alignment, tiling, offset);
+    assert(range != TlsfRangeAllocator::sInvalidHandle && "Fresh block too small for request");
+    
+    allocation->mMemory = block.mMemory;
+    allocation->mOffset = offset;
+    allocation->mSize = requirements.size;
+    allocation->mMapped = block.mMapped ? static_cast<uint8_t*>(block.mMapped) + offset : nullptr;
+    allocation->mMemoryType = memoryType;
+    allocation->mBlock = blockIndex;
+    allocation->mRange = range;
+    return true;
+}
+
+bool DeviceMemoryAllocatorVk::allocateDedicated(uint32_t memoryType, const VkMemoryRequirements& requirements, Allocation* allocation) {
+    VkDeviceMemory memory;
+    void* mapped;
+    VkResult result = this->allocateMemory(memoryType, requirements.size, &memory, &mapped);
+    if(result != VK_SUCCESS) {
+        return false;
+    }
+    
+    ++ mNumDedicated;
+    mDedicatedBytes += requirements.size;
+    
+    allocation->mMemory = memory;
+    allocation->mOffset = 0;
+    allocation->mSize = requirements.size;
+    allocation->mMapped = mapped;
+    allocation->mMemoryType = memoryType;
+    allocation->mBlock = sDedicatedBlock;
+    allocation->mRange = TlsfRangeAllocator::sInvalidHandle;
+    return true;
+}
+
+void DeviceMemoryAllocatorVk::releaseBlock(uint32_t memoryType, uint32_t blockIndex) {
+    Block& block = mBlocks[memoryType][blockIndex];
+    delete block.mRanges;
+    block.mRanges = nullptr;
+    vkFreeMemory(mDevice, block.mMemory, nullptr);
+    block.mMemory = VK_NULL_HANDLE;
+    block.mMapped = nullptr;
+}
+
+bool DeviceMemoryAllocatorVk::allocate(
+    const VkMemoryRequirements& requirements, 
+    VkMemoryPropertyFlags requiredProperties, 
+    Tiling tiling, 
+    Allocation* allocation) {
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    // Memory types are ordered by preference, so try them in order, moving on if one is exhausted
+    for(uint32_t memoryType = 0; memoryType < mMemoryProperties.memoryTypeCount; ++ memoryType) {
+        if(!(requirements.memoryTypeBits & (1u << memoryType))) {
+            continue;
+        }
+        if((mMemoryProperties.memoryTypes[memoryType].propertyFlags & requiredProperties) != requiredProperties) {
+            continue;
+        }
+        
+        if(this->allocateFromType(memoryType, requirements, tiling, allocation)) {
+            return true;
+        }
+    }
+    
+    Logger::log(Logger::WARN) << "Could not allocate " << requirements.size << " bytes of device memory" << std::endl;
+    (*allocation) = Allocation();
+    return false;
+}
+
+void DeviceMemoryAllocatorVk::free(Allocation* allocation) {
+    if(allocation->mMemory == VK_NULL_HANDLE) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    if(allocation->mBlock == sDedicatedBlock) {
+        vkFreeMemory(mDevice, allocation->mMemory, nullptr);
+        -- mNumDedicated;
+        mDedicatedBytes -= allocation->mSize;
+    } else {
+        std::vector<Block>& blocks = mBlocks[allocation->mMemoryType];
+        Block& block = blocks[allocation->mBlock];
+        assert(block.mMemory == allocation->mMemory && "Allocation does not belong to this block");
+        block.mRanges->free(allocation->mRange);
+        
+        // Keep one empty block around per memory type, so that repeatedly allocating and freeing a single
+        // resource does not allocate device memory every time
+        if(block.mRanges->isEmpty()) {
+            for(uint32_t blockIndex = 0; blockIndex < blocks.size(); ++ blockIndex) {
+                if(blockIndex != allocation->mBlock && blocks[blockIndex].mRanges && blocks[blockIndex].mRanges->isEmpty()) {
+                    this->releaseBlock(allocation->mMemoryType, allocation->mBlock);
+                    break;
+                }
+            }
+        }
+    }
+    
+    (*allocation) = Allocation();
+}
+
+DeviceMemoryAllocatorVk::Stats DeviceMemoryAllocatorVk::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    Stats stats;
+    for(uint32_t memoryType = 0; memoryType < VK_MAX_MEMORY_TYPES; ++ memoryType) {
+        for(const Block& block : mBlocks[memoryType]) {
+            if(!block.mRanges) {
+                continue;
+            }
+            ++ stats.mNumBlocks;
+            stats.mBlockBytes += block.mRanges->getCapacity();
+            stats.mRanges += block.mRanges->getStats();
+        }
+    }
+    stats.mNumDedicated = mNumDedicated;
+    stats.mDedicatedBytes = mDedicatedBytes;
+    return stats;
+}
+
+}
+
+#endif // PGG_VULKAN
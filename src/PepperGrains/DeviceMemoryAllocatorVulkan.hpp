@@ -0,0 +1,153 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_DEVICEMEMORYALLOCATORVULKAN_HPP
+#define PGG_DEVICEMEMORYALLOCATORVULKAN_HPP
+
+#ifdef PGG_VULKAN
+
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+#include "TlsfRangeAllocator.hpp"
+
+namespace pgg {
+
+/**
+ * @brief Sub-allocates device memory for buffers and images out of large blocks
+ * 
+ * Each memory type gets its own list of blocks, which are allocated with vkAllocateMemory on demand. Placement
+ * within a block is done by a TlsfRangeAllocator, which also keeps linear and optimally tiled resources
+ * bufferImageGranularity apart. Requests too large to share a block get a dedicated VkDeviceMemory.
+ * 
+ * Blocks in host visible memory are mapped once when they are created and stay mapped, since a VkDeviceMemory
+ * cannot be mapped more than once at a time.
+ * 
+ * Thread-safe.
+ */
+class DeviceMemoryAllocatorVk {
+public:
+    static const VkDeviceSize sDefaultBlockSize = 64 * 1024 * 1024;
+    
+    /// Buffers and VK_IMAGE_TILING_LINEAR images are linear, VK_IMAGE_TILING_OPTIMAL images are optimal
+    enum Tiling {
+        LINEAR,
+        OPTIMAL
+    };
+    
+    struct Allocation {
+        VkDeviceMemory mMemory = VK_NULL_HANDLE;
+        VkDeviceSize mOffset = 0;
+        VkDeviceSize mSize = 0;
+        
+        /// Address of mOffset within the memory if it is host visible, nullptr otherwise
+        /// Writes must still be flushed unless the memory is also host coherent
+        void* mMapped = nullptr;
+        
+        /// Used internally to free the allocation
+        uint32_t mMemoryType = 0;
+        uint32_t mBlock = 0;
+        TlsfRangeAllocator::Handle mRange = TlsfRangeAllocator::sInvalidHandle;
+    };
+    
+    struct Stats {
+        Stats();
+        
+        uint32_t mNumBlocks;
+        VkDeviceSize mBlockBytes;
+        
+        uint32_t mNumDedicated;
+        VkDeviceSize mDedicatedBytes;
+        
+        /// Summed over all blocks; the fragmentation is of the free space in blocks only
+        TlsfRangeAllocator::Stats mRanges;
+    };
+    
+private:
+    static const uint32_t sDedicatedBlock = 0xffffffffu;
+    
+    struct Block {
+        VkDeviceMemory mMemory;
+        void* mMapped;
+        
+        /// nullptr if this slot is unused, so that indices into the block list stay valid
+        TlsfRangeAllocator* mRanges;
+    };
+    
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties mMemoryProperties;
+    VkDeviceSize mBufferImageGranularity = 1;
+    VkDeviceSize mBlockSize = sDefaultBlockSize;
+    
+    std::vector<Block> mBlocks[VK_MAX_MEMORY_TYPES];
+    
+    uint32_t mNumDedicated = 0;
+    VkDeviceSize mDedicatedBytes = 0;
+    
+    std::mutex mMutex;
+    
+    /// Block size to use for a memory type, which is smaller for small heaps
+    VkDeviceSize getBlockSize(uint32_t memoryType) const;
+    
+    VkResult allocateMemory(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory* memory, void** mapped);
+    
+    bool allocateFromType(uint32_t memoryType, const VkMemoryRequirements& requirements, Tiling tiling, Allocation* allocation);
+    bool allocateDedicated(uint32_t memoryType, const VkMemoryRequirements& requirements, Allocation* allocation);
+    void releaseBlock(uint32_t memoryType, uint32_t blockIndex);
+    
+public:
+    DeviceMemoryAllocatorVk();
+    ~DeviceMemoryAllocatorVk();
+    
+    /**
+     * @brief Must be called after the logical device is created and before anything is allocated
+     * @param bufferImageGranularity From VkPhysicalDeviceLimits
+     * @param blockSize Preferred size of each block; requests of more than half of this are dedicated
+     */
+    bool initialize(
+        VkDevice device, 
+        const VkPhysicalDeviceMemoryProperties& memoryProperties, 
+        VkDeviceSize bufferImageGranularity, 
+        VkDeviceSize blockSize = sDefaultBlockSize);
+    
+    /// Frees all blocks. Must be called before the logical device is destroyed
+    void cleanup();
+    
+    /**
+     * @brief Finds room for a resource in a memory type allowed by the requirements and having all of the required properties
+     * The resource still needs to be bound to allocation->mMemory at allocation->mOffset.
+     * @return True iff successful
+     */
+    bool allocate(
+        const VkMemoryRequirements& requirements, 
+        VkMemoryPropertyFlags requiredProperties, 
+        Tiling tiling, 
+        Allocation* allocation);
+    
+    /// Allocation is reset to its default state; freeing an allocation that was already freed does nothing
+    void free(Allocation* allocation);
+    
+    Stats getStats();
+};
+
+}
+
+#endif // PGG_VULKAN
+
+#endif // PGG_DEVICEMEMORYALLOCATORVULKAN_HPP
@@ -92,7 +92,7 @@ void DirectionalLightModel::SharedResources::unload() {
     glDeleteBuffers(1, &mDLightVbo);
     glDeleteVertexArrays(1, &mDLightVao);
 }
-void DirectionalLightModel::SharedResources::render(Renderable::Pass rendPass, const glm::mat4& modelMat, const glm::vec3& lightColor) {
+void DirectionalLightModel::SharedResources::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat, const glm::vec3& lightColor) {
     if(rendPass.mType != Renderable::Pass::Type::GLOBAL_LIGHTS) {
         return;
     }
@@ -132,7 +132,7 @@ void DirectionalLightModel::unload() {
     mSharedRes->drop();
 }
 
-void DirectionalLightModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void DirectionalLightModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
     mSharedRes->render(rendPass, modelMat, mColor);
 }
 
@@ -17,9 +17,14 @@
 #include "Engine.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cstring>
+#include <functional>
+#include <mutex>
 #include <set>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <chrono>
 
@@ -35,6 +40,7 @@
 #include "Addons.hpp"
 #include "Scripts.hpp"
 #include "Input.hpp"
+#include "Jobs.hpp"
 
 #include "StreamStuff.hpp"
 
@@ -49,11 +55,35 @@ namespace Engine {
     const char* mEngineName = "Peppergrains";
     const char* mAppName = "Paradise";
 
-    bool mMainLoopRunning;
+    // Both threads may request quitting
+    std::atomic<bool> mMainLoopRunning(false);
     void quit() {
         mMainLoopRunning = false;
     }
     
+    // Gamelayer state belongs to the simulation thread, so window/input callbacks (which run on the main
+    // thread) are queued here and replayed by the simulation thread before it next ticks
+    std::mutex mSimEventsMutex;
+    std::vector<std::function<void()> > mSimEvents;
+    void postToSimulation(std::function<void()> event) {
+        std::lock_guard<std::mutex> lock(mSimEventsMutex);
+        mSimEvents.push_back(event);
+    }
+    
+    // Read by both threads; the rate is derived from the period so the two can never disagree
+    std::atomic<double> mTickPeriod(1.0 / 60.0);
+    void setTickRate(double ticksPerSecond) {
+        assert(ticksPerSecond > 0 && "Tick rate must be positive");
+        mTickPeriod = 1.0 / ticksPerSecond;
+    }
+    double getTickRate() { return 1.0 / mTickPeriod; }
+    
+    std::atomic<uint32_t> mMaxTicksPerFrame(5);
+    void setMaxTicksPerFrame(uint32_t maxTicks) {
+        mMaxTicksPerFrame = maxTicks < 1 ? 1 : maxTicks;
+    }
+    uint32_t getMaxTicksPerFrame() { return mMaxTicksPerFrame; }
+    
     InputState mInputState;
     
     // Fire resize event only on new frame
@@ -124,36 +154,41 @@ namespace Engine {
         while(SDL_PollEvent(&event)) {
             switch(event.type) {
                 case SDL_QUIT: {
-                    mGamelayerMachine.onQuit(QuitEvent(event.quit));
+                    QuitEvent qe(event.quit);
+                    postToSimulation([qe]() { mGamelayerMachine.onQuit(qe); });
                     quit();
                     break;
                 }
                 case SDL_TEXTINPUT: {
-                    mGamelayerMachine.onTextInput(TextInputEvent(event.text));
+                    TextInputEvent tie(event.text);
+                    postToSimulation([tie]() { mGamelayerMachine.onTextInput(tie); });
                     break;
                 }
                 
                 // Both press and release should trigger the same event
                 case SDL_KEYUP:
                 case SDL_KEYDOWN: {
-                    mGamelayerMachine.onKeyboardEvent(KeyboardEvent(event.key));
+                    KeyboardEvent ke(event.key);
+                    postToSimulation([ke]() { mGamelayerMachine.onKeyboardEvent(ke); });
                     break;
                 }
                 case SDL_MOUSEMOTION: {
                     MouseMoveEvent mme(event.motion);
-                    mInputState.setMouseDelta(mme.dx, mme.dy);
-                    mGamelayerMachine.onMouseMove(MouseMoveEvent(event.motion));
+                    mInputState.addMouseDelta(mme.dx, mme.dy);
+                    postToSimulation([mme]() { mGamelayerMachine.onMouseMove(mme); });
                     break;
                 }
                 
                 // Both press and release should trigger the same event
                 case SDL_MOUSEBUTTONUP:
                 case SDL_MOUSEBUTTONDOWN: {
-                    mGamelayerMachine.onMouseButton(MouseButtonEvent(event.button));
+                    MouseButtonEvent mbe(event.button);
+                    postToSimulation([mbe]() { mGamelayerMachine.onMouseButton(mbe); });
                     break;
                 }
                 case SDL_MOUSEWHEEL: {
-                    mGamelayerMachine.onMouseWheel(MouseWheelMoveEvent(event.wheel));
+                    MouseWheelMoveEvent mwme(event.wheel);
+                    postToSimulation([mwme]() { mGamelayerMachine.onMouseWheel(mwme); });
                     break;
                 }
                 case SDL_WINDOWEVENT: {
@@ -188,20 +223,45 @@ namespace Engine {
     #ifdef PGG_GLFW
     GLFWwindow* mGlfwWindow;
     GLFWwindow* getGlfwWindow() { return mGlfwWindow; }
+    
+    // GLFW only reports positions, so motion is measured from the previous one
+    bool mGlfwCursorKnown = false;
+    double mGlfwCursorX;
+    double mGlfwCursorY;
+    
+    // Motion not yet handed to the input state, which only takes whole pixels
+    double mGlfwCursorRemainderX = 0.0;
+    double mGlfwCursorRemainderY = 0.0;
     void keyCallbackGlfw(GLFWwindow* window, int key, int scancode, int action, int heldKeys) {
-        mGamelayerMachine.onKeyboardEvent(KeyboardEvent(key, action));
+        KeyboardEvent ke(key, action);
+        postToSimulation([ke]() { mGamelayerMachine.onKeyboardEvent(ke); });
         
         if(Input::scancodeFromGLFWKey(key) == Input::Scancode::K_Q) {
             quit();
         }
     }
     void cursorPositionCallbackGlfw(GLFWwindow* window, double x, double y) {
+        double dx = mGlfwCursorKnown ? x - mGlfwCursorX : 0.0;
+        double dy = mGlfwCursorKnown ? y - mGlfwCursorY : 0.0;
+        mGlfwCursorRemainderX += dx;
+        mGlfwCursorRemainderY += dy;
+        int32_t wholeDX = static_cast<int32_t>(mGlfwCursorRemainderX);
+        int32_t wholeDY = static_cast<int32_t>(mGlfwCursorRemainderY);
+        mGlfwCursorRemainderX -= wholeDX;
+        mGlfwCursorRemainderY -= wholeDY;
+        mInputState.addMouseDelta(wholeDX, wholeDY);
+        mGlfwCursorKnown = true;
+        mGlfwCursorX = x;
+        mGlfwCursorY = y;
+        
         double width = Video::getWindowWidth();
         double height = Video::getWindowHeight();
-        mGamelayerMachine.onMouseMove(MouseMoveEvent(x * width, y * height, mInputState.getMouseDX(), mInputState.getMouseDY()));
+        MouseMoveEvent mme(x * width, y * height, dx, dy);
+        postToSimulation([mme]() { mGamelayerMachine.onMouseMove(mme); });
     }
     void mouseButtonCallbackGlfw(GLFWwindow* window, int button, int action, int heldKeys) {
-        mGamelayerMachine.onMouseButton(MouseButtonEvent(button, action, mInputState.getMouseX(), mInputState.getMouseY()));
+        MouseButtonEvent mbe(button, action, mInputState.getMouseX(), mInputState.getMouseY());
+        postToSimulation([mbe]() { mGamelayerMachine.onMouseButton(mbe); });
     }
     void windowResizeCallbackGlfw(GLFWwindow* window, int width, int height) {
         mWindowResizeEventQueued = true;
@@ -237,9 +297,12 @@ namespace Engine {
         glfwShowWindow(mGlfwWindow);
         return true;
     }
+    // The close flag stays set once raised, but layers should only be told to quit once
+    bool mQuitPosted = false;
     inline void wisPollEvents() {
-        if(glfwWindowShouldClose(mGlfwWindow)) {
-            mGamelayerMachine.onQuit(QuitEvent());
+        if(glfwWindowShouldClose(mGlfwWindow) && !mQuitPosted) {
+            mQuitPosted = true;
+            postToSimulation([]() { mGamelayerMachine.onQuit(QuitEvent()); });
             quit();
         }
         glfwPollEvents();
@@ -289,12 +352,89 @@ namespace Engine {
     }
 
     GamelayerMachine mGamelayerMachine;
+    
+    // Input state as seen by the simulation thread
+    InputState mSimInputState;
+    
+    // Written by the simulation thread, read by the main thread
+    std::atomic<bool> mSimulationFinished(true);
+    std::atomic<uint32_t> mTicksThisSecond(0);
+    std::atomic<std::chrono::steady_clock::rep> mLastTickTime(0);
+    
+    // Runs all game logic at a fixed tick rate, independently of rendering
+    void simulationLoop() {
+        // Real time not yet consumed by simulation ticks
+        double tickAccumulator = 0.0;
+        
+        auto timePrev = std::chrono::steady_clock::now();
+        mLastTickTime = timePrev.time_since_epoch().count();
+        while(mMainLoopRunning) {
+            std::vector<std::function<void()> > events;
+            {
+                std::lock_guard<std::mutex> lock(mSimEventsMutex);
+                events.swap(mSimEvents);
+            }
+            for(std::function<void()>& event : events) {
+                event();
+            }
+            
+            // It is possible that an event triggered the loop to end
+            if(!mMainLoopRunning) {
+                break;
+            }
+            
+            auto timeNow = std::chrono::steady_clock::now();
+            std::chrono::duration<double> timeDelta = timeNow - timePrev;
+            timePrev = timeNow;
+            
+            // Settings may be changed from the main thread; use one consistent value for this iteration
+            double tickPeriod = mTickPeriod;
+            uint32_t maxTicksPerFrame = mMaxTicksPerFrame;
+            
+            // Run as many fixed-length ticks as have elapsed, within the catch-up limit
+            tickAccumulator += timeDelta.count();
+            uint32_t ticksRun = 0;
+            while(tickAccumulator >= tickPeriod) {
+                if(ticksRun >= maxTicksPerFrame) {
+                    // Simulation cannot keep up; drop the backlog instead of spiraling
+                    tickAccumulator = 0.0;
+                    break;
+                }
+                mGamelayerMachine.onTick(tickPeriod, &mSimInputState);
+                tickAccumulator -= tickPeriod;
+                ++ ticksRun;
+                
+                // Only the first tick sees the motion handed over since the previous tick
+                mSimInputState.setMouseDelta(0, 0);
+            }
+            
+            if(ticksRun > 0) {
+                mTicksThisSecond += ticksRun;
+                mSoundEndpoint.updateSoundThread();
+                
+                // Hand the new state over to the main thread; may wait for the previous snapshot to be taken
+                mLastTickTime = (timeNow - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(tickAccumulator))).time_since_epoch().count();
+                mGamelayerMachine.onPublishSnapshot();
+            } else {
+                // Nothing to do until the next tick is due
+                std::this_thread::sleep_for(std::chrono::duration<double>(tickPeriod - tickAccumulator));
+            }
+        }
+        mSimulationFinished = true;
+    }
+    
     int run(int argc, char* argv[]) {
         //Logger::VERBOSE->setEnabled(false);
         
         Logger::Out iout = Logger::log(Logger::INFO);
         Logger::Out sout = Logger::log(Logger::SEVERE);
         
+        iout << "Initializing job system..." << std::endl;
+        if(!Jobs::initialize()) {
+            sout << "Fatal error initializing job system" << std::endl;
+            return EXIT_FAILURE;
+        }
         iout << "Initializing windowing/input system..." << std::endl;
         if(!wisInitialize()) {
             sout << "Fatal error initializing windowing/input system" << std::endl;
@@ -324,10 +464,6 @@ namespace Engine {
             return EXIT_FAILURE;
         }
         
-        double mTps = 0.f;
-        double mTpsWeight = 0.85f;
-        double mOneSecondTimer;
-        
         iout << "Finalizing windowing/input system..." << std::endl;
         if(!wisPostInitialize()) {
             sout << "Fatal error finalizing windowing/input system" << std::endl;
@@ -338,52 +474,79 @@ namespace Engine {
         iout << "Running..." << std::endl;
         
         mGamelayerMachine.addBottom(new MissionGameLayer());
-
-        auto timePrev = std::chrono::steady_clock::now();
+        
         mMainLoopRunning = true;
-        while(mMainLoopRunning) {
-            mInputState.setMouseDelta(0, 0);
+        mSimulationFinished = false;
+        std::thread simulationThread(simulationLoop);
+        
+        double fps = 0.f;
+        double fpsWeight = 0.85f;
+        double oneSecondTimer = 0.0;
+        
+        // The main thread only handles windowing, input, and rendering, and so should never wait on game logic.
+        // After quitting is requested, rendering continues until the simulation thread finishes, so that a
+        // simulation thread waiting to hand over a snapshot is never left blocked.
+        auto timePrev = std::chrono::steady_clock::now();
+        while(!mSimulationFinished) {
             wisPollEvents();
             
-            // TODO: use separate threads for game logic and windowing/rendering to avoid pause while dragging/resizing
             if(mWindowResizeEventQueued) {
                 if(mNewWindowWidth < 1) mNewWindowWidth = 1;
                 if(mNewWindowHeight < 1) mNewWindowHeight = 1;
                 if(mNewWindowWidth != Video::getWindowWidth() || mNewWindowHeight != Video::getWindowHeight()) {
                     Logger::log(Logger::VERBOSE) << "Window resized to " << mNewWindowWidth << ", " << mNewWindowHeight << std::endl;
                     Video::onWindowResize(mNewWindowWidth, mNewWindowHeight);
-                    mGamelayerMachine.onWindowResize(WindowResizeEvent(mNewWindowWidth, mNewWindowHeight));
+                    WindowResizeEvent wre(mNewWindowWidth, mNewWindowHeight);
+                    postToSimulation([wre]() { mGamelayerMachine.onWindowResize(wre); });
                 }
                 mWindowResizeEventQueued = false;
             }
             
+            // Latest input state is replayed on the simulation thread along with the events that produced it.
+            // Motion is added to whatever the simulation has not yet consumed in a tick, since several frames
+            // may be posted between two ticks.
+            InputState inputState = mInputState;
+            postToSimulation([inputState]() {
+                int32_t dx = mSimInputState.getMouseDX() + inputState.getMouseDX();
+                int32_t dy = mSimInputState.getMouseDY() + inputState.getMouseDY();
+                mSimInputState = inputState;
+                mSimInputState.setMouseDelta(dx, dy);
+            });
+            mInputState.setMouseDelta(0, 0);
+            
             soundio_flush_events(mSndIo);
             
-            // It is possible that an event triggered the loop to end
-            if(mMainLoopRunning) {
-                auto timeNow = std::chrono::steady_clock::now();
-                std::chrono::duration<double> timeDelta = timeNow - timePrev;
-                timePrev = timeNow;
-                
-                // TPF = Time Per Frame (in seconds per frame)
-                double tpf = timeDelta.count();
-                
-                if(tpf > 0) {
-                    float fpsNew = 1 / tpf;
-                    mTps = (mTps * mTpsWeight) + (fpsNew * (1.f - mTpsWeight));
-                }
-                mOneSecondTimer += tpf;
-                if(mOneSecondTimer > 1.f) {
-                    mOneSecondTimer -= 1.f;
-                    iout << "TPS: " << (uint32_t) mTps << "  \tLast tick: " << (tpf * 1e3) << "ms" << std::endl;
-                }
-                
-                mGamelayerMachine.onTick(tpf, &mInputState);
-                mSoundEndpoint.updateSoundThread();
-
-                wisPostRender();
+            Jobs::processMainThreadJobs();
+            
+            auto timeNow = std::chrono::steady_clock::now();
+            std::chrono::duration<double> timeDelta = timeNow - timePrev;
+            timePrev = timeNow;
+            
+            // TPF = Time Per Frame (in seconds per frame)
+            double tpf = timeDelta.count();
+            
+            if(tpf > 0) {
+                float fpsNew = 1 / tpf;
+                fps = (fps * fpsWeight) + (fpsNew * (1.f - fpsWeight));
             }
+            oneSecondTimer += tpf;
+            if(oneSecondTimer > 1.f) {
+                oneSecondTimer -= 1.f;
+                iout << "FPS: " << (uint32_t) fps << "  \tTPS: " << mTicksThisSecond.exchange(0) << "  \tLast frame: " << (tpf * 1e3) << "ms" << std::endl;
+            }
+            
+            // Time since the simulation thread last ticked, as a fraction of the tick period
+            std::chrono::duration<double> sinceTick = timeNow - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(mLastTickTime.load()));
+            double interp = sinceTick.count() / mTickPeriod.load();
+            if(interp < 0.0) interp = 0.0;
+            if(interp > 1.0) interp = 1.0;
+            
+            mGamelayerMachine.onRender(tpf, interp);
+            
+            wisPostRender();
         }
+        simulationThread.join();
+        
         iout << "Terminating..." << std::endl;
         
         #ifdef PGG_VULKAN
@@ -392,6 +555,12 @@ namespace Engine {
         
         mGamelayerMachine.removeAll();
         
+        iout << "Cleaning up job system..." << std::endl;
+        if(!Jobs::cleanup()) {
+            sout << "Fatal error cleaning up job system" << std::endl;
+            return EXIT_FAILURE;
+        }
+        
         iout << "Cleaning up scripts..." << std::endl;
         if(!Scripts::cleanup()) {
             sout << "Fatal error cleaning up scripts" << std::endl;
@@ -35,6 +35,16 @@ namespace Engine {
     
     void quit();
     
+    // Simulation rate in ticks per second. Gamelayers are always ticked with a period of 1 / rate,
+    // independent of how quickly frames are being rendered.
+    void setTickRate(double ticksPerSecond);
+    double getTickRate();
+    
+    // Upper bound on ticks run to catch up within a single frame; any further backlog is dropped,
+    // which slows the simulation down rather than letting it fall further and further behind
+    void setMaxTicksPerFrame(uint32_t maxTicks);
+    uint32_t getMaxTicksPerFrame();
+    
     #ifdef PGG_SDL
     SDL_Window* getSdlWindow();
     #endif
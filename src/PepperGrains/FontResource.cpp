@@ -55,15 +55,10 @@ void FontResource::load() {
     mShaderProg = ShaderProgramResource::gallop(Resources::find("Font.shaderProgram"));
     mShaderProg->grab();
 
+    // (Might want other samplers in the future)
     const std::vector<ShaderProgramResource::Control>& sampler2DControls = mShaderProg->getUniformSampler2Ds();
-
-    for(std::vector<ShaderProgramResource::Control>::const_iterator iter = sampler2DControls.begin(); iter != sampler2DControls.end(); ++ iter) {
-        const ShaderProgramResource::Control& entry = *iter;
-
-        mTextureHandle = entry.handle;
-
-        // (Might want other samplers in the future)
-        break;
+    if(!sampler2DControls.empty()) {
+        mTextureHandle = sampler2DControls.front().handle;
     }
 
     mTexture = TextureResource::gallop(Resources::find(textureName));
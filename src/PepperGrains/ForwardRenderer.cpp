@@ -23,6 +23,7 @@ namespace pgg {
 ForwardRenderer::ForwardRenderer(uint32_t width, uint32_t height, Renderable* renderable)
 : mScreenWidth(width)
 , mScreenHeight(height)
+, mGLState(&mGLBackend)
 , mRenderable(renderable) {
 }
 
@@ -163,7 +164,10 @@ void ForwardRenderer::renderFrame() {
         geometryRenderPass.setScreenSize(mScreenWidth, mScreenHeight);
         */
         
+        geometryRenderPass.mGLState = &mGLState;
+        mGLState.invalidate();
         mRenderable->render(geometryRenderPass);
+        mGLState.resetBindings();
     }
     
     // Perform post-process
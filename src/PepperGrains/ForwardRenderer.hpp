@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 
+#include "GLBackend.hpp"
+#include "GLStateCache.hpp"
 #include "OpenGLStuff.hpp"
 #include "ShaderProgramResource.hpp"
 #include "Renderable.hpp"
@@ -53,6 +55,10 @@ private:
     GLuint mFullscreenVbo;
     GLuint mFullscreenIbo;
     
+    // Only used by models which support it; the renderer's own state is set directly
+    OpenGLBackend mGLBackend;
+    GLStateCache mGLState;
+    
 public:
     void load();
     void unload();
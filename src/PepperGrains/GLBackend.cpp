@@ -0,0 +1,172 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "GLBackend.hpp"
+
+#include <cassert>
+
+namespace pgg {
+
+GLBackend::~GLBackend() { }
+
+#ifdef PGG_OPENGL
+
+OpenGLBackend::OpenGLBackend() { }
+OpenGLBackend::~OpenGLBackend() { }
+
+void OpenGLBackend::useProgram(GLuint program) { glUseProgram(program); }
+void OpenGLBackend::bindVertexArray(GLuint vertexArray) { glBindVertexArray(vertexArray); }
+void OpenGLBackend::enable(GLenum capability) { glEnable(capability); }
+void OpenGLBackend::disable(GLenum capability) { glDisable(capability); }
+void OpenGLBackend::depthFunc(GLenum func) { glDepthFunc(func); }
+void OpenGLBackend::depthMask(bool write) { glDepthMask(write ? GL_TRUE : GL_FALSE); }
+void OpenGLBackend::cullFace(GLenum face) { glCullFace(face); }
+void OpenGLBackend::blendEquation(GLenum mode) { glBlendEquation(mode); }
+void OpenGLBackend::blendFunc(GLenum srcFactor, GLenum dstFactor) { glBlendFunc(srcFactor, dstFactor); }
+void OpenGLBackend::stencilFunc(GLenum func, GLint ref, GLuint mask) { glStencilFunc(func, ref, mask); }
+void OpenGLBackend::polygonMode(GLenum mode) { glPolygonMode(GL_FRONT_AND_BACK, mode); }
+void OpenGLBackend::activeTexture(GLuint unit) { glActiveTexture(GL_TEXTURE0 + unit); }
+void OpenGLBackend::bindTexture2D(GLuint texture) { glBindTexture(GL_TEXTURE_2D, texture); }
+
+#endif // PGG_OPENGL
+
+const char* RecordingGLBackend::getFunctionName(Function function) {
+    switch(function) {
+        case USE_PROGRAM: return "glUseProgram";
+        case BIND_VERTEX_ARRAY: return "glBindVertexArray";
+        case ENABLE: return "glEnable";
+        case DISABLE: return "glDisable";
+        case DEPTH_FUNC: return "glDepthFunc";
+        case DEPTH_MASK: return "glDepthMask";
+        case CULL_FACE: return "glCullFace";
+        case BLEND_EQUATION: return "glBlendEquation";
+        case BLEND_FUNC: return "glBlendFunc";
+        case STENCIL_FUNC: return "glStencilFunc";
+        case POLYGON_MODE: return "glPolygonMode";
+        case ACTIVE_TEXTURE: return "glActiveTexture";
+        case BIND_TEXTURE_2D: return "glBindTexture";
+        default: return "?";
+    }
+}
+
+RecordingGLBackend::RecordingGLBackend(GLBackend* forward, bool keepLog)
+: mForward(forward)
+, mKeepLog(keepLog) {
+    this->clear();
+}
+RecordingGLBackend::~RecordingGLBackend() { }
+
+void RecordingGLBackend::record(Function function, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    ++ mNumCalls[function];
+    ++ mTotalCalls;
+    if(mKeepLog) {
+        Call call;
+        call.mFunction = function;
+        call.mArgs[0] = arg0;
+        call.mArgs[1] = arg1;
+        call.mArgs[2] = arg2;
+        mCalls.push_back(call);
+    }
+}
+
+void RecordingGLBackend::useProgram(GLuint program) {
+    this->record(USE_PROGRAM, program);
+    if(mForward) mForward->useProgram(program);
+}
+void RecordingGLBackend::bindVertexArray(GLuint vertexArray) {
+    this->record(BIND_VERTEX_ARRAY, vertexArray);
+    if(mForward) mForward->bindVertexArray(vertexArray);
+}
+void RecordingGLBackend::enable(GLenum capability) {
+    this->record(ENABLE, capability);
+    if(mForward) mForward->enable(capability);
+}
+void RecordingGLBackend::disable(GLenum capability) {
+    this->record(DISABLE, capability);
+    if(mForward) mForward->disable(capability);
+}
+void RecordingGLBackend::depthFunc(GLenum func) {
+    this->record(DEPTH_FUNC, func);
+    if(mForward) mForward->depthFunc(func);
+}
+void RecordingGLBackend::depthMask(bool write) {
+    this->record(DEPTH_MASK, write ? 1 : 0);
+    if(mForward) mForward->depthMask(write);
+}
+void RecordingGLBackend::cullFace(GLenum face) {
+    this->record(CULL_FACE, face);
+    if(mForward) mForward->cullFace(face);
+}
+void RecordingGLBackend::blendEquation(GLenum mode) {
+    this->record(BLEND_EQUATION, mode);
+    if(mForward) mForward->blendEquation(mode);
+}
+void RecordingGLBackend::blendFunc(GLenum srcFactor, GLenum dstFactor) {
+    this->record(BLEND_FUNC, srcFactor, dstFactor);
+    if(mForward) mForward->blendFunc(srcFactor, dstFactor);
+}
+void RecordingGLBackend::stencilFunc(GLenum func, GLint ref, GLuint mask) {
+    this->record(STENCIL_FUNC, func, ref, mask);
+    if(mForward) mForward->stencilFunc(func, ref, mask);
+}
+void RecordingGLBackend::polygonMode(GLenum mode) {
+    this->record(POLYGON_MODE, mode);
+    if(mForward) mForward->polygonMode(mode);
+}
+void RecordingGLBackend::activeTexture(GLuint unit) {
+    this->record(ACTIVE_TEXTURE, unit);
+    if(mForward) mForward->activeTexture(unit);
+}
+void RecordingGLBackend::bindTexture2D(GLuint texture) {
+    this->record(BIND_TEXTURE_2D, texture);
+    if(mForward) mForward->bindTexture2D(texture);
+}
+
+void RecordingGLBackend::clear() {
+    mCalls.clear();
+    for(uint32_t i = 0; i < NUM_FUNCTIONS; ++ i) {
+        mNumCalls[i] = 0;
+    }
+    mTotalCalls = 0;
+}
+
+const std::vector<RecordingGLBackend::Call>& RecordingGLBackend::getCalls() const { return mCalls; }
+uint32_t RecordingGLBackend::getNumCalls() const { return mTotalCalls; }
+uint32_t RecordingGLBackend::getNumCalls(Function function) const {
+    assert(function < NUM_FUNCTIONS && "Invalid function");
+    return mNumCalls[function];
+}
+
+void RecordingGLBackend::writeLog(std::ostream& output) const {
+    std::ios::fmtflags flags = output.flags();
+    for(std::vector<Call>::const_iterator iter = mCalls.begin(); iter != mCalls.end(); ++ iter) {
+        const Call& call = *iter;
+        output << getFunctionName(call.mFunction) << "(" << std::hex << std::showbase;
+        
+        // Only print as many arguments as the function takes
+        uint32_t numArgs = call.mFunction == STENCIL_FUNC ? 3 : (call.mFunction == BLEND_FUNC ? 2 : 1);
+        for(uint32_t i = 0; i < numArgs; ++ i) {
+            if(i > 0) {
+                output << ", ";
+            }
+            output << call.mArgs[i];
+        }
+        output << std::dec << ")" << std::endl;
+    }
+    output.flags(flags);
+}
+
+}
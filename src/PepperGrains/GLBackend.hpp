@@ -0,0 +1,154 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_GLBACKEND_HPP
+#define PGG_GLBACKEND_HPP
+
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+namespace pgg {
+
+/* The subset of OpenGL state-setting functions which GLStateCache filters.
+ *
+ * Renderers normally use OpenGLBackend, which makes the actual calls. RecordingGLBackend logs them
+ * instead, so that the calls made for a frame can be counted and compared without a GPU.
+ */
+class GLBackend {
+public:
+    virtual ~GLBackend();
+    
+    virtual void useProgram(GLuint program) = 0;
+    virtual void bindVertexArray(GLuint vertexArray) = 0;
+    virtual void enable(GLenum capability) = 0;
+    virtual void disable(GLenum capability) = 0;
+    virtual void depthFunc(GLenum func) = 0;
+    virtual void depthMask(bool write) = 0;
+    virtual void cullFace(GLenum face) = 0;
+    virtual void blendEquation(GLenum mode) = 0;
+    virtual void blendFunc(GLenum srcFactor, GLenum dstFactor) = 0;
+    virtual void stencilFunc(GLenum func, GLint ref, GLuint mask) = 0;
+    
+    // Applies to both front and back faces
+    virtual void polygonMode(GLenum mode) = 0;
+    
+    // Unit is an index, not GL_TEXTURE0 + index
+    virtual void activeTexture(GLuint unit) = 0;
+    virtual void bindTexture2D(GLuint texture) = 0;
+};
+
+#ifdef PGG_OPENGL
+
+class OpenGLBackend : public GLBackend {
+public:
+    OpenGLBackend();
+    ~OpenGLBackend();
+    
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void cullFace(GLenum face);
+    void blendEquation(GLenum mode);
+    void blendFunc(GLenum srcFactor, GLenum dstFactor);
+    void stencilFunc(GLenum func, GLint ref, GLuint mask);
+    void polygonMode(GLenum mode);
+    void activeTexture(GLuint unit);
+    void bindTexture2D(GLuint texture);
+};
+
+#endif // PGG_OPENGL
+
+/* Records every call made through it. Calls are optionally forwarded to another backend afterwards;
+ * without one, this is a null backend and nothing reaches the driver.
+ */
+class RecordingGLBackend : public GLBackend {
+public:
+    enum Function {
+        USE_PROGRAM,
+        BIND_VERTEX_ARRAY,
+        ENABLE,
+        DISABLE,
+        DEPTH_FUNC,
+        DEPTH_MASK,
+        CULL_FACE,
+        BLEND_EQUATION,
+        BLEND_FUNC,
+        STENCIL_FUNC,
+        POLYGON_MODE,
+        ACTIVE_TEXTURE,
+        BIND_TEXTURE_2D,
+        
+        NUM_FUNCTIONS
+    };
+    
+    struct Call {
+        Function mFunction;
+        
+        // Unused arguments are zero
+        uint32_t mArgs[3];
+    };
+    
+    static const char* getFunctionName(Function function);
+    
+    // If keepLog is false, calls are only counted
+    RecordingGLBackend(GLBackend* forward = nullptr, bool keepLog = true);
+    ~RecordingGLBackend();
+    
+private:
+    GLBackend* mForward;
+    bool mKeepLog;
+    
+    std::vector<Call> mCalls;
+    uint32_t mNumCalls[NUM_FUNCTIONS];
+    uint32_t mTotalCalls;
+    
+    void record(Function function, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0);
+    
+public:
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void cullFace(GLenum face);
+    void blendEquation(GLenum mode);
+    void blendFunc(GLenum srcFactor, GLenum dstFactor);
+    void stencilFunc(GLenum func, GLint ref, GLuint mask);
+    void polygonMode(GLenum mode);
+    void activeTexture(GLuint unit);
+    void bindTexture2D(GLuint texture);
+    
+    // Forget all calls and counts recorded so far
+    void clear();
+    
+    const std::vector<Call>& getCalls() const;
+    uint32_t getNumCalls() const;
+    uint32_t getNumCalls(Function function) const;
+    
+    // One call per line, e.g. "glEnable(0xb71)"
+    void writeLog(std::ostream& output) const;
+};
+
+}
+
+#endif // PGG_GLBACKEND_HPP
@@ -0,0 +1,197 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "GLStateCache.hpp"
+
+#include <cassert>
+
+namespace pgg {
+
+GLStateCache::Stats::Stats()
+: mRequested(0)
+, mIssued(0) {
+}
+
+GLStateCache::Stats& GLStateCache::Stats::operator+=(const Stats& other) {
+    mRequested += other.mRequested;
+    mIssued += other.mIssued;
+    return *this;
+}
+
+GLStateCache::GLStateCache(GLBackend* backend)
+: mBackend(backend) {
+    this->invalidate();
+}
+
+GLStateCache::~GLStateCache() {
+}
+
+void GLStateCache::setBackend(GLBackend* backend) {
+    mBackend = backend;
+    this->invalidate();
+}
+GLBackend* GLStateCache::getBackend() const { return mBackend; }
+
+void GLStateCache::invalidate() {
+    mProgram.mKnown = false;
+    mVertexArray.mKnown = false;
+    mDepthFunc.mKnown = false;
+    mDepthMask.mKnown = false;
+    mCullFace.mKnown = false;
+    mBlendEquation.mKnown = false;
+    mBlendFunc.mKnown = false;
+    mStencilFunc.mKnown = false;
+    mPolygonMode.mKnown = false;
+    mActiveTexture.mKnown = false;
+    for(uint32_t i = 0; i < sMaxTrackedTextureUnits; ++ i) {
+        mTexture2Ds[i].mKnown = false;
+    }
+    mNumCapabilities = 0;
+}
+
+void GLStateCache::resetBindings() {
+    this->useProgram(0);
+    this->bindVertexArray(0);
+}
+
+void GLStateCache::useProgram(GLuint program) {
+    ++ mStats.mRequested;
+    if(mProgram.set(program)) {
+        mBackend->useProgram(program);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray) {
+    ++ mStats.mRequested;
+    if(mVertexArray.set(vertexArray)) {
+        mBackend->bindVertexArray(vertexArray);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::setCapability(GLenum capability, bool enabled) {
+    ++ mStats.mRequested;
+    Capability* known = nullptr;
+    for(uint32_t i = 0; i < mNumCapabilities; ++ i) {
+        if(mCapabilities[i].mCapability == capability) {
+            known = &mCapabilities[i];
+            break;
+        }
+    }
+    if(known) {
+        if(known->mEnabled == enabled) {
+            return;
+        }
+    } else if(mNumCapabilities < sMaxTrackedCapabilities) {
+        known = &mCapabilities[mNumCapabilities ++];
+        known->mCapability = capability;
+    }
+    if(known) {
+        known->mEnabled = enabled;
+    }
+    
+    if(enabled) {
+        mBackend->enable(capability);
+    } else {
+        mBackend->disable(capability);
+    }
+    ++ mStats.mIssued;
+}
+
+void GLStateCache::enable(GLenum capability) { this->setCapability(capability, true); }
+void GLStateCache::disable(GLenum capability) { this->setCapability(capability, false); }
+
+void GLStateCache::depthFunc(GLenum func) {
+    ++ mStats.mRequested;
+    if(mDepthFunc.set(func)) {
+        mBackend->depthFunc(func);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::depthMask(bool write) {
+    ++ mStats.mRequested;
+    if(mDepthMask.set(write)) {
+        mBackend->depthMask(write);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::cullFace(GLenum face) {
+    ++ mStats.mRequested;
+    if(mCullFace.set(face)) {
+        mBackend->cullFace(face);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::blendEquation(GLenum mode) {
+    ++ mStats.mRequested;
+    if(mBlendEquation.set(mode)) {
+        mBackend->blendEquation(mode);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::blendFunc(GLenum srcFactor, GLenum dstFactor) {
+    ++ mStats.mRequested;
+    BlendFunc value;
+    value.mSrc = srcFactor;
+    value.mDst = dstFactor;
+    if(mBlendFunc.set(value)) {
+        mBackend->blendFunc(srcFactor, dstFactor);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::stencilFunc(GLenum func, GLint ref, GLuint mask) {
+    ++ mStats.mRequested;
+    StencilFunc value;
+    value.mFunc = func;
+    value.mRef = ref;
+    value.mMask = mask;
+    if(mStencilFunc.set(value)) {
+        mBackend->stencilFunc(func, ref, mask);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::polygonMode(GLenum mode) {
+    ++ mStats.mRequested;
+    if(mPolygonMode.set(mode)) {
+        mBackend->polygonMode(mode);
+        ++ mStats.mIssued;
+    }
+}
+
+void GLStateCache::bindTexture2D(GLuint unit, GLuint texture) {
+    ++ mStats.mRequested;
+    if(unit < sMaxTrackedTextureUnits && !mTexture2Ds[unit].set(texture)) {
+        return;
+    }
+    if(mActiveTexture.set(unit)) {
+        mBackend->activeTexture(unit);
+        ++ mStats.mIssued;
+    }
+    mBackend->bindTexture2D(texture);
+    ++ mStats.mIssued;
+}
+
+const GLStateCache::Stats& GLStateCache::getStats() const { return mStats; }
+void GLStateCache::resetStats() { mStats = Stats(); }
+
+}
@@ -0,0 +1,141 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_GLSTATECACHE_HPP
+#define PGG_GLSTATECACHE_HPP
+
+#include <stdint.h>
+
+#include <GraphicsApiLibrary.hpp>
+
+#include "GLBackend.hpp"
+
+namespace pgg {
+
+/* Shadow copy of the GL state set through it, which drops calls that would not change anything.
+ *
+ * Since bindings are no longer reset after every draw, code which sets the same state directly (not
+ * through this) must call invalidate() afterwards. Until the state is set again through the cache, the
+ * next call for each piece of state is always passed on.
+ *
+ * Capabilities and texture units beyond the limits below are passed on without being tracked.
+ */
+class GLStateCache {
+public:
+    static const uint32_t sMaxTrackedCapabilities = 16;
+    static const uint32_t sMaxTrackedTextureUnits = 16;
+    
+    struct Stats {
+        Stats();
+        
+        // Calls made to the cache, and calls it passed on to the backend
+        uint32_t mRequested;
+        uint32_t mIssued;
+        
+        Stats& operator+=(const Stats& other);
+    };
+    
+    GLStateCache(GLBackend* backend);
+    ~GLStateCache();
+    
+private:
+    GLBackend* mBackend;
+    
+    template<typename T> struct Shadow {
+        T mValue;
+        bool mKnown;
+        
+        // Returns true if the value changed (or was unknown), in which case the call must be made
+        bool set(const T& value) {
+            if(mKnown && mValue == value) {
+                return false;
+            }
+            mValue = value;
+            mKnown = true;
+            return true;
+        }
+    };
+    
+    struct BlendFunc {
+        GLenum mSrc;
+        GLenum mDst;
+        bool operator==(const BlendFunc& other) const { return mSrc == other.mSrc && mDst == other.mDst; }
+    };
+    struct StencilFunc {
+        GLenum mFunc;
+        GLint mRef;
+        GLuint mMask;
+        bool operator==(const StencilFunc& other) const { return mFunc == other.mFunc && mRef == other.mRef && mMask == other.mMask; }
+    };
+    struct Capability {
+        GLenum mCapability;
+        bool mEnabled;
+    };
+    
+    Shadow<GLuint> mProgram;
+    Shadow<GLuint> mVertexArray;
+    Shadow<GLenum> mDepthFunc;
+    Shadow<bool> mDepthMask;
+    Shadow<GLenum> mCullFace;
+    Shadow<GLenum> mBlendEquation;
+    Shadow<BlendFunc> mBlendFunc;
+    Shadow<StencilFunc> mStencilFunc;
+    Shadow<GLenum> mPolygonMode;
+    Shadow<GLuint> mActiveTexture;
+    Shadow<GLuint> mTexture2Ds[sMaxTrackedTextureUnits];
+    
+    // Only those with a known state
+    Capability mCapabilities[sMaxTrackedCapabilities];
+    uint32_t mNumCapabilities;
+    
+    Stats mStats;
+    
+    void setCapability(GLenum capability, bool enabled);
+    
+public:
+    // Also invalidates, since nothing is known about the new backend's state
+    void setBackend(GLBackend* backend);
+    GLBackend* getBackend() const;
+    
+    // Forget everything, so that the next call for each piece of state is passed on
+    void invalidate();
+    
+    // Unbind the program and vertex array, so that later code (which may bind buffers) cannot modify
+    // the last vertex array used; call when done drawing
+    void resetBindings();
+    
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void cullFace(GLenum face);
+    void blendEquation(GLenum mode);
+    void blendFunc(GLenum srcFactor, GLenum dstFactor);
+    void stencilFunc(GLenum func, GLint ref, GLuint mask);
+    void polygonMode(GLenum mode);
+    
+    // Makes unit active (if not already) and binds the texture to its 2D target
+    void bindTexture2D(GLuint unit, GLuint texture);
+    
+    const Stats& getStats() const;
+    void resetStats();
+};
+
+}
+
+#endif // PGG_GLSTATECACHE_HPP
@@ -27,6 +27,8 @@ void Gamelayer::onEnd() {}
 
 // Ticks
 void Gamelayer::onTick(double tpf, const InputState* keyStates) {}
+void Gamelayer::onPublishSnapshot() {}
+void Gamelayer::onRender(double tpf, double interp) {}
 
 /* Key filtering:
  *  Set whatever keystates to be false before passing them on to the next layers
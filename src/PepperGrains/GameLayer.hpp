@@ -32,9 +32,26 @@ public:
     virtual void onBegin();
     virtual void onEnd();
     
+    /* Threading:
+     *  onBegin/onEnd run on whichever thread adds or removes the layer, never while the main thread is
+     *      inside onRender or onNeedRebuildRenderPipeline; they must not wait on the main thread
+     *  onTick, onPublishSnapshot and all input/window events run on the simulation thread
+     *  onRender and onNeedRebuildRenderPipeline run on the main (render) thread
+     *  The only state shared between the two should be handed over through a SnapshotBuffer
+     */
+    
     // Ticks
+    // Simulation step; tpf is always the fixed tick period (see Engine::setTickRate)
     virtual void onTick(double tpf, const InputState* keyStates);
     
+    // Called after one or more ticks; write whatever rendering needs into a snapshot and publish it
+    virtual void onPublishSnapshot();
+    
+    // Called once per displayed frame, reading only the latest acquired snapshot
+    // interp is how far real time has progressed between the last tick and the next one [0, 1]
+    // Renderers should blend between the previous and current simulation states by this amount
+    virtual void onRender(double tpf, double interp);
+    
     /* Key filtering:
      *  Set whatever keystates to be false before passing them on to the next layers
      *  Return true to set all keys to false
@@ -30,11 +30,14 @@ GamelayerMachine::GamelayerMachine() { }
 GamelayerMachine::~GamelayerMachine() {}
 
 void GamelayerMachine::addBottom(Gamelayer* addMe) {
+    std::lock_guard<std::recursive_mutex> lock(mLayersMutex);
     mLayers.insert(mLayers.begin(), addMe);
     addMe->onBegin();
 }
 
 void GamelayerMachine::addAbove(Gamelayer* addMe, Gamelayer* caller) {
+    std::lock_guard<std::recursive_mutex> lock(mLayersMutex);
+    
     // Find where the caller is located
     std::vector<Gamelayer*>::iterator location = mLayers.end();
     for(std::vector<Gamelayer*>::iterator iter = mLayers.begin(); iter != mLayers.end(); ++ iter) {
@@ -67,6 +70,8 @@ void GamelayerMachine::addAbove(Gamelayer* addMe, Gamelayer* caller) {
     }
 }
 void GamelayerMachine::remove(Gamelayer* removeMe) {
+    std::lock_guard<std::recursive_mutex> lock(mLayersMutex);
+    
     // Find the layer to remove
     std::vector<Gamelayer*>::iterator location = mLayers.end();
     for(std::vector<Gamelayer*>::iterator iter = mLayers.begin(); iter != mLayers.end(); ++ iter) {
@@ -95,11 +100,11 @@ void GamelayerMachine::remove(Gamelayer* removeMe) {
     mLayers.erase(location);
 }
 void GamelayerMachine::removeAll() {
-    std::vector<Gamelayer*>::reverse_iterator iter = mLayers.rbegin();
-    while(iter != mLayers.rend()) {
-        Gamelayer* layer = *iter;
-        this->remove(layer);
-        ++ iter;
+    std::lock_guard<std::recursive_mutex> lock(mLayersMutex);
+    
+    // Topmost first; remove() erases from mLayers, so iterators cannot be kept across calls
+    while(!mLayers.empty()) {
+        this->remove(mLayers.back());
     }
 }
 
@@ -130,6 +135,23 @@ void GamelayerMachine::onTick(double tpf, const InputState* keys) {
     }
 }
 
+void GamelayerMachine::onPublishSnapshot() {
+    for(std::vector<Gamelayer*>::iterator iter = mLayers.begin(); iter != mLayers.end(); ++ iter) {
+        Gamelayer* layer = *iter;
+        layer->onPublishSnapshot();
+    }
+}
+
+void GamelayerMachine::onRender(double tpf, double interp) {
+    std::lock_guard<std::recursive_mutex> lock(mLayersMutex);
+    
+    // Bottom layers are drawn first so that upper layers appear over them
+    for(std::vector<Gamelayer*>::iterator iter = mLayers.begin(); iter != mLayers.end(); ++ iter) {
+        Gamelayer* layer = *iter;
+        layer->onRender(tpf, interp);
+    }
+}
+
 void GamelayerMachine::onKeyboardEvent(const KeyboardEvent& event) {
     for(std::vector<Gamelayer*>::reverse_iterator iter = mLayers.rbegin(); iter != mLayers.rend(); ++ iter) {
         Gamelayer* layer = *iter;
@@ -168,6 +190,7 @@ void GamelayerMachine::onWindowResize(const WindowResizeEvent& event) {
 }
 
 void GamelayerMachine::onNeedRebuildRenderPipeline() {
+    std::lock_guard<std::recursive_mutex> lock(mLayersMutex);
     for(std::vector<Gamelayer*>::reverse_iterator iter = mLayers.rbegin(); iter != mLayers.rend(); ++ iter) {
         Gamelayer* layer = *iter;
         if(layer->onNeedRebuildRenderPipeline()) break;
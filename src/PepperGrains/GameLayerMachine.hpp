@@ -17,6 +17,7 @@
 #ifndef VSE_GAMELAYERMACHINE_HPP
 #define VSE_GAMELAYERMACHINE_HPP
 
+#include <mutex>
 #include <vector>
 
 #include "Events.hpp"
@@ -32,6 +33,11 @@ public:
 private:
     std::vector<Gamelayer*> mLayers;
     
+    // Layers are added and removed by the simulation thread while the main thread renders them.
+    // Held while the list changes (including onBegin/onEnd) and while the main thread walks it.
+    // The simulation thread is the only writer, so its own reads need no lock.
+    std::recursive_mutex mLayersMutex;
+    
     static InputState sEmptyInputState;
     
 public:
@@ -42,6 +48,8 @@ public:
     
     // Ticks
     void onTick(double tpf, const InputState* inputState);
+    void onPublishSnapshot();
+    void onRender(double tpf, double interp);
     
     // Key handling
     void onKeyboardEvent(const KeyboardEvent& event);
@@ -35,6 +35,14 @@ const Geometry::Armature& Geometry::getArmature() const {
     static Armature dummy;
     return dummy;
 }
+const BoundingBox& Geometry::getBoundingBox() const {
+    static BoundingBox infinite = BoundingBox::getInfinite();
+    return infinite;
+}
+const BoundingSphere& Geometry::getBoundingSphere() const {
+    static BoundingSphere infinite = BoundingSphere::getInfinite();
+    return infinite;
+}
 
 #ifdef PGG_OPENGL
 void Geometry::enablePositionAttrib(GLuint posAttrib) { }
@@ -50,7 +58,7 @@ void Geometry::enableBoneAttrib(GLuint boneWeightAttrib, GLuint boneIndexAttrib)
 const VkPipelineVertexInputStateCreateInfo* Geometry::getVertexInputState() { return nullptr; }
 const VkPipelineInputAssemblyStateCreateInfo* Geometry::getInputAssemblyState() { return nullptr; }
 void Geometry::cmdBindBuffers(VkCommandBuffer cmdBuff) { }
-void Geometry::cmdDrawIndexed(VkCommandBuffer cmdBuff) { }
+void Geometry::cmdDrawIndexed(VkCommandBuffer cmdBuff, uint32_t instances) { }
 #endif
 
 void Geometry::load() { }
@@ -21,6 +21,7 @@
 
 #include <GraphicsApiLibrary.hpp>
 
+#include "BoundingVolume.hpp"
 #include "ReferenceCounted.hpp"
 #include "Resource.hpp"
 #include "Vec3.hpp"
@@ -35,6 +36,7 @@ namespace pgg {
  *      - Flex data
  *  - Armature: Bone heiarchy, intial transform matrices
  *  - Lightprobe: per-probe position and bone weights
+ *  - Bounds: box and sphere containing all vertices, in the same space as vertices
  */
 class Geometry : virtual public ReferenceCounted {
 public:
@@ -73,6 +75,10 @@ public:
     virtual const std::vector<Lightprobe>& getLightprobes() const;
     virtual bool hasArmature() const;
     virtual const Armature& getArmature() const;
+    
+    /// Bounds are infinite unless the geometry knows its vertex positions
+    virtual const BoundingBox& getBoundingBox() const;
+    virtual const BoundingSphere& getBoundingSphere() const;
 
     #ifdef PGG_OPENGL
     virtual void drawElements() const = 0;
@@ -100,7 +106,7 @@ public:
     virtual const VkPipelineVertexInputStateCreateInfo* getVertexInputState();
     virtual const VkPipelineInputAssemblyStateCreateInfo* getInputAssemblyState();
     virtual void cmdBindBuffers(VkCommandBuffer cmdBuff);
-    virtual void cmdDrawIndexed(VkCommandBuffer cmdBuff);
+    virtual void cmdDrawIndexed(VkCommandBuffer cmdBuff, uint32_t instances = 1);
     #endif // PGG_VULKAN
     
     virtual void load();
@@ -31,6 +31,8 @@ namespace pgg {
 
 GeometryResourceOG::GeometryResourceOG()
 : mLoaded(false)
+, mBoundingBox(BoundingBox::getInfinite())
+, mBoundingSphere(BoundingSphere::getInfinite())
 , Resource(Resource::Type::GEOMETRY) {
 }
 
@@ -136,6 +138,12 @@ void GeometryResourceOG::load() {
         }
     }
     
+    // Bounds for culling
+    if(mUsePosition) {
+        mBoundingBox = BoundingBox::fromPositions(floatVertices + mPositionOff, mNumVertices, mFloatsPerVertex);
+        mBoundingSphere = BoundingSphere::fromPositions(floatVertices + mPositionOff, mNumVertices, mFloatsPerVertex, mBoundingBox);
+    }
+    
     mNumTriangles = readU32(input);
 
     GLuint indices[mNumTriangles * 3];
@@ -236,6 +244,9 @@ void GeometryResourceOG::unload() {
     mLoaded = false;
 }
 
+const BoundingBox& GeometryResourceOG::getBoundingBox() const { return mBoundingBox; }
+const BoundingSphere& GeometryResourceOG::getBoundingSphere() const { return mBoundingSphere; }
+
 void GeometryResourceOG::drawElements() const {
     glDrawElements(GL_TRIANGLES, mNumTriangles * 3, GL_UNSIGNED_INT, 0);
 }
@@ -60,6 +60,9 @@ private:
     
     Geometry::Armature mArmature;
     std::vector<Geometry::Lightprobe> mLightprobes;
+    
+    BoundingBox mBoundingBox;
+    BoundingSphere mBoundingSphere;
 
     GLuint mFloatVertexBufferObject;
     GLuint mByteVertexBufferObject;
@@ -75,6 +78,9 @@ public:
 
     void load();
     void unload();
+    
+    const BoundingBox& getBoundingBox() const;
+    const BoundingSphere& getBoundingSphere() const;
 
     void drawElements() const;
     void drawElementsInstanced(uint32_t num) const;
@@ -34,6 +34,8 @@ namespace pgg {
 
 GeometryResourceVK::GeometryResourceVK()
 : mLoaded(false)
+, mBoundingBox(BoundingBox::getInfinite())
+, mBoundingSphere(BoundingSphere::getInfinite())
 , Resource(Resource::Type::GEOMETRY) {
 }
 
@@ -155,6 +157,12 @@ void GeometryResourceVK::load() {
         }
     }
     
+    // Bounds for culling
+    if(mUsePosition) {
+        mBoundingBox = BoundingBox::fromPositions(floatVertices + mPositionOff, mNumVertices, mFloatsPerVertex);
+        mBoundingSphere = BoundingSphere::fromPositions(floatVertices + mPositionOff, mNumVertices, mFloatsPerVertex, mBoundingBox);
+    }
+    
     mNumTriangles = readU32(input);
     //iout << mNumTriangles << std::endl;
     
@@ -247,21 +255,18 @@ void GeometryResourceVK::load() {
     Video::Vulkan::Utils::bufferCreateAndAllocate(mSizeOfFloatVertexArray + mSizeOfIndexArray, 
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-        &mVertexIndexBuffer, &mVertexIndexBufferMemory);
+        &mVertexIndexBuffer, &mVertexIndexAllocation);
     {
-        void* memAddr;
+        // Host visible memory stays mapped for as long as it is allocated
+        uint8_t* memAddr = static_cast<uint8_t*>(mVertexIndexAllocation.mMapped);
         
-        vkMapMemory(Video::Vulkan::getLogicalDevice(), mVertexIndexBufferMemory, 0, mSizeOfFloatVertexArray, 0, &memAddr);
         std::memcpy(memAddr, floatVertices, mSizeOfFloatVertexArray);
-        vkUnmapMemory(Video::Vulkan::getLogicalDevice(), mVertexIndexBufferMemory);
         
-        vkMapMemory(Video::Vulkan::getLogicalDevice(), mVertexIndexBufferMemory, mSizeOfFloatVertexArray, mSizeOfIndexArray, 0, &memAddr);
         if(mIndexTypeSize == sizeof(glm::u16)) {
-            std::memcpy(memAddr, indices16, mSizeOfIndexArray);
+            std::memcpy(memAddr + mSizeOfFloatVertexArray, indices16, mSizeOfIndexArray);
         } else if(mIndexTypeSize == sizeof(glm::u32)) {
-            std::memcpy(memAddr, indices32, mSizeOfIndexArray);
+            std::memcpy(memAddr + mSizeOfFloatVertexArray, indices32, mSizeOfIndexArray);
         }
-        vkUnmapMemory(Video::Vulkan::getLogicalDevice(), mVertexIndexBufferMemory);
     }
     
     // TODO: make sure memory is cleaned up even in the event of error
@@ -352,12 +357,13 @@ void GeometryResourceVK::load() {
 void GeometryResourceVK::unload() {
     assert(mLoaded && "Attempted to unload geometry before loading it");
     
-    vkFreeMemory(Video::Vulkan::getLogicalDevice(), mVertexIndexBufferMemory, nullptr);
-    vkDestroyBuffer(Video::Vulkan::getLogicalDevice(), mVertexIndexBuffer, nullptr);
+    Video::Vulkan::Utils::bufferDestroyAndFree(&mVertexIndexBuffer, &mVertexIndexAllocation);
     
     mLoaded = false;
 }
 
+const BoundingBox& GeometryResourceVK::getBoundingBox() const { return mBoundingBox; }
+const BoundingSphere& GeometryResourceVK::getBoundingSphere() const { return mBoundingSphere; }
 const VkPipelineVertexInputStateCreateInfo* GeometryResourceVK::getVertexInputState() { return &mVertexInputState; }
 const VkPipelineInputAssemblyStateCreateInfo* GeometryResourceVK::getInputAssemblyState() { return &mInputAssemblyState; }
 
@@ -366,8 +372,8 @@ void GeometryResourceVK::cmdBindBuffers(VkCommandBuffer cmdBuff) {
     vkCmdBindVertexBuffers(cmdBuff, 0, 1, &mVertexIndexBuffer, &offset);
     vkCmdBindIndexBuffer(cmdBuff, mVertexIndexBuffer, mSizeOfFloatVertexArray, Video::Vulkan::Utils::indexTypeFromSize(mIndexTypeSize));
 }
-void GeometryResourceVK::cmdDrawIndexed(VkCommandBuffer cmdBuff) {
-    vkCmdDrawIndexed(cmdBuff, mNumTriangles * 3, 1, 0, 0, 0);
+void GeometryResourceVK::cmdDrawIndexed(VkCommandBuffer cmdBuff, uint32_t instances) {
+    vkCmdDrawIndexed(cmdBuff, mNumTriangles * 3, instances, 0, 0, 0);
 }
 }
 
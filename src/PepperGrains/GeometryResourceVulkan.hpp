@@ -23,6 +23,7 @@
 
 #include <GraphicsApiLibrary.hpp>
 
+#include "DeviceMemoryAllocatorVulkan.hpp"
 #include "Geometry.hpp"
 #include "Resource.hpp"
 
@@ -67,7 +68,7 @@ private:
     uint32_t mNumTriangles;
     
     VkBuffer mVertexIndexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory mVertexIndexBufferMemory = VK_NULL_HANDLE;
+    DeviceMemoryAllocatorVk::Allocation mVertexIndexAllocation;
     
     // The data of these vectors are referenced during pipeline creation
     std::vector<VkVertexInputBindingDescription> mVertexInputBindingDescs;
@@ -78,6 +79,9 @@ private:
     
     Geometry::Armature mArmature;
     std::vector<Geometry::Lightprobe> mLightprobes;
+    
+    BoundingBox mBoundingBox;
+    BoundingSphere mBoundingSphere;
 
     bool mLoaded;
     
@@ -90,11 +94,14 @@ public:
     void load();
     void unload();
     
+    const BoundingBox& getBoundingBox() const;
+    const BoundingSphere& getBoundingSphere() const;
+    
     const VkPipelineVertexInputStateCreateInfo* getVertexInputState();
     const VkPipelineInputAssemblyStateCreateInfo* getInputAssemblyState();
     
     void cmdBindBuffers(VkCommandBuffer cmdBuff);
-    void cmdDrawIndexed(VkCommandBuffer cmdBuff);
+    void cmdDrawIndexed(VkCommandBuffer cmdBuff, uint32_t instances = 1);
 };
 typedef GeometryResourceVK GeometryResource;
 
@@ -15,8 +15,11 @@
 */
 
 #include "GrassModel.hpp"
+
+#include <cassert>
 #include <iostream>
 
+#include "GLStateCache.hpp"
 #include "ResourceManager.hpp"
 
 namespace pgg {
@@ -38,29 +41,20 @@ void GrassModel::load() {
     
     std::cout << "Is error: " << mShaderProg->isFallback() << std::endl;
     
+    // Offset and color are whichever instanced controls the shader has, regardless of name
     const std::vector<ShaderProgramResource::Control>& vec3Controls = mShaderProg->getInstancedVec3s();
-    for(std::vector<ShaderProgramResource::Control>::const_iterator iter = vec3Controls.begin(); iter != vec3Controls.end(); ++ iter) {
-        const ShaderProgramResource::Control& entry = *iter;
-        mOffsetHandle = entry.handle;
-        break;
+    if(!vec3Controls.empty()) {
+        mOffsetHandle = vec3Controls.front().handle;
     }
     const std::vector<ShaderProgramResource::Control>& vec2Controls = mShaderProg->getInstancedVec2s();
-    for(std::vector<ShaderProgramResource::Control>::const_iterator iter = vec2Controls.begin(); iter != vec2Controls.end(); ++ iter) {
-        const ShaderProgramResource::Control& entry = *iter;
-        mColorHandle = entry.handle;
-        break;
+    if(!vec2Controls.empty()) {
+        mColorHandle = vec2Controls.front().handle;
     }
-    const std::vector<ShaderProgramResource::Control>& sampler2DControls = mShaderProg->getUniformSampler2Ds();
-    for(std::vector<ShaderProgramResource::Control>::const_iterator iter = sampler2DControls.begin(); iter != sampler2DControls.end(); ++ iter) {
-        const ShaderProgramResource::Control& entry = *iter;
-        
-        if(entry.name == "diffuseMap") {
-            mDiffuseHandle = entry.handle;
-            std::cout << "Diffuse " << mDiffuseHandle << std::endl;
-        } else if(entry.name == "heightMap") {
-            mHeightHandle = entry.handle;
-            std::cout << "Height " << mHeightHandle << std::endl;
-        }
+    if(mShaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "diffuseMap", mDiffuseHandle)) {
+        std::cout << "Diffuse " << mDiffuseHandle << std::endl;
+    }
+    if(mShaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "heightMap", mHeightHandle)) {
+        std::cout << "Height " << mHeightHandle << std::endl;
     }
     
     glm::vec3 offsets[40000];
@@ -155,34 +149,35 @@ void GrassModel::unload() {
 
     delete this;
 }
-void GrassModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void GrassModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
     
     if(rendPass.mType != Renderable::Pass::Type::GEOMETRY) {
         return;
     }
     
-    glDisable(GL_CULL_FACE);
+    assert(rendPass.mGLState && "Grass requires a GL state cache");
+    GLStateCache& glState = *rendPass.mGLState;
+    
+    glState.disable(GL_CULL_FACE);
     
-    glUseProgram(mShaderProg->getHandle());
+    glState.useProgram(mShaderProg->getHandle());
 
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
     
-    glActiveTexture(GL_TEXTURE0 + 0);
-    glBindTexture(GL_TEXTURE_2D, mDiffuseTexture->getHandle());
+    glState.bindTexture2D(0, mDiffuseTexture->getHandle());
     glUniform1i(mDiffuseHandle, 0);
     
-    glActiveTexture(GL_TEXTURE0 + 1);
-    glBindTexture(GL_TEXTURE_2D, mHeightTexture->getHandle());
+    glState.bindTexture2D(1, mHeightTexture->getHandle());
     glUniform1i(mHeightHandle, 1);
 
-    glBindVertexArray(mVertexArrayObject);
+    glState.bindVertexArray(mVertexArrayObject);
 
     mGeometry->drawElementsInstanced(40000);
-
-    glBindVertexArray(0);
-
-    glUseProgram(0);
-    glEnable(GL_CULL_FACE);
+    
+    // Other models in the pass expect culling; the program and vertex array can stay bound
+    glState.enable(GL_CULL_FACE);
 }
 
+bool GrassModel::usesGLStateCache() const { return true; }
+
 }
@@ -45,7 +45,8 @@ public:
     void load();
     void unload();
 
-    void render(Renderable::Pass rendPass, const glm::mat4& modelMat);
+    void render(const Renderable::Pass& rendPass, const glm::mat4& modelMat);
+    bool usesGLStateCache() const;
 
 };
 
@@ -36,10 +36,15 @@ public:
     virtual uint32_t getWidth() const = 0;
     virtual uint32_t getHeight() const = 0;
     virtual uint32_t getNumComponents() const = 0;
+    virtual uint32_t getNumMipLevels() const = 0;
     
     #ifdef PGG_VULKAN
     virtual VkImage getHandle() const = 0;
+    
+    // Memory may be shared with other resources; the image is bound at getMemoryOffset()
     virtual VkDeviceMemory getMemory() const = 0;
+    virtual VkDeviceSize getMemoryOffset() const = 0;
+    
     virtual VkImageView getView() const = 0;
     virtual VkFormat getFormat() const = 0;
     virtual VkImageLayout getLayout() const = 0;
@@ -60,10 +65,12 @@ public:
     uint32_t getWidth() const;
     uint32_t getHeight() const;
     uint32_t getNumComponents() const;
+    uint32_t getNumMipLevels() const;
     
     #ifdef PGG_VULKAN
     VkImage getHandle() const;
     VkDeviceMemory getMemory() const;
+    VkDeviceSize getMemoryOffset() const;
     VkImageView getView() const;
     VkFormat getFormat() const;
     VkImageLayout getLayout() const;
@@ -16,26 +16,164 @@
 
 #include "ImageResource.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <sstream>
 
 #include <GraphicsApiLibrary.hpp>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "DescriptorSetCacheVulkan.hpp"
 #include "Video.hpp"
+#include "Jobs.hpp"
 #include "Logger.hpp"
 #include "Resources.hpp"
+#include "StreamStuff.hpp"
+#include "TextureStreamerVulkan.hpp"
+#include "TransferBatcherVulkan.hpp"
 #include "VulkanUtils.hpp"
 
 namespace pgg {
 
+namespace {
+    
+    const char* sCacheDirName = "user/texcache";
+    const uint32_t sCacheMagic = 0x43424750; // "PGBC"
+    const uint32_t sCacheVersion = 2;
+    
+    // Streamed images always keep the levels this many texels across and smaller resident
+    const uint32_t sMinStreamedSize = 128;
+    
+    // Size of the first numLevels mip levels, tightly packed as either texels or blocks
+    uint64_t calcChainSize(bool compressed, BlockCompression::Format format, uint32_t width, uint32_t height, uint32_t numComponents, uint32_t numLevels) {
+        std::vector<MipChain::Level> levels = MipChain::calcLevels(width, height, numComponents);
+        uint64_t size = 0;
+        for(uint32_t i = 0; i < numLevels && i < levels.size(); ++ i) {
+            if(compressed) {
+                size += BlockCompression::calcCompressedSize(format, levels[i].mWidth, levels[i].mHeight);
+            } else {
+                size += static_cast<uint64_t>(levels[i].mWidth) * levels[i].mHeight * numComponents;
+            }
+        }
+        return size;
+    }
+    
+    #ifdef PGG_VULKAN
+    VkFormat toVkFormat(BlockCompression::Format format) {
+        switch(format) {
+            case BlockCompression::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            case BlockCompression::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+            case BlockCompression::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+    
+    bool isBlockFormatSupported(BlockCompression::Format format) {
+        return Video::Vulkan::getPhysicalDeviceFeatures().textureCompressionBC
+            && Video::Vulkan::Utils::physDeviceSupportsFormat(toVkFormat(format), VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+    }
+    #endif // PGG_VULKAN
+    
+    /* Pixel buffers (whole source files, mip chains and blocks) are kept once an image is done with them, so that
+     * loading many images in a row does not keep handing tens of megabytes back to the heap only to ask for them again.
+     * Also guards the decode stats.
+     */
+    std::mutex sDecodeMutex;
+    std::vector<std::vector<uint8_t> > sBufferPool;
+    std::size_t sBufferPoolBytes = 0;
+    ImageResource::DecodeStats sDecodeStats;
+    
+    const std::size_t sMaxPooledBuffers = 16;
+    const std::size_t sMaxPooledBytes = 256 << 20;
+    
+    // Leaves buffer with size bytes, swapping in the smallest pooled buffer with room for them if there is one
+    void acquireBuffer(std::vector<uint8_t>& buffer, std::size_t size);
+    
+    // Hands the buffer's storage back to the pool, or frees it if the pool is full; buffer is left empty
+    void releaseBuffer(std::vector<uint8_t>& buffer) {
+        if(buffer.capacity() == 0) {
+            return;
+        }
+        buffer.clear();
+        {
+            std::lock_guard<std::mutex> lock(sDecodeMutex);
+            if(sBufferPool.size() < sMaxPooledBuffers && sBufferPoolBytes + buffer.capacity() <= sMaxPooledBytes) {
+                sBufferPoolBytes += buffer.capacity();
+                sBufferPool.emplace_back();
+                sBufferPool.back().swap(buffer);
+                return;
+            }
+        }
+        std::vector<uint8_t>().swap(buffer);
+    }
+    
+    void acquireBuffer(std::vector<uint8_t>& buffer, std::size_t size) {
+        if(buffer.capacity() < size) {
+            releaseBuffer(buffer);
+            
+            std::lock_guard<std::mutex> lock(sDecodeMutex);
+            std::size_t best = sBufferPool.size();
+            for(std::size_t i = 0; i < sBufferPool.size(); ++ i) {
+                std::size_t capacity = sBufferPool[i].capacity();
+                if(capacity >= size && (best == sBufferPool.size() || capacity < sBufferPool[best].capacity())) {
+                    best = i;
+                }
+            }
+            
+            // Too small buffers are left for smaller images, rather than reallocated here
+            if(best < sBufferPool.size()) {
+                sBufferPoolBytes -= sBufferPool[best].capacity();
+                buffer.swap(sBufferPool[best]);
+                sBufferPool[best].swap(sBufferPool.back());
+                sBufferPool.pop_back();
+                ++ sDecodeStats.mNumPoolHits;
+            } else {
+                ++ sDecodeStats.mNumPoolMisses;
+            }
+        }
+        buffer.resize(size);
+    }
+    
+} // namespace
+
 ImageResource::ImageResource()
-: mLoaded(false)
+: mHasCache(false)
+, mCacheDataOffset(0)
+, mBlockCompressed(false)
+, mBlockFormat(BlockCompression::BC1)
+, mMipLevels(1)
+, mLoaded(false)
+, mCompression(COMPRESSION_AUTO)
+, mMipFilter(MIP_FILTER_KAISER)
+, mColorSpace(COLOR_SPACE_AUTO)
+, mStreamable(true)
 , Resource(Resource::Type::IMAGE) {
 }
 
 ImageResource::~ImageResource() {
+    #ifdef PGG_VULKAN
+    this->releaseDecoded(mDecoded);
+    #endif // PGG_VULKAN
+}
+
+ImageResource::DecodeStats::DecodeStats()
+: mNumDecoded(0)
+, mNumCacheHits(0)
+, mNumFailures(0)
+, mNumBatches(0)
+, mSourceBytes(0)
+, mOutputBytes(0)
+, mDecodeMicroseconds(0)
+, mBatchMicroseconds(0)
+, mNumPoolHits(0)
+, mNumPoolMisses(0) {
 }
 
 Image* ImageResource::gallop(Resource* resource) {
@@ -47,35 +185,421 @@ Image* ImageResource::gallop(Resource* resource) {
     }
 }
 
-#ifdef PGG_VULKAN
-void ImageResource::load() {
-    assert(!mLoaded && "Attempted to load image that has already been loaded");
+void ImageResource::setCompression(const std::string& compression) {
+    if(compression == "none") {
+        mCompression = COMPRESSION_NONE;
+    } else if(compression == "bc1") {
+        mCompression = COMPRESSION_BC1;
+    } else if(compression == "bc3") {
+        mCompression = COMPRESSION_BC3;
+    } else if(compression == "bc5") {
+        mCompression = COMPRESSION_BC5;
+    } else {
+        if(!compression.empty() && compression != "auto") {
+            Logger::log(Logger::WARN) << "Unknown image compression: " << compression << std::endl;
+        }
+        mCompression = COMPRESSION_AUTO;
+    }
+}
+
+ImageResource::Compression ImageResource::getCompression() const { return mCompression; }
+
+void ImageResource::setMipFilter(const std::string& mipFilter) {
+    if(mipFilter == "none") {
+        mMipFilter = MIP_FILTER_NONE;
+    } else if(mipFilter == "box") {
+        mMipFilter = MIP_FILTER_BOX;
+    } else {
+        if(!mipFilter.empty() && mipFilter != "kaiser") {
+            Logger::log(Logger::WARN) << "Unknown image mip filter: " << mipFilter << std::endl;
+        }
+        mMipFilter = MIP_FILTER_KAISER;
+    }
+}
+
+ImageResource::MipFilter ImageResource::getMipFilter() const { return mMipFilter; }
+
+void ImageResource::setColorSpace(const std::string& colorSpace) {
+    if(colorSpace == "srgb") {
+        mColorSpace = COLOR_SPACE_SRGB;
+    } else if(colorSpace == "linear") {
+        mColorSpace = COLOR_SPACE_LINEAR;
+    } else {
+        if(!colorSpace.empty()) {
+            Logger::log(Logger::WARN) << "Unknown image color space: " << colorSpace << std::endl;
+        }
+        mColorSpace = COLOR_SPACE_AUTO;
+    }
+}
+
+ImageResource::ColorSpace ImageResource::getColorSpace() const { return mColorSpace; }
 
+void ImageResource::setStreamable(bool streamable) { mStreamable = streamable; }
+
+bool ImageResource::chooseBlockFormat(const uint8_t* texels, BlockCompression::Format& format) const {
+    switch(mCompression) {
+        case COMPRESSION_NONE: return false;
+        case COMPRESSION_BC1: format = BlockCompression::BC1; return true;
+        case COMPRESSION_BC3: format = BlockCompression::BC3; return true;
+        case COMPRESSION_BC5: format = BlockCompression::BC5; return true;
+        default: break;
+    }
+    
+    if(mComponents == 2) {
+        format = BlockCompression::BC5;
+        return true;
+    }
+    if(mComponents == 3) {
+        format = BlockCompression::BC1;
+        return true;
+    }
+    if(mComponents == 4) {
+        // Alpha costs twice the space, so only keep it if it is actually used
+        format = BlockCompression::BC1;
+        std::size_t numTexels = ((std::size_t) mWidth) * mHeight;
+        for(std::size_t i = 0; i < numTexels; ++ i) {
+            if(texels[i * 4 + 3] != 255) {
+                format = BlockCompression::BC3;
+                break;
+            }
+        }
+        return true;
+    }
+    
+    // Single channels would need BC4
+    return false;
+}
+
+std::string ImageResource::getCacheFilename() const {
+    // Resource names can repeat across addons, so the cache is named after the source file instead
+    std::string source = this->getFile().string();
+    uint64_t hash = 14695981039346656037ull;
+    for(char c : source) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    
+    std::stringstream ss;
+    ss << sCacheDirName << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".tex";
+    return ss.str();
+}
+
+bool ImageResource::loadCache(std::vector<uint8_t>& data, bool& compressed, BlockCompression::Format& format) {
+    if(mCompression == COMPRESSION_NONE && mMipFilter == MIP_FILTER_NONE) {
+        return false;
+    }
+    
+    boost::system::error_code error;
+    uint64_t sourceSize = boost::filesystem::file_size(this->getFile(), error);
+    if(error) return false;
+    uint64_t sourceTime = boost::filesystem::last_write_time(this->getFile(), error);
+    if(error) return false;
+    
+    std::ifstream input(this->getCacheFilename(), std::ios::in | std::ios::binary);
+    if(!input.is_open()) {
+        return false;
+    }
+    
+    if(readU32(input) != sCacheMagic) return false;
+    if(readU32(input) != sCacheVersion) return false;
+    if(readU32(input) != mCompression) return false;
+    if(readU32(input) != mMipFilter) return false;
+    if(readU32(input) != mColorSpace) return false;
+    if(readU64(input) != sourceSize) return false;
+    if(readU64(input) != sourceTime) return false;
+    bool isCompressed = readU8(input) != 0;
+    uint32_t formatVal = readU32(input);
+    uint32_t width = readU32(input);
+    uint32_t height = readU32(input);
+    uint32_t components = readU32(input);
+    uint32_t mipLevels = readU32(input);
+    uint64_t size = readU64(input);
+    
+    if(!input.good() || formatVal >= BlockCompression::NUM_FORMATS) {
+        return false;
+    }
+    if(mipLevels < 1 || mipLevels > MipChain::calcNumLevels(width, height)) {
+        return false;
+    }
+    BlockCompression::Format cachedFormat = static_cast<BlockCompression::Format>(formatVal);
+    if(size != calcChainSize(isCompressed, cachedFormat, width, height, components, mipLevels)) {
+        return false;
+    }
+    
+    uint64_t dataOffset = input.tellg();
+    acquireBuffer(data, size);
+    input.read(reinterpret_cast<char*>(data.data()), size);
+    if(!input.good()) {
+        data.clear();
+        return false;
+    }
+    
+    mHasCache = true;
+    mCacheDataOffset = dataOffset;
+    
+    compressed = isCompressed;
+    format = cachedFormat;
+    mWidth = width;
+    mHeight = height;
+    mComponents = components;
+    mMipLevels = mipLevels;
+    return true;
+}
+
+void ImageResource::saveCache(const std::vector<uint8_t>& data, bool compressed, BlockCompression::Format format) {
+    boost::system::error_code error;
+    uint64_t sourceSize = boost::filesystem::file_size(this->getFile(), error);
+    if(error) return;
+    uint64_t sourceTime = boost::filesystem::last_write_time(this->getFile(), error);
+    if(error) return;
+    boost::filesystem::create_directories(sCacheDirName, error);
+    if(error) return;
+    
+    std::string filename = this->getCacheFilename();
+    std::ofstream output(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!output.is_open()) {
+        Logger::log(Logger::WARN) << "Could not write image cache " << filename << std::endl;
+        return;
+    }
+    
+    // A write cut short is caught by the size check when loading
+    writeU32(output, sCacheMagic);
+    writeU32(output, sCacheVersion);
+    writeU32(output, mCompression);
+    writeU32(output, mMipFilter);
+    writeU32(output, mColorSpace);
+    writeU64(output, sourceSize);
+    writeU64(output, sourceTime);
+    writeU8(output, compressed ? 1 : 0);
+    writeU32(output, compressed ? format : 0);
+    writeU32(output, mWidth);
+    writeU32(output, mHeight);
+    writeU32(output, mComponents);
+    writeU32(output, mMipLevels);
+    writeU64(output, data.size());
+    uint64_t dataOffset = output.tellp();
+    output.write(reinterpret_cast<const char*>(data.data()), data.size());
+    output.flush();
+    
+    if(output.good()) {
+        mHasCache = true;
+        mCacheDataOffset = dataOffset;
+    }
+}
+
+bool ImageResource::readCachedLevels(uint32_t baseLevel, std::vector<uint8_t>& data) const {
+    if(!mHasCache) {
+        return false;
+    }
+    
+    std::ifstream input(this->getCacheFilename(), std::ios::in | std::ios::binary);
+    if(!input.is_open()) {
+        return false;
+    }
+    
+    // Smaller levels come after larger ones, so they are all in one piece
+    input.seekg(mCacheDataOffset + mLevelOffsets[baseLevel]);
+    data.resize(mLevelOffsets.back() - mLevelOffsets[baseLevel]);
+    input.read(reinterpret_cast<char*>(data.data()), data.size());
+    return input.good();
+}
+
+#ifdef PGG_VULKAN
+bool ImageResource::decode(Decoded& decoded) {
     Logger::Out vout = Logger::log(Logger::VERBOSE);
     Logger::Out wout = Logger::log(Logger::WARN);
     
-    uint8_t* rawImgData = nullptr;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    
+    std::vector<uint8_t>& levelData = decoded.mLevelData;
+    decoded.mCompressed = false;
+    decoded.mBlockFormat = BlockCompression::BC1;
+    uint64_t sourceBytes = 0;
+    
+    // A chain built by an earlier launch spares decoding the source at all
+    bool cached = this->loadCache(levelData, decoded.mCompressed, decoded.mBlockFormat) 
+        && (!decoded.mCompressed || isBlockFormatSupported(decoded.mBlockFormat));
+    
+    if(!cached) {
+        decoded.mCompressed = false;
+        
+        // The cache may have been read but not be usable here; it is only trusted again once saveCache() rewrites it
+        mHasCache = false;
+        
+        // The whole file is read into memory first, so that decoding does no further I/O
+        std::vector<uint8_t> source;
+        {
+            std::ifstream input(this->getFile().string().c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+            if(input.is_open()) {
+                std::streamoff size = input.tellg();
+                input.seekg(0);
+                acquireBuffer(source, static_cast<std::size_t>(size));
+                input.read(reinterpret_cast<char*>(source.data()), source.size());
+                if(!input.good()) {
+                    source.clear();
+                }
+            }
+        }
+        sourceBytes = source.size();
+        
+        // Read image using stbi
+        uint8_t* rawImgData = nullptr;
+        if(!source.empty()) {
+            int width;
+            int height;
+            int components;
+            rawImgData = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &width, &height, &components, 0);
+            mWidth = width;
+            mHeight = height;
+            mComponents = components;
+            vout << "width: " << width << std::endl;
+            vout << "height: " << height << std::endl;
+        }
+        releaseBuffer(source);
+        
+        if(!rawImgData) {
+            wout << "Could not decode image " << this->getFile().string() << std::endl;
+            releaseBuffer(levelData);
+            
+            std::lock_guard<std::mutex> lock(sDecodeMutex);
+            ++ sDecodeStats.mNumFailures;
+            return false;
+        }
+        
+        // Full size level first
+        std::vector<uint8_t> chain;
+        mMipLevels = mMipFilter == MIP_FILTER_NONE ? 1 : MipChain::calcNumLevels(mWidth, mHeight);
+        acquireBuffer(chain, calcChainSize(false, BlockCompression::BC1, mWidth, mHeight, mComponents, mMipLevels));
+        if(mMipLevels > 1) {
+            bool srgb = mColorSpace == COLOR_SPACE_SRGB || (mColorSpace == COLOR_SPACE_AUTO && mComponents >= 3);
+            MipChain::generate(
+                mMipFilter == MIP_FILTER_BOX ? MipChain::BOX : MipChain::KAISER, srgb, 
+                rawImgData, mWidth, mHeight, mComponents, 
+                chain);
+        } else {
+            std::memcpy(chain.data(), rawImgData, chain.size());
+        }
+        stbi_image_free(rawImgData);
+        const uint8_t* texels = chain.data();
+        
+        BlockCompression::Format blockFormat = BlockCompression::BC1;
+        if(this->chooseBlockFormat(texels, blockFormat) && isBlockFormatSupported(blockFormat)) {
+            acquireBuffer(levelData, calcChainSize(true, blockFormat, mWidth, mHeight, mComponents, mMipLevels));
+            
+            // Each level is compressed from its own texels
+            std::vector<MipChain::Level> levels = MipChain::calcLevels(mWidth, mHeight, mComponents);
+            uint64_t blockOffset = 0;
+            for(uint32_t i = 0; i < mMipLevels; ++ i) {
+                const MipChain::Level& level = levels[i];
+                BlockCompression::compress(blockFormat, texels + level.mOffset, level.mWidth, level.mHeight, mComponents, levelData.data() + blockOffset);
+                blockOffset += BlockCompression::calcCompressedSize(blockFormat, level.mWidth, level.mHeight);
+            }
+            decoded.mCompressed = true;
+            decoded.mBlockFormat = blockFormat;
+        } else {
+            levelData.swap(chain);
+        }
+        releaseBuffer(chain);
+        
+        // A single uncompressed level is no quicker to read from the cache than from the source
+        if(decoded.mCompressed || mMipLevels > 1) {
+            this->saveCache(levelData, decoded.mCompressed, decoded.mBlockFormat);
+        }
+    }
+    
+    decoded.mValid = true;
     
-    // Read image using stbi
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - startTime;
     {
-        int width;
-        int height;
-        int components;
-        rawImgData = stbi_load(this->getFile().string().c_str(), &width, &height, &components, 0);
-        mWidth = width;
-        mHeight = height;
-        mComponents = components;
-        vout << "width: " << width << std::endl;
-        vout << "height: " << height << std::endl;
+        std::lock_guard<std::mutex> lock(sDecodeMutex);
+        if(cached) {
+            ++ sDecodeStats.mNumCacheHits;
+        } else {
+            ++ sDecodeStats.mNumDecoded;
+        }
+        sDecodeStats.mSourceBytes += sourceBytes;
+        sDecodeStats.mOutputBytes += levelData.size();
+        sDecodeStats.mDecodeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+    return true;
+}
+
+void ImageResource::releaseDecoded(Decoded& decoded) {
+    releaseBuffer(decoded.mLevelData);
+    decoded.mValid = false;
+}
+
+void ImageResource::decodeBatch(const std::vector<ImageResource*>& images) {
+    std::vector<ImageResource*> pending;
+    pending.reserve(images.size());
+    for(ImageResource* image : images) {
+        if(image && !image->mLoaded && !image->mDecoded.mValid) {
+            pending.push_back(image);
+        }
+    }
+    
+    // The same image must not be decoded by two jobs at once
+    std::sort(pending.begin(), pending.end());
+    pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+    if(pending.empty()) {
+        return;
+    }
+    
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    
+    // One image per job; filtering large images' mip chains is split across the pool as well
+    Jobs::parallelFor(0, pending.size(), [&pending](std::size_t begin, std::size_t end) {
+        for(std::size_t i = begin; i < end; ++ i) {
+            pending[i]->decode(pending[i]->mDecoded);
+        }
+    }, 1);
+    
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - startTime;
+    Logger::log(Logger::VERBOSE) << "Decoded " << pending.size() << " images in " 
+        << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms" << std::endl;
+    
+    std::lock_guard<std::mutex> lock(sDecodeMutex);
+    ++ sDecodeStats.mNumBatches;
+    sDecodeStats.mBatchMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void ImageResource::freeDecodeBuffers() {
+    std::vector<std::vector<uint8_t> > freed;
+    std::lock_guard<std::mutex> lock(sDecodeMutex);
+    freed.swap(sBufferPool);
+    sBufferPoolBytes = 0;
+}
+
+ImageResource::DecodeStats ImageResource::getDecodeStats() {
+    std::lock_guard<std::mutex> lock(sDecodeMutex);
+    return sDecodeStats;
+}
+
+void ImageResource::resetDecodeStats() {
+    std::lock_guard<std::mutex> lock(sDecodeMutex);
+    sDecodeStats = DecodeStats();
+}
+
+void ImageResource::load() {
+    assert(!mLoaded && "Attempted to load image that has already been loaded");
+
+    Logger::Out wout = Logger::log(Logger::WARN);
+    
+    // Unless decodeBatch() already did
+    if(!mDecoded.mValid && !this->decode(mDecoded)) {
+        wout << "Unable to load image " << this->getName() << std::endl;
+        return;
     }
+    bool compressed = mDecoded.mCompressed;
+    BlockCompression::Format blockFormat = mDecoded.mBlockFormat;
     
     #ifdef PGG_VULKAN
     
-    VkResult result;
     bool success;
     
-    
-    if(mComponents == 1) {
+    if(compressed) {
+        mImgFormat = toVkFormat(blockFormat);
+    }
+    else if(mComponents == 1) {
         mImgFormat = VK_FORMAT_R8_UNORM;
     }
     else if(mComponents == 2) {
@@ -92,108 +616,94 @@ void ImageResource::load() {
         // crash?
     }
     
-        
-    uint32_t mImageSize = mWidth * mHeight * mComponents * sizeof(uint8_t);
+    mBlockCompressed = compressed;
+    mBlockFormat = blockFormat;
     
-    VkImage stagingImgHandle = VK_NULL_HANDLE;
-    VkDeviceMemory stagingImgMemory = VK_NULL_HANDLE;
-    success = Video::Vulkan::Utils::imageCreateAndAllocate(
-        mWidth, mHeight, 
-        mImgFormat, 
-        VK_IMAGE_TILING_LINEAR, 
-        VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-        &stagingImgHandle, &stagingImgMemory);
+    std::vector<MipChain::Level> levels = MipChain::calcLevels(mWidth, mHeight, mComponents);
+    mLevelOffsets.resize(mMipLevels + 1);
+    for(uint32_t i = 0; i <= mMipLevels; ++ i) {
+        mLevelOffsets[i] = calcChainSize(compressed, blockFormat, mWidth, mHeight, mComponents, i);
+    }
     
-    if(!success) {
-        wout << "Unable to create image and allocate memory for staging image" << std::endl;
-        // crash?
+    // Streamed images start with only their smallest levels, which the streamer adds to as they are drawn larger
+    mMinBaseLevel = 0;
+    if(mStreamable && mHasCache) {
+        while(mMinBaseLevel + 1 < mMipLevels && std::max(levels[mMinBaseLevel].mWidth, levels[mMinBaseLevel].mHeight) > sMinStreamedSize) {
+            ++ mMinBaseLevel;
+        }
     }
+    mStreamed = mMinBaseLevel > 0;
+    mBaseLevel = mMinBaseLevel;
     
-    void* memAddr;
-    vkMapMemory(Video::Vulkan::getLogicalDevice(), stagingImgMemory, 0, mImageSize, 0, &memAddr);
+    mImgLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    success = this->createDeviceImage(mBaseLevel, mDecoded.mLevelData.data() + mLevelOffsets[mBaseLevel], 
+        &mImgHandle, &mImgAllocation, &mImgView);
+    
+    // Already copied into the staging ring, so the buffer can go to the next image
+    this->releaseDecoded(mDecoded);
     
-    VkImageSubresource imgSubresQuery; {
-        imgSubresQuery.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imgSubresQuery.mipLevel = 0;
-        imgSubresQuery.arrayLayer = 0;
+    if(!success) {
+        wout << "Unable to create device image for " << this->getName() << std::endl;
+        return;
     }
-    VkSubresourceLayout stagingImgSubresLayout;
-    vkGetImageSubresourceLayout(Video::Vulkan::getLogicalDevice(), stagingImgHandle, &imgSubresQuery, &stagingImgSubresLayout);
     
-    // Image as represented in RAM exactly matches how it is represented in GPU memory, so just copy it
-    if(stagingImgSubresLayout.rowPitch == mWidth * mComponents * sizeof(uint8_t)) {
-        memcpy(memAddr, rawImgData, mImageSize);
+    if(mStreamed) {
+        Video::Vulkan::getTextureStreamer()->addImage(this);
     }
     
-    // Image as represented in RAM has some extra padding between rows, requiring multiple calls to memcpy
-    else {
-        uint8_t* destImgMem = reinterpret_cast<uint8_t*>(memAddr);
-        for(uint32_t y = 0; y < mHeight; ++ y) {
-            memcpy(
-                &(destImgMem[y * stagingImgSubresLayout.rowPitch]), 
-                &(rawImgData[y * mWidth * mComponents]), 
-                mWidth * mComponents);
-        }
+    #endif // PGG_VULKAN
+    
+    mLoaded = true;
+}
+void ImageResource::unload() {
+    assert(mLoaded && "Attempted to unload image before loading it");
+    
+    #ifdef PGG_VULKAN
+    if(mStreamed) {
+        Video::Vulkan::getTextureStreamer()->removeImage(this);
     }
     
-    vkUnmapMemory(Video::Vulkan::getLogicalDevice(), stagingImgMemory);
+    // The upload may not have been submitted yet
+    Video::Vulkan::getTransferBatcher()->finish();
     
-    // Free up image from ram, unneeded now
-    stbi_image_free(rawImgData);
+    DescriptorSetCacheVk::forgetImageViewInAll(mImgView);
+    vkDestroyImageView(Video::Vulkan::getLogicalDevice(), mImgView, nullptr);
+    mImgView = VK_NULL_HANDLE;
+    Video::Vulkan::Utils::imageDestroyAndFree(&mImgHandle, &mImgAllocation);
+    #endif // PGG_VULKAN
     
+    mLoaded = false;
+}
+
+bool ImageResource::createDeviceImage(uint32_t baseLevel, const uint8_t* data, 
+    VkImage* image, DeviceMemoryAllocatorVk::Allocation* allocation, VkImageView* view) const {
+    
+    VkResult result;
+    bool success;
+    
+    uint32_t width = std::max(mWidth >> baseLevel, 1u);
+    uint32_t height = std::max(mHeight >> baseLevel, 1u);
+    uint32_t levelCount = mMipLevels - baseLevel;
     
     success = Video::Vulkan::Utils::imageCreateAndAllocate(
-        mWidth, mHeight, 
+        width, height, 
         mImgFormat,
         VK_IMAGE_TILING_OPTIMAL, // Tiling can differ, in this case just use whatever is optimal for the GPU since we won't read from this anyway
         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-        &mImgHandle, &mImgMemory);
+        image, allocation, 
+        levelCount);
     
     if(!success) {
-        wout << "Unable to create image and allocate memory for destination image" << std::endl;
-        // crash?
+        Logger::log(Logger::WARN) << "Unable to create image and allocate memory for destination image" << std::endl;
+        return false;
     }
     
-    /*
-    VkCommandBuffer imgUploadCmdBuffer;
-    Video::Vulkan::Utils::oneTimeUseCmdBufferAllocateAndBegin(Video::Vulkan::getGraphicsCommandPool(), &imgUploadCmdBuffer);
-    //Video::Vulkan::Utils::oneTimeUseCmdBufferAllocateAndBegin(Video::Vulkan::getTransferCommandPool(), &imgUploadCmdBuffer);
-    Video::Vulkan::Utils::oneTimeUseCmdBufferFreeAndEndAndSubmitAndSynchronizeExecution(Video::Vulkan::getGraphicsQueue(), Video::Vulkan::getGraphicsCommandPool(), &imgUploadCmdBuffer);
-    //Video::Vulkan::Utils::oneTimeUseCmdBufferFreeAndEndAndSubmitAndSynchronizeExecution(Video::Vulkan::getTransferQueue(), Video::Vulkan::getTransferCommandPool(), &imgUploadCmdBuffer);
-    */
-    
-    // TODO: perform in a single immediate command buffer
-    
-    Video::Vulkan::Utils::immChangeImageLayout(
-        stagingImgHandle, 
-        mImgFormat, 
-        VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    Video::Vulkan::Utils::immChangeImageLayout(
-        mImgHandle, 
-        mImgFormat, 
-        VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        //VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DEST_OPTIMAL);
-    Video::Vulkan::Utils::immCopyImage(
-        stagingImgHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        mImgHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        mWidth,
-        mHeight);
-    mImgLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    Video::Vulkan::Utils::immChangeImageLayout(
-        mImgHandle, 
-        mImgFormat, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mImgLayout);
-    
-    vkFreeMemory(Video::Vulkan::getLogicalDevice(), stagingImgMemory, nullptr);
-    vkDestroyImage(Video::Vulkan::getLogicalDevice(), stagingImgHandle, nullptr);
-    
     VkImageViewCreateInfo imageViewCstrArgs; {
         imageViewCstrArgs.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         imageViewCstrArgs.pNext = nullptr;
         imageViewCstrArgs.flags = 0;
-        imageViewCstrArgs.image = mImgHandle;
+        imageViewCstrArgs.image = *image;
         imageViewCstrArgs.viewType = VK_IMAGE_VIEW_TYPE_2D;
         imageViewCstrArgs.format = mImgFormat;
         imageViewCstrArgs.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -202,47 +712,72 @@ void ImageResource::load() {
         imageViewCstrArgs.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCstrArgs.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         imageViewCstrArgs.subresourceRange.baseMipLevel = 0;
-        imageViewCstrArgs.subresourceRange.levelCount = 1;
+        imageViewCstrArgs.subresourceRange.levelCount = levelCount;
         imageViewCstrArgs.subresourceRange.baseArrayLayer = 0;
         imageViewCstrArgs.subresourceRange.layerCount = 1;
     }
     
-    result = vkCreateImageView(Video::Vulkan::getLogicalDevice(), &imageViewCstrArgs, nullptr, &mImgView);
+    result = vkCreateImageView(Video::Vulkan::getLogicalDevice(), &imageViewCstrArgs, nullptr, view);
     if(result != VK_SUCCESS) {
-        wout << "Could not create image view for image" << std::endl;
-        return;
+        Logger::log(Logger::WARN) << "Could not create image view for image" << std::endl;
+        Video::Vulkan::Utils::imageDestroyAndFree(image, allocation);
+        return false;
     }
     
-    #endif // PGG_VULKAN
+    // The texels are copied into the staging ring right away, but the copy and layout transitions are only recorded
+    // into the current transfer batch, which is submitted along with other uploads. The renderer waits for
+    // outstanding uploads before drawing. All levels are staged together and written with a single copy.
+    Video::Vulkan::getTransferBatcher()->uploadImageMipChain(
+        *image, mImgFormat, 
+        width, height, levelCount, 
+        mBlockCompressed ? BlockCompression::getBytesPerBlock(mBlockFormat) : mComponents * sizeof(uint8_t), mBlockCompressed, 
+        data, 
+        mImgLayout);
     
-    mLoaded = true;
+    return true;
 }
-void ImageResource::unload() {
-    assert(mLoaded && "Attempted to unload image before loading it");
+
+bool ImageResource::changeResidency(uint32_t baseLevel, const std::vector<uint8_t>& data, 
+    VkImage* oldImage, VkImageView* oldView, DeviceMemoryAllocatorVk::Allocation* oldAllocation) {
     
-    #ifdef PGG_VULKAN
-    vkDestroyImageView(Video::Vulkan::getLogicalDevice(), mImgView, nullptr);
-    mImgView = VK_NULL_HANDLE;
-    vkFreeMemory(Video::Vulkan::getLogicalDevice(), mImgMemory, nullptr);
-    mImgMemory = VK_NULL_HANDLE;
-    vkDestroyImage(Video::Vulkan::getLogicalDevice(), mImgHandle, nullptr);
-    mImgHandle = VK_NULL_HANDLE;
-    #endif // PGG_VULKAN
+    assert(mStreamed && baseLevel <= mMinBaseLevel && "Invalid residency change");
+    assert(data.size() == this->calcResidentBytes(baseLevel) && "Wrong amount of level data");
     
-    mLoaded = false;
+    VkImage image = VK_NULL_HANDLE;
+    DeviceMemoryAllocatorVk::Allocation allocation;
+    VkImageView view = VK_NULL_HANDLE;
+    if(!this->createDeviceImage(baseLevel, data.data(), &image, &allocation, &view)) {
+        return false;
+    }
+    
+    (*oldImage) = mImgHandle;
+    (*oldView) = mImgView;
+    (*oldAllocation) = mImgAllocation;
+    
+    mImgHandle = image;
+    mImgAllocation = allocation;
+    mImgView = view;
+    mBaseLevel = baseLevel;
+    return true;
 }
 #endif // PGG_VULKAN
 
 uint32_t ImageResource::getWidth() const { return mWidth; }
 uint32_t ImageResource::getHeight() const { return mHeight; }
 uint32_t ImageResource::getNumComponents() const { return mComponents; }
+uint32_t ImageResource::getNumMipLevels() const { return mMipLevels; }
 
 #ifdef PGG_VULKAN
 VkImage ImageResource::getHandle() const { return mImgHandle; }
-VkDeviceMemory ImageResource::getMemory() const { return mImgMemory; }
+VkDeviceMemory ImageResource::getMemory() const { return mImgAllocation.mMemory; }
+VkDeviceSize ImageResource::getMemoryOffset() const { return mImgAllocation.mOffset; }
 VkImageView ImageResource::getView() const { return mImgView; }
 VkFormat ImageResource::getFormat() const { return mImgFormat; }
 VkImageLayout ImageResource::getLayout() const { return mImgLayout; }
+bool ImageResource::isStreamed() const { return mStreamed; }
+uint32_t ImageResource::getResidentBaseLevel() const { return mBaseLevel; }
+uint32_t ImageResource::getMinResidentBaseLevel() const { return mMinBaseLevel; }
+VkDeviceSize ImageResource::calcResidentBytes(uint32_t baseLevel) const { return mLevelOffsets.back() - mLevelOffsets[baseLevel]; }
 #endif // PGG_VULKAN
 
 }
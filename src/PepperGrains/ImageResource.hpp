@@ -18,49 +18,221 @@
 #define PGG_IMAGERESOURCE_HPP
 
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 #include <GraphicsApiLibrary.hpp>
 
+#include "BlockCompression.hpp"
+#include "MipChain.hpp"
 #include "Resource.hpp"
 #include "Image.hpp"
 
+#ifdef PGG_VULKAN
+#include "DeviceMemoryAllocatorVulkan.hpp"
+#endif // PGG_VULKAN
+
 namespace pgg {
 
 class ImageResource : public Image, public Resource {
+public:
+    /**
+     * Set by the "compression" field of the resource's entry in its data package:
+     *  "bc1" for color, "bc3" for color with alpha, "bc5" for two channels (e.g. normal maps), "none" to upload
+     *  texels as they are, or left out to choose by the number of components (and whether alpha is used).
+     * Block compression is only used if the device supports the format; otherwise texels are uploaded as they are.
+     */
+    enum Compression {
+        COMPRESSION_AUTO,
+        COMPRESSION_NONE,
+        COMPRESSION_BC1,
+        COMPRESSION_BC3,
+        COMPRESSION_BC5
+    };
+    
+    /**
+     * Set by the "mipFilter" field: "box", "kaiser" (the default) or "none" for only the full size level.
+     * The whole chain down to 1x1 is generated when the image is imported.
+     */
+    enum MipFilter {
+        MIP_FILTER_NONE,
+        MIP_FILTER_BOX,
+        MIP_FILTER_KAISER
+    };
+    
+    /**
+     * Set by the "colorSpace" field: "srgb" or "linear". Left out, images with three or four components are
+     * taken to be sRGB and the rest linear. Only affects how mip levels are filtered.
+     */
+    enum ColorSpace {
+        COLOR_SPACE_AUTO,
+        COLOR_SPACE_SRGB,
+        COLOR_SPACE_LINEAR
+    };
+    
+    /// Totals over every decode since the last reset, whether done by decodeBatch() or by load() itself
+    struct DecodeStats {
+        DecodeStats();
+        
+        uint32_t mNumDecoded; // From the source file
+        uint32_t mNumCacheHits; // Read from the texture cache instead
+        uint32_t mNumFailures;
+        uint32_t mNumBatches;
+        
+        uint64_t mSourceBytes; // Encoded bytes read from source files
+        uint64_t mOutputBytes; // Texels or blocks ready for upload
+        
+        // Time spent decoding summed over all threads, and wall time spent inside decodeBatch(); the ratio of the two
+        // is how many cores a batch kept busy on average
+        uint64_t mDecodeMicroseconds;
+        uint64_t mBatchMicroseconds;
+        
+        // Whether pixel buffers came from the pool with enough room already
+        uint32_t mNumPoolHits;
+        uint32_t mNumPoolMisses;
+    };
+    
 private:
+    /* Mip chains and compressed blocks are cached under user/ so that later launches can skip decoding, filtering
+     * and compression. The cache is tied to the source file's size and modification time, and to the requested
+     * compression, filter and color space.
+     */
+    std::string getCacheFilename() const;
+    bool loadCache(std::vector<uint8_t>& data, bool& compressed, BlockCompression::Format& format);
+    void saveCache(const std::vector<uint8_t>& data, bool compressed, BlockCompression::Format format);
+    
+    // Where the chain starts in the cache file, if there is one
+    bool mHasCache;
+    uint64_t mCacheDataOffset;
     
+    // Returns false if the texels should be uploaded uncompressed
+    bool chooseBlockFormat(const uint8_t* texels, BlockCompression::Format& format) const;
+    
+
     #ifdef PGG_VULKAN
+    /* Everything load() needs before it touches the device. Filled in by decode(), which only writes to this image's
+     * own members and so can run on a worker thread, and kept until load() has staged the data for upload.
+     */
+    struct Decoded {
+        bool mValid = false;
+        
+        // Every mip level, tightly packed as either texels or blocks; a pooled buffer
+        std::vector<uint8_t> mLevelData;
+        bool mCompressed = false;
+        BlockCompression::Format mBlockFormat = BlockCompression::BC1;
+    };
+    Decoded mDecoded;
+    
+    bool decode(Decoded& decoded);
+    void releaseDecoded(Decoded& decoded);
+    
     VkImage mImgHandle = VK_NULL_HANDLE;
-    VkDeviceMemory mImgMemory = VK_NULL_HANDLE;
+    DeviceMemoryAllocatorVk::Allocation mImgAllocation;
     VkImageView mImgView = VK_NULL_HANDLE;
     VkFormat mImgFormat;
     VkImageLayout mImgLayout;
+    
+    // Streamed images only have the levels from mBaseLevel down in device memory; the image and view cover just those
+    bool mStreamed = false;
+    uint32_t mBaseLevel = 0;
+    uint32_t mMinBaseLevel = 0;
+    
+    /// Creates an image with the levels from baseLevel down, and records uploading them from tightly packed data
+    bool createDeviceImage(uint32_t baseLevel, const uint8_t* data, 
+        VkImage* image, DeviceMemoryAllocatorVk::Allocation* allocation, VkImageView* view) const;
     #endif // PGG_VULKAN
     
+    bool mBlockCompressed;
+    BlockCompression::Format mBlockFormat;
+    
+    // Offset of each level within the chain, plus the size of the whole chain at the end
+    std::vector<uint64_t> mLevelOffsets;
+    
     
     uint32_t mWidth;
     uint32_t mHeight;
     uint32_t mComponents;
+    uint32_t mMipLevels;
     bool mLoaded;
+    Compression mCompression;
+    MipFilter mMipFilter;
+    ColorSpace mColorSpace;
+    bool mStreamable;
 public:
     ImageResource();
     ~ImageResource();
     
     static Image* gallop(Resource* resource);
     
+    // Empty or unrecognized values mean the defaults described above
+    void setCompression(const std::string& compression);
+    Compression getCompression() const;
+    void setMipFilter(const std::string& mipFilter);
+    MipFilter getMipFilter() const;
+    void setColorSpace(const std::string& colorSpace);
+    ColorSpace getColorSpace() const;
+    
+    /**
+     * Set by the "streamed" field (true when left out). Streamed images are handed to TextureStreamerVk, which keeps
+     * only the mip levels they are drawn at in device memory. Only images with a cached chain larger than the
+     * smallest streamed size are actually streamed.
+     */
+    void setStreamable(bool streamable);
+    
     void load();
     void unload();
     
+    #ifdef PGG_VULKAN
+    /**
+     * @brief Decodes images which are about to be loaded, in parallel on the job pool
+     * Images that are already loaded or decoded are skipped. Each result is kept until that image is loaded (i.e.
+     * first grabbed), which then only has to create the device image and stage its levels for upload. Must be
+     * called from the thread which loads resources, and nothing may load the given images until this returns.
+     */
+    static void decodeBatch(const std::vector<ImageResource*>& images);
+    
+    /// Frees pixel buffers kept for reuse by later decodes, e.g. once a level has finished loading
+    static void freeDecodeBuffers();
+    
+    static DecodeStats getDecodeStats();
+    static void resetDecodeStats();
+    #endif // PGG_VULKAN
+    
     uint32_t getWidth() const;
     uint32_t getHeight() const;
     uint32_t getNumComponents() const;
+    uint32_t getNumMipLevels() const;
+    
+    /**
+     * @brief Reads levels from baseLevel down, tightly packed, from the cache file
+     * Blocks on file I/O, but touches nothing that changes while the image is loaded, so it can run on a job.
+     */
+    bool readCachedLevels(uint32_t baseLevel, std::vector<uint8_t>& data) const;
     
     #ifdef PGG_VULKAN
     VkImage getHandle() const;
     VkDeviceMemory getMemory() const;
+    VkDeviceSize getMemoryOffset() const;
     VkImageView getView() const;
     VkFormat getFormat() const;
     VkImageLayout getLayout() const;
+    
+    bool isStreamed() const;
+    uint32_t getResidentBaseLevel() const;
+    
+    /// Levels from here down are always resident
+    uint32_t getMinResidentBaseLevel() const;
+    
+    /// Size of the level data from baseLevel down
+    VkDeviceSize calcResidentBytes(uint32_t baseLevel) const;
+    
+    /**
+     * @brief Replaces the device image with one holding the levels from baseLevel down, given by readCachedLevels()
+     * Only for use by TextureStreamerVk. The previous image, view and memory are handed back, to be destroyed once
+     * the device no longer uses them. Returns false, keeping the previous image, if the new one could not be made.
+     */
+    bool changeResidency(uint32_t baseLevel, const std::vector<uint8_t>& data, 
+        VkImage* oldImage, VkImageView* oldView, DeviceMemoryAllocatorVk::Allocation* oldAllocation);
     #endif // PGG_VULKAN
 };
 
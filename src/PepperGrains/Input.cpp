@@ -422,7 +422,11 @@ Scancode scancodeFromGLFWMouse(int button) {
 
 }
 
-InputState::InputState() {
+InputState::InputState()
+: mMouseX(0)
+, mMouseY(0)
+, mMouseDX(0)
+, mMouseDY(0) {
     for(uint32_t i = 0; i < Input::Scancode::ENUM_SIZE; ++ i) {
         mPressed[i] = false;
     }
@@ -454,6 +458,10 @@ void InputState::setMouseDelta(int32_t dx, int32_t dy) {
     mMouseDX = dx;
     mMouseDY = dy;
 }
+void InputState::addMouseDelta(int32_t dx, int32_t dy) {
+    mMouseDX += dx;
+    mMouseDY += dy;
+}
 
 #ifdef PGG_SDL
 void InputState::updateKeysFromSDL() {
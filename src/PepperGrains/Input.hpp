@@ -320,6 +320,9 @@ public:
     
     void setState(Input::Scancode button, bool pressed);
     void setMouseDelta(int32_t dx, int32_t dy);
+    
+    // Motion is added up until whoever consumes it resets the delta
+    void addMouseDelta(int32_t dx, int32_t dy);
 };
 
 }
@@ -0,0 +1,84 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef PGG_OPENGL
+
+#include "InstanceBuffer.hpp"
+
+#include <cassert>
+#include <cstring>
+
+namespace pgg {
+
+InstanceBuffer::InstanceBuffer(uint32_t capacity)
+: mHandle(0)
+, mCapacity(capacity)
+, mCursor(capacity)
+, mNumOrphans(0) {
+}
+
+InstanceBuffer::~InstanceBuffer() {
+    if(mHandle) {
+        glDeleteBuffers(1, &mHandle);
+    }
+}
+
+uint32_t InstanceBuffer::write(const glm::mat4* const* matrices, uint32_t count) {
+    assert(count <= mCapacity && "Too many instances to write at once");
+
+    if(!mHandle) {
+        glGenBuffers(1, &mHandle);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, mHandle);
+
+    // Out of room (or never allocated), so replace the storage; draws already issued keep the old one
+    if(mCursor + count > mCapacity) {
+        glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        mCursor = 0;
+        ++ mNumOrphans;
+    }
+
+    uint32_t first = mCursor;
+    GLvoid* mapped = glMapBufferRange(GL_ARRAY_BUFFER, first * sizeof(glm::mat4), count * sizeof(glm::mat4),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glm::mat4* dest = static_cast<glm::mat4*>(mapped);
+    for(uint32_t i = 0; i < count; ++ i) {
+        std::memcpy(dest + i, glm::value_ptr(*matrices[i]), sizeof(glm::mat4));
+    }
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    mCursor += count;
+    return first;
+}
+
+void InstanceBuffer::bindModelMatrixAttrib(GLuint attrib, uint32_t first) {
+    glBindBuffer(GL_ARRAY_BUFFER, mHandle);
+    for(GLuint column = 0; column < 4; ++ column) {
+        glEnableVertexAttribArray(attrib + column);
+        glVertexAttribPointer(attrib + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+            (void*) (first * sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(attrib + column, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+uint32_t InstanceBuffer::getCapacity() const { return mCapacity; }
+uint32_t InstanceBuffer::getNumOrphans() const { return mNumOrphans; }
+
+}
+
+#endif // PGG_OPENGL
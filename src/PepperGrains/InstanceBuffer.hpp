@@ -0,0 +1,71 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_INSTANCEBUFFER_HPP
+#define PGG_INSTANCEBUFFER_HPP
+
+#ifdef PGG_OPENGL
+
+#include <stdint.h>
+
+#include <GraphicsApiLibrary.hpp>
+
+namespace pgg {
+
+/* Streaming vertex buffer of per-instance model matrices.
+ *
+ * Matrices are appended to the end of the buffer with unsynchronized mapping, so writing never waits
+ * on draws which are still reading earlier instances. When the buffer is full, its storage is orphaned
+ * and writing starts again from the beginning of a fresh allocation.
+ *
+ * The buffer itself is created on the first write, so that this can be constructed without a context.
+ */
+class InstanceBuffer {
+public:
+    static const uint32_t sDefaultCapacity = 16384;
+
+    InstanceBuffer(uint32_t capacity = sDefaultCapacity);
+    ~InstanceBuffer();
+
+private:
+    GLuint mHandle;
+
+    // In number of matrices
+    uint32_t mCapacity;
+    uint32_t mCursor;
+
+    uint32_t mNumOrphans;
+
+public:
+    // Returns the index of the first instance written, to be passed to bindModelMatrixAttrib()
+    // Count must not be more than getCapacity()
+    uint32_t write(const glm::mat4* const* matrices, uint32_t count);
+
+    // Point the four vec4 columns of a mat4 attribute (at locations attrib to attrib + 3) at the instances
+    // starting from first; the vertex array object to modify must already be bound
+    void bindModelMatrixAttrib(GLuint attrib, uint32_t first);
+
+    uint32_t getCapacity() const;
+
+    // Number of times new storage has been allocated, including the first
+    uint32_t getNumOrphans() const;
+};
+
+}
+
+#endif // PGG_OPENGL
+
+#endif // PGG_INSTANCEBUFFER_HPP
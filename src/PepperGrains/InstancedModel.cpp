@@ -16,8 +16,10 @@
 
 #include "InstancedModel.hpp"
 
+#include <cassert>
 #include <iostream>
 
+#include "GLStateCache.hpp"
 #include "ResourceManager.hpp"
 
 namespace pgg {
@@ -113,23 +115,24 @@ void InstancedModel::unload() {
 
     delete this;
 }
-void InstancedModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void InstancedModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
     
     if(rendPass.mType != Renderable::Pass::Type::GEOMETRY && rendPass.mType != Renderable::Pass::Type::SHADOW) {
         return;
     }
     
-    glUseProgram(mShaderProg->getHandle());
+    assert(rendPass.mGLState && "Instanced model requires a GL state cache");
+    GLStateCache& glState = *rendPass.mGLState;
+    
+    glState.useProgram(mShaderProg->getHandle());
 
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
 
-    glBindVertexArray(mVertexArrayObject);
+    glState.bindVertexArray(mVertexArrayObject);
 
     mGeometry->drawElementsInstanced(160000);
-
-    glBindVertexArray(0);
-
-    glUseProgram(0);
 }
 
+bool InstancedModel::usesGLStateCache() const { return true; }
+
 }
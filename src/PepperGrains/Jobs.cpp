@@ -0,0 +1,474 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "Jobs.hpp"
+
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include "Logger.hpp"
+
+namespace pgg {
+namespace Jobs {
+
+    struct Job {
+        Func mFunc;
+        Counter* mCounter;
+    };
+
+    /* Chase-Lev work-stealing deque with a fixed capacity.
+     * Only the owning worker may push() and pop(); any thread may steal().
+     * Based on "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., 2013).
+     */
+    class WorkStealingDeque {
+    public:
+        static const int64_t sCapacity = 4096; // Must be a power of two
+    private:
+        std::atomic<int64_t> mTop;
+        std::atomic<int64_t> mBottom;
+        std::atomic<Job*> mBuffer[sCapacity];
+    public:
+        WorkStealingDeque()
+        : mTop(0)
+        , mBottom(0) {
+            for(int64_t i = 0; i < sCapacity; ++ i) {
+                mBuffer[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        // Returns false if full
+        bool push(Job* job) {
+            int64_t bottom = mBottom.load(std::memory_order_relaxed);
+            int64_t top = mTop.load(std::memory_order_acquire);
+            if(bottom - top >= sCapacity) {
+                return false;
+            }
+            mBuffer[bottom & (sCapacity - 1)].store(job, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        Job* pop() {
+            int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+            mBottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = mTop.load(std::memory_order_relaxed);
+
+            // Empty
+            if(top > bottom) {
+                mBottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* job = mBuffer[bottom & (sCapacity - 1)].load(std::memory_order_relaxed);
+
+            // Last item; race against thieves for it
+            if(top == bottom) {
+                if(!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    job = nullptr;
+                }
+                mBottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        Job* steal() {
+            int64_t top = mTop.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = mBottom.load(std::memory_order_acquire);
+            if(top >= bottom) {
+                return nullptr;
+            }
+            Job* job = mBuffer[top & (sCapacity - 1)].load(std::memory_order_relaxed);
+            if(!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                // Lost the race to another thief or the owner
+                return nullptr;
+            }
+            return job;
+        }
+    };
+
+    std::vector<std::thread> mWorkers;
+    std::vector<WorkStealingDeque*> mDeques;
+    std::atomic<bool> mRunning(false);
+    std::thread::id mMainThreadId;
+
+    // Jobs submitted from threads that do not own a deque
+    std::mutex mSharedQueueMutex;
+    std::deque<Job*> mSharedQueue;
+
+    std::mutex mMainThreadQueueMutex;
+    std::vector<Job*> mMainThreadQueue;
+
+    // Used only to put idle workers to sleep
+    std::mutex mIdleMutex;
+    std::condition_variable mIdleCondition;
+    
+    // Bumped on every submission. A worker reads it before searching for work and only sleeps while it is
+    // unchanged, so a job pushed during the search is never slept through.
+    std::atomic<uint64_t> mWorkEpoch(0);
+    
+    // Submitters only touch mIdleMutex when somebody may be asleep
+    std::atomic<uint32_t> mSleepingWorkers(0);
+
+    std::atomic<uint64_t> mJobsRun(0);
+    std::atomic<uint64_t> mJobsStolen(0);
+    std::atomic<uint64_t> mJobsRunOnMainThread(0);
+
+    // Index into mDeques for worker threads, -1 for all other threads
+    thread_local int32_t tWorkerIndex = -1;
+
+    // Per-thread state for choosing steal victims
+    thread_local uint32_t tStealSeed = 0;
+
+    struct Scheduler {
+        static Job* newJob(Func func, Counter* counter) {
+            Job* job = new Job();
+            job->mFunc = func;
+            job->mCounter = counter;
+            if(counter) {
+                counter->increment();
+            }
+            return job;
+        }
+
+        static void submit(Job* job) {
+            if(tWorkerIndex >= 0 && mDeques[tWorkerIndex]->push(job)) {
+                // Pushed onto own deque
+            } else {
+                std::lock_guard<std::mutex> lock(mSharedQueueMutex);
+                mSharedQueue.push_back(job);
+            }
+            wakeWorker();
+        }
+        
+        static void wakeWorker() {
+            mWorkEpoch.fetch_add(1, std::memory_order_seq_cst);
+            if(mSleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+                // Taking the lock orders this with a worker that is between checking the epoch and waiting
+                { std::lock_guard<std::mutex> lock(mIdleMutex); }
+                mIdleCondition.notify_one();
+            }
+        }
+
+        static void submitOrDefer(Job* job, Counter* dependency) {
+            if(dependency && dependency->tryAddDependent(job)) {
+                return;
+            }
+            submit(job);
+        }
+
+        static void execute(Job* job) {
+            job->mFunc();
+            if(job->mCounter) {
+                job->mCounter->decrement();
+            }
+            delete job;
+            ++ mJobsRun;
+        }
+
+        static Job* popShared() {
+            std::lock_guard<std::mutex> lock(mSharedQueueMutex);
+            if(mSharedQueue.empty()) {
+                return nullptr;
+            }
+            Job* job = mSharedQueue.front();
+            mSharedQueue.pop_front();
+            return job;
+        }
+
+        static Job* stealAny() {
+            uint32_t numDeques = mDeques.size();
+            if(numDeques == 0) {
+                return nullptr;
+            }
+
+            // Xorshift to spread thieves across victims
+            if(tStealSeed == 0) {
+                tStealSeed = (uint32_t) std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+            }
+            tStealSeed ^= tStealSeed << 13;
+            tStealSeed ^= tStealSeed >> 17;
+            tStealSeed ^= tStealSeed << 5;
+
+            uint32_t start = tStealSeed % numDeques;
+            for(uint32_t i = 0; i < numDeques; ++ i) {
+                uint32_t victim = (start + i) % numDeques;
+                if((int32_t) victim == tWorkerIndex) continue;
+                Job* job = mDeques[victim]->steal();
+                if(job) {
+                    ++ mJobsStolen;
+                    return job;
+                }
+            }
+            return nullptr;
+        }
+
+        // Own deque first (most recent, cache-warm), then shared queue, then other workers
+        static Job* findJob() {
+            Job* job = nullptr;
+            if(tWorkerIndex >= 0) {
+                job = mDeques[tWorkerIndex]->pop();
+            }
+            if(!job) job = popShared();
+            if(!job) job = stealAny();
+            return job;
+        }
+
+        static bool runMainThreadJobs() {
+            std::vector<Job*> jobs;
+            {
+                std::lock_guard<std::mutex> lock(mMainThreadQueueMutex);
+                jobs.swap(mMainThreadQueue);
+            }
+            for(Job* job : jobs) {
+                execute(job);
+                ++ mJobsRunOnMainThread;
+            }
+            return !jobs.empty();
+        }
+
+        static void workerLoop(int32_t index) {
+            tWorkerIndex = index;
+            uint32_t failedAttempts = 0;
+            while(mRunning) {
+                uint64_t seenEpoch = mWorkEpoch.load(std::memory_order_seq_cst);
+                Job* job = findJob();
+                if(job) {
+                    execute(job);
+                    failedAttempts = 0;
+                    continue;
+                }
+
+                // Spin briefly before sleeping, since new work usually arrives in bursts
+                ++ failedAttempts;
+                if(failedAttempts < 64) {
+                    std::this_thread::yield();
+                } else {
+                    // Sleep until something is submitted after the search began, or the pool stops
+                    mSleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+                    {
+                        std::unique_lock<std::mutex> lock(mIdleMutex);
+                        mIdleCondition.wait(lock, [seenEpoch]() {
+                            return !mRunning || mWorkEpoch.load(std::memory_order_seq_cst) != seenEpoch;
+                        });
+                    }
+                    mSleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+                    failedAttempts = 0;
+                }
+            }
+        }
+    };
+
+    Counter::Counter()
+    : mPending(0)
+    , mDecrementing(0) { }
+
+    Counter::~Counter() {
+        assert(isDone() && "Counter destroyed while jobs are still pending");
+    }
+
+    bool Counter::isDone() const {
+        return mPending.load(std::memory_order_seq_cst) == 0 && mDecrementing.load(std::memory_order_seq_cst) == 0;
+    }
+
+    uint32_t Counter::getPending() const {
+        return mPending.load(std::memory_order_acquire);
+    }
+
+    void Counter::increment(uint32_t amount) {
+        mPending.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    void Counter::decrement() {
+        mDecrementing.fetch_add(1, std::memory_order_seq_cst);
+        std::vector<Job*> released;
+        if(mPending.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+            // Reached zero, release everything waiting on this counter
+            std::lock_guard<std::mutex> lock(mMutex);
+            released.swap(mDependents);
+        }
+
+        // Last access to this counter; it may be destroyed immediately after
+        mDecrementing.fetch_sub(1, std::memory_order_seq_cst);
+
+        for(Job* job : released) {
+            Scheduler::submit(job);
+        }
+    }
+
+    bool Counter::tryAddDependent(Job* job) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(mPending.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+        mDependents.push_back(job);
+        return true;
+    }
+
+    bool initialize(uint32_t numWorkers) {
+        assert(!mRunning && "Job system already initialized");
+
+        if(numWorkers == 0) {
+            uint32_t hardwareThreads = std::thread::hardware_concurrency();
+            numWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        mMainThreadId = std::this_thread::get_id();
+        mRunning = true;
+        for(uint32_t i = 0; i < numWorkers; ++ i) {
+            mDeques.push_back(new WorkStealingDeque());
+        }
+        for(uint32_t i = 0; i < numWorkers; ++ i) {
+            mWorkers.push_back(std::thread(Scheduler::workerLoop, (int32_t) i));
+        }
+
+        Logger::log(Logger::INFO) << "Started " << numWorkers << " job worker threads" << std::endl;
+        return true;
+    }
+
+    bool cleanup() {
+        // Drain everything that was already queued
+        while(true) {
+            bool didWork = Scheduler::runMainThreadJobs();
+            Job* job = Scheduler::findJob();
+            if(job) {
+                Scheduler::execute(job);
+                didWork = true;
+            }
+            if(!didWork) {
+                bool empty;
+                {
+                    std::lock_guard<std::mutex> lock(mSharedQueueMutex);
+                    empty = mSharedQueue.empty();
+                }
+                if(empty) break;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mIdleMutex);
+            mRunning = false;
+        }
+        mIdleCondition.notify_all();
+        for(std::thread& worker : mWorkers) {
+            worker.join();
+        }
+        mWorkers.clear();
+        for(WorkStealingDeque* deque : mDeques) {
+            delete deque;
+        }
+        mDeques.clear();
+        return true;
+    }
+
+    uint32_t getNumWorkers() {
+        return mWorkers.size();
+    }
+
+    void run(Func func, Counter* counter, Counter* dependency) {
+        Job* job = Scheduler::newJob(func, counter);
+
+        // Without any workers, just run inline
+        if(mDeques.empty() && !dependency) {
+            Scheduler::execute(job);
+            return;
+        }
+        Scheduler::submitOrDefer(job, dependency);
+    }
+
+    void runOnMainThread(Func func, Counter* counter) {
+        Job* job = Scheduler::newJob(func, counter);
+
+        if(std::this_thread::get_id() == mMainThreadId) {
+            Scheduler::execute(job);
+            ++ mJobsRunOnMainThread;
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mMainThreadQueueMutex);
+        mMainThreadQueue.push_back(job);
+    }
+
+    void processMainThreadJobs() {
+        assert(std::this_thread::get_id() == mMainThreadId && "Main thread jobs processed on another thread");
+        Scheduler::runMainThreadJobs();
+    }
+
+    void wait(Counter* counter) {
+        bool isMainThread = std::this_thread::get_id() == mMainThreadId;
+        while(!counter->isDone()) {
+            // The counter may depend on jobs that only this thread can run
+            if(isMainThread && Scheduler::runMainThreadJobs()) {
+                continue;
+            }
+
+            Job* job = Scheduler::findJob();
+            if(job) {
+                Scheduler::execute(job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void parallelFor(std::size_t begin, std::size_t end, RangeFunc func, std::size_t grainSize) {
+        if(end <= begin) {
+            return;
+        }
+        std::size_t count = end - begin;
+
+        if(grainSize == 0) {
+            std::size_t numChunks = (mWorkers.size() + 1) * 4;
+            grainSize = (count + numChunks - 1) / numChunks;
+            if(grainSize == 0) grainSize = 1;
+        }
+
+        // Small enough to not be worth splitting
+        if(count <= grainSize || mWorkers.empty()) {
+            func(begin, end);
+            return;
+        }
+
+        // The calling thread takes the first chunk itself
+        Counter counter;
+        for(std::size_t chunkBegin = begin + grainSize; chunkBegin < end; chunkBegin += grainSize) {
+            std::size_t chunkEnd = chunkBegin + grainSize < end ? chunkBegin + grainSize : end;
+            run([&func, chunkBegin, chunkEnd]() { func(chunkBegin, chunkEnd); }, &counter);
+        }
+        func(begin, begin + grainSize);
+        wait(&counter);
+    }
+
+    Stats getStats() {
+        Stats stats;
+        stats.mJobsRun = mJobsRun;
+        stats.mJobsStolen = mJobsStolen;
+        stats.mJobsRunOnMainThread = mJobsRunOnMainThread;
+        return stats;
+    }
+
+    void resetStats() {
+        mJobsRun = 0;
+        mJobsStolen = 0;
+        mJobsRunOnMainThread = 0;
+    }
+
+} // Jobs
+} // pgg
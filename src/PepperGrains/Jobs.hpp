@@ -0,0 +1,120 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_ENGINEJOBS_HPP
+#define PGG_ENGINEJOBS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+/* Shared pool of worker threads, one per spare core.
+ *
+ * Each worker owns a work-stealing deque (Chase-Lev): it pushes and pops its own jobs from the bottom,
+ * while idle workers steal from the top of others. Threads that are not workers (main, simulation)
+ * submit into a shared queue instead.
+ *
+ * Completion is tracked with Counters. A Counter is incremented for every job submitted against it and
+ * decremented as each one finishes. Jobs may also depend on a Counter, in which case they are only queued
+ * once that Counter reaches zero.
+ *
+ * Waiting on a Counter never idles the calling thread: it runs other jobs until the Counter reaches zero.
+ * Jobs should therefore not hold locks while waiting.
+ */
+
+namespace pgg {
+namespace Jobs {
+
+    typedef std::function<void()> Func;
+
+    // Inclusive begin, exclusive end
+    typedef std::function<void(std::size_t, std::size_t)> RangeFunc;
+
+    struct Job;
+    struct Scheduler;
+
+    class Counter {
+    public:
+        Counter();
+        ~Counter();
+
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+        bool isDone() const;
+        uint32_t getPending() const;
+    private:
+        std::atomic<uint32_t> mPending;
+
+        // Number of threads inside decrement(); the counter is only done once this is also zero, so that
+        // the owner cannot destroy it while a finishing job is still releasing dependents
+        std::atomic<uint32_t> mDecrementing;
+
+        // Jobs that depend on this counter; guarded by mMutex
+        std::mutex mMutex;
+        std::vector<Job*> mDependents;
+
+        void increment(uint32_t amount = 1);
+        void decrement();
+
+        // Returns false if the job should be queued immediately instead
+        bool tryAddDependent(Job* job);
+
+        friend struct Scheduler;
+    };
+
+    struct Stats {
+        uint64_t mJobsRun;
+        uint64_t mJobsStolen;
+        uint64_t mJobsRunOnMainThread;
+    };
+
+    // Start the worker pool; numWorkers of 0 means one less than the number of hardware threads
+    // Must be called on the thread which will call processMainThreadJobs()
+    bool initialize(uint32_t numWorkers = 0);
+
+    // Finishes all queued jobs, then stops the workers
+    bool cleanup();
+
+    uint32_t getNumWorkers();
+
+    // Queue a job. If counter is given, it will be incremented now and decremented once the job finishes.
+    // If dependency is given, the job will not start until that counter reaches zero.
+    void run(Func func, Counter* counter = nullptr, Counter* dependency = nullptr);
+
+    // Queue a job which must run on the main thread (e.g. anything touching the graphics context)
+    void runOnMainThread(Func func, Counter* counter = nullptr);
+
+    // Called by the main thread once per frame
+    void processMainThreadJobs();
+
+    // Runs other jobs until the counter reaches zero
+    void wait(Counter* counter);
+
+    // Split [begin, end) into chunks of at most grainSize and run them across all workers, returning once
+    // all chunks have completed. grainSize of 0 picks a size giving each worker a few chunks.
+    void parallelFor(std::size_t begin, std::size_t end, RangeFunc func, std::size_t grainSize = 0);
+
+    Stats getStats();
+    void resetStats();
+
+} // Jobs
+} // pgg
+
+#endif // PGG_ENGINEJOBS_HPP
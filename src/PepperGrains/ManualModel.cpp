@@ -73,7 +73,7 @@ void ManualModel::unload() {
 
     delete this;
 }
-void ManualModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void ManualModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
 
     if(rendPass.mType != Renderable::Pass::Type::GEOMETRY && rendPass.mType != Renderable::Pass::Type::SHADOW) {
         return;
@@ -81,7 +81,7 @@ void ManualModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
     
     glUseProgram(mShaderProg->getHandle());
 
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
 
     glBindVertexArray(mVertexArrayObject);
 
@@ -92,4 +92,29 @@ void ManualModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
     glUseProgram(0);
 }
 
+bool ManualModel::canDrawInstanced(const Renderable::Pass& rendPass) const {
+    // Shader programs taking the model matrix as an instanced attribute can only be drawn this way
+    return mShaderProg->needsInstancedModelMatrix();
+}
+void ManualModel::drawInstanced(const Renderable::Pass& rendPass, InstanceBuffer& instances, uint32_t first, uint32_t count) {
+
+    if(rendPass.mType != Renderable::Pass::Type::GEOMETRY && rendPass.mType != Renderable::Pass::Type::SHADOW) {
+        return;
+    }
+    
+    glUseProgram(mShaderProg->getHandle());
+
+    mShaderProg->bindModelViewProjMatrices(glm::mat4(), rendPass.getConstants());
+
+    glBindVertexArray(mVertexArrayObject);
+
+    instances.bindModelMatrixAttrib(mShaderProg->getInstancedModelMatrixAttrib(), first);
+
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, count);
+
+    glBindVertexArray(0);
+
+    glUseProgram(0);
+}
+
 }
@@ -36,7 +36,10 @@ public:
     void load();
     void unload();
 
-    void render(Renderable::Pass rendPass, const glm::mat4& modelMat);
+    void render(const Renderable::Pass& rendPass, const glm::mat4& modelMat);
+
+    bool canDrawInstanced(const Renderable::Pass& rendPass) const;
+    void drawInstanced(const Renderable::Pass& rendPass, InstanceBuffer& instances, uint32_t first, uint32_t count);
 
 };
 
@@ -109,6 +109,7 @@ Material::Input& Material::Input::operator=(const Material::Input& other) {
 
 Material::Input::Type Material::Input::getType() const { return mType; }
 bool Material::Input::isSpecified() const { return mType != Type::EMPTY; }
+Texture* Material::Input::getTexture() const { return mType == Type::TEXTURE ? mValue.mTexture : nullptr; }
 
 // Deconstructor
 Material::Input::~Input() {
@@ -152,5 +153,14 @@ const Material::Technique& Material::getTechnique() const {
     return mTechnique;
 }
 
+#ifdef PGG_OPENGL
+bool Material::isVisible(const Renderable::Pass& rendPass) const {
+    return this->getProgram(rendPass) != nullptr;
+}
+ShaderProgramResource* Material::getProgram(const Renderable::Pass& rendPass) const { return nullptr; }
+ShaderProgramResource* Material::getInstancedProgram(const Renderable::Pass& rendPass) const { return nullptr; }
+void Material::enableVertexAttributesFor(Geometry* geometry) const { }
+#endif
+
 }
 
@@ -18,11 +18,15 @@
 #define PGG_MATERIAL_HPP
 
 #include "ReferenceCounted.hpp"
+#include "Renderable.hpp"
 #include "Texture.hpp"
 #include "Vec3.hpp"
 
 namespace pgg {
 
+class Geometry;
+class ShaderProgramResource;
+
 /* Represents a list of textures, constant values, and other shader hints to be used in conjunction with a particular
  * Geometry when rendering a Model.
  * 
@@ -64,6 +68,9 @@ public:
         Type getType() const;
         bool isSpecified() const;
         void clear();
+        
+        // Nullptr unless this is a texture input
+        Texture* getTexture() const;
     };
     
     /* Different techniques allow for automatic fallback behavior.
@@ -107,6 +114,21 @@ public:
     virtual void unload();
     
     virtual const Technique& getTechnique() const;
+    
+    #ifdef PGG_OPENGL
+    // True if models using this material are drawn in the pass at all; by default, if there is a program for it
+    virtual bool isVisible(const Renderable::Pass& rendPass) const;
+    
+    /* The program to draw with in the given pass, or nullptr if none. The instanced variant reads its
+     * model matrix from an instanced mat4 named "model", and may be nullptr even if the other is not.
+     * Plain materials have neither.
+     */
+    virtual ShaderProgramResource* getProgram(const Renderable::Pass& rendPass) const;
+    virtual ShaderProgramResource* getInstancedProgram(const Renderable::Pass& rendPass) const;
+    
+    // Enable the vertex attributes the programs read in the currently bound vertex array object
+    virtual void enableVertexAttributesFor(Geometry* geometry) const;
+    #endif
 };
 
 }
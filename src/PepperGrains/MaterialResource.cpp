@@ -19,9 +19,12 @@
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #include <json/json.h>
 
+#include "Geometry.hpp"
+#include "ImageResource.hpp"
 #include "ShaderProgramResource.hpp"
 #include "Logger.hpp"
 #include "Resources.hpp"
@@ -29,8 +32,33 @@
 
 namespace pgg {
 
+namespace {
+    
+    #ifdef PGG_VULKAN
+    // Adds the image behind a texture input, if grabbing that texture would load it
+    void addInputImage(const Json::Value& inputData, std::vector<ImageResource*>& images) {
+        if(!inputData.isObject() || inputData["type"].asString() != "texture") {
+            return;
+        }
+        Resource* resource = Resources::find(inputData["value"].asString());
+        if(!resource || resource->mResourceType != Resource::Type::TEXTURE) {
+            return;
+        }
+        ImageResource* image = static_cast<TextureResource*>(resource)->findImageToLoad();
+        if(image) {
+            images.push_back(image);
+        }
+    }
+    #endif // PGG_VULKAN
+    
+} // namespace
+
 MaterialResource::MaterialResource()
 : mLoaded(false)
+#ifdef PGG_OPENGL
+, mGeometryProg(nullptr)
+, mGeometryInstancedProg(nullptr)
+#endif
 , Resource(Resource::Type::MATERIAL) {
 }
 
@@ -69,6 +97,10 @@ void MaterialResource::load() {
         mTechnique.mType = Material::Technique::Type::HIGH_LEVEL_VALUES;
         mTechnique.mDiffuse = Material::Input(Texture::getFallback());
         
+        #ifdef PGG_OPENGL
+        this->grabPrograms();
+        #endif
+        
         mLoaded = true;
         return;
     }
@@ -100,6 +132,17 @@ void MaterialResource::load() {
             else if(typeData.asString() == "high-level-values") {
                 mTechnique.mType = Material::Technique::Type::HIGH_LEVEL_VALUES;
                 
+                #ifdef PGG_VULKAN
+                // Decode all of the images together, rather than one after another as each texture is grabbed
+                {
+                    std::vector<ImageResource*> images;
+                    addInputImage(techniqueData["diffuse"], images);
+                    addInputImage(techniqueData["specular"], images);
+                    addInputImage(techniqueData["normals"], images);
+                    ImageResource::decodeBatch(images);
+                }
+                #endif // PGG_VULKAN
+                
                 mTechnique.mDiffuse = jsonToMaterialInput(techniqueData["diffuse"]);
                 mTechnique.mSpecular = jsonToMaterialInput(techniqueData["specular"]);
                 mTechnique.mNormals = jsonToMaterialInput(techniqueData["normals"]);
@@ -110,15 +153,97 @@ void MaterialResource::load() {
         }
     
     }
+    
+    #ifdef PGG_OPENGL
+    this->grabPrograms();
+    #endif
+    
     mLoaded = true;
 }
 
 void MaterialResource::unload() {
     assert(mLoaded && "Attempted to unload material before loading it");
+    #ifdef PGG_OPENGL
+    this->dropPrograms();
+    #endif
     mTechnique.clear();
     mLoaded = false;
 }
 
+const Material::Technique& MaterialResource::getTechnique() const {
+    return mTechnique;
+}
+
+#ifdef PGG_OPENGL
+void MaterialResource::grabPrograms() {
+    if(mTechnique.mType != Material::Technique::Type::HIGH_LEVEL_VALUES) {
+        return;
+    }
+    
+    std::string progName = mTechnique.mNormals.isSpecified() ? "HLVSDiffuseTexNormalTex" : "HLVSDiffuseTex";
+    
+    mGeometryProg = ShaderProgramResource::gallop(Resources::find(progName + ".shaderProgram"));
+    if(mGeometryProg) {
+        mGeometryProg->grab();
+    }
+    
+    // Same shaders, with an "instancing" block declaring the model matrix; optional
+    Resource* instancedResource = Resources::find(progName + "Instanced.shaderProgram");
+    if(instancedResource) {
+        mGeometryInstancedProg = ShaderProgramResource::gallop(instancedResource);
+        if(mGeometryInstancedProg) {
+            mGeometryInstancedProg->grab();
+        }
+    }
+}
+void MaterialResource::dropPrograms() {
+    if(mGeometryProg) {
+        mGeometryProg->drop();
+        mGeometryProg = nullptr;
+    }
+    if(mGeometryInstancedProg) {
+        mGeometryInstancedProg->drop();
+        mGeometryInstancedProg = nullptr;
+    }
+}
+
+ShaderProgramResource* MaterialResource::getProgram(const Renderable::Pass& rendPass) const {
+    // The geometry programs write to every gbuffer target, so they cannot be used for the shadow pass
+    return rendPass.mType == Renderable::Pass::Type::GEOMETRY ? mGeometryProg : nullptr;
+}
+ShaderProgramResource* MaterialResource::getInstancedProgram(const Renderable::Pass& rendPass) const {
+    return rendPass.mType == Renderable::Pass::Type::GEOMETRY ? mGeometryInstancedProg : nullptr;
+}
+
+void MaterialResource::enableVertexAttributesFor(Geometry* geometry) const {
+    // Both programs are drawn from the same vertex array object
+    const ShaderProgramResource* programs[] = { mGeometryProg, mGeometryInstancedProg };
+    for(const ShaderProgramResource* program : programs) {
+        if(!program) {
+            continue;
+        }
+        if(program->needsPosAttrib()) {
+            geometry->enablePositionAttrib(program->getPosAttrib());
+        }
+        if(program->needsColorAttrib()) {
+            geometry->enableColorAttrib(program->getColorAttrib());
+        }
+        if(program->needsUVAttrib()) {
+            geometry->enableUVAttrib(program->getUVAttrib());
+        }
+        if(program->needsNormalAttrib()) {
+            geometry->enableNormalAttrib(program->getNormalAttrib());
+        }
+        if(program->needsTangentAttrib()) {
+            geometry->enableTangentAttrib(program->getTangentAttrib());
+        }
+        if(program->needsBitangentAttrib()) {
+            geometry->enableBitangentAttrib(program->getBitangentAttrib());
+        }
+    }
+}
+#endif // PGG_OPENGL
+
 /*
 void MaterialResource::grabNeededHLVShaders() {
     if(mTechnique.deferredGeometryProg) {
@@ -172,7 +297,7 @@ void MaterialResource::enableVertexAttributesFor(Geometry* geometry) const {
         geometry->enableBitangentAttrib(mTechnique.deferredGeometryProg->getBitangentAttrib());
     }
 }
-void MaterialResource::useProgram(Renderable::Pass rendPass, const glm::mat4& modelMatrix) const {
+void MaterialResource::useProgram(const Renderable::Pass& rendPass, const glm::mat4& modelMatrix) const {
     
     if(rendPass.mType == Renderable::Pass::Type::SHO_FORWARD) {
         
@@ -248,7 +373,7 @@ void MaterialResource::useProgram(Renderable::Pass rendPass, const glm::mat4& mo
         }
     }
 }
-bool MaterialResource::isVisible(Renderable::Pass rpc) const {
+bool MaterialResource::isVisible(const Renderable::Pass& rpc) const {
     if(rpc.mType == Renderable::Pass::Type::GEOMETRY) {
         return mTechnique.deferredGeometryProg != nullptr;
     }
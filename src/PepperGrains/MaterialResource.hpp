@@ -33,6 +33,15 @@ class MaterialResource : public Material, public Resource {
 private:
     Material::Technique mTechnique;
     bool mLoaded;
+    
+    #ifdef PGG_OPENGL
+    // Deferred geometry pass programs for the loaded technique; either may be nullptr
+    ShaderProgramResource* mGeometryProg;
+    ShaderProgramResource* mGeometryInstancedProg;
+    
+    void grabPrograms();
+    void dropPrograms();
+    #endif
 public:
     MaterialResource();
     virtual ~MaterialResource();
@@ -42,6 +51,14 @@ public:
 
     void load();
     void unload();
+    
+    const Material::Technique& getTechnique() const;
+    
+    #ifdef PGG_OPENGL
+    ShaderProgramResource* getProgram(const Renderable::Pass& rendPass) const;
+    ShaderProgramResource* getInstancedProgram(const Renderable::Pass& rendPass) const;
+    void enableVertexAttributesFor(Geometry* geometry) const;
+    #endif
 };
 
 }
@@ -16,6 +16,11 @@
 
 #include "MathUtil.hpp"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PGG_MATHUTIL_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace pgg
 {
 
@@ -189,6 +194,43 @@ float randFloat(float min, float max) {
     return min + (static_cast<float>(std::rand()) / (static_cast<float>(RAND_MAX) / (max - min)));
 }
 
+void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& result) {
+    #ifdef PGG_MATHUTIL_SSE
+    const float* aPtr = glm::value_ptr(a);
+    const float* bPtr = glm::value_ptr(b);
+    __m128 aCol0 = _mm_loadu_ps(aPtr);
+    __m128 aCol1 = _mm_loadu_ps(aPtr + 4);
+    __m128 aCol2 = _mm_loadu_ps(aPtr + 8);
+    __m128 aCol3 = _mm_loadu_ps(aPtr + 12);
+    
+    // Each column of the result is a combination of the columns of a, weighted by a column of b
+    __m128 resultCols[4];
+    for(uint32_t i = 0; i < 4; ++ i) {
+        const float* bCol = bPtr + i * 4;
+        resultCols[i] = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(aCol0, _mm_set1_ps(bCol[0])), _mm_mul_ps(aCol1, _mm_set1_ps(bCol[1]))),
+            _mm_add_ps(_mm_mul_ps(aCol2, _mm_set1_ps(bCol[2])), _mm_mul_ps(aCol3, _mm_set1_ps(bCol[3]))));
+    }
+    float* resultPtr = glm::value_ptr(result);
+    for(uint32_t i = 0; i < 4; ++ i) {
+        _mm_storeu_ps(resultPtr + i * 4, resultCols[i]);
+    }
+    #else
+    result = a * b;
+    #endif
+}
+
+glm::mat4 inverseAffine(const glm::mat4& matrix) {
+    if(matrix[0][3] != 0.f || matrix[1][3] != 0.f || matrix[2][3] != 0.f || matrix[3][3] != 1.f) {
+        return glm::inverse(matrix);
+    }
+    
+    glm::mat3 invLinear = glm::inverse(glm::mat3(matrix));
+    glm::mat4 inverse(invLinear);
+    inverse[3] = glm::vec4(-(invLinear * glm::vec3(matrix[3])), 1.f);
+    return inverse;
+}
+
 }
 
 }
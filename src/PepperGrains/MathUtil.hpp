@@ -54,6 +54,13 @@ float lerp(float min, float max, float value);
     
 float randFloat(float min, float max);
 
+// result = a * b, using SSE where available; result may alias a or b
+void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& result);
+
+// Inverse of a matrix made only of rotation, scale, shear and translation (bottom row 0, 0, 0, 1), which
+// is much cheaper than a general inverse; other matrices fall back to glm::inverse
+glm::mat4 inverseAffine(const glm::mat4& matrix);
+
 }
 }
 
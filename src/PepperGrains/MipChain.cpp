@@ -0,0 +1,302 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "MipChain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Jobs.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PGG_MIPCHAIN_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace pgg {
+namespace MipChain {
+
+namespace {
+    
+    const float sPi = 3.14159265358979323846f;
+    
+    // Half-width of the Kaiser window in destination texels, and its shape parameter
+    const float sKaiserRadius = 1.5f;
+    const float sKaiserAlpha = 4.f;
+    
+    // Texels are filtered as four floats each, regardless of how many components are used
+    const uint32_t sTexelFloats = 4;
+    
+    // Source texels contributing to one destination texel along one axis, with weights summing to 1
+    struct Kernel {
+        struct Tap {
+            uint32_t mIndex;
+            float mWeight;
+        };
+        std::vector<Tap> mTaps;
+        
+        // Taps for destination texel i are from mStarts[i] up to mStarts[i + 1]
+        std::vector<uint32_t> mStarts;
+    };
+    
+    // Modified Bessel function of the first kind, order zero
+    float besselI0(float x) {
+        float sum = 1.f;
+        float term = 1.f;
+        float halfX = x * 0.5f;
+        for(uint32_t k = 1; k < 32; ++ k) {
+            term *= (halfX / k) * (halfX / k);
+            sum += term;
+            if(term < sum * 1e-7f) {
+                break;
+            }
+        }
+        return sum;
+    }
+    
+    float sinc(float x) {
+        if(std::abs(x) < 1e-6f) {
+            return 1.f;
+        }
+        return std::sin(sPi * x) / (sPi * x);
+    }
+    
+    // x is the distance from the destination texel center in destination texels
+    float calcWeight(Filter filter, float x) {
+        float ax = std::abs(x);
+        switch(filter) {
+            case BOX: {
+                // Source texels straddling the edge are shared with the neighbor
+                return ax < 0.5f ? 1.f : (ax == 0.5f ? 0.5f : 0.f);
+            }
+            case KAISER: {
+                if(ax >= sKaiserRadius) {
+                    return 0.f;
+                }
+                float t = x / sKaiserRadius;
+                return sinc(x) * besselI0(sKaiserAlpha * std::sqrt(1.f - t * t)) / besselI0(sKaiserAlpha);
+            }
+            default: return 0.f;
+        }
+    }
+    
+    void buildKernel(Filter filter, uint32_t srcSize, uint32_t dstSize, Kernel& kernel) {
+        float scale = static_cast<float>(srcSize) / dstSize;
+        float radius = (filter == BOX ? 0.5f : sKaiserRadius) * scale;
+        
+        kernel.mTaps.clear();
+        kernel.mStarts.clear();
+        for(uint32_t dst = 0; dst < dstSize; ++ dst) {
+            kernel.mStarts.push_back(kernel.mTaps.size());
+            
+            float center = (dst + 0.5f) * scale;
+            int32_t first = static_cast<int32_t>(std::floor(center - radius));
+            int32_t last = static_cast<int32_t>(std::ceil(center + radius));
+            
+            float total = 0.f;
+            for(int32_t src = first; src <= last; ++ src) {
+                float weight = calcWeight(filter, (src + 0.5f - center) / scale);
+                if(weight == 0.f) {
+                    continue;
+                }
+                
+                // Edges are clamped
+                Kernel::Tap tap;
+                tap.mIndex = static_cast<uint32_t>(std::min(std::max(src, 0), static_cast<int32_t>(srcSize) - 1));
+                tap.mWeight = weight;
+                kernel.mTaps.push_back(tap);
+                total += weight;
+            }
+            
+            for(std::size_t i = kernel.mStarts.back(); i < kernel.mTaps.size(); ++ i) {
+                kernel.mTaps[i].mWeight /= total;
+            }
+        }
+        kernel.mStarts.push_back(kernel.mTaps.size());
+    }
+    
+    // dst += src * weight, for one texel
+    inline void accumulate(float* dst, const float* src, float weight) {
+        #ifdef PGG_MIPCHAIN_SSE
+        _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), _mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(weight))));
+        #else
+        for(uint32_t c = 0; c < sTexelFloats; ++ c) {
+            dst[c] += src[c] * weight;
+        }
+        #endif
+    }
+    
+    // Shrinks every row from srcWidth to the kernel's destination size
+    void filterRows(const float* src, uint32_t srcWidth, uint32_t height, const Kernel& kernel, float* dst) {
+        uint32_t dstWidth = kernel.mStarts.size() - 1;
+        Jobs::parallelFor(0, height, [=, &kernel](std::size_t begin, std::size_t end) {
+            for(std::size_t y = begin; y < end; ++ y) {
+                const float* srcRow = src + y * srcWidth * sTexelFloats;
+                float* dstTexel = dst + y * dstWidth * sTexelFloats;
+                for(uint32_t x = 0; x < dstWidth; ++ x) {
+                    std::memset(dstTexel, 0, sizeof(float) * sTexelFloats);
+                    for(uint32_t i = kernel.mStarts[x]; i < kernel.mStarts[x + 1]; ++ i) {
+                        const Kernel::Tap& tap = kernel.mTaps[i];
+                        accumulate(dstTexel, srcRow + tap.mIndex * sTexelFloats, tap.mWeight);
+                    }
+                    dstTexel += sTexelFloats;
+                }
+            }
+        });
+    }
+    
+    // Shrinks every column to the kernel's destination size, a whole row at a time
+    void filterColumns(const float* src, uint32_t width, const Kernel& kernel, float* dst) {
+        uint32_t dstHeight = kernel.mStarts.size() - 1;
+        std::size_t rowFloats = static_cast<std::size_t>(width) * sTexelFloats;
+        Jobs::parallelFor(0, dstHeight, [=, &kernel](std::size_t begin, std::size_t end) {
+            for(std::size_t y = begin; y < end; ++ y) {
+                float* dstRow = dst + y * rowFloats;
+                std::memset(dstRow, 0, sizeof(float) * rowFloats);
+                for(uint32_t i = kernel.mStarts[y]; i < kernel.mStarts[y + 1]; ++ i) {
+                    const Kernel::Tap& tap = kernel.mTaps[i];
+                    const float* srcRow = src + tap.mIndex * rowFloats;
+                    for(uint32_t x = 0; x < width; ++ x) {
+                        accumulate(dstRow + x * sTexelFloats, srcRow + x * sTexelFloats, tap.mWeight);
+                    }
+                }
+            }
+        });
+    }
+    
+    const float* getSrgbToLinearTable() {
+        struct Table {
+            float mValues[256];
+            Table() {
+                for(uint32_t i = 0; i < 256; ++ i) {
+                    float c = i / 255.f;
+                    mValues[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+            }
+        };
+        static Table table;
+        return table.mValues;
+    }
+    
+    uint8_t quantize(float c) {
+        c = std::min(std::max(c, 0.f), 1.f);
+        return static_cast<uint8_t>(c * 255.f + 0.5f);
+    }
+    
+    uint8_t linearToSrgb(float c) {
+        c = std::min(std::max(c, 0.f), 1.f);
+        return quantize(c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f);
+    }
+    
+    bool isSrgbComponent(bool srgb, uint32_t component) {
+        return srgb && component < 3;
+    }
+    
+    void expand(const uint8_t* texels, std::size_t numTexels, uint32_t numComponents, bool srgb, float* output) {
+        const float* srgbTable = getSrgbToLinearTable();
+        Jobs::parallelFor(0, numTexels, [=](std::size_t begin, std::size_t end) {
+            for(std::size_t i = begin; i < end; ++ i) {
+                const uint8_t* texel = texels + i * numComponents;
+                float* result = output + i * sTexelFloats;
+                for(uint32_t c = 0; c < sTexelFloats; ++ c) {
+                    if(c >= numComponents) {
+                        result[c] = 0.f;
+                    } else if(isSrgbComponent(srgb, c)) {
+                        result[c] = srgbTable[texel[c]];
+                    } else {
+                        result[c] = texel[c] / 255.f;
+                    }
+                }
+            }
+        });
+    }
+    
+    void contract(const float* texels, std::size_t numTexels, uint32_t numComponents, bool srgb, uint8_t* output) {
+        Jobs::parallelFor(0, numTexels, [=](std::size_t begin, std::size_t end) {
+            for(std::size_t i = begin; i < end; ++ i) {
+                const float* texel = texels + i * sTexelFloats;
+                uint8_t* result = output + i * numComponents;
+                for(uint32_t c = 0; c < numComponents; ++ c) {
+                    result[c] = isSrgbComponent(srgb, c) ? linearToSrgb(texel[c]) : quantize(texel[c]);
+                }
+            }
+        });
+    }
+    
+} // namespace
+
+uint32_t calcNumLevels(uint32_t width, uint32_t height) {
+    uint32_t size = std::max(width, height);
+    uint32_t levels = 1;
+    while(size > 1) {
+        size /= 2;
+        ++ levels;
+    }
+    return levels;
+}
+
+std::vector<Level> calcLevels(uint32_t width, uint32_t height, uint32_t bytesPerTexel) {
+    std::vector<Level> levels(calcNumLevels(width, height));
+    uint64_t offset = 0;
+    for(Level& level : levels) {
+        level.mWidth = width;
+        level.mHeight = height;
+        level.mOffset = offset;
+        offset += static_cast<uint64_t>(width) * height * bytesPerTexel;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return levels;
+}
+
+void generate(
+    Filter filter, bool srgb, 
+    const uint8_t* texels, uint32_t width, uint32_t height, uint32_t numComponents, 
+    std::vector<uint8_t>& output) {
+    
+    std::vector<Level> levels = calcLevels(width, height, numComponents);
+    const Level& smallest = levels.back();
+    output.resize(smallest.mOffset + static_cast<uint64_t>(smallest.mWidth) * smallest.mHeight * numComponents);
+    std::memcpy(output.data(), texels, static_cast<std::size_t>(width) * height * numComponents);
+    
+    std::vector<float> current(static_cast<std::size_t>(width) * height * sTexelFloats);
+    std::vector<float> halfFiltered;
+    std::vector<float> next;
+    expand(texels, static_cast<std::size_t>(width) * height, numComponents, srgb, current.data());
+    
+    Kernel rowKernel;
+    Kernel columnKernel;
+    for(std::size_t i = 1; i < levels.size(); ++ i) {
+        const Level& src = levels[i - 1];
+        const Level& dst = levels[i];
+        
+        buildKernel(filter, src.mWidth, dst.mWidth, rowKernel);
+        buildKernel(filter, src.mHeight, dst.mHeight, columnKernel);
+        
+        halfFiltered.resize(static_cast<std::size_t>(dst.mWidth) * src.mHeight * sTexelFloats);
+        next.resize(static_cast<std::size_t>(dst.mWidth) * dst.mHeight * sTexelFloats);
+        filterRows(current.data(), src.mWidth, src.mHeight, rowKernel, halfFiltered.data());
+        filterColumns(halfFiltered.data(), dst.mWidth, columnKernel, next.data());
+        
+        contract(next.data(), static_cast<std::size_t>(dst.mWidth) * dst.mHeight, numComponents, srgb, output.data() + dst.mOffset);
+        current.swap(next);
+    }
+}
+
+} // MipChain
+} // pgg
@@ -0,0 +1,68 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef PGG_MIPCHAIN_HPP
+#define PGG_MIPCHAIN_HPP
+
+#include <stdint.h>
+#include <vector>
+
+/* Generation of complete mip chains from 8-bit texels, for storing and uploading alongside the image.
+ *
+ * Each level is half the size of the one before it, rounded down and at least 1, down to 1x1. Levels are
+ * filtered from the previous level kept at full float precision, rather than from rounded 8-bit texels, and
+ * color channels are averaged in linear space so that downsampled sRGB textures keep their brightness.
+ *
+ * Texels are given tightly packed with 1 to 4 components. When sRGB, every component except the fourth
+ * (alpha) is decoded before filtering.
+ */
+
+namespace pgg {
+namespace MipChain {
+
+    enum Filter {
+        BOX, // Average of the texels under each destination texel
+        KAISER, // Kaiser-windowed sinc; sharper, with less aliasing
+        
+        NUM_FILTERS
+    };
+    
+    struct Level {
+        uint32_t mWidth;
+        uint32_t mHeight;
+        
+        // In bytes, from the start of the chain
+        uint64_t mOffset;
+    };
+    
+    uint32_t calcNumLevels(uint32_t width, uint32_t height);
+    
+    // Sizes and offsets of every level when tightly packed one after another, largest first
+    std::vector<Level> calcLevels(uint32_t width, uint32_t height, uint32_t bytesPerTexel);
+    
+    /* Writes every level, including a copy of the given texels as the first, tightly packed one after another
+     * into output. Rows are filtered in parallel on the job system.
+     */
+    void generate(
+        Filter filter, bool srgb, 
+        const uint8_t* texels, uint32_t width, uint32_t height, uint32_t numComponents, 
+        std::vector<uint8_t>& output);
+
+} // MipChain
+} // pgg
+
+#endif // PGG_MIPCHAIN_HPP
@@ -28,7 +28,8 @@
 namespace pgg {
 
 MissionGameLayer::MissionGameLayer()
-: mPeriod(0.f) {
+: mPeriod(0.f)
+, mPeriodPrev(0.f) {
 }
 
 MissionGameLayer::~MissionGameLayer()
@@ -66,13 +67,24 @@ bool MissionGameLayer::onQuit(const QuitEvent& event) {
 
 // Ticks
 void MissionGameLayer::onTick(double tpf, const InputState* keyStates) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    
     //mRootNode->update(tpf);
     
+    mPeriodPrev = mPeriod;
     mPeriod += tpf;
-    //mRootNode->mModelInst->mModelMatr = glm::rotate(glm::mat4(1.f), std::sin(mPeriod), glm::vec3(0.f, 1.f, 0.f));
-    mRenderer->mCamera.setViewMatrix(glm::vec3(std::sin(mPeriod) * 4.f, 4.f, std::cos(mPeriod) * 4.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+}
+void MissionGameLayer::onPublishSnapshot() {
+    RenderSnapshot& snapshot = mSnapshots.beginWrite();
+    snapshot.mPeriod = mPeriod;
+    snapshot.mPeriodPrev = mPeriodPrev;
+    mSnapshots.publish();
+}
+void MissionGameLayer::onRender(double tpf, double interp) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    
+    const RenderSnapshot& snapshot = mSnapshots.acquire();
+    float period = snapshot.mPeriodPrev + (snapshot.mPeriod - snapshot.mPeriodPrev) * ((float) interp);
+    //mRootNode->mModelInst->mModelMatr = glm::rotate(glm::mat4(1.f), std::sin(period), glm::vec3(0.f, 1.f, 0.f));
+    mRenderer->mCamera.setViewMatrix(glm::vec3(std::sin(period) * 4.f, 4.f, std::cos(period) * 4.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
     
     mRenderer->renderFrame();
 }
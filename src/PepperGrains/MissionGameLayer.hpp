@@ -20,6 +20,7 @@
 #include "Gamelayer.hpp"
 #include "ShoRenderer.hpp"
 #include "SimpleScenegraph.hpp"
+#include "SnapshotBuffer.hpp"
 #include "NRES.hpp"
 
 namespace pgg {
@@ -37,7 +38,16 @@ private:
     ShoRenderer* mRenderer = nullptr;
     SimpleScenegraph* mScenegraph = nullptr;
     
+    // Simulation state as of the last two ticks
     float mPeriod;
+    float mPeriodPrev;
+    
+    // Everything the render thread needs from the simulation, blended between when rendering
+    struct RenderSnapshot {
+        float mPeriod = 0.f;
+        float mPeriodPrev = 0.f;
+    };
+    SnapshotBuffer<RenderSnapshot> mSnapshots;
 
 public:
     // Lifecycle
@@ -46,6 +56,8 @@ public:
     
     // Ticks
     void onTick(double tpf, const InputState* keyStates);
+    void onPublishSnapshot();
+    void onRender(double tpf, double interp);
     
     bool onNeedRebuildRenderPipeline();
 
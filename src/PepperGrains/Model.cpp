@@ -51,8 +51,27 @@ void Model::unload() {
 Geometry* Model::getGeometry() const { return mGeometry; }
 Material* Model::getMaterial() const { return mMaterial; }
 
+void Model::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) { }
+
+const void* Model::getProgramKey(const Renderable::Pass& rendPass) const { return this; }
+const void* Model::getMaterialKey(const Renderable::Pass& rendPass) const { return this->getMaterial(); }
+const void* Model::getGeometryKey() const { return this->getGeometry(); }
+void Model::bindProgram(const Renderable::Pass& rendPass) { }
+void Model::bindMaterial(const Renderable::Pass& rendPass) { }
+void Model::bindGeometry() {
+    #ifdef PGG_OPENGL
+    this->bindVertexArray();
+    #endif
+}
+void Model::draw(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
+    this->render(rendPass, modelMat);
+}
+bool Model::usesGLStateCache() const { return false; }
+
 #ifdef PGG_OPENGL
 void Model::bindVertexArray() { }
+bool Model::canDrawInstanced(const Renderable::Pass& rendPass) const { return false; }
+void Model::drawInstanced(const Renderable::Pass& rendPass, InstanceBuffer& instances, uint32_t first, uint32_t count) { }
 #endif
 
 }
@@ -21,6 +21,7 @@
 #include "Resource.hpp"
 #include "Renderable.hpp"
 #include "Geometry.hpp"
+#include "InstanceBuffer.hpp"
 #include "Material.hpp"
 
 namespace pgg {
@@ -44,8 +45,39 @@ public:
     virtual void load();
     virtual void unload();
     
+    // Draw everything in one call; by default, does nothing
+    virtual void render(const Renderable::Pass& rendPass, const glm::mat4& modelMat);
+    
+    /* Used by RenderQueue to sort draws and skip redundant state changes.
+     * 
+     * Draws returning the same key share that state; bindX() is only called on the first of them. Models
+     * which do not split their state this way can keep the defaults, where the program key is unique to
+     * the model and everything is bound by render(). A null program key means the model is not drawn in
+     * that pass.
+     */
+    virtual const void* getProgramKey(const Renderable::Pass& rendPass) const;
+    virtual const void* getMaterialKey(const Renderable::Pass& rendPass) const;
+    virtual const void* getGeometryKey() const;
+    virtual void bindProgram(const Renderable::Pass& rendPass);
+    virtual void bindMaterial(const Renderable::Pass& rendPass);
+    virtual void bindGeometry();
+    virtual void draw(const Renderable::Pass& rendPass, const glm::mat4& modelMat);
+    
+    /* If false (the default), the model sets GL state directly, so the pass's GLStateCache is
+     * invalidated after drawing it. Models returning true must only set tracked state through
+     * Renderable::Pass::mGLState, and may leave their bindings in place.
+     */
+    virtual bool usesGLStateCache() const;
+    
     #ifdef PGG_OPENGL
     virtual void bindVertexArray();
+    
+    /* If true, RenderQueue draws runs of this model which share all keys with drawInstanced() instead of
+     * draw(); the model matrices are written to the instance buffer starting at index first.
+     * Called after the bind methods, as with draw().
+     */
+    virtual bool canDrawInstanced(const Renderable::Pass& rendPass) const;
+    virtual void drawInstanced(const Renderable::Pass& rendPass, InstanceBuffer& instances, uint32_t first, uint32_t count);
     #endif
 };
 
@@ -0,0 +1,82 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef PGG_MODELMATRIXUNIFORMS_HPP
+#define PGG_MODELMATRIXUNIFORMS_HPP
+
+#include <GraphicsApiLibrary.hpp>
+
+#include "MathUtil.hpp"
+
+namespace pgg {
+
+/* The uniforms of a shader program which depend on the model matrix, and so change with every draw.
+ * Only the products a program uses are calculated. Each result is handed to an uploader called as
+ * uploader(location, matrix), which is glUniformMatrix4fv in the OpenGL build; taking it as a parameter
+ * lets this per-draw work be measured without a context.
+ */
+struct ModelMatrixUniforms {
+    bool mUseMMat = false;
+    bool mUseMVMat = false;
+    bool mUseMVPMat = false;
+    bool mUseIMMat = false;
+    bool mUseIMVMat = false;
+    bool mUseIMVPMat = false;
+    
+    GLuint mMMatUnif;
+    GLuint mMVMatUnif;
+    GLuint mMVPMatUnif;
+    GLuint mIMMatUnif;
+    GLuint mIMVMatUnif;
+    GLuint mIMVPMatUnif;
+    
+    // Pass matrices are only read if a product needing them is used
+    template<typename Uploader>
+    void upload(const glm::mat4& modelMat, const glm::mat4& viewMat, const glm::mat4& viewProjMat,
+            const glm::mat4& invViewMat, const glm::mat4& invViewProjMat, Uploader uploader) const {
+        glm::mat4 product;
+        if(mUseMMat) {
+            uploader(mMMatUnif, modelMat);
+        }
+        if(mUseMVMat) {
+            Math::multiplyMatrices(viewMat, modelMat, product);
+            uploader(mMVMatUnif, product);
+        }
+        if(mUseMVPMat) {
+            Math::multiplyMatrices(viewProjMat, modelMat, product);
+            uploader(mMVPMatUnif, product);
+        }
+        if(mUseIMMat || mUseIMVMat || mUseIMVPMat) {
+            glm::mat4 invModelMat = Math::inverseAffine(modelMat);
+            if(mUseIMMat) {
+                uploader(mIMMatUnif, invModelMat);
+            }
+            if(mUseIMVMat) {
+                Math::multiplyMatrices(invModelMat, invViewMat, product);
+                uploader(mIMVMatUnif, product);
+            }
+            if(mUseIMVPMat) {
+                Math::multiplyMatrices(invModelMat, invViewProjMat, product);
+                uploader(mIMVPMatUnif, product);
+            }
+        }
+    }
+};
+
+}
+
+#endif // PGG_MODELMATRIXUNIFORMS_HPP
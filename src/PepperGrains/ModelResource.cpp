@@ -83,7 +83,7 @@ void ModelResource::load() {
     mGeometry->bindBuffers();
 
     // Tell OpenGL which attributes to read, how to read them, and where to send them
-    //mMaterial->enableVertexAttributesFor(mGeometry);
+    mMaterial->enableVertexAttributesFor(mGeometry);
 
     // Finished initalizing vertex array object, so unbind
     glBindVertexArray(0);
@@ -109,7 +109,7 @@ void ModelResource::unload() {
 }
 
 /*
-void ModelResource::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void ModelResource::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
     
     if(!mMaterial->isVisible(rendPass)) {
         return;
@@ -142,6 +142,64 @@ Material* ModelResource::getMaterial() const {
 void ModelResource::bindVertexArray() {
     glBindVertexArray(mVertexArrayObject);
 }
+
+void ModelResource::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
+    if(!mMaterial->isVisible(rendPass)) {
+        return;
+    }
+    ShaderProgramResource* program = mMaterial->getProgram(rendPass);
+    glUseProgram(program->getHandle());
+    program->bindRenderPass(rendPass, modelMat);
+    this->bindTextures(program);
+    this->bindVertexArray();
+    mGeometry->drawElements();
+}
+
+ShaderProgramResource* ModelResource::getQueuedProgram(const Renderable::Pass& rendPass) const {
+    ShaderProgramResource* program = mMaterial->getInstancedProgram(rendPass);
+    return program ? program : mMaterial->getProgram(rendPass);
+}
+const void* ModelResource::getProgramKey(const Renderable::Pass& rendPass) const {
+    return mMaterial->isVisible(rendPass) ? this->getQueuedProgram(rendPass) : nullptr;
+}
+void ModelResource::bindProgram(const Renderable::Pass& rendPass) {
+    ShaderProgramResource* program = this->getQueuedProgram(rendPass);
+    glUseProgram(program->getHandle());
+    
+    // An instanced program has no model matrix uniform, so this only uploads the pass matrices
+    program->bindRenderPass(rendPass, glm::mat4());
+}
+void ModelResource::bindMaterial(const Renderable::Pass& rendPass) {
+    this->bindTextures(this->getQueuedProgram(rendPass));
+}
+void ModelResource::bindTextures(const ShaderProgramResource* program) {
+    const Material::Technique& technique = mMaterial->getTechnique();
+    Texture* diffuse = technique.mDiffuse.getTexture();
+    if(!diffuse) {
+        diffuse = Texture::getFallback();
+    }
+    GLuint handle;
+    if(program->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, ShaderProgramResource::hashName("diffuse"), handle)) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, diffuse->getHandle());
+        glUniform1i(handle, 0);
+    }
+    Texture* normals = technique.mNormals.getTexture();
+    if(normals && program->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, ShaderProgramResource::hashName("normals"), handle)) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normals->getHandle());
+        glUniform1i(handle, 1);
+    }
+}
+bool ModelResource::canDrawInstanced(const Renderable::Pass& rendPass) const {
+    ShaderProgramResource* program = mMaterial->getInstancedProgram(rendPass);
+    return program && program->needsInstancedModelMatrix();
+}
+void ModelResource::drawInstanced(const Renderable::Pass& rendPass, InstanceBuffer& instances, uint32_t first, uint32_t count) {
+    // Program, material and vertex array are already bound, and stay bound for the next run
+    instances.bindModelMatrixAttrib(mMaterial->getInstancedProgram(rendPass)->getInstancedModelMatrixAttrib(), first);
+    mGeometry->drawElementsInstanced(count);
+}
 #endif
 
 }
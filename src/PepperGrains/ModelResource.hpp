@@ -21,6 +21,7 @@
 #include "Material.hpp"
 #include "Model.hpp"
 #include "Resource.hpp"
+#include "ShaderProgramResource.hpp"
 
 namespace pgg {
 
@@ -32,6 +33,14 @@ private:
     Material* mMaterial;
     GLuint mVertexArrayObject;
     
+    #ifdef PGG_OPENGL
+    // Program bound for RenderQueue draws: the material's instanced variant when it has one
+    ShaderProgramResource* getQueuedProgram(const Renderable::Pass& rendPass) const;
+    
+    // Binds the material's textures to whichever of its samplers the program declares
+    void bindTextures(const ShaderProgramResource* program);
+    #endif
+    
     void loadError();
     void unloadError();
     bool mIsErrorResource;
@@ -47,13 +56,26 @@ public:
     static Model* gallop(Resource* resource);
 
     // Render this model with the provided matrices
-    //void render(Renderable::Pass rendPass, const glm::mat4& modelMat);
+    //void render(const Renderable::Pass& rendPass, const glm::mat4& modelMat);
     
     Geometry* getGeometry() const;
     Material* getMaterial() const;
     
     #ifdef PGG_OPENGL
     void bindVertexArray();
+    
+    // Draw without a RenderQueue, using the material's non-instanced program
+    void render(const Renderable::Pass& rendPass, const glm::mat4& modelMat);
+    
+    /* Every model sharing a material and geometry also shares the program, so the RenderQueue coalesces
+     * all of their draws into one instanced draw if the material has an instanced program. The material
+     * and geometry keys are the defaults.
+     */
+    const void* getProgramKey(const Renderable::Pass& rendPass) const;
+    void bindProgram(const Renderable::Pass& rendPass);
+    void bindMaterial(const Renderable::Pass& rendPass);
+    bool canDrawInstanced(const Renderable::Pass& rendPass) const;
+    void drawInstanced(const Renderable::Pass& rendPass, InstanceBuffer& instances, uint32_t first, uint32_t count);
     #endif
 };
 
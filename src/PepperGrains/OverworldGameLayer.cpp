@@ -173,6 +173,7 @@ void OverworldGameLayer::onBegin() {
 
     fps = 0.f;
     fpsWeight = 0.85f;
+    mTransformsUpdated = 0;
     
     mDebugWireframe = false;
 
@@ -266,7 +267,8 @@ void OverworldGameLayer::onTick(float tpf, const Uint8* keyStates) {
         cube->publish();
     }
     mDynamicsWorld->stepSimulation(tpf, 5);
-    mRigidBodyESys->onTick();
+    mRigidBodyESys->gatherActivePoses(mPhysicsPoses);
+    mSceneNodeESys->applyPhysicsPoses(mPhysicsPoses);
     mSceneNodeESys->onTick(tpf);
     
     mCamera.viewMat = glm::inverse(mCamRollNode->calcWorldTransform());
@@ -290,6 +292,8 @@ void OverworldGameLayer::onTick(float tpf, const Uint8* keyStates) {
         std::stringstream ss;
         ss << "FPS: ";
         ss << (uint32_t) fps;
+        ss << " Transforms: ";
+        ss << mTransformsUpdated;
 
         fpsCounter = new TextModel(rainstormFont, ss.str());
         fpsCounter->grab();
@@ -587,6 +591,9 @@ void OverworldGameLayer::unloadSun() {
 }
 
 void OverworldGameLayer::renderFrame(glm::vec4 debugShow, bool wireframe) {
+    // Bring all world transforms up to date before any pass reads them
+    mTransformsUpdated = SceneNode::updateAllTransforms();
+
     // Calculate shadow map cascades:
     {
         mSky.sunBasicViewMatrix = glm::lookAt(mSky.sunPosition - mSky.sunDirection, mSky.sunPosition, glm::vec3(0.f, 1.f, 0.f));
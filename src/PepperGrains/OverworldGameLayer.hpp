@@ -140,6 +140,7 @@ private:
     
     SceneNodeESys* mSceneNodeESys;
     RigidBodyESys* mRigidBodyESys;
+    RigidBodyESys::PoseBatch mPhysicsPoses;
     
     ShaderProgramResource* mComputer;
     TextureResource* mRoseTexture;
@@ -176,6 +177,7 @@ public:
 
     float fps;
     float fpsWeight;
+    uint32_t mTransformsUpdated;
 
     float oneSecondTimer;
     
@@ -0,0 +1,300 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef PGG_VULKAN
+
+#include "PipelineStateCacheVulkan.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+#include "Logger.hpp"
+#include "Video.hpp"
+
+namespace pgg {
+
+namespace {
+    
+    /// 64-bit FNV-1a, fed one field at a time since create info structs contain padding and pointers
+    class StateHasher {
+    public:
+        uint64_t mHash = 14695981039346656037ull;
+        
+        void addBytes(const void* data, std::size_t size) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for(std::size_t i = 0; i < size; ++ i) {
+                mHash = (mHash ^ bytes[i]) * 1099511628211ull;
+            }
+        }
+        
+        template<typename T>
+        void add(const T& value) {
+            this->addBytes(&value, sizeof(value));
+        }
+        
+        void addString(const char* str) {
+            if(!str) {
+                this->add<uint8_t>(0);
+                return;
+            }
+            this->addBytes(str, std::strlen(str) + 1);
+        }
+    };
+    
+    void hashStencilOpState(StateHasher& hasher, const VkStencilOpState& state) {
+        hasher.add(state.failOp);
+        hasher.add(state.passOp);
+        hasher.add(state.depthFailOp);
+        hasher.add(state.compareOp);
+        hasher.add(state.compareMask);
+        hasher.add(state.writeMask);
+        hasher.add(state.reference);
+    }
+    
+} // namespace
+
+PipelineStateCacheVk::Stats::Stats()
+: mNumPipelines(0)
+, mNumHits(0)
+, mNumMisses(0) { }
+
+PipelineStateCacheVk::PipelineStateCacheVk() { }
+PipelineStateCacheVk::~PipelineStateCacheVk() { }
+
+uint64_t PipelineStateCacheVk::hashGraphicsPipeline(const VkGraphicsPipelineCreateInfo& cargs) {
+    StateHasher hasher;
+    
+    hasher.add(cargs.flags);
+    
+    hasher.add(cargs.stageCount);
+    for(uint32_t i = 0; i < cargs.stageCount; ++ i) {
+        const VkPipelineShaderStageCreateInfo& stage = cargs.pStages[i];
+        hasher.add(stage.flags);
+        hasher.add(stage.stage);
+        hasher.add(stage.module);
+        hasher.addString(stage.pName);
+        
+        const VkSpecializationInfo* spec = stage.pSpecializationInfo;
+        hasher.add<uint8_t>(spec ? 1 : 0);
+        if(spec) {
+            hasher.add(spec->mapEntryCount);
+            for(uint32_t j = 0; j < spec->mapEntryCount; ++ j) {
+                hasher.add(spec->pMapEntries[j].constantID);
+                hasher.add(spec->pMapEntries[j].offset);
+                hasher.add<uint64_t>(spec->pMapEntries[j].size);
+            }
+            hasher.add<uint64_t>(spec->dataSize);
+            hasher.addBytes(spec->pData, spec->dataSize);
+        }
+    }
+    
+    const VkPipelineVertexInputStateCreateInfo* vertexInput = cargs.pVertexInputState;
+    hasher.add<uint8_t>(vertexInput ? 1 : 0);
+    if(vertexInput) {
+        hasher.add(vertexInput->flags);
+        hasher.add(vertexInput->vertexBindingDescriptionCount);
+        for(uint32_t i = 0; i < vertexInput->vertexBindingDescriptionCount; ++ i) {
+            const VkVertexInputBindingDescription& binding = vertexInput->pVertexBindingDescriptions[i];
+            hasher.add(binding.binding);
+            hasher.add(binding.stride);
+            hasher.add(binding.inputRate);
+        }
+        hasher.add(vertexInput->vertexAttributeDescriptionCount);
+        for(uint32_t i = 0; i < vertexInput->vertexAttributeDescriptionCount; ++ i) {
+            const VkVertexInputAttributeDescription& attrib = vertexInput->pVertexAttributeDescriptions[i];
+            hasher.add(attrib.location);
+            hasher.add(attrib.binding);
+            hasher.add(attrib.format);
+            hasher.add(attrib.offset);
+        }
+    }
+    
+    const VkPipelineInputAssemblyStateCreateInfo* inputAssembly = cargs.pInputAssemblyState;
+    hasher.add<uint8_t>(inputAssembly ? 1 : 0);
+    if(inputAssembly) {
+        hasher.add(inputAssembly->flags);
+        hasher.add(inputAssembly->topology);
+        hasher.add(inputAssembly->primitiveRestartEnable);
+    }
+    
+    const VkPipelineTessellationStateCreateInfo* tessellation = cargs.pTessellationState;
+    hasher.add<uint8_t>(tessellation ? 1 : 0);
+    if(tessellation) {
+        hasher.add(tessellation->flags);
+        hasher.add(tessellation->patchControlPoints);
+    }
+    
+    // Hashed before the viewport state, which depends on it
+    bool dynamicViewport = false;
+    bool dynamicScissor = false;
+    const VkPipelineDynamicStateCreateInfo* dynamic = cargs.pDynamicState;
+    hasher.add<uint8_t>(dynamic ? 1 : 0);
+    if(dynamic) {
+        hasher.add(dynamic->flags);
+        hasher.add(dynamic->dynamicStateCount);
+        for(uint32_t i = 0; i < dynamic->dynamicStateCount; ++ i) {
+            VkDynamicState state = dynamic->pDynamicStates[i];
+            hasher.add(state);
+            if(state == VK_DYNAMIC_STATE_VIEWPORT) dynamicViewport = true;
+            if(state == VK_DYNAMIC_STATE_SCISSOR) dynamicScissor = true;
+        }
+    }
+    
+    const VkPipelineViewportStateCreateInfo* viewport = cargs.pViewportState;
+    hasher.add<uint8_t>(viewport ? 1 : 0);
+    if(viewport) {
+        hasher.add(viewport->flags);
+        hasher.add(viewport->viewportCount);
+        if(!dynamicViewport) {
+            for(uint32_t i = 0; i < viewport->viewportCount; ++ i) {
+                const VkViewport& vp = viewport->pViewports[i];
+                hasher.add(vp.x);
+                hasher.add(vp.y);
+                hasher.add(vp.width);
+                hasher.add(vp.height);
+                hasher.add(vp.minDepth);
+                hasher.add(vp.maxDepth);
+            }
+        }
+        hasher.add(viewport->scissorCount);
+        if(!dynamicScissor) {
+            for(uint32_t i = 0; i < viewport->scissorCount; ++ i) {
+                const VkRect2D& scissor = viewport->pScissors[i];
+                hasher.add(scissor.offset.x);
+                hasher.add(scissor.offset.y);
+                hasher.add(scissor.extent.width);
+                hasher.add(scissor.extent.height);
+            }
+        }
+    }
+    
+    const VkPipelineRasterizationStateCreateInfo* raster = cargs.pRasterizationState;
+    hasher.add<uint8_t>(raster ? 1 : 0);
+    if(raster) {
+        hasher.add(raster->flags);
+        hasher.add(raster->depthClampEnable);
+        hasher.add(raster->rasterizerDiscardEnable);
+        hasher.add(raster->polygonMode);
+        hasher.add(raster->cullMode);
+        hasher.add(raster->frontFace);
+        hasher.add(raster->depthBiasEnable);
+        hasher.add(raster->depthBiasConstantFactor);
+        hasher.add(raster->depthBiasClamp);
+        hasher.add(raster->depthBiasSlopeFactor);
+        hasher.add(raster->lineWidth);
+    }
+    
+    const VkPipelineMultisampleStateCreateInfo* multisample = cargs.pMultisampleState;
+    hasher.add<uint8_t>(multisample ? 1 : 0);
+    if(multisample) {
+        hasher.add(multisample->flags);
+        hasher.add(multisample->rasterizationSamples);
+        hasher.add(multisample->sampleShadingEnable);
+        hasher.add(multisample->minSampleShading);
+        hasher.add<uint8_t>(multisample->pSampleMask ? 1 : 0);
+        if(multisample->pSampleMask) {
+            // One bit per sample
+            uint32_t numWords = (static_cast<uint32_t>(multisample->rasterizationSamples) + 31) / 32;
+            hasher.addBytes(multisample->pSampleMask, numWords * sizeof(uint32_t));
+        }
+        hasher.add(multisample->alphaToCoverageEnable);
+        hasher.add(multisample->alphaToOneEnable);
+    }
+    
+    const VkPipelineDepthStencilStateCreateInfo* depthStencil = cargs.pDepthStencilState;
+    hasher.add<uint8_t>(depthStencil ? 1 : 0);
+    if(depthStencil) {
+        hasher.add(depthStencil->flags);
+        hasher.add(depthStencil->depthTestEnable);
+        hasher.add(depthStencil->depthWriteEnable);
+        hasher.add(depthStencil->depthCompareOp);
+        hasher.add(depthStencil->depthBoundsTestEnable);
+        hasher.add(depthStencil->stencilTestEnable);
+        hashStencilOpState(hasher, depthStencil->front);
+        hashStencilOpState(hasher, depthStencil->back);
+        hasher.add(depthStencil->minDepthBounds);
+        hasher.add(depthStencil->maxDepthBounds);
+    }
+    
+    const VkPipelineColorBlendStateCreateInfo* colorBlend = cargs.pColorBlendState;
+    hasher.add<uint8_t>(colorBlend ? 1 : 0);
+    if(colorBlend) {
+        hasher.add(colorBlend->flags);
+        hasher.add(colorBlend->logicOpEnable);
+        hasher.add(colorBlend->logicOp);
+        hasher.add(colorBlend->attachmentCount);
+        for(uint32_t i = 0; i < colorBlend->attachmentCount; ++ i) {
+            const VkPipelineColorBlendAttachmentState& attach = colorBlend->pAttachments[i];
+            hasher.add(attach.blendEnable);
+            hasher.add(attach.srcColorBlendFactor);
+            hasher.add(attach.dstColorBlendFactor);
+            hasher.add(attach.colorBlendOp);
+            hasher.add(attach.srcAlphaBlendFactor);
+            hasher.add(attach.dstAlphaBlendFactor);
+            hasher.add(attach.alphaBlendOp);
+            hasher.add(attach.colorWriteMask);
+        }
+        for(uint32_t i = 0; i < 4; ++ i) {
+            hasher.add(colorBlend->blendConstants[i]);
+        }
+    }
+    
+    hasher.add(cargs.layout);
+    hasher.add(cargs.renderPass);
+    hasher.add(cargs.subpass);
+    
+    return hasher.mHash;
+}
+
+VkPipeline PipelineStateCacheVk::findOrCreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& cargs) {
+    uint64_t hash = hashGraphicsPipeline(cargs);
+    
+    std::unordered_map<uint64_t, VkPipeline>::iterator iter = mPipelines.find(hash);
+    if(iter != mPipelines.end()) {
+        ++ mNumHits;
+        return iter->second;
+    }
+    ++ mNumMisses;
+    
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateGraphicsPipelines(Video::Vulkan::getLogicalDevice(), Video::Vulkan::getPipelineCache(), 1, &cargs, nullptr, &pipeline);
+    if(result != VK_SUCCESS) {
+        Logger::log(Logger::WARN) << "Could not create graphics pipeline" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    
+    mPipelines[hash] = pipeline;
+    return pipeline;
+}
+
+void PipelineStateCacheVk::clear() {
+    for(std::unordered_map<uint64_t, VkPipeline>::iterator iter = mPipelines.begin(); iter != mPipelines.end(); ++ iter) {
+        vkDestroyPipeline(Video::Vulkan::getLogicalDevice(), iter->second, nullptr);
+    }
+    mPipelines.clear();
+}
+
+PipelineStateCacheVk::Stats PipelineStateCacheVk::getStats() const {
+    Stats stats;
+    stats.mNumPipelines = mPipelines.size();
+    stats.mNumHits = mNumHits;
+    stats.mNumMisses = mNumMisses;
+    return stats;
+}
+
+}
+
+#endif // PGG_VULKAN
@@ -0,0 +1,83 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_PIPELINESTATECACHEVULKAN_HPP
+#define PGG_PIPELINESTATECACHEVULKAN_HPP
+
+#ifdef PGG_VULKAN
+
+#include <stdint.h>
+#include <unordered_map>
+
+#include <GraphicsApiLibrary.hpp>
+
+namespace pgg {
+
+/**
+ * @brief Graphics pipelines, keyed by a hash of the state they were created from
+ * 
+ * Asking for a pipeline with the same state as one already created returns that pipeline, so owners can rebuild
+ * everything which depends on the swapchain without creating their pipelines again. Pipelines which do need to be
+ * created go through Video::Vulkan::getPipelineCache(), which is saved to disk, so even those usually skip shader
+ * compilation after the first launch.
+ * 
+ * The hash covers shader stages, vertex input, fixed function and dynamic state, the layout, render pass and
+ * subpass. Viewports and scissors which are dynamic state are not hashed. Neither are pNext chains or base
+ * pipelines, which do not change what is created.
+ * 
+ * Shader modules, the layout and the render pass are hashed by handle. Clear the cache before destroying any of
+ * these which its pipelines were created with, since a new object may be given the same handle.
+ */
+class PipelineStateCacheVk {
+public:
+    struct Stats {
+        Stats();
+        
+        uint32_t mNumPipelines;
+        uint32_t mNumHits;
+        uint32_t mNumMisses;
+    };
+    
+private:
+    std::unordered_map<uint64_t, VkPipeline> mPipelines;
+    
+    uint32_t mNumHits = 0;
+    uint32_t mNumMisses = 0;
+    
+public:
+    PipelineStateCacheVk();
+    ~PipelineStateCacheVk();
+    
+    static uint64_t hashGraphicsPipeline(const VkGraphicsPipelineCreateInfo& cargs);
+    
+    /**
+     * @brief Returns the pipeline for this state, creating it if there is none yet
+     * The pipeline belongs to the cache and is destroyed by clear().
+     * @return VK_NULL_HANDLE if creation failed
+     */
+    VkPipeline findOrCreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& cargs);
+    
+    /// Destroys every pipeline. Must be called before the logical device is destroyed
+    void clear();
+    
+    Stats getStats() const;
+};
+
+}
+
+#endif // PGG_VULKAN
+
+#endif // PGG_PIPELINESTATECACHEVULKAN_HPP
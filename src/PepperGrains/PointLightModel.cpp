@@ -39,54 +39,15 @@ void PointLightModel::SharedResources::load() {
     mShaderProg->grab();
     mMinimalShader->grab();
     
-    {
-        const std::vector<ShaderProgramResource::Control>& vec3Controls = mMinimalShader->getUniformVec3s();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = vec3Controls.begin(); iter != vec3Controls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "position") {
-                mStencilPositionHandle = entry.handle;
-            }
-        }
-        const std::vector<ShaderProgramResource::Control>& floatControls = mMinimalShader->getUniformFloats();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = floatControls.begin(); iter != floatControls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "volumeRadius") {
-                mStencilVolumeRadiusHandle = entry.handle;
-            }
-        }
-    }
-    {
-        const std::vector<ShaderProgramResource::Control>& sampler2DControls = mShaderProg->getUniformSampler2Ds();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = sampler2DControls.begin(); iter != sampler2DControls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "normal") {
-                mNormalHandle = entry.handle;
-            }
-            else if(entry.name == "depth") {
-                mDepthHandle = entry.handle;
-            }
-        }
-        const std::vector<ShaderProgramResource::Control>& vec3Controls = mShaderProg->getUniformVec3s();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = vec3Controls.begin(); iter != vec3Controls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "position") {
-                mPositionHandle = entry.handle;
-            }
-            else if(entry.name == "color") {
-                mColorHandle = entry.handle;
-            }
-        }
-        const std::vector<ShaderProgramResource::Control>& floatControls = mShaderProg->getUniformFloats();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = floatControls.begin(); iter != floatControls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "radius") {
-                mRadiusHandle = entry.handle;
-            }
-            else if(entry.name == "volumeRadius") {
-                mVolumeRadiusHandle = entry.handle;
-            }
-        }
-    }
+    mMinimalShader->findHandle(ShaderProgramResource::UNIFORM_VEC3, "position", mStencilPositionHandle);
+    mMinimalShader->findHandle(ShaderProgramResource::UNIFORM_FLOAT, "volumeRadius", mStencilVolumeRadiusHandle);
+    
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "normal", mNormalHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "depth", mDepthHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_VEC3, "position", mPositionHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_VEC3, "color", mColorHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_FLOAT, "radius", mRadiusHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_FLOAT, "volumeRadius", mVolumeRadiusHandle);
     
     glGenVertexArrays(1, &mVertexArrayObject);
     glBindVertexArray(mVertexArrayObject);
@@ -109,7 +70,7 @@ void PointLightModel::SharedResources::unload() {
     
     glDeleteVertexArrays(1, &mVertexArrayObject);
 }
-void PointLightModel::SharedResources::render(Renderable::Pass rendPass, const glm::mat4& modelMat, const glm::vec3& lightColor, const GLfloat& lightRad, const GLfloat& lightVolRad) {
+void PointLightModel::SharedResources::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat, const glm::vec3& lightColor, const GLfloat& lightRad, const GLfloat& lightVolRad) {
     if(rendPass.mType != Renderable::Pass::Type::LOCAL_LIGHTS) {
         return;
     }
@@ -131,7 +92,7 @@ void PointLightModel::SharedResources::render(Renderable::Pass rendPass, const g
     glStencilOpSeparate(GL_BACK, GL_KEEP, GL_DECR, GL_KEEP);
     
     glUseProgram(mMinimalShader->getHandle());
-    mMinimalShader->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mMinimalShader->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
     glUniform3fv(mStencilPositionHandle, 1, glm::value_ptr(lightPosition));
     glUniform1f(mStencilVolumeRadiusHandle, lightVolRad * lightScale);
     glBindVertexArray(mVertexArrayObject);
@@ -155,7 +116,7 @@ void PointLightModel::SharedResources::render(Renderable::Pass rendPass, const g
     
     glUseProgram(mShaderProg->getHandle());
     
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
     glUniform3fv(mColorHandle, 1, glm::value_ptr(lightColor));
     glUniform3fv(mPositionHandle, 1, glm::value_ptr(lightPosition));
 
@@ -211,7 +172,7 @@ void PointLightModel::unload() {
     mSharedRes->drop();
 }
 
-void PointLightModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void PointLightModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
     mSharedRes->render(rendPass, modelMat, mColor, mRadius, mVolumeRadius);
 }
 
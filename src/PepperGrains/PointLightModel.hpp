@@ -48,7 +48,7 @@ public:
         
         void load();
         void unload();
-        void render(Renderable::Pass rendPass, const glm::mat4& modelMat, const glm::vec3& color, const GLfloat& radius, const GLfloat& volumeRadius);
+        void render(const Renderable::Pass& rendPass, const glm::mat4& modelMat, const glm::vec3& color, const GLfloat& radius, const GLfloat& volumeRadius);
     };
 private:
     
@@ -66,7 +66,7 @@ public:
     void load();
     void unload();
 
-    void render(Renderable::Pass rendPass, const glm::mat4& modelMat);
+    void render(const Renderable::Pass& rendPass, const glm::mat4& modelMat);
     
     void setBrightness(glm::vec3 brightness, float radius);
 };
@@ -0,0 +1,135 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef PGG_VULKAN
+
+#include "RenderCommandExecutorVulkan.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include "Geometry.hpp"
+
+namespace pgg {
+
+RenderCommandExecutorVk::RenderCommandExecutorVk() { }
+RenderCommandExecutorVk::~RenderCommandExecutorVk() { }
+
+uint32_t RenderCommandExecutorVk::addPipeline(VkPipeline pipeline, VkDescriptorSet descriptorSet) {
+    mPipelines.push_back(pipeline);
+    mDescriptorSets.push_back(descriptorSet);
+    return mPipelines.size() - 1;
+}
+
+void RenderCommandExecutorVk::clearPipelines() {
+    mPipelines.clear();
+    mDescriptorSets.clear();
+}
+
+void RenderCommandExecutorVk::setPipelineLayout(VkPipelineLayout pipelineLayout) {
+    mPipelineLayout = pipelineLayout;
+}
+
+void RenderCommandExecutorVk::setCommandBuffer(VkCommandBuffer cmdBuff) {
+    mCmdBuff = cmdBuff;
+}
+
+void RenderCommandExecutorVk::setUniformTarget(void* mapped, VkDeviceSize offset, VkDeviceSize stride, const glm::mat4& viewProj) {
+    mUniformMapped = static_cast<uint8_t*>(mapped);
+    mUniformOffset = offset;
+    mUniformStride = stride;
+    mViewProjMatrix = viewProj;
+}
+
+void RenderCommandExecutorVk::clearUniformTarget() {
+    mUniformMapped = nullptr;
+    mUniformOffset = 0;
+    mUniformStride = 0;
+}
+
+void RenderCommandExecutorVk::setViewport(const VkViewport& viewport, const VkRect2D& scissor) {
+    mHasViewport = true;
+    mViewport = viewport;
+    mScissor = scissor;
+}
+
+void RenderCommandExecutorVk::bindDescriptorSet() {
+    if(mDescriptorSet == VK_NULL_HANDLE) {
+        return;
+    }
+    if(mUniformMapped) {
+        uint32_t dynamicOffset = mDynamicOffset;
+        vkCmdBindDescriptorSets(mCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mDescriptorSet, 1, &dynamicOffset);
+    } else {
+        vkCmdBindDescriptorSets(mCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mDescriptorSet, 0, nullptr);
+    }
+}
+
+void RenderCommandExecutorVk::execute(const RenderCommandList& commands) {
+    assert(mCmdBuff != VK_NULL_HANDLE && "No command buffer to record into");
+    
+    // Draws go to whichever geometry was bound last
+    Geometry* geometry = nullptr;
+    
+    mDescriptorSet = VK_NULL_HANDLE;
+    mDynamicOffset = mUniformOffset;
+    VkDeviceSize uniformWritten = 0;
+    
+    if(mHasViewport) {
+        vkCmdSetViewport(mCmdBuff, 0, 1, &mViewport);
+        vkCmdSetScissor(mCmdBuff, 0, 1, &mScissor);
+    }
+    
+    const std::vector<glm::mat4>& matrices = commands.getMatrices();
+    const std::vector<RenderCommandList::Command>& list = commands.getCommands();
+    for(const RenderCommandList::Command& command : list) {
+        switch(command.mOpcode) {
+            case RenderCommandList::BIND_PIPELINE: {
+                assert(command.mArg < mPipelines.size() && "Unknown pipeline id");
+                vkCmdBindPipeline(mCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelines[command.mArg]);
+                mDescriptorSet = mDescriptorSets[command.mArg];
+                this->bindDescriptorSet();
+                break;
+            }
+            case RenderCommandList::BIND_GEOMETRY: {
+                geometry = command.mGeometry;
+                geometry->cmdBindBuffers(mCmdBuff);
+                break;
+            }
+            case RenderCommandList::SET_MODEL_MATRIX: {
+                if(!mUniformMapped) {
+                    break;
+                }
+                glm::mat4 modelViewProj = mViewProjMatrix * matrices[command.mArg];
+                memcpy(mUniformMapped + uniformWritten, &modelViewProj, sizeof(modelViewProj));
+                mDynamicOffset = mUniformOffset + uniformWritten;
+                uniformWritten += mUniformStride;
+                this->bindDescriptorSet();
+                break;
+            }
+            case RenderCommandList::DRAW_INDEXED: {
+                assert(geometry && "No geometry bound before drawing");
+                geometry->cmdDrawIndexed(mCmdBuff, command.mArg);
+                break;
+            }
+            default: break;
+        }
+    }
+}
+
+}
+
+#endif // PGG_VULKAN
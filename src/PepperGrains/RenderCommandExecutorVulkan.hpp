@@ -0,0 +1,96 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_RENDERCOMMANDEXECUTORVULKAN_HPP
+#define PGG_RENDERCOMMANDEXECUTORVULKAN_HPP
+
+#ifdef PGG_VULKAN
+
+#include <stdint.h>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+#include "RenderCommandList.hpp"
+
+namespace pgg {
+
+/// Translates a RenderCommandList into commands in a Vulkan command buffer
+class RenderCommandExecutorVk : public RenderCommandExecutor {
+private:
+    VkCommandBuffer mCmdBuff = VK_NULL_HANDLE;
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    
+    /// Indexed by the pipeline ids recorded in command lists
+    std::vector<VkPipeline> mPipelines;
+    std::vector<VkDescriptorSet> mDescriptorSets;
+    
+    /// Where model matrices are written; see setUniformTarget()
+    uint8_t* mUniformMapped = nullptr;
+    VkDeviceSize mUniformOffset = 0;
+    VkDeviceSize mUniformStride = 0;
+    glm::mat4 mViewProjMatrix;
+    
+    /// Set bound along with the current pipeline, and the dynamic offset it was last bound with
+    VkDescriptorSet mDescriptorSet = VK_NULL_HANDLE;
+    VkDeviceSize mDynamicOffset = 0;
+    
+    /// Dynamic state set at the start of every list; see setViewport()
+    bool mHasViewport = false;
+    VkViewport mViewport;
+    VkRect2D mScissor;
+    
+    void bindDescriptorSet();
+    
+public:
+    RenderCommandExecutorVk();
+    ~RenderCommandExecutorVk();
+    
+    /**
+     * @brief Registers a pipeline, returning the id to record in command lists
+     * The descriptor set (which may be VK_NULL_HANDLE) is bound to set 0 whenever the pipeline is bound.
+     */
+    uint32_t addPipeline(VkPipeline pipeline, VkDescriptorSet descriptorSet);
+    void clearPipelines();
+    void setPipelineLayout(VkPipelineLayout pipelineLayout);
+    
+    /// Commands are recorded into this buffer, which must already be inside a render pass
+    void setCommandBuffer(VkCommandBuffer cmdBuff);
+    
+    /**
+     * @brief Directs model matrices into a dynamic uniform buffer
+     * For each SET_MODEL_MATRIX, viewProj * model is written to the next stride bytes of mapped, and the descriptor
+     * set is rebound with that position as its dynamic offset. Offset is the position of mapped within the buffer.
+     * The caller must leave room for every matrix in the list. Without a target, model matrices are ignored and
+     * descriptor sets are bound with no dynamic offsets.
+     */
+    void setUniformTarget(void* mapped, VkDeviceSize offset, VkDeviceSize stride, const glm::mat4& viewProj);
+    void clearUniformTarget();
+    
+    /**
+     * @brief Sets the viewport and scissor at the start of every list executed
+     * Needed for pipelines which leave these as dynamic state, since secondary command buffers inherit no state.
+     */
+    void setViewport(const VkViewport& viewport, const VkRect2D& scissor);
+    
+    void execute(const RenderCommandList& commands);
+};
+
+}
+
+#endif // PGG_VULKAN
+
+#endif // PGG_RENDERCOMMANDEXECUTORVULKAN_HPP
@@ -0,0 +1,146 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "RenderCommandList.hpp"
+
+#include <cassert>
+
+namespace pgg {
+
+RenderCommandList::Stats::Stats()
+: mRedundantBinds(0) {
+    for(uint32_t i = 0; i < NUM_OPCODES; ++ i) {
+        mCommands[i] = 0;
+    }
+}
+
+RenderCommandList::Stats& RenderCommandList::Stats::operator+=(const Stats& other) {
+    for(uint32_t i = 0; i < NUM_OPCODES; ++ i) {
+        mCommands[i] += other.mCommands[i];
+    }
+    mRedundantBinds += other.mRedundantBinds;
+    return *this;
+}
+
+RenderCommandList::RenderCommandList() {
+    this->clear();
+}
+
+RenderCommandList::~RenderCommandList() {
+}
+
+void RenderCommandList::clear() {
+    mCommands.clear();
+    mMatrices.clear();
+    mPipelineBound = false;
+    mPipeline = 0;
+    mGeometry = nullptr;
+    mStats = Stats();
+}
+
+void RenderCommandList::push(Opcode opcode, uint32_t arg, Geometry* geometry) {
+    Command command;
+    command.mOpcode = opcode;
+    command.mArg = arg;
+    command.mGeometry = geometry;
+    mCommands.push_back(command);
+    ++ mStats.mCommands[opcode];
+}
+
+void RenderCommandList::bindPipeline(uint32_t pipeline) {
+    if(mPipelineBound && mPipeline == pipeline) {
+        ++ mStats.mRedundantBinds;
+        return;
+    }
+    mPipelineBound = true;
+    mPipeline = pipeline;
+    
+    // Executors may need to rebind vertex buffers after changing pipelines
+    mGeometry = nullptr;
+    this->push(BIND_PIPELINE, pipeline);
+}
+
+void RenderCommandList::bindGeometry(Geometry* geometry) {
+    assert(geometry && "Cannot bind null geometry");
+    if(mGeometry == geometry) {
+        ++ mStats.mRedundantBinds;
+        return;
+    }
+    mGeometry = geometry;
+    this->push(BIND_GEOMETRY, 0, geometry);
+}
+
+void RenderCommandList::setModelMatrix(const glm::mat4& modelMat) {
+    this->push(SET_MODEL_MATRIX, mMatrices.size());
+    mMatrices.push_back(modelMat);
+}
+
+void RenderCommandList::drawIndexed(uint32_t instances) {
+    assert(mGeometry && "No geometry bound before drawing");
+    this->push(DRAW_INDEXED, instances);
+}
+
+const std::vector<RenderCommandList::Command>& RenderCommandList::getCommands() const { return mCommands; }
+const std::vector<glm::mat4>& RenderCommandList::getMatrices() const { return mMatrices; }
+uint32_t RenderCommandList::size() const { return mCommands.size(); }
+const RenderCommandList::Stats& RenderCommandList::getStats() const { return mStats; }
+
+RenderCommandExecutor::~RenderCommandExecutor() { }
+
+NullRenderCommandExecutor::NullRenderCommandExecutor() {
+    this->reset();
+}
+
+NullRenderCommandExecutor::~NullRenderCommandExecutor() {
+}
+
+void NullRenderCommandExecutor::execute(const RenderCommandList& commands) {
+    const std::vector<glm::mat4>& matrices = commands.getMatrices();
+    const std::vector<RenderCommandList::Command>& list = commands.getCommands();
+    for(std::vector<RenderCommandList::Command>::const_iterator iter = list.begin(); iter != list.end(); ++ iter) {
+        const RenderCommandList::Command& command = *iter;
+        ++ mExecuted[command.mOpcode];
+        switch(command.mOpcode) {
+            case RenderCommandList::SET_MODEL_MATRIX: {
+                const glm::mat4& modelMat = matrices[command.mArg];
+                mChecksum += modelMat[3][0] + modelMat[3][1] + modelMat[3][2];
+                break;
+            }
+            case RenderCommandList::DRAW_INDEXED: {
+                mInstances += command.mArg;
+                break;
+            }
+            default: break;
+        }
+    }
+}
+
+uint32_t NullRenderCommandExecutor::getNumExecuted(RenderCommandList::Opcode opcode) const {
+    assert(opcode < RenderCommandList::NUM_OPCODES && "Invalid opcode");
+    return mExecuted[opcode];
+}
+uint32_t NullRenderCommandExecutor::getNumInstances() const { return mInstances; }
+float NullRenderCommandExecutor::getChecksum() const { return mChecksum; }
+
+void NullRenderCommandExecutor::reset() {
+    for(uint32_t i = 0; i < RenderCommandList::NUM_OPCODES; ++ i) {
+        mExecuted[i] = 0;
+    }
+    mInstances = 0;
+    mChecksum = 0.f;
+}
+
+}
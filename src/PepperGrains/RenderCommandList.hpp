@@ -0,0 +1,142 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_RENDERCOMMANDLIST_HPP
+#define PGG_RENDERCOMMANDLIST_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+namespace pgg {
+
+class Geometry;
+
+/* Draw commands recorded during scene traversal, independent of any graphics API.
+ *
+ * Renderers record into a list and then hand it to a RenderCommandExecutor, which translates it into
+ * API calls. Since recording never touches the API, it can be run (and timed) against
+ * NullRenderCommandExecutor without a device or window.
+ *
+ * Binds which would not change anything are dropped while recording.
+ */
+class RenderCommandList {
+public:
+    enum Opcode {
+        BIND_PIPELINE,
+        BIND_GEOMETRY,
+        SET_MODEL_MATRIX,
+        DRAW_INDEXED,
+        
+        NUM_OPCODES
+    };
+    
+    struct Command {
+        Opcode mOpcode;
+        
+        // BIND_PIPELINE: pipeline id, as understood by the executor
+        // SET_MODEL_MATRIX: index into getMatrices()
+        // DRAW_INDEXED: instance count
+        uint32_t mArg;
+        
+        // BIND_GEOMETRY only
+        Geometry* mGeometry;
+    };
+    
+    struct Stats {
+        Stats();
+        
+        uint32_t mCommands[NUM_OPCODES];
+        
+        // Binds which were requested but not recorded because the same thing was already bound
+        uint32_t mRedundantBinds;
+        
+        Stats& operator+=(const Stats& other);
+    };
+    
+    RenderCommandList();
+    ~RenderCommandList();
+    
+private:
+    std::vector<Command> mCommands;
+    std::vector<glm::mat4> mMatrices;
+    
+    // What the most recently recorded commands left bound
+    bool mPipelineBound;
+    uint32_t mPipeline;
+    Geometry* mGeometry;
+    
+    Stats mStats;
+    
+    void push(Opcode opcode, uint32_t arg, Geometry* geometry = nullptr);
+    
+public:
+    // Empty the list, keeping its storage for the next frame
+    void clear();
+    
+    void bindPipeline(uint32_t pipeline);
+    void bindGeometry(Geometry* geometry);
+    
+    // Applies to all following draws
+    void setModelMatrix(const glm::mat4& modelMat);
+    
+    void drawIndexed(uint32_t instances = 1);
+    
+    const std::vector<Command>& getCommands() const;
+    const std::vector<glm::mat4>& getMatrices() const;
+    uint32_t size() const;
+    
+    // Statistics since the last clear()
+    const Stats& getStats() const;
+};
+
+class RenderCommandExecutor {
+public:
+    virtual ~RenderCommandExecutor();
+    
+    // Issue every command in the list, in order
+    virtual void execute(const RenderCommandList& commands) = 0;
+};
+
+/* Walks the list as a real executor would, reading every command and matrix, but calls nothing.
+ * Used to measure the CPU cost of preparing a frame.
+ */
+class NullRenderCommandExecutor : public RenderCommandExecutor {
+public:
+    NullRenderCommandExecutor();
+    ~NullRenderCommandExecutor();
+    
+private:
+    uint32_t mExecuted[RenderCommandList::NUM_OPCODES];
+    uint32_t mInstances;
+    
+    // Depends on all of the data read, so that none of the reading can be optimized away
+    float mChecksum;
+    
+public:
+    void execute(const RenderCommandList& commands);
+    
+    // Totals over every execute() since construction or the last reset()
+    uint32_t getNumExecuted(RenderCommandList::Opcode opcode) const;
+    uint32_t getNumInstances() const;
+    float getChecksum() const;
+    void reset();
+};
+
+}
+
+#endif // PGG_RENDERCOMMANDLIST_HPP
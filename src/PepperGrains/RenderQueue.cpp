@@ -0,0 +1,228 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "RenderQueue.hpp"
+
+#include <cstring>
+#include <utility>
+
+#include "GLStateCache.hpp"
+#include "Model.hpp"
+
+namespace pgg {
+
+RenderQueue::Stats::Stats()
+: mPackets(0)
+, mProgramBinds(0)
+, mMaterialBinds(0)
+, mGeometryBinds(0)
+, mDrawCalls(0)
+, mInstancedDraws(0) {
+}
+
+RenderQueue::Stats& RenderQueue::Stats::operator+=(const Stats& other) {
+    mPackets += other.mPackets;
+    mProgramBinds += other.mProgramBinds;
+    mMaterialBinds += other.mMaterialBinds;
+    mGeometryBinds += other.mGeometryBinds;
+    mDrawCalls += other.mDrawCalls;
+    mInstancedDraws += other.mInstancedDraws;
+    return *this;
+}
+
+RenderQueue::RenderQueue()
+: mClipRowZ(0.f)
+, mClipRowW(0.f, 0.f, 0.f, 1.f) {
+}
+
+RenderQueue::~RenderQueue() {
+}
+
+uint32_t RenderQueue::findId(std::unordered_map<const void*, uint32_t>& ids, const void* key, uint32_t maxId) {
+    if(!key) {
+        return 0;
+    }
+    std::unordered_map<const void*, uint32_t>::iterator iter = ids.find(key);
+    if(iter != ids.end()) {
+        return iter->second;
+    }
+
+    // Out of ids; start again. This only makes the ordering worse for a frame, since binding does not rely on ids
+    if(ids.size() >= maxId) {
+        ids.clear();
+    }
+    uint32_t id = ids.size() + 1;
+    ids[key] = id;
+    return id;
+}
+
+void RenderQueue::begin(const Renderable::Pass& rendPass) {
+    mPackets.clear();
+    mStats = Stats();
+
+    const glm::mat4& viewProj = rendPass.getConstants().mViewProjMatrix;
+    mClipRowZ = glm::vec4(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+    mClipRowW = glm::vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+}
+
+void RenderQueue::push(const Renderable::Pass& rendPass, Model* model, const glm::mat4& modelMat) {
+    Packet packet;
+    packet.mProgram = model->getProgramKey(rendPass);
+    if(!packet.mProgram) {
+        return;
+    }
+    packet.mMaterial = model->getMaterialKey(rendPass);
+    packet.mGeometry = model->getGeometryKey();
+    packet.mModel = model;
+    packet.mModelMat = &modelMat;
+
+    uint64_t programId = findId(mProgramIds, packet.mProgram, 0xFFF);
+    uint64_t materialId = findId(mMaterialIds, packet.mMaterial, 0xFFFF);
+    uint64_t geometryId = findId(mGeometryIds, packet.mGeometry, 0xFFFF);
+
+    // Front-to-back within the same state, using the model's origin
+    glm::vec4 origin = modelMat[3];
+    float clipW = glm::dot(mClipRowW, origin);
+    float depth = clipW > 0.f ? glm::dot(mClipRowZ, origin) / clipW * 0.5f + 0.5f : 0.f;
+    depth = depth < 0.f ? 0.f : (depth > 1.f ? 1.f : depth);
+    uint64_t depthBits = (uint64_t) (depth * 65535.f);
+
+    packet.mKey =
+        (((uint64_t) rendPass.mType & 0xF) << 60) |
+        (programId << 48) |
+        (materialId << 32) |
+        (geometryId << 16) |
+        depthBits;
+
+    mPackets.push_back(packet);
+}
+
+void RenderQueue::sort() {
+    uint32_t count = mPackets.size();
+    if(count < 2) {
+        return;
+    }
+    mSortBuffer.resize(count);
+
+    Packet* src = &mPackets[0];
+    Packet* dst = &mSortBuffer[0];
+    for(uint32_t shift = 0; shift < 64; shift += 8) {
+        uint32_t histogram[256];
+        std::memset(histogram, 0, sizeof(histogram));
+        for(uint32_t i = 0; i < count; ++ i) {
+            ++ histogram[(src[i].mKey >> shift) & 0xFF];
+        }
+
+        // Every key has the same digit, so this pass would not change the order
+        if(histogram[(src[0].mKey >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for(uint32_t i = 0; i < 256; ++ i) {
+            uint32_t digitCount = histogram[i];
+            histogram[i] = offset;
+            offset += digitCount;
+        }
+        for(uint32_t i = 0; i < count; ++ i) {
+            dst[histogram[(src[i].mKey >> shift) & 0xFF] ++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if(src != &mPackets[0]) {
+        mPackets.swap(mSortBuffer);
+    }
+}
+
+void RenderQueue::submit(const Renderable::Pass& rendPass) {
+    const void* program = nullptr;
+    const void* material = nullptr;
+    const void* geometry = nullptr;
+    uint32_t count = mPackets.size();
+    for(uint32_t i = 0; i < count; ) {
+        Packet& packet = mPackets[i];
+
+        // Changing a more significant part of the state invalidates everything less significant
+        bool bindProgram = i == 0 || packet.mProgram != program;
+        bool bindMaterial = bindProgram || packet.mMaterial != material;
+        bool bindGeometry = bindMaterial || packet.mGeometry != geometry;
+
+        if(bindProgram) {
+            packet.mModel->bindProgram(rendPass);
+            program = packet.mProgram;
+            ++ mStats.mProgramBinds;
+        }
+        if(bindMaterial) {
+            packet.mModel->bindMaterial(rendPass);
+            material = packet.mMaterial;
+            ++ mStats.mMaterialBinds;
+        }
+        if(bindGeometry) {
+            packet.mModel->bindGeometry();
+            geometry = packet.mGeometry;
+            ++ mStats.mGeometryBinds;
+        }
+
+        #ifdef PGG_OPENGL
+        if(packet.mModel->canDrawInstanced(rendPass)) {
+            // Sorting has already placed every draw with the same state next to each other
+            uint32_t runEnd = i + 1;
+            uint32_t maxEnd = i + mInstanceBuffer.getCapacity();
+            while(runEnd < count && runEnd < maxEnd
+                    && mPackets[runEnd].mProgram == program
+                    && mPackets[runEnd].mMaterial == material
+                    && mPackets[runEnd].mGeometry == geometry) {
+                ++ runEnd;
+            }
+
+            mInstanceMatrices.clear();
+            for(uint32_t j = i; j < runEnd; ++ j) {
+                mInstanceMatrices.push_back(mPackets[j].mModelMat);
+            }
+            uint32_t first = mInstanceBuffer.write(&mInstanceMatrices[0], mInstanceMatrices.size());
+            packet.mModel->drawInstanced(rendPass, mInstanceBuffer, first, mInstanceMatrices.size());
+            ++ mStats.mDrawCalls;
+            ++ mStats.mInstancedDraws;
+            this->invalidateGLState(rendPass, packet.mModel);
+            i = runEnd;
+            continue;
+        }
+        #endif
+
+        packet.mModel->draw(rendPass, *packet.mModelMat);
+        ++ mStats.mDrawCalls;
+        this->invalidateGLState(rendPass, packet.mModel);
+        ++ i;
+    }
+    mStats.mPackets += count;
+}
+
+void RenderQueue::invalidateGLState(const Renderable::Pass& rendPass, const Model* model) {
+    if(rendPass.mGLState && !model->usesGLStateCache()) {
+        rendPass.mGLState->invalidate();
+    }
+}
+
+uint32_t RenderQueue::size() const {
+    return mPackets.size();
+}
+
+const RenderQueue::Stats& RenderQueue::getStats() const {
+    return mStats;
+}
+
+}
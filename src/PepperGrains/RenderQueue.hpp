@@ -0,0 +1,125 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_RENDERQUEUE_HPP
+#define PGG_RENDERQUEUE_HPP
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+#include "InstanceBuffer.hpp"
+#include "Renderable.hpp"
+
+namespace pgg {
+
+class Model;
+
+/* Collects draws during scene traversal and submits them afterwards, in an order which minimizes state
+ * changes.
+ *
+ * Each draw is a packet with a 64-bit sort key. From most to least significant bits:
+ *      pass (4) | program (12) | material (16) | geometry (16) | depth (16)
+ * Programs, materials and geometry are identified by whatever the Model returns from its getXKey()
+ * methods; these are mapped to small integers which remain stable between frames.
+ *
+ * During submission, a Model's bindProgram(), bindMaterial() and bindGeometry() are only called when
+ * that part of the key differs from the previous draw. Consecutive draws which share all three are
+ * coalesced into a single instanced draw if the model supports it.
+ */
+class RenderQueue {
+public:
+    struct Stats {
+        Stats();
+
+        uint32_t mPackets;
+
+        // Number of times state was actually bound; without sorting, each of these would equal mPackets
+        uint32_t mProgramBinds;
+        uint32_t mMaterialBinds;
+        uint32_t mGeometryBinds;
+        
+        // Draw calls actually made; one instanced draw may cover many packets
+        uint32_t mDrawCalls;
+        uint32_t mInstancedDraws;
+
+        Stats& operator+=(const Stats& other);
+    };
+
+    RenderQueue();
+    ~RenderQueue();
+
+private:
+    struct Packet {
+        uint64_t mKey;
+        Model* mModel;
+        const glm::mat4* mModelMat;
+
+        // Ids in the key may be shared after running out of bits, so binding compares these instead
+        const void* mProgram;
+        const void* mMaterial;
+        const void* mGeometry;
+    };
+
+    std::vector<Packet> mPackets;
+    std::vector<Packet> mSortBuffer;
+
+    // Stable small integer identifiers for each kind of state; zero is reserved for "none"
+    std::unordered_map<const void*, uint32_t> mProgramIds;
+    std::unordered_map<const void*, uint32_t> mMaterialIds;
+    std::unordered_map<const void*, uint32_t> mGeometryIds;
+
+    // Rows of the view-projection matrix giving clip space z and w, for the depth part of the key
+    glm::vec4 mClipRowZ;
+    glm::vec4 mClipRowW;
+
+    Stats mStats;
+    
+    #ifdef PGG_OPENGL
+    InstanceBuffer mInstanceBuffer;
+    std::vector<const glm::mat4*> mInstanceMatrices;
+    #endif
+
+    static uint32_t findId(std::unordered_map<const void*, uint32_t>& ids, const void* key, uint32_t maxId);
+    
+    // Called after each draw, since the model may have changed GL state behind the cache's back
+    static void invalidateGLState(const Renderable::Pass& rendPass, const Model* model);
+
+public:
+    // Empty the queue, ready to be filled for the given pass
+    void begin(const Renderable::Pass& rendPass);
+
+    // Models which are not drawn in this pass (getProgramKey() returns nullptr) are ignored
+    // The model matrix is not copied, and must remain valid until after submit()
+    void push(const Renderable::Pass& rendPass, Model* model, const glm::mat4& modelMat);
+
+    // Least significant digit radix sort on the keys
+    void sort();
+
+    // Draw everything in the queue in order; requires a context if anything might be instanced
+    void submit(const Renderable::Pass& rendPass);
+
+    uint32_t size() const;
+
+    // Statistics for the most recent submit()
+    const Stats& getStats() const;
+};
+
+}
+
+#endif // PGG_RENDERQUEUE_HPP
@@ -20,49 +20,59 @@ namespace pgg {
 
 Renderable::Pass::Pass(Pass::Type renderPassType)
 : mType(renderPassType)
-, mAvailableFustrumAABB(false) {
+, mCullingEnabled(false)
+, mCullStats(nullptr)
+, mGLState(nullptr)
+, mConstantsValid(false) {
 }
 Renderable::Pass::~Pass() { }
 
-glm::vec2 Renderable::Pass::calcScreenSize() {
-    return glm::vec2((float) mScreenWidth, (float) mScreenHeight);
+void Renderable::Pass::updateConstants() {
+    this->calcConstants();
 }
 
-glm::vec2 Renderable::Pass::calcInvScreenSize() {
-    return glm::vec2(1.f / (float) mScreenWidth, 1.f / (float) mScreenHeight);
+void Renderable::Pass::calcConstants() const {
+    mConstants.mViewMatrix = mCamera.getViewMatrix();
+    mConstants.mProjMatrix = mCamera.getProjMatrix();
+    mConstants.mViewProjMatrix = mConstants.mProjMatrix * mConstants.mViewMatrix;
+    mConstants.mInvViewMatrix = glm::inverse(mConstants.mViewMatrix);
+    mConstants.mInvProjMatrix = glm::inverse(mConstants.mProjMatrix);
+    mConstants.mInvViewProjMatrix = mConstants.mInvViewMatrix * mConstants.mInvProjMatrix;
+    mConstants.mCameraLocation = glm::vec3(mConstants.mInvViewMatrix[3]);
+    mConstants.mCameraDirection = -glm::vec3(mConstants.mInvViewMatrix[2]);
+    mConstants.mScreenSize = this->calcScreenSize();
+    mConstants.mInvScreenSize = this->calcInvScreenSize();
+    mConstantsValid = true;
 }
 
-void Renderable::Pass::calcFustrumAABB() {
-    /*
-    glm::mat4 invVPMatrix = glm::inverse(projMat * viewMat);
+const Renderable::Pass::Constants& Renderable::Pass::getConstants() const {
+    if(!mConstantsValid) {
+        this->calcConstants();
+    }
+    return mConstants;
+}
 
-    for(uint8_t j = 0; j < 8; ++ j) {
-        glm::vec4 corner(
-            (j & (1 << 0)) ? -1.f : 1.f,
-            (j & (1 << 1)) ? -1.f : 1.f,
-            (j & (1 << 2)) ? -1.f : 1.f,
-            1.f
-        );
+glm::vec2 Renderable::Pass::calcScreenSize() const {
+    return glm::vec2((float) mScreenWidth, (float) mScreenHeight);
+}
 
-        glm::vec4 cornerWorldSpace = invVPMatrix * corner;
-        cornerWorldSpace /= cornerWorldSpace.w; // Perspective divide
+glm::vec2 Renderable::Pass::calcInvScreenSize() const {
+    return glm::vec2(1.f / (float) mScreenWidth, 1.f / (float) mScreenHeight);
+}
 
-        // cornerWorldSpace is a coordinate in world space for this corner of the view fustrum
+Renderable::Pass::CullStats::CullStats()
+: mSubtreesTested(0)
+, mSubtreesCulled(0)
+, mModelsTested(0)
+, mModelsCulled(0)
+, mModelsDrawn(0) {
+}
 
-        if(j == 0) {
-            minBB = glm::vec3(cornerWorldSpace);
-            maxBB = glm::vec3(cornerWorldSpace);
-        } else {
-            if(cornerWorldSpace.x < minBB.x) { minBB.x = cornerWorldSpace.x; }
-            if(cornerWorldSpace.y < minBB.y) { minBB.y = cornerWorldSpace.y; }
-            if(cornerWorldSpace.z < minBB.z) { minBB.z = cornerWorldSpace.z; }
-            if(cornerWorldSpace.x > maxBB.x) { maxBB.x = cornerWorldSpace.x; }
-            if(cornerWorldSpace.y > maxBB.y) { maxBB.y = cornerWorldSpace.y; }
-            if(cornerWorldSpace.z > maxBB.z) { maxBB.z = cornerWorldSpace.z; }
-        }
-    }
-    */
-    mAvailableFustrumAABB = true;
+void Renderable::Pass::enableCulling(CullStats* stats) {
+    this->updateConstants();
+    mFrustum.setViewProj(mConstants.mViewProjMatrix);
+    mCullStats = stats;
+    mCullingEnabled = true;
 }
 
 }
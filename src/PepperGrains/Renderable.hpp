@@ -19,11 +19,14 @@
 
 #include <GraphicsApiLibrary.hpp>
 
+#include "BoundingVolume.hpp"
 #include "HardValueStuff.hpp"
 #include "Camera.hpp"
 
 namespace pgg {
 
+class GLStateCache;
+
 class Renderable {
 public:
     // Might someday have different configs for different renderables
@@ -45,14 +48,50 @@ public:
         Type mType;
         
         Pass(Pass::Type renderPassType);
-        virtual ~Pass();
+        ~Pass();
         
         Camera mCamera;
         
-        void calcFustrumAABB();
+        // Values shared by every draw in the pass, so that they are only calculated once
+        struct Constants {
+            glm::mat4 mViewMatrix;
+            glm::mat4 mProjMatrix;
+            glm::mat4 mViewProjMatrix;
+            glm::mat4 mInvViewMatrix;
+            glm::mat4 mInvProjMatrix;
+            glm::mat4 mInvViewProjMatrix;
+            glm::vec3 mCameraLocation;
+            glm::vec3 mCameraDirection;
+            glm::vec2 mScreenSize;
+            glm::vec2 mInvScreenSize;
+        };
+        
+        // Recalculate the constants from mCamera and the screen size; call again after changing either
+        void updateConstants();
+        
+        // Calculated on first use if updateConstants() was never called
+        const Constants& getConstants() const;
+        
+        // Counts of what was culled during a single pass
+        struct CullStats {
+            CullStats();
+            
+            uint32_t mSubtreesTested;
+            uint32_t mSubtreesCulled;
+            uint32_t mModelsTested;
+            uint32_t mModelsCulled;
+            uint32_t mModelsDrawn;
+        };
+        
+        // Build the culling frustum from mCamera (also updates constants); stats are optional and accumulated into
+        void enableCulling(CullStats* stats = nullptr);
         
-        glm::vec2 calcScreenSize();
-        glm::vec2 calcInvScreenSize();
+        bool mCullingEnabled;
+        Frustum mFrustum;
+        CullStats* mCullStats;
+        
+        glm::vec2 calcScreenSize() const;
+        glm::vec2 calcInvScreenSize() const;
         
         uint32_t mScreenWidth;
         uint32_t mScreenHeight;
@@ -69,12 +108,16 @@ public:
         
         glm::mat4 mSunViewProjMatr[PGG_NUM_SUN_CASCADES];
         
-        bool mAvailableFustrumAABB;
-        glm::vec3 mMinBB;
-        glm::vec3 mMaxBB;
+        // Set by renderers which track GL state; models which use it return true from usesGLStateCache()
+        GLStateCache* mGLState;
+        
+    private:
+        mutable Constants mConstants;
+        mutable bool mConstantsValid;
+        void calcConstants() const;
     };
     
-    virtual void render(Renderable::Pass rendPass) = 0;
+    virtual void render(const Renderable::Pass& rendPass) = 0;
 };
 }
 
@@ -60,7 +60,12 @@ namespace Resources {
             } else if(resType == "shader-program") {
                 newRes = new ShaderProgramResource();
             } else if(resType == "image") {
-                newRes = new ImageResource();
+                ImageResource* image = new ImageResource();
+                image->setCompression(resourceData["compression"].asString());
+                image->setMipFilter(resourceData["mipFilter"].asString());
+                image->setColorSpace(resourceData["colorSpace"].asString());
+                image->setStreamable(resourceData.get("streamed", true).asBool());
+                newRes = image;
             } else if(resType == "texture") {
                 newRes = new TextureResource();
             } else if(resType == "model") {
@@ -33,12 +33,6 @@ public:
     ~RigidBodyEComp();
     
     
-    btQuaternion mRotation;
-    btVector3 mLocation;
-    btVector3 mVelocityLinear;
-    
-    bool mOnPhysUpdate;
-    
     const float mMass;
     
     btCollisionShape* mCollisionShape; // For deletion
@@ -18,29 +18,33 @@
 
 #include <algorithm>
 
-#include "PhysicsLocationUpdateESignal.hpp"
-#include "PhysicsOrientationUpdateESignal.hpp"
-
 namespace pgg {
 
-RigidBodyESys::RigidBodyMotionListener::RigidBodyMotionListener(const btTransform& initialLoc, RigidBodyEComp* const sendTo)
-: sendTo(sendTo),
-initialLoc(initialLoc) {
+RigidBodyESys::RigidBodyMotionListener::RigidBodyMotionListener(const btTransform& initialLoc)
+: mTransform(initialLoc) {
 }
 
 void RigidBodyESys::RigidBodyMotionListener::getWorldTransform(btTransform& worldTransform) const {
-    worldTransform = initialLoc;
+    worldTransform = mTransform;
 }
 
 void RigidBodyESys::RigidBodyMotionListener::setWorldTransform(const btTransform& worldTransform) {
-    sendTo->mRotation = worldTransform.getRotation();
-    sendTo->mLocation = worldTransform.getOrigin();
-    sendTo->mVelocityLinear = sendTo->mRigidBody->getLinearVelocity();
-    sendTo->mOnPhysUpdate = true;
+    mTransform = worldTransform;
+}
+
+void RigidBodyESys::PoseBatch::clear() {
+    mEntities.clear();
+    mLocations.clear();
+    mOrientations.clear();
+}
+
+std::size_t RigidBodyESys::PoseBatch::size() const {
+    return mEntities.size();
 }
 
 RigidBodyESys::RigidBodyESys(btDynamicsWorld* dynamicsWorld)
-: mDynamicsWorld(dynamicsWorld) {
+: mDynamicsWorld(dynamicsWorld)
+, mNumRemoved(0) {
     mRequiredComponents.push_back(RigidBodyEComp::sComponentID);
 }
 
@@ -53,7 +57,7 @@ void RigidBodyESys::onEntityExists(nres::Entity* entity) {
     btTransform trans;
     trans.setIdentity();
     trans.setOrigin(comp->mArgInitialLoc);
-    comp->mMotionState = new RigidBodyMotionListener(trans, comp);
+    comp->mMotionState = new RigidBodyMotionListener(trans);
     btVector3 inertia(0, 0, 0);
     comp->mCollisionShape->calculateLocalInertia(comp->mMass, inertia);
     comp->mRigidBody = new btRigidBody(comp->mMass, comp->mMotionState, comp->mCollisionShape, inertia);
@@ -61,15 +65,26 @@ void RigidBodyESys::onEntityExists(nres::Entity* entity) {
     mDynamicsWorld->addRigidBody(comp->mRigidBody);
     
     mTrackedEntities.push_back(entity);
+    mTrackedBodies.push_back(comp->mRigidBody);
 }
 void RigidBodyESys::onEntityDestroyed(nres::Entity* entity) {
     RigidBodyEComp* comp = (RigidBodyEComp*) entity->getComponent(RigidBodyEComp::sComponentID);
     
     mDynamicsWorld->removeRigidBody(comp->mRigidBody);
+    
+    // Swap-and-pop to keep both tracking lists parallel
+    std::vector<nres::Entity*>::iterator found = std::find(mTrackedEntities.begin(), mTrackedEntities.end(), entity);
+    if(found != mTrackedEntities.end()) {
+        std::size_t index = found - mTrackedEntities.begin();
+        mTrackedEntities[index] = mTrackedEntities.back();
+        mTrackedBodies[index] = mTrackedBodies.back();
+        mTrackedEntities.pop_back();
+        mTrackedBodies.pop_back();
+    }
+    ++ mNumRemoved;
+    
     delete comp->mMotionState;
     delete comp->mRigidBody;
-    
-    mTrackedEntities.erase(std::remove(mTrackedEntities.begin(), mTrackedEntities.end(), entity), mTrackedEntities.end());
 }
 void RigidBodyESys::onEntityBroadcast(nres::Entity* entity, const nres::EntitySignal* data) {
 }
@@ -77,19 +92,26 @@ const std::vector<nres::ComponentID>& RigidBodyESys::getRequiredComponents() {
     return mRequiredComponents;
 }
 
-void RigidBodyESys::onTick() {
-    for(std::vector<nres::Entity*>::iterator it = mTrackedEntities.begin(); it != mTrackedEntities.end(); ++ it) {
-        nres::Entity* entity = *it;
-        RigidBodyEComp* rigidBody = (RigidBodyEComp*) entity->getComponent(RigidBodyEComp::sComponentID);
+void RigidBodyESys::gatherActivePoses(PoseBatch& batch) const {
+    // Batch is expected to be reused between ticks, so clearing keeps its capacity
+    batch.clear();
+    batch.mNumRemoved = mNumRemoved;
+    
+    btTransform trans;
+    for(std::size_t i = 0; i < mTrackedBodies.size(); ++ i) {
+        const btRigidBody* body = mTrackedBodies[i];
         
-        if(rigidBody->mOnPhysUpdate) {
-            entity->broadcast(new PhysicsLocationUpdateESignal(rigidBody->mLocation));
-            entity->broadcast(new PhysicsOrientationUpdateESignal(rigidBody->mRotation));
-            
-            rigidBody->mOnPhysUpdate = false;
-        }
+        // Sleeping bodies did not move; static bodies never move
+        if(!body->isActive() || body->isStaticOrKinematicObject()) continue;
+        
+        body->getMotionState()->getWorldTransform(trans);
+        const btVector3& loc = trans.getOrigin();
+        btQuaternion rot = trans.getRotation();
+        
+        batch.mEntities.push_back(mTrackedEntities[i]);
+        batch.mLocations.push_back(glm::vec3(loc.x(), loc.y(), loc.z()));
+        batch.mOrientations.push_back(glm::quat(rot.w(), rot.x(), rot.y(), rot.z()));
     }
 }
 
 }
-
@@ -17,8 +17,14 @@
 #ifndef PGG_RIGIDBODYESYS_HPP
 #define PGG_RIGIDBODYESYS_HPP
 
+#include <stdint.h>
+#include <vector>
+
 #include "btBulletDynamicsCommon.h"
 
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
 #include "NRES.hpp"
 
 #include "RigidBodyEComp.hpp"
@@ -27,15 +33,30 @@ namespace pgg {
 
 class RigidBodyESys : public nres::System {
 public:
+    // Holds the (interpolated) transform Bullet last reported; read back during gatherActivePoses()
     class RigidBodyMotionListener : public btMotionState {
     protected:
-        btTransform initialLoc;
-        RigidBodyEComp* const sendTo;
+        btTransform mTransform;
     public:
-        RigidBodyMotionListener(const btTransform& initialLoc, RigidBodyEComp* const sendTo);
+        RigidBodyMotionListener(const btTransform& initialLoc);
         void getWorldTransform(btTransform& worldTransform) const;
         void setWorldTransform(const btTransform& worldTransform);
     };
+    
+    // Packed poses of every body that was awake during the last physics step
+    // Index i of each vector refers to the same body
+    struct PoseBatch {
+        std::vector<nres::Entity*> mEntities;
+        std::vector<glm::vec3> mLocations;
+        std::vector<glm::quat> mOrientations;
+        
+        // Bodies removed from the system before this batch was gathered; when this changes, entities in earlier
+        // batches may have been destroyed and their addresses reused
+        uint64_t mNumRemoved = 0;
+        
+        void clear();
+        std::size_t size() const;
+    };
 public:
     RigidBodyESys(btDynamicsWorld* dynamicsWorld);
     ~RigidBodyESys();
@@ -43,8 +64,13 @@ private:
     std::vector<nres::ComponentID> mRequiredComponents;
     std::vector<nres::Entity*> mTrackedEntities;
     
+    // Parallel to mTrackedEntities, avoids component lookup during gathering
+    std::vector<btRigidBody*> mTrackedBodies;
+    
     btDynamicsWorld* mDynamicsWorld;
     
+    uint64_t mNumRemoved;
+    
 public:
     void onEntityExists(nres::Entity* entity);
     void onEntityDestroyed(nres::Entity* entity);
@@ -52,7 +78,8 @@ public:
     
     const std::vector<nres::ComponentID>& getRequiredComponents();
     
-    void onTick();
+    // Fills the batch with the poses of all active bodies; sleeping bodies are skipped entirely
+    void gatherActivePoses(PoseBatch& batch) const;
 };
 
 }
@@ -66,44 +66,14 @@ void SSAOModel::SharedResources::load() {
         glBindTexture(GL_TEXTURE_2D, 0);
     }
     
-    {
-        const std::vector<ShaderProgramResource::Control>& sampler2DControls = mShaderProg->getUniformSampler2Ds();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = sampler2DControls.begin(); iter != sampler2DControls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "normal") {
-                mNormalHandle = entry.handle;
-            } else if(entry.name == "depth") {
-                mDepthHandle = entry.handle;
-            } else if(entry.name == "normalized2DNoise") {
-                mNoiseTextureHandle = entry.handle;
-            }
-        }
-        const std::vector<ShaderProgramResource::Control>& vec3Controls = mShaderProg->getUniformVec3s();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = vec3Controls.begin(); iter != vec3Controls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "ssaoKernel") {
-                mSSAOKernelHandle = entry.handle;
-            } else if(entry.name == "color") {
-                mColorHandle = entry.handle;
-            }
-        }
-        const std::vector<ShaderProgramResource::Control>& vec2Controls = mShaderProg->getUniformVec2s();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = vec2Controls.begin(); iter != vec2Controls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "normalized2DNoiseRatio") {
-                mNoiseRatioHandle = entry.handle;
-            }
-        }
-        const std::vector<ShaderProgramResource::Control>& floatControls = mShaderProg->getUniformFloats();
-        for(std::vector<ShaderProgramResource::Control>::const_iterator iter = floatControls.begin(); iter != floatControls.end(); ++ iter) {
-            const ShaderProgramResource::Control& entry = *iter;
-            if(entry.name == "nearPlane") {
-                mNearHandle = entry.handle;
-            } else if(entry.name == "farPlane") {
-                mFarHandle = entry.handle;
-            }
-        }
-    }
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "normal", mNormalHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "depth", mDepthHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_SAMPLER2D, "normalized2DNoise", mNoiseTextureHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_VEC3, "ssaoKernel", mSSAOKernelHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_VEC3, "color", mColorHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_VEC2, "normalized2DNoiseRatio", mNoiseRatioHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_FLOAT, "nearPlane", mNearHandle);
+    mShaderProg->findHandle(ShaderProgramResource::UNIFORM_FLOAT, "farPlane", mFarHandle);
     
     GLfloat vertices[] = {
         -1.f, -1.f,
@@ -146,14 +116,14 @@ void SSAOModel::SharedResources::unload() {
     glDeleteVertexArrays(1, &mScreenVao);
 }
 
-void SSAOModel::SharedResources::render(Renderable::Pass rendPass, const glm::mat4& modelMat, const glm::vec3& lightColor) {
+void SSAOModel::SharedResources::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat, const glm::vec3& lightColor) {
     if(rendPass.mType != Renderable::Pass::Type::GLOBAL_LIGHTS) {
         return;
     }
 
     glUseProgram(mShaderProg->getHandle());
     
-    mShaderProg->bindModelViewProjMatrices(glm::mat4(), rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(glm::mat4(), rendPass.getConstants());
     
     glUniform3fv(mSSAOKernelHandle, 64, mKernels.ssao);
     glUniform3fv(mColorHandle, 1, glm::value_ptr(lightColor));
@@ -201,7 +171,7 @@ void SSAOModel::unload() {
     mSharedRes->drop();
 }
 
-void SSAOModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void SSAOModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
     mSharedRes->render(rendPass, modelMat, mColor);
 }
 
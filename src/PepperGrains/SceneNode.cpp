@@ -17,24 +17,38 @@
 #include "SceneNode.hpp"
 
 #include <algorithm>
+#include <cassert>
 
 #include <OpenGLStuff.hpp>
 
+#include "GLStateCache.hpp"
+
 namespace pgg {
 
+TransformStore SceneNode::sTransforms;
+
 SceneNode::SceneNode()
-: mLocalTransformDirty(false)
-, mWorldTransformDirty(true)
+: mTransform(sTransforms.create())
 , mParent(nullptr)
 , mModelRes(nullptr)
-, mLocalScale(glm::vec3(1.f))
-, mLocalTranslation(glm::vec3(0.f))
 , mVisible(true) {
 }
 
 SceneNode::~SceneNode() {
     this->detachAllChildren();
     this->dropModel();
+    sTransforms.destroy(mTransform);
+}
+
+uint32_t SceneNode::updateAllTransforms() {
+    return sTransforms.updateAll();
+}
+TransformStore& SceneNode::getTransformStore() {
+    return sTransforms;
+}
+
+TransformStore::Handle SceneNode::getTransformHandle() const {
+    return mTransform;
 }
 
 void SceneNode::load() {
@@ -44,9 +58,9 @@ void SceneNode::unload() {
     delete this;
 }
 
-const glm::vec3& SceneNode::getLocalScale() const { return mLocalScale; }
-const glm::quat& SceneNode::getLocalOrientation() const { return mLocalOrientation; }
-const glm::vec3& SceneNode::getLocalTranslation() const { return mLocalTranslation; }
+const glm::vec3& SceneNode::getLocalScale() const { return sTransforms.getLocalScale(mTransform); }
+const glm::quat& SceneNode::getLocalOrientation() const { return sTransforms.getLocalOrientation(mTransform); }
+const glm::vec3& SceneNode::getLocalTranslation() const { return sTransforms.getLocalTranslation(mTransform); }
 SceneNode* SceneNode::getParent() const { return mParent; }
 const std::vector<SceneNode*>& SceneNode::getChildren() const { return mChildren; }
 
@@ -57,7 +71,8 @@ SceneNode* SceneNode::addChild(SceneNode* child) {
 
     // If the child had a previous parent, then remove child from parent's child list
     if(child->mParent) {
-        child->mParent->mChildren.erase(std::remove(mChildren.begin(), mChildren.end(), child), mChildren.end());
+        std::vector<SceneNode*>& siblings = child->mParent->mChildren;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), child), siblings.end());
         // No need to change child's reference count, as ownership is being transfered
         // Also an increment may not be possible after a decrement since the reference count could drop to zero
     }
@@ -68,7 +83,7 @@ SceneNode* SceneNode::addChild(SceneNode* child) {
 
     mChildren.push_back(child);
     child->mParent = this;
-    child->markWorldTransformDirty();
+    sTransforms.setParent(child->mTransform, mTransform);
     
     return child;
 }
@@ -78,59 +93,34 @@ SceneNode* SceneNode::newChild() {
 void SceneNode::detachChild(SceneNode* child) {
     mChildren.erase(std::remove(mChildren.begin(), mChildren.end(), child), mChildren.end());
     child->mParent = nullptr;
-    child->markWorldTransformDirty();
+    sTransforms.setParent(child->mTransform, TransformStore::sNullHandle);
     child->drop();
 }
 void SceneNode::detachAllChildren() {
     for(std::vector<SceneNode*>::iterator iter = mChildren.begin(); iter != mChildren.end(); ++ iter) {
         SceneNode* child = *iter;
         child->mParent = nullptr;
-        child->markWorldTransformDirty();
+        sTransforms.setParent(child->mTransform, TransformStore::sNullHandle);
         child->drop();
     }
     mChildren.clear();
 }
 
 const glm::mat4& SceneNode::calcLocalTransform() {
-    if(!mLocalTransformDirty) {
-        return mLocalTransform;
-    }
-
-    mLocalTransform =
-        glm::translate(glm::mat4(1.f), mLocalTranslation) *
-        glm::mat4_cast(mLocalOrientation) *
-        glm::scale(glm::mat4(1.f), mLocalScale);
-
-    mLocalTransformDirty = false;
-    mWorldTransformDirty = true;
-
-    return mLocalTransform;
+    return sTransforms.calcLocalTransform(mTransform);
 }
 const glm::mat4& SceneNode::calcWorldTransform() {
-    if(!mWorldTransformDirty) {
-        return mWorldTransform;
-    }
-
-    this->calcLocalTransform();
-
-    if(mParent) {
-        mWorldTransform = mParent->calcWorldTransform() * mLocalTransform;
-    } else {
-        mWorldTransform = mLocalTransform;
-    }
-
-    mWorldTransformDirty = false;
-
-    return mWorldTransform;
+    return sTransforms.calcWorldTransform(mTransform);
 }
 
 SceneNode* SceneNode::calcWorldScale(glm::vec3& scale) {
+    const glm::vec3& localScale = sTransforms.getLocalScale(mTransform);
     if(mParent) {
         const glm::mat4& parentTransform = mParent->calcWorldTransform();
-        scale = glm::vec3(parentTransform * glm::vec4(mLocalScale, 0.f));
+        scale = glm::vec3(parentTransform * glm::vec4(localScale, 0.f));
     }
     else {
-        scale = mLocalScale;
+        scale = localScale;
     }
     return this;
 }
@@ -140,17 +130,18 @@ SceneNode* SceneNode::calcWorldOrientation(glm::quat& orientation) {
         orientation = glm::quat_cast(this->calcWorldTransform());
     }
     else {
-        orientation = mLocalOrientation;
+        orientation = sTransforms.getLocalOrientation(mTransform);
     }
     return this;
 }
 SceneNode* SceneNode::calcWorldTranslation(glm::vec3& translation) {
+    const glm::vec3& localTranslation = sTransforms.getLocalTranslation(mTransform);
     if(mParent) {
         const glm::mat4& parentTransform = mParent->calcWorldTransform();
-        translation = glm::vec3(parentTransform * glm::vec4(mLocalTranslation, 1.f));
+        translation = glm::vec3(parentTransform * glm::vec4(localTranslation, 1.f));
     }
     else {
-        translation = mLocalTranslation;
+        translation = localTranslation;
     }
     return this;
 }
@@ -161,18 +152,20 @@ glm::vec3 SceneNode::calcWorldTranslation() {
 }
 
 SceneNode* SceneNode::setLocalScale(const glm::vec3& scale) {
-    mLocalScale = scale;
-    this->markBothTransformsDirty();
+    sTransforms.setLocalScale(mTransform, scale);
     return this;
 }
 SceneNode* SceneNode::setLocalOrientation(const glm::quat& orientation) {
-    mLocalOrientation = orientation;
-    this->markBothTransformsDirty();
+    sTransforms.setLocalOrientation(mTransform, orientation);
     return this;
 }
 SceneNode* SceneNode::setLocalTranslation(const glm::vec3& translation) {
-    mLocalTranslation = translation;
-    this->markBothTransformsDirty();
+    sTransforms.setLocalTranslation(mTransform, translation);
+    return this;
+}
+
+SceneNode* SceneNode::setLocalTranslationOrientation(const glm::vec3& translation, const glm::quat& orientation) {
+    sTransforms.setLocalTranslationOrientation(mTransform, translation, orientation);
     return this;
 }
 
@@ -183,73 +176,47 @@ SceneNode* SceneNode::resetLocalTransform() {
 }
 
 SceneNode* SceneNode::scale(const glm::vec3& scale) {
-    mLocalScale *= scale;
-    this->markBothTransformsDirty();
+    sTransforms.setLocalScale(mTransform, sTransforms.getLocalScale(mTransform) * scale);
     return this;
 }
 SceneNode* SceneNode::scale(const float& scale) {
-    mLocalScale *= scale;
-    this->markBothTransformsDirty();
+    sTransforms.setLocalScale(mTransform, sTransforms.getLocalScale(mTransform) * scale);
     return this;
 }
 SceneNode* SceneNode::rotate(const glm::quat& rotation) {
-    mLocalOrientation = rotation * mLocalOrientation;
-    this->markBothTransformsDirty();
+    sTransforms.setLocalOrientation(mTransform, rotation * sTransforms.getLocalOrientation(mTransform));
     return this;
 }
 SceneNode* SceneNode::rotate(const glm::vec3& axis, const float& radians) {
-    mLocalOrientation = glm::angleAxis(radians, axis) * mLocalOrientation;
-    this->markBothTransformsDirty();
-    return this;
+    return this->rotate(glm::angleAxis(radians, axis));
 }
 SceneNode* SceneNode::rotatePitch(const float& radians) {
-    this->rotate(glm::vec3(1.f, 0.f, 0.f), radians);
-    this->markBothTransformsDirty();
-    return this;
+    return this->rotate(glm::vec3(1.f, 0.f, 0.f), radians);
 }
 SceneNode* SceneNode::rotateYaw(const float& radians) {
-    this->rotate(glm::vec3(0.f, 1.f, 0.f), radians);
-    this->markBothTransformsDirty();
-    return this;
+    return this->rotate(glm::vec3(0.f, 1.f, 0.f), radians);
 }
 SceneNode* SceneNode::rotateRoll(const float& radians) {
-    this->rotate(glm::vec3(0.f, 0.f, 1.f), radians);
-    this->markBothTransformsDirty();
-    return this;
+    return this->rotate(glm::vec3(0.f, 0.f, 1.f), radians);
 }
 SceneNode* SceneNode::move(const glm::vec3& translation) {
-    mLocalTranslation += translation;
-    this->markBothTransformsDirty();
+    sTransforms.setLocalTranslation(mTransform, sTransforms.getLocalTranslation(mTransform) + translation);
     return this;
 }
-void SceneNode::markWorldTransformDirty() {
-    // Avoid unnecessary tree iteration
-    if(mWorldTransformDirty) {
-        return;
-    }
-
-    mWorldTransformDirty = true;
-    for(std::vector<SceneNode*>::iterator iter = mChildren.begin(); iter != mChildren.end(); ++ iter) {
-        SceneNode* child = *iter;
-        child->markWorldTransformDirty();
-    }
-}
-void SceneNode::markBothTransformsDirty() {
-    mLocalTransformDirty = true;
-    this->markWorldTransformDirty();
-}
 
 SceneNode* SceneNode::grabModel(Model* model) {
     this->dropModel();
 
     mModelRes = model;
     mModelRes->grab();
+    sTransforms.setLocalBounds(mTransform, mModelRes->getGeometry()->getBoundingSphere());
     return this;
 }
 SceneNode* SceneNode::dropModel() {
     if(mModelRes) {
         mModelRes->drop();
         mModelRes = nullptr;
+        sTransforms.setLocalBounds(mTransform, BoundingSphere::getEmpty());
     }
     return this;
 }
@@ -258,21 +225,124 @@ SceneNode* SceneNode::setVisible(const bool& visibility) {
     mVisible = visibility;
 }
 
-void SceneNode::render(Renderable::Pass rendPass) {
+void SceneNode::render(const Renderable::Pass& rendPass) {
+    this->renderCulled(rendPass, !rendPass.mCullingEnabled, nullptr);
+}
+
+void SceneNode::enqueue(RenderQueue& queue, const Renderable::Pass& rendPass) {
+    this->renderCulled(rendPass, !rendPass.mCullingEnabled, &queue);
+}
+
+void SceneNode::renderCulled(const Renderable::Pass& rendPass, bool insideFrustum, RenderQueue* queue) {
     if(!mVisible) {
         return;
     }
     
-    this->calcWorldTransform();
+    Renderable::Pass::CullStats* stats = rendPass.mCullStats;
+    
+    // Bounds include all descendants, so this may skip the entire subtree
+    if(!insideFrustum) {
+        if(stats) ++ stats->mSubtreesTested;
+        Frustum::Result result = rendPass.mFrustum.testSphere(sTransforms.getSubtreeBounds(mTransform));
+        if(result == Frustum::OUTSIDE) {
+            if(stats) ++ stats->mSubtreesCulled;
+            return;
+        }
+        insideFrustum = result == Frustum::INSIDE;
+    }
+    
+    // World transforms are precomputed by updateAllTransforms() before any pass is rendered
+    const glm::mat4& worldTransform = sTransforms.getWorldTransform(mTransform);
 
     if(mModelRes) {
-        mModelRes->render(rendPass, mWorldTransform);
+        // The box is tighter than the sphere, so it is worth testing separately
+        bool visible = insideFrustum;
+        if(!visible) {
+            if(stats) ++ stats->mModelsTested;
+            visible = rendPass.mFrustum.testBox(mModelRes->getGeometry()->getBoundingBox(), worldTransform);
+            if(!visible && stats) ++ stats->mModelsCulled;
+        }
+        if(visible) {
+            if(queue) {
+                queue->push(rendPass, mModelRes, worldTransform);
+            } else {
+                mModelRes->render(rendPass, worldTransform);
+                if(rendPass.mGLState && !mModelRes->usesGLStateCache()) rendPass.mGLState->invalidate();
+            }
+            if(stats) ++ stats->mModelsDrawn;
+        }
     }
 
     // Render all children
     for(std::vector<SceneNode*>::iterator iter = mChildren.begin(); iter != mChildren.end(); ++ iter) {
         SceneNode* child = *iter;
-        child->render(rendPass);
+        child->renderCulled(rendPass, insideFrustum, queue);
+    }
+}
+
+void SceneNode::collectVisible(const Frustum* volumes, uint32_t numVolumes, std::vector<SceneNode*>* visible, Renderable::Pass::CullStats* stats) {
+    assert(numVolumes <= 32 && "Too many volumes");
+    uint32_t allVolumes = numVolumes == 32 ? 0xFFFFFFFF : (1u << numVolumes) - 1;
+    this->collectVisible(volumes, allVolumes, 0, visible, stats);
+}
+
+void SceneNode::collectVisible(const Frustum* volumes, uint32_t testMask, uint32_t insideMask, std::vector<SceneNode*>* visible, Renderable::Pass::CullStats* stats) {
+    if(!mVisible) {
+        return;
+    }
+    
+    // Narrow down which volumes could contain anything in this subtree
+    const BoundingSphere& subtreeBounds = sTransforms.getSubtreeBounds(mTransform);
+    for(uint32_t i = 0; i < 32 && (testMask >> i); ++ i) {
+        if(!(testMask & (1u << i))) continue;
+        if(stats) ++ stats[i].mSubtreesTested;
+        Frustum::Result result = volumes[i].testSphere(subtreeBounds);
+        if(result == Frustum::OUTSIDE) {
+            testMask &= ~(1u << i);
+            if(stats) ++ stats[i].mSubtreesCulled;
+        }
+        else if(result == Frustum::INSIDE) {
+            testMask &= ~(1u << i);
+            insideMask |= 1u << i;
+        }
+    }
+    if(!testMask && !insideMask) {
+        return;
+    }
+    
+    if(mModelRes) {
+        const BoundingBox& box = mModelRes->getGeometry()->getBoundingBox();
+        const glm::mat4& worldTransform = sTransforms.getWorldTransform(mTransform);
+        for(uint32_t i = 0; i < 32 && ((testMask | insideMask) >> i); ++ i) {
+            bool overlaps = insideMask & (1u << i);
+            if(!overlaps && (testMask & (1u << i))) {
+                if(stats) ++ stats[i].mModelsTested;
+                overlaps = volumes[i].testBox(box, worldTransform);
+                if(!overlaps && stats) ++ stats[i].mModelsCulled;
+            }
+            if(overlaps) {
+                visible[i].push_back(this);
+                if(stats) ++ stats[i].mModelsDrawn;
+            }
+        }
+    }
+    
+    for(std::vector<SceneNode*>::iterator iter = mChildren.begin(); iter != mChildren.end(); ++ iter) {
+        SceneNode* child = *iter;
+        child->collectVisible(volumes, testMask, insideMask, visible, stats);
+    }
+}
+
+void SceneNode::renderModel(const Renderable::Pass& rendPass) {
+    if(mModelRes) {
+        mModelRes->render(rendPass, sTransforms.getWorldTransform(mTransform));
+        if(rendPass.mGLState && !mModelRes->usesGLStateCache()) rendPass.mGLState->invalidate();
+    }
+}
+
+void SceneNode::enqueueModel(RenderQueue& queue, const Renderable::Pass& rendPass) {
+    if(mModelRes) {
+        queue.push(rendPass, mModelRes, sTransforms.getWorldTransform(mTransform));
     }
 }
 
@@ -27,6 +27,8 @@
 #include "Model.hpp"
 #include "ReferenceCounted.hpp"
 #include "Renderable.hpp"
+#include "RenderQueue.hpp"
+#include "TransformStore.hpp"
 
 namespace pgg {
 
@@ -37,17 +39,12 @@ public:
     SceneNode();
     ~SceneNode();
 private:
-    glm::vec3 mLocalScale;
-    glm::quat mLocalOrientation;
-    glm::vec3 mLocalTranslation;
-
+    // All scene node transforms live together in one flat store; a SceneNode is just a handle into it
+    static TransformStore sTransforms;
+    
     // Local transform is this scene node's transform relative to its parent's
-    glm::mat4 mLocalTransform;
-    bool mLocalTransformDirty;
-
     // World transform is this scene node's transform applied to its parent's (recursively)
-    glm::mat4 mWorldTransform;
-    bool mWorldTransformDirty;
+    const TransformStore::Handle mTransform;
     
     // Skip rendering when false
     bool mVisible;
@@ -77,6 +74,14 @@ public:
 
     const glm::mat4& calcLocalTransform();
     const glm::mat4& calcWorldTransform();
+    
+    // Brings the world transforms of every scene node up to date, splitting the work across the job pool
+    // Must be called before rendering; returns the number of world transforms that were recalculated
+    static uint32_t updateAllTransforms();
+    static TransformStore& getTransformStore();
+    
+    // This node's transform within getTransformStore()
+    TransformStore::Handle getTransformHandle() const;
 
     SceneNode* getParent() const;
     const std::vector<SceneNode*>& getChildren() const;
@@ -93,6 +98,9 @@ public:
     SceneNode* setLocalScale(const glm::vec3& scale);
     SceneNode* setLocalOrientation(const glm::quat& orientation);
     SceneNode* setLocalTranslation(const glm::vec3& translation);
+    
+    // Sets both at once, marking transforms dirty only a single time (e.g. for physics updates)
+    SceneNode* setLocalTranslationOrientation(const glm::vec3& translation, const glm::quat& orientation);
 
     // Same as above, but is relative to previous transform
     SceneNode* scale(const glm::vec3& scale);
@@ -110,12 +118,28 @@ public:
     
     SceneNode* setVisible(const bool& visibility);
 
-    // Calculates world transform (which becomes the model matrix) and then renders
-    void render(Renderable::Pass rendPass);
-
+    // Renders this node and its children using the world transforms from updateAllTransforms()
+    // If culling is enabled for the pass, whole subtrees outside of the frustum are skipped
+    void render(const Renderable::Pass& rendPass);
+    
+    // Same as render(), but pushes visible models onto the queue to be sorted and drawn later
+    void enqueue(RenderQueue& queue, const Renderable::Pass& rendPass);
+    
+    // Tests this subtree against several volumes (at most 32) in a single traversal, appending every node
+    // whose model overlaps volumes[i] to visible[i]; stats may be nullptr, otherwise one per volume
+    void collectVisible(const Frustum* volumes, uint32_t numVolumes, std::vector<SceneNode*>* visible, Renderable::Pass::CullStats* stats);
+    
+    // Renders only the model attached to this node, without children or culling
+    void renderModel(const Renderable::Pass& rendPass);
+    void enqueueModel(RenderQueue& queue, const Renderable::Pass& rendPass);
+    
 private:
-    void markWorldTransformDirty();
-    void markBothTransformsDirty();
+    // insideFrustum is true when an ancestor was found to be entirely inside, so no more tests are needed
+    // Models are drawn immediately if queue is nullptr
+    void renderCulled(const Renderable::Pass& rendPass, bool insideFrustum, RenderQueue* queue);
+    
+    // Bit i of testMask is set if volumes[i] still needs testing; of insideMask if it contains this subtree
+    void collectVisible(const Frustum* volumes, uint32_t testMask, uint32_t insideMask, std::vector<SceneNode*>* visible, Renderable::Pass::CullStats* stats);
 };
 
 }
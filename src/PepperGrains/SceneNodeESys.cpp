@@ -25,7 +25,8 @@
 namespace pgg {
 
 SceneNodeESys::SceneNodeESys(SceneNode* rootNode)
-: mRootNode(rootNode) {
+: mPoseNumRemoved(0)
+, mRootNode(rootNode) {
     mRequiredComponents.push_back(SceneNodeEComp::sComponentID);
 }
 
@@ -44,6 +45,10 @@ void SceneNodeESys::onEntityExists(nres::Entity* entity) {
 void SceneNodeESys::onEntityDestroyed(nres::Entity* entity) {
     SceneNodeEComp* comp = (SceneNodeEComp*) entity->getComponent(SceneNodeEComp::sComponentID);
     comp->mSceneNode->drop();
+    
+    // A new entity could take this one's place in memory
+    mPoseEntities.clear();
+    mPoseTransforms.clear();
 }
 void SceneNodeESys::onEntityBroadcast(nres::Entity* entity, const ESignal* data) {
     ESignal::Type type = data->getType();
@@ -77,4 +82,28 @@ void SceneNodeESys::onTick(const float& tps) {
     
 }
 
+void SceneNodeESys::applyPhysicsPoses(const RigidBodyESys::PoseBatch& batch) {
+    if(batch.mNumRemoved != mPoseNumRemoved) {
+        mPoseNumRemoved = batch.mNumRemoved;
+        mPoseEntities.clear();
+        mPoseTransforms.clear();
+    }
+    
+    const std::size_t numPoses = batch.size();
+    mPoseEntities.resize(numPoses, nullptr);
+    mPoseTransforms.resize(numPoses, TransformStore::sNullHandle);
+    for(std::size_t i = 0; i < numPoses; ++ i) {
+        nres::Entity* entity = batch.mEntities[i];
+        if(mPoseEntities[i] == entity) continue;
+        mPoseEntities[i] = entity;
+        
+        // Entity may have a rigid body without being visible
+        SceneNodeEComp* comp = (SceneNodeEComp*) entity->getComponent(SceneNodeEComp::sComponentID);
+        mPoseTransforms[i] = comp ? comp->mSceneNode->getTransformHandle() : TransformStore::sNullHandle;
+    }
+    
+    SceneNode::getTransformStore().setLocalTranslationsOrientations(
+        mPoseTransforms.data(), batch.mLocations.data(), batch.mOrientations.data(), numPoses);
+}
+
 }
@@ -19,6 +19,7 @@
 
 #include "NRES.hpp" // Base class: nres::System
 
+#include "RigidBodyESys.hpp"
 #include "SceneNode.hpp"
 
 namespace pgg {
@@ -30,6 +31,15 @@ public:
 private:
     std::vector<nres::ComponentID> mRequiredComponents;
     std::vector<nres::Entity*> mTrackedEntities;
+    
+    // Parallel to the last pose batch: which entity each entry was, and that entity's scene node transform
+    // Bodies stay in the same order while awake, so only entries which changed need a component lookup
+    std::vector<nres::Entity*> mPoseEntities;
+    std::vector<TransformStore::Handle> mPoseTransforms;
+    
+    // PoseBatch::mNumRemoved of the last batch; rigid bodies without a scene node are destroyed without this
+    // system hearing about it, so the batch says when entity addresses may have been reused
+    uint64_t mPoseNumRemoved;
 public:
     SceneNode* const mRootNode;
     
@@ -40,6 +50,9 @@ public:
     const std::vector<nres::ComponentID>& getRequiredComponents();
     
     void onTick(const float& tps);
+    
+    // Writes the poses of all bodies that moved into the transform store in one batch
+    void applyPhysicsPoses(const RigidBodyESys::PoseBatch& batch);
 };
 
 }
@@ -17,6 +17,7 @@
 #include "ShaderProgramResource.hpp"
 
 #include <cassert>
+#include <cstring>
 #include <sstream>
 #include <iostream>
 #include <fstream>
@@ -24,12 +25,15 @@
 #include <json/json.h>
 
 #include "Logger.hpp"
+#include "MathUtil.hpp"
 #include "Resources.hpp"
 
 namespace pgg {
 
 ShaderProgramResource::ShaderProgramResource()
 : mLoaded(false)
+, mUseInstancedModelMatrix(false)
+, mPassMatricesUploaded(false)
 , Resource(Resource::Type::SHADER_PROGRAM) {
 }
 
@@ -159,22 +163,22 @@ void ShaderProgramResource::loadError() {
     mNormalAttrib = glGetAttribLocation(mShaderProg, "iNormal");
                 
     // Setup uniform matrices
-    mUseMMat = true;
+    mModelUniforms.mUseMMat = true;
     mUseVMat = true;
     mUsePMat = true;
-    mMMatUnif = glGetUniformLocation(mShaderProg, "uModel");
+    mModelUniforms.mMMatUnif = glGetUniformLocation(mShaderProg, "uModel");
     mVMatUnif = glGetUniformLocation(mShaderProg, "uView");
     mPMatUnif = glGetUniformLocation(mShaderProg, "uProj");
     
-    mUseMVMat = false;
+    mModelUniforms.mUseMVMat = false;
     mUseVPMat = false;
-    mUseMVPMat = false;
-    mUseIMMat = false;
+    mModelUniforms.mUseMVPMat = false;
+    mModelUniforms.mUseIMMat = false;
     mUseIVMat = false;
     mUseIPMat = false;
-    mUseIMVMat = false;
+    mModelUniforms.mUseIMVMat = false;
     mUseIVPMat = false;
-    mUseIMVPMat = false;
+    mModelUniforms.mUseIMVPMat = false;
         
     // Setup controls
     Control control;
@@ -353,7 +357,7 @@ void ShaderProgramResource::load() {
     {
         const Json::Value& passUniforms = progData["pass-uniforms"];
         if(passUniforms.isNull()) {
-            mUseMMat = false;
+            mModelUniforms.mUseMMat = false;
             mUseVMat = false;
             mUsePMat = false;
         }
@@ -376,8 +380,8 @@ void ShaderProgramResource::load() {
             const Json::Value& camLoc = passUniforms["cameraLocation"];
             const Json::Value& camDir = passUniforms["cameraDirection"];
 
-            if(mMat.isNull()) { mUseMMat = false; } else { mUseMMat = true;
-                mMMatUnif = glGetUniformLocation(mShaderProg, mMat.asString().c_str());
+            if(mMat.isNull()) { mModelUniforms.mUseMMat = false; } else { mModelUniforms.mUseMMat = true;
+                mModelUniforms.mMMatUnif = glGetUniformLocation(mShaderProg, mMat.asString().c_str());
             }
             if(vMat.isNull()) { mUseVMat = false; } else { mUseVMat = true;
                 mVMatUnif = glGetUniformLocation(mShaderProg, vMat.asString().c_str());
@@ -385,17 +389,17 @@ void ShaderProgramResource::load() {
             if(pMat.isNull()) { mUsePMat = false; } else { mUsePMat = true;
                 mPMatUnif = glGetUniformLocation(mShaderProg, pMat.asString().c_str());
             }
-            if(mvMat.isNull()) { mUseMVMat = false; } else { mUseMVMat = true;
-                mMVMatUnif = glGetUniformLocation(mShaderProg, mvMat.asString().c_str());
+            if(mvMat.isNull()) { mModelUniforms.mUseMVMat = false; } else { mModelUniforms.mUseMVMat = true;
+                mModelUniforms.mMVMatUnif = glGetUniformLocation(mShaderProg, mvMat.asString().c_str());
             }
             if(vpMat.isNull()) { mUseVPMat = false; } else { mUseVPMat = true;
                 mVPMatUnif = glGetUniformLocation(mShaderProg, vpMat.asString().c_str());
             }
-            if(mvpMat.isNull()) { mUseMVPMat = false; } else { mUseMVPMat = true;
-                mMVPMatUnif = glGetUniformLocation(mShaderProg, mvpMat.asString().c_str());
+            if(mvpMat.isNull()) { mModelUniforms.mUseMVPMat = false; } else { mModelUniforms.mUseMVPMat = true;
+                mModelUniforms.mMVPMatUnif = glGetUniformLocation(mShaderProg, mvpMat.asString().c_str());
             }
-            if(imMat.isNull()) { mUseIMMat = false; } else { mUseIMMat = true;
-                mIMMatUnif = glGetUniformLocation(mShaderProg, imMat.asString().c_str());
+            if(imMat.isNull()) { mModelUniforms.mUseIMMat = false; } else { mModelUniforms.mUseIMMat = true;
+                mModelUniforms.mIMMatUnif = glGetUniformLocation(mShaderProg, imMat.asString().c_str());
             }
             if(ivMat.isNull()) { mUseIVMat = false; } else { mUseIVMat = true;
                 mIVMatUnif = glGetUniformLocation(mShaderProg, ivMat.asString().c_str());
@@ -403,14 +407,14 @@ void ShaderProgramResource::load() {
             if(ipMat.isNull()) { mUseIPMat = false; } else { mUseIPMat = true;
                 mIPMatUnif = glGetUniformLocation(mShaderProg, ipMat.asString().c_str());
             }
-            if(imvMat.isNull()) { mUseIMVMat = false; } else { mUseIMVMat = true;
-                mIMVMatUnif = glGetUniformLocation(mShaderProg, imvMat.asString().c_str());
+            if(imvMat.isNull()) { mModelUniforms.mUseIMVMat = false; } else { mModelUniforms.mUseIMVMat = true;
+                mModelUniforms.mIMVMatUnif = glGetUniformLocation(mShaderProg, imvMat.asString().c_str());
             }
             if(ivpMat.isNull()) { mUseIVPMat = false; } else { mUseIVPMat = true;
                 mIVPMatUnif = glGetUniformLocation(mShaderProg, ivpMat.asString().c_str());
             }
-            if(imvpMat.isNull()) { mUseIMVPMat = false; } else { mUseIMVPMat = true;
-                mIMVPMatUnif = glGetUniformLocation(mShaderProg, imvpMat.asString().c_str());
+            if(imvpMat.isNull()) { mModelUniforms.mUseIMVPMat = false; } else { mModelUniforms.mUseIMVPMat = true;
+                mModelUniforms.mIMVPMatUnif = glGetUniformLocation(mShaderProg, imvpMat.asString().c_str());
             }
             if(svpMat.isNull()) { mUseSunViewProjMatrix = false; } else { mUseSunViewProjMatrix = true;
                 mSunViewProjMatrixUnif = glGetUniformLocation(mShaderProg, svpMat.asString().c_str());
@@ -544,6 +548,16 @@ void ShaderProgramResource::load() {
                 }
             }
         }
+        
+        mUseInstancedModelMatrix = false;
+        for(std::vector<Control>::iterator iter = mInstancedMat4s.begin(); iter != mInstancedMat4s.end(); ++ iter) {
+            const Control& control = *iter;
+            if(control.name == "model") {
+                mUseInstancedModelMatrix = true;
+                mInstancedModelMatrixAttrib = control.handle;
+                break;
+            }
+        }
     }
 
     // Setup controls
@@ -663,7 +677,11 @@ void ShaderProgramResource::load() {
     }
     
     #endif
+    
+    this->buildControlIndex();
 
+    // A newly linked program has none of the cached matrices uploaded
+    mPassMatricesUploaded = false;
     mLoaded = true;
 }
 
@@ -689,100 +707,139 @@ void ShaderProgramResource::unload() {
         ShaderResource* shader = *iter;
         shader->drop();
     }
+    mLinkedShaders.clear();
+    
+    // Controls are found again on the next load
+    for(int type = 0; type < NUM_CONTROL_TYPES; ++ type) {
+        this->getControlVector((ControlType) type).clear();
+    }
+    mControlIndex.clear();
 
     mLoaded = false;
 }
 
-void ShaderProgramResource::bindModelViewProjMatrices(const glm::mat4& mMat, const glm::mat4& vMat, const glm::mat4& pMat) const {
-    #ifdef PGG_OPENGL
-    if(mUseMMat) {
-        glUniformMatrix4fv(mMMatUnif, 1, GL_FALSE, glm::value_ptr(mMat));
+bool ShaderProgramResource::needsPassMatrixUpload(const glm::mat4& viewMat, const glm::mat4& projMat) const {
+    // Uniform values stay with the program, so there is nothing to do if these were the last ones uploaded
+    if(mPassMatricesUploaded
+            && std::memcmp(glm::value_ptr(viewMat), glm::value_ptr(mCachedVMat), sizeof(glm::mat4)) == 0
+            && std::memcmp(glm::value_ptr(projMat), glm::value_ptr(mCachedPMat), sizeof(glm::mat4)) == 0) {
+        return false;
     }
+    mCachedVMat = viewMat;
+    mCachedPMat = projMat;
+    mPassMatricesUploaded = true;
+    return true;
+}
+void ShaderProgramResource::uploadPassMatrices() const {
+    #ifdef PGG_OPENGL
     if(mUseVMat) {
-        glUniformMatrix4fv(mVMatUnif, 1, GL_FALSE, glm::value_ptr(vMat));
+        glUniformMatrix4fv(mVMatUnif, 1, GL_FALSE, glm::value_ptr(mCachedVMat));
     }
     if(mUsePMat) {
-        glUniformMatrix4fv(mPMatUnif, 1, GL_FALSE, glm::value_ptr(pMat));
-    }
-    if(mUseMVMat) {
-        glUniformMatrix4fv(mMVMatUnif, 1, GL_FALSE, glm::value_ptr(vMat * mMat));
+        glUniformMatrix4fv(mPMatUnif, 1, GL_FALSE, glm::value_ptr(mCachedPMat));
     }
     if(mUseVPMat) {
-        glUniformMatrix4fv(mVPMatUnif, 1, GL_FALSE, glm::value_ptr(pMat * vMat));
-    }
-    if(mUseMVPMat) {
-        glUniformMatrix4fv(mMVPMatUnif, 1, GL_FALSE, glm::value_ptr(pMat * vMat * mMat));
-    }
-    if(mUseIMMat) {
-        glUniformMatrix4fv(mIMMatUnif, 1, GL_FALSE, glm::value_ptr(glm::inverse(mMat)));
+        glUniformMatrix4fv(mVPMatUnif, 1, GL_FALSE, glm::value_ptr(mCachedVPMat));
     }
     if(mUseIVMat) {
-        glUniformMatrix4fv(mIVMatUnif, 1, GL_FALSE, glm::value_ptr(glm::inverse(vMat)));
+        glUniformMatrix4fv(mIVMatUnif, 1, GL_FALSE, glm::value_ptr(mCachedIVMat));
     }
     if(mUseIPMat) {
-        glUniformMatrix4fv(mIPMatUnif, 1, GL_FALSE, glm::value_ptr(glm::inverse(pMat)));
-    }
-    if(mUseIMVMat) {
-        glUniformMatrix4fv(mIMVMatUnif, 1, GL_FALSE, glm::value_ptr(glm::inverse(vMat * mMat)));
+        glUniformMatrix4fv(mIPMatUnif, 1, GL_FALSE, glm::value_ptr(mCachedIPMat));
     }
     if(mUseIVPMat) {
-        glUniformMatrix4fv(mIVPMatUnif, 1, GL_FALSE, glm::value_ptr(glm::inverse(pMat * vMat)));
-    }
-    if(mUseIMVPMat) {
-        glUniformMatrix4fv(mIMVPMatUnif, 1, GL_FALSE, glm::value_ptr(glm::inverse(pMat * vMat * mMat)));
+        glUniformMatrix4fv(mIVPMatUnif, 1, GL_FALSE, glm::value_ptr(mCachedIVPMat));
     }
     #endif
 }
-void ShaderProgramResource::bindRenderPass(Renderable::Pass rpc, const glm::mat4& modelMat) const {
-    bindModelViewProjMatrices(modelMat, rpc.mCamera.getViewMatrix(), rpc.mCamera.getProjMatrix());
+void ShaderProgramResource::uploadModelMatrices(const glm::mat4& modelMat) const {
+    #ifdef PGG_OPENGL
+    mModelUniforms.upload(modelMat, mCachedVMat, mCachedVPMat, mCachedIVMat, mCachedIVPMat,
+        [](GLuint location, const glm::mat4& matrix) {
+            glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+        });
+    #endif
+}
+void ShaderProgramResource::bindModelViewProjMatrices(const glm::mat4& mMat, const glm::mat4& vMat, const glm::mat4& pMat) const {
+    if(this->needsPassMatrixUpload(vMat, pMat)) {
+        // Derived matrices are only calculated when they are needed, either directly or for a per-draw product
+        if(mUseVPMat || mModelUniforms.mUseMVPMat) {
+            Math::multiplyMatrices(pMat, vMat, mCachedVPMat);
+        }
+        if(mUseIVMat || mUseIVPMat || mModelUniforms.mUseIMVMat || mModelUniforms.mUseIMVPMat) {
+            mCachedIVMat = glm::inverse(vMat);
+        }
+        if(mUseIPMat || mUseIVPMat || mModelUniforms.mUseIMVPMat) {
+            mCachedIPMat = glm::inverse(pMat);
+        }
+        if(mUseIVPMat || mModelUniforms.mUseIMVPMat) {
+            Math::multiplyMatrices(mCachedIVMat, mCachedIPMat, mCachedIVPMat);
+        }
+        this->uploadPassMatrices();
+    }
+    this->uploadModelMatrices(mMat);
+}
+void ShaderProgramResource::bindModelViewProjMatrices(const glm::mat4& modelMat, const Renderable::Pass::Constants& constants) const {
+    if(this->needsPassMatrixUpload(constants.mViewMatrix, constants.mProjMatrix)) {
+        mCachedVPMat = constants.mViewProjMatrix;
+        mCachedIVMat = constants.mInvViewMatrix;
+        mCachedIPMat = constants.mInvProjMatrix;
+        mCachedIVPMat = constants.mInvViewProjMatrix;
+        this->uploadPassMatrices();
+    }
+    this->uploadModelMatrices(modelMat);
+}
+void ShaderProgramResource::bindRenderPass(const Renderable::Pass& rpc, const glm::mat4& modelMat) const {
+    const Renderable::Pass::Constants& constants = rpc.getConstants();
+    bindModelViewProjMatrices(modelMat, constants);
     #ifdef PGG_OPENGL
     if(mUseScreenSize) {
-        glUniform2fv(mScreenSizeUnif, 1, glm::value_ptr(rpc.calcScreenSize()));
+        glUniform2fv(mScreenSizeUnif, 1, glm::value_ptr(constants.mScreenSize));
     }
     if(mUseIScreenSize) {
-        glUniform2fv(mIScreenSizeUnif, 1, glm::value_ptr(rpc.calcInvScreenSize()));
+        glUniform2fv(mIScreenSizeUnif, 1, glm::value_ptr(constants.mInvScreenSize));
     }
     if(mUseCameraLoc) {
-        glUniform3fv(mCameraLocUnif, 1, glm::value_ptr(rpc.mCamera.calcLocation()));
+        glUniform3fv(mCameraLocUnif, 1, glm::value_ptr(constants.mCameraLocation));
     }
     if(mUseCameraDir) {
-        glUniform3fv(mCameraDirUnif, 1, glm::value_ptr(rpc.mCamera.calcDirection()));
+        glUniform3fv(mCameraDirUnif, 1, glm::value_ptr(constants.mCameraDirection));
     }
     #endif
 }
 
 GLuint ShaderProgramResource::getHandle() const { return mShaderProg; }
 
-bool ShaderProgramResource::needsModelMatrix() const { return mUseMMat; }
+bool ShaderProgramResource::needsModelMatrix() const { return mModelUniforms.mUseMMat; }
 bool ShaderProgramResource::needsViewMatrix() const { return mUseVMat; }
 bool ShaderProgramResource::needsProjMatrix() const { return mUsePMat; }
-bool ShaderProgramResource::needsModelViewMatrix() const { return mUseMVMat; }
+bool ShaderProgramResource::needsModelViewMatrix() const { return mModelUniforms.mUseMVMat; }
 bool ShaderProgramResource::needsViewProjMatrix() const { return mUseVPMat; }
-bool ShaderProgramResource::needsModelViewProjMatrix() const { return mUseMVPMat; }
-bool ShaderProgramResource::needsInvModelMatrix() const { return mUseIMMat; }
+bool ShaderProgramResource::needsModelViewProjMatrix() const { return mModelUniforms.mUseMVPMat; }
+bool ShaderProgramResource::needsInvModelMatrix() const { return mModelUniforms.mUseIMMat; }
 bool ShaderProgramResource::needsInvViewMatrix() const { return mUseIVMat; }
 bool ShaderProgramResource::needsInvProjMatrix() const { return mUseIPMat; }
-bool ShaderProgramResource::needsInvModelViewMatrix() const { return mUseIMVMat; }
+bool ShaderProgramResource::needsInvModelViewMatrix() const { return mModelUniforms.mUseIMVMat; }
 bool ShaderProgramResource::needsInvViewProjMatrix() const { return mUseIVPMat; }
-bool ShaderProgramResource::needsInvModelViewProjMatrix() const { return mUseIMVPMat; }
+bool ShaderProgramResource::needsInvModelViewProjMatrix() const { return mModelUniforms.mUseIMVPMat; }
 bool ShaderProgramResource::needsSunViewProjMatrix() const { return mUseSunViewProjMatrix; }
 bool ShaderProgramResource::needsScreenSize() const { return mUseScreenSize; }
 bool ShaderProgramResource::needsInvScreenSize() const { return mUseIScreenSize; }
 bool ShaderProgramResource::needsCameraLocation() const { return mUseCameraLoc; }
 bool ShaderProgramResource::needsCameraDirection() const { return mUseCameraDir; }
 
-GLuint ShaderProgramResource::getModelMatrixUnif() const { return mMMatUnif; }
+GLuint ShaderProgramResource::getModelMatrixUnif() const { return mModelUniforms.mMMatUnif; }
 GLuint ShaderProgramResource::getViewMatrixUnif() const { return mVMatUnif; }
 GLuint ShaderProgramResource::getProjMatrixUnif() const { return mPMatUnif; }
-GLuint ShaderProgramResource::getModelViewMatrixUnif() const { return mMVMatUnif; }
+GLuint ShaderProgramResource::getModelViewMatrixUnif() const { return mModelUniforms.mMVMatUnif; }
 GLuint ShaderProgramResource::getViewProjMatrixUnif() const { return mVPMatUnif; }
-GLuint ShaderProgramResource::getModelViewProjMatrixUnif() const { return mMVPMatUnif; }
-GLuint ShaderProgramResource::getInvModelMatrixUnif() const { return mIMMatUnif; }
+GLuint ShaderProgramResource::getModelViewProjMatrixUnif() const { return mModelUniforms.mMVPMatUnif; }
+GLuint ShaderProgramResource::getInvModelMatrixUnif() const { return mModelUniforms.mIMMatUnif; }
 GLuint ShaderProgramResource::getInvViewMatrixUnif() const { return mIVMatUnif; }
 GLuint ShaderProgramResource::getInvProjMatrixUnif() const { return mIPMatUnif; }
-GLuint ShaderProgramResource::getInvModelViewMatrixUnif() const { return mIMVMatUnif; }
+GLuint ShaderProgramResource::getInvModelViewMatrixUnif() const { return mModelUniforms.mIMVMatUnif; }
 GLuint ShaderProgramResource::getInvViewProjMatrixUnif() const { return mIVPMatUnif; }
-GLuint ShaderProgramResource::getInvModelViewProjMatrixUnif() const { return mIMVPMatUnif; }
+GLuint ShaderProgramResource::getInvModelViewProjMatrixUnif() const { return mModelUniforms.mIMVPMatUnif; }
 GLuint ShaderProgramResource::getSunViewProjMatrixUnif() const { return mSunViewProjMatrixUnif; }
 GLuint ShaderProgramResource::getScreenSizeUnif() const { return mScreenSizeUnif; }
 GLuint ShaderProgramResource::getInvScreenSizeUnif() const { return mIScreenSizeUnif; }
@@ -803,6 +860,71 @@ GLuint ShaderProgramResource::getNormalAttrib() const { return mNormalAttrib; }
 GLuint ShaderProgramResource::getTangentAttrib() const { return mTangentAttrib; }
 GLuint ShaderProgramResource::getBitangentAttrib() const { return mBitangentAttrib; }
 
+std::vector<ShaderProgramResource::Control>& ShaderProgramResource::getControlVector(ControlType type) {
+    switch(type) {
+        case UNIFORM_SAMPLER2D: return mUniformSampler2Ds;
+        case UNIFORM_FLOAT: return mUniformFloats;
+        case UNIFORM_INT: return mUniformInts;
+        case UNIFORM_UINT: return mUniformUints;
+        case UNIFORM_VEC2: return mUniformVec2s;
+        case UNIFORM_VEC3: return mUniformVec3s;
+        case UNIFORM_VEC4: return mUniformVec4s;
+        case UNIFORM_MAT4: return mUniformMat4s;
+        case INSTANCED_SAMPLER2D: return mInstancedSampler2Ds;
+        case INSTANCED_FLOAT: return mInstancedFloats;
+        case INSTANCED_INT: return mInstancedInts;
+        case INSTANCED_UINT: return mInstancedUints;
+        case INSTANCED_VEC2: return mInstancedVec2s;
+        case INSTANCED_VEC3: return mInstancedVec3s;
+        case INSTANCED_VEC4: return mInstancedVec4s;
+        default: return mInstancedMat4s;
+    }
+}
+
+void ShaderProgramResource::buildControlIndex() {
+    mControlIndex.clear();
+    for(uint32_t type = 0; type < NUM_CONTROL_TYPES; ++ type) {
+        const std::vector<Control>& controls = this->getControlVector((ControlType) type);
+        for(std::vector<Control>::const_iterator iter = controls.begin(); iter != controls.end(); ++ iter) {
+            const Control& control = *iter;
+            uint64_t key = ((uint64_t) type << 32) | hashName(control.name.c_str());
+            
+            // The first control keeps the name, matching what a linear search would have found
+            if(!mControlIndex.insert(std::make_pair(key, &control)).second) {
+                Logger::log(Logger::WARN) << "Control name " << control.name << " in " << this->getName() << " collides with " << mControlIndex[key]->name << std::endl;
+            }
+        }
+    }
+}
+
+const ShaderProgramResource::Control* ShaderProgramResource::findControl(ControlType type, NameHash name) const {
+    std::unordered_map<uint64_t, const Control*>::const_iterator iter = mControlIndex.find(((uint64_t) type << 32) | name);
+    return iter == mControlIndex.end() ? nullptr : iter->second;
+}
+
+const ShaderProgramResource::Control* ShaderProgramResource::findControl(ControlType type, const std::string& name) const {
+    const Control* control = this->findControl(type, hashName(name.c_str()));
+    return control && control->name == name ? control : nullptr;
+}
+
+bool ShaderProgramResource::findHandle(ControlType type, NameHash name, GLuint& handle) const {
+    const Control* control = this->findControl(type, name);
+    if(control) {
+        handle = control->handle;
+        return true;
+    }
+    return false;
+}
+
+bool ShaderProgramResource::findHandle(ControlType type, const std::string& name, GLuint& handle) const {
+    const Control* control = this->findControl(type, name);
+    if(control) {
+        handle = control->handle;
+        return true;
+    }
+    return false;
+}
+
 const std::vector<ShaderProgramResource::Control>& ShaderProgramResource::getUniformSampler2Ds() const { return mUniformSampler2Ds; }
 const std::vector<ShaderProgramResource::Control>& ShaderProgramResource::getUniformFloats() const { return mUniformFloats; }
 const std::vector<ShaderProgramResource::Control>& ShaderProgramResource::getUniformInts() const { return mUniformInts; }
@@ -820,4 +942,7 @@ const std::vector<ShaderProgramResource::Control>& ShaderProgramResource::getIns
 const std::vector<ShaderProgramResource::Control>& ShaderProgramResource::getInstancedVec4s() const { return mInstancedVec4s; }
 const std::vector<ShaderProgramResource::Control>& ShaderProgramResource::getInstancedMat4s() const { return mInstancedMat4s; }
 
+bool ShaderProgramResource::needsInstancedModelMatrix() const { return mUseInstancedModelMatrix; }
+GLuint ShaderProgramResource::getInstancedModelMatrixAttrib() const { return mInstancedModelMatrixAttrib; }
+
 }
@@ -17,11 +17,14 @@
 #ifndef PGG_ShaderProgramResource_HPP
 #define PGG_ShaderProgramResource_HPP
 
+#include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <GraphicsApiLibrary.hpp>
 
+#include "ModelMatrixUniforms.hpp"
 #include "Renderable.hpp"
 #include "Resource.hpp"
 #include "ShaderResource.hpp"
@@ -34,6 +37,45 @@ public:
         std::string name;
         GLuint handle;
     };
+    
+    // Each type of control has its own set of names
+    enum ControlType {
+        UNIFORM_SAMPLER2D,
+        UNIFORM_FLOAT,
+        UNIFORM_INT,
+        UNIFORM_UINT,
+        UNIFORM_VEC2,
+        UNIFORM_VEC3,
+        UNIFORM_VEC4,
+        UNIFORM_MAT4,
+        
+        INSTANCED_SAMPLER2D,
+        INSTANCED_FLOAT,
+        INSTANCED_INT,
+        INSTANCED_UINT,
+        INSTANCED_VEC2,
+        INSTANCED_VEC3,
+        INSTANCED_VEC4,
+        INSTANCED_MAT4,
+        
+        NUM_CONTROL_TYPES
+    };
+    
+    // 32-bit FNV-1a hash of a control name; constexpr so that literal names are hashed at compile time
+    typedef uint32_t NameHash;
+    static constexpr NameHash hashName(const char* name, NameHash hash = 2166136261u) {
+        return *name ? hashName(name + 1, (hash ^ (uint8_t) *name) * 16777619u) : hash;
+    }
+    
+    /* Constant time lookup of a control by name hash, using an index built when the program is loaded.
+     * Returns nullptr if there is no such control; findHandle() only writes to handle if there is.
+     * The hash overloads trust the hash alone. The name overloads also compare the name, so a different
+     * control whose name happens to share the hash is never returned; prefer them outside of hot paths.
+     */
+    const Control* findControl(ControlType type, NameHash name) const;
+    const Control* findControl(ControlType type, const std::string& name) const;
+    bool findHandle(ControlType type, NameHash name, GLuint& handle) const;
+    bool findHandle(ControlType type, const std::string& name, GLuint& handle) const;
 
     const std::vector<Control>& getUniformSampler2Ds() const;
     const std::vector<Control>& getUniformFloats() const;
@@ -77,6 +119,11 @@ private:
     std::vector<Control> mInstancedVec3s;
     std::vector<Control> mInstancedVec4s;
     std::vector<Control> mInstancedMat4s;
+    
+    // Key is the control type in the upper 32 bits and the name hash in the lower
+    std::unordered_map<uint64_t, const Control*> mControlIndex;
+    std::vector<Control>& getControlVector(ControlType type);
+    void buildControlIndex();
 
     /*
      * Model
@@ -98,41 +145,48 @@ private:
     
     // Note to self: do not name any member variables mMat
     
-    bool mUseMMat;
+    // Model, ModelView, ModelViewProj and their inverses
+    ModelMatrixUniforms mModelUniforms;
+    
     bool mUseVMat;
     bool mUsePMat;
-    bool mUseMVMat;
     bool mUseVPMat;
-    bool mUseMVPMat;
-    bool mUseIMMat;
     bool mUseIVMat;
     bool mUseIPMat;
-    bool mUseIMVMat;
     bool mUseIVPMat;
-    bool mUseIMVPMat;
     bool mUseSunViewProjMatrix;
     bool mUseScreenSize;
     bool mUseIScreenSize;
     bool mUseCameraLoc;
     bool mUseCameraDir;
     
-    GLuint mMMatUnif;
     GLuint mVMatUnif;
     GLuint mPMatUnif;
-    GLuint mMVMatUnif;
     GLuint mVPMatUnif;
-    GLuint mMVPMatUnif;
-    GLuint mIMMatUnif;
     GLuint mIVMatUnif;
     GLuint mIPMatUnif;
-    GLuint mIMVMatUnif;
     GLuint mIVPMatUnif;
-    GLuint mIMVPMatUnif;
     GLuint mSunViewProjMatrixUnif;
     GLuint mScreenSizeUnif;
     GLuint mIScreenSizeUnif;
     GLuint mCameraLocUnif;
     GLuint mCameraDirUnif;
+    
+    /* View and projection matrices most recently uploaded to this program, along with whichever derived
+     * matrices are used. Uniforms keep their values between draws, so these are only uploaded again when
+     * the view or projection changes. Setting those uniforms by other means bypasses this.
+     */
+    mutable bool mPassMatricesUploaded;
+    mutable glm::mat4 mCachedVMat;
+    mutable glm::mat4 mCachedPMat;
+    mutable glm::mat4 mCachedVPMat;
+    mutable glm::mat4 mCachedIVMat;
+    mutable glm::mat4 mCachedIPMat;
+    mutable glm::mat4 mCachedIVPMat;
+    
+    bool needsPassMatrixUpload(const glm::mat4& viewMat, const glm::mat4& projMat) const;
+    void uploadPassMatrices() const;
+    void uploadModelMatrices(const glm::mat4& modelMat) const;
 
     bool mUsePosAttrib;
     GLuint mPosAttrib;
@@ -152,6 +206,10 @@ private:
     bool mUseBitangentAttrib;
     GLuint mBitangentAttrib;
     
+    // Instanced mat4 named "model", which takes the place of the model matrix uniform
+    bool mUseInstancedModelMatrix;
+    GLuint mInstancedModelMatrixAttrib;
+    
     //void loadError();
     //void unloadError();
     //bool mIsErrorResource;
@@ -166,7 +224,10 @@ public:
     static ShaderProgramResource* getFallback();
     
     void bindModelViewProjMatrices(const glm::mat4& modelMat, const glm::mat4& viewMat, const glm::mat4& projMat) const;
-    void bindRenderPass(Renderable::Pass rpc, const glm::mat4& modelMat) const;
+    
+    // Same as above, but reuses the matrices which were already calculated for the pass
+    void bindModelViewProjMatrices(const glm::mat4& modelMat, const Renderable::Pass::Constants& constants) const;
+    void bindRenderPass(const Renderable::Pass& rpc, const glm::mat4& modelMat) const;
     
     void load();
     void unload();
@@ -221,6 +282,9 @@ public:
     GLuint getNormalAttrib() const;
     GLuint getTangentAttrib() const;
     GLuint getBitangentAttrib() const;
+    
+    bool needsInstancedModelMatrix() const;
+    GLuint getInstancedModelMatrixAttrib() const;
 
 };
 
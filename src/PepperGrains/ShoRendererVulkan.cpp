@@ -21,12 +21,15 @@
 #include "Image.hpp"
 #include "ImageResource.hpp"
 #include "TextureResource.hpp"
+#include "TextureStreamerVulkan.hpp"
+#include "TransferBatcherVulkan.hpp"
 #include "Resources.hpp"
 #include "Video.hpp"
 #include "Logger.hpp"
 #include "VulkanUtils.hpp"
 #include "GeometryResource.hpp"
 #include "Engine.hpp"
+#include "Jobs.hpp"
 
 namespace pgg {
 
@@ -53,9 +56,11 @@ bool ShoRendererVk::initialize() {
         initializeDepthBuffer() && 
         initializeRenderpass() && 
         initializeFramebuffers() && 
-        initializeSemaphores() && 
+        initializeShaders() && 
         setupTestGeometry() && 
-        initializePipeline();
+        initializePipelineLayout() && 
+        initializePipeline() && 
+        initializeFramesInFlight();
 }
 
 bool ShoRendererVk::initializeDepthBuffer() {
@@ -92,7 +97,7 @@ bool ShoRendererVk::initializeDepthBuffer() {
         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         &mDepthImage,
-        &mDepthImageMemory
+        &mDepthImageAllocation
         );
     Video::Vulkan::Utils::imageViewCreate(
         mDepthImage, 
@@ -115,9 +120,11 @@ bool ShoRendererVk::initializeRenderpass() {
     
     VkResult result;
     
+    mColorFormat = Video::Vulkan::getSwapchainFormat();
+    
     VkAttachmentDescription colorAttachDesc; {
         colorAttachDesc.flags = 0;
-        colorAttachDesc.format = Video::Vulkan::getSwapchainFormat();
+        colorAttachDesc.format = mColorFormat;
         colorAttachDesc.samples = VK_SAMPLE_COUNT_1_BIT;
         //colorAttachDesc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -166,14 +173,15 @@ bool ShoRendererVk::initializeRenderpass() {
         subpassDesc.pPreserveAttachments = nullptr;
     }
     
+    // The depth image is shared by every frame in flight, so depth tests must also wait for the previous frame's
     VkSubpassDependency subpassDep; {
         subpassDep.dependencyFlags = 0;
         subpassDep.srcSubpass = VK_SUBPASS_EXTERNAL;
         subpassDep.dstSubpass = 0;
-        subpassDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpassDep.srcAccessMask = 0;
-        subpassDep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpassDep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        subpassDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subpassDep.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        subpassDep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        subpassDep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     }
     
     std::array<VkAttachmentDescription, 2> attachments = {
@@ -214,20 +222,6 @@ bool ShoRendererVk::initializeFramebuffers() {
     
     mFramebufferSquads.resize(Video::Vulkan::getSwapchainImageViews().size());
     
-    std::vector<VkCommandBuffer> commandBuffers(mFramebufferSquads.size(), VK_NULL_HANDLE);
-    VkCommandBufferAllocateInfo cbaArgs; {
-        cbaArgs.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        cbaArgs.pNext = nullptr;
-        cbaArgs.commandPool = Video::Vulkan::getGraphicsCommandPool();
-        cbaArgs.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        cbaArgs.commandBufferCount = commandBuffers.size();
-    }
-    result = vkAllocateCommandBuffers(Video::Vulkan::getLogicalDevice(), &cbaArgs, commandBuffers.data());
-    if(result != VK_SUCCESS) {
-        sout << "Could not allocate command buffers" << std::endl;
-        return false;
-    }
-    
     for(uint32_t index = 0; index < Video::Vulkan::getSwapchainImageViews().size(); ++ index) {
         // Must be reference because data is being modified
         FramebufferSquad& stuff = mFramebufferSquads[index];
@@ -235,7 +229,8 @@ bool ShoRendererVk::initializeFramebuffers() {
         std::array<VkImageView, 2> imgViewAttachments = {
             Video::Vulkan::getSwapchainImageViews().at(index),
             
-            // The one depth image can be shared because only one subpass can run at a time
+            // The one depth image can be shared because only one subpass can run at a time (the render pass's
+            // external dependency keeps frames in flight from overlapping on it)
             mDepthImageView
         };
         
@@ -259,67 +254,17 @@ bool ShoRendererVk::initializeFramebuffers() {
             sout << "Could not create framebuffer #" << index << std::endl;
             return false;
         }
-        
-        stuff.mGraphicsCmdBuffer = commandBuffers[index];
-    }
-    
-    VkSemaphoreCreateInfo semaphoreCargs; {
-        semaphoreCargs.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-        semaphoreCargs.pNext = nullptr;
-        semaphoreCargs.flags = 0;
-    }
-    VkFenceCreateInfo fenceCargs; {
-        fenceCargs.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceCargs.pNext = nullptr;
-        fenceCargs.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    }
-    
-    
-    // Must iterate by reference; modifying values
-    for(FramebufferSquad& squad : mFramebufferSquads) {
-        result = vkCreateSemaphore(Video::Vulkan::getLogicalDevice(), &semaphoreCargs, nullptr, &(squad.mSemRenderFinished));
-        if(result != VK_SUCCESS) {
-            sout << "Could not create render completion semaphore" << std::endl;
-            return false;
-        }
-        result = vkCreateFence(Video::Vulkan::getLogicalDevice(), &fenceCargs, nullptr, &(squad.mFenceRenderFinished));
-        if(result != VK_SUCCESS) {
-            sout << "Could not create render completion fence" << std::endl;
-            return false;
-        }
-    }
-    
-    mAllFenceRenderFinished.reserve(mFramebufferSquads.size());
-    for(FramebufferSquad squad : mFramebufferSquads) {
-        if(squad.mFenceRenderFinished == VK_NULL_HANDLE) {
-            sout << "Framebuffer group's render finishing fence is null" << std::endl;
-            return false;
-        }
-        mAllFenceRenderFinished.push_back(squad.mFenceRenderFinished);
     }
     
     return true;
 }
 
-bool ShoRendererVk::initializeSemaphores() {
-
-    Logger::Out iout = Logger::log(Logger::INFO);
-    Logger::Out vout = Logger::log(Logger::VERBOSE);
-    Logger::Out sout = Logger::log(Logger::SEVERE);
-    
-    VkResult result;
-    
-    VkSemaphoreCreateInfo whyVulkan; {
-        whyVulkan.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-        whyVulkan.pNext = nullptr;
-        whyVulkan.flags = 0;
-    }
-    
-    result = vkCreateSemaphore(Video::Vulkan::getLogicalDevice(), &whyVulkan, nullptr, &mSemImageAvailable);
-    if(result != VK_SUCCESS) {
-        sout << "Could not create image availability semaphore" << std::endl;
-        return false;
-    }
+bool ShoRendererVk::initializeShaders() {
+    // Held for as long as the renderer, since their modules are part of the pipeline cache's keys
+    mShaderVertex = ShaderResource::gallop(Resources::find("TestShader2.vertexShader"));
+    mShaderVertex->grab();
+    mShaderFragment = ShaderResource::gallop(Resources::find("TestShader2.fragmentShader"));
+    mShaderFragment->grab();
     
     return true;
 }
@@ -345,20 +290,8 @@ bool ShoRendererVk::setupTestGeometry() {
     VkResult result;
     
     {
-        glm::mat4 geomMVP[1];
-        
-        Video::Vulkan::Utils::bufferCreateAndAllocate(sizeof(geomMVP), 
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-            &mUniformBuffer, &mUniformBufferMemory);
-            
-        void* memAddr;
-        vkMapMemory(Video::Vulkan::getLogicalDevice(), mUniformBufferMemory, 0, sizeof(geomMVP), 0, &memAddr);
-        memcpy(memAddr, geomMVP, sizeof(geomMVP));
-        vkUnmapMemory(Video::Vulkan::getLogicalDevice(), mUniformBufferMemory);
-        
         VkDescriptorSetLayoutBinding uniformBufferLayoutBinding; {
-            uniformBufferLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            uniformBufferLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             
             uniformBufferLayoutBinding.binding = 0;
             uniformBufferLayoutBinding.descriptorCount = 1;
@@ -397,7 +330,7 @@ bool ShoRendererVk::setupTestGeometry() {
         }
         
         VkDescriptorPoolSize uniformBufferPoolSize; {
-            uniformBufferPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            uniformBufferPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             uniformBufferPoolSize.descriptorCount = 1;
         }
         
@@ -406,94 +339,102 @@ bool ShoRendererVk::setupTestGeometry() {
             samplerPoolSize.descriptorCount = 1;
         }
         
-        std::array<VkDescriptorPoolSize, 2> poolSizes = {
+        // How many of each type of descriptor a set with mDescriptorSetLayout holds
+        std::vector<VkDescriptorPoolSize> sizesPerSet = {
             uniformBufferPoolSize,
             samplerPoolSize
         };
         
-        VkDescriptorPoolCreateInfo descPoolCargs; {
-            descPoolCargs.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-            descPoolCargs.pNext = nullptr;
-            descPoolCargs.flags = 0;
-            descPoolCargs.poolSizeCount = poolSizes.size();
-            descPoolCargs.pPoolSizes = poolSizes.data();
-            descPoolCargs.maxSets = 1;
-        }
-        
-        result = vkCreateDescriptorPool(Video::Vulkan::getLogicalDevice(), &descPoolCargs, nullptr, &mDescriptorPool);
-        
-        
-        if(result != VK_SUCCESS) {
-            sout << "Could not create descriptor pool" << std::endl;
-            return false;
-        }
-        
-        VkDescriptorSetAllocateInfo descSetAargs; {
-            descSetAargs.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            descSetAargs.pNext = nullptr;
-            descSetAargs.descriptorPool = mDescriptorPool;
-            descSetAargs.descriptorSetCount = 1;
-            descSetAargs.pSetLayouts = &mDescriptorSetLayout;
-        }
-        
-        result = vkAllocateDescriptorSets(Video::Vulkan::getLogicalDevice(), &descSetAargs, &mDescriptorSet);
-        
-        
-        if(result != VK_SUCCESS) {
-            sout << "Could not allocate descriptor sets" << std::endl;
-            return false;
-        }
-        
-        VkDescriptorBufferInfo descBufferData; {
-            descBufferData.buffer = mUniformBuffer;
-            descBufferData.offset = 0;
-            descBufferData.range = sizeof(geomMVP);
-        }
-        
-        VkWriteDescriptorSet writeDescSetBuffer; {
-            writeDescSetBuffer.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescSetBuffer.pNext = nullptr;
-            writeDescSetBuffer.dstSet = mDescriptorSet;
-            writeDescSetBuffer.dstBinding = 0;
-            writeDescSetBuffer.dstArrayElement = 0;
-            writeDescSetBuffer.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            writeDescSetBuffer.descriptorCount = 1;
-            writeDescSetBuffer.pBufferInfo = &descBufferData;
-            writeDescSetBuffer.pImageInfo = nullptr;
-            writeDescSetBuffer.pTexelBufferView = nullptr;
-        }
-        
-        VkDescriptorImageInfo descImageData; {
-            descImageData.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            descImageData.imageView = mTestTexture->getImage()->getView();
-            descImageData.sampler = mTestTexture->getSamplerHandle();
-        }
-        
-        VkWriteDescriptorSet writeDescSetImage; {
-            writeDescSetImage.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescSetImage.pNext = nullptr;
-            writeDescSetImage.dstSet = mDescriptorSet;
-            writeDescSetImage.dstBinding = 1;
-            writeDescSetImage.dstArrayElement = 0;
-            writeDescSetImage.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            writeDescSetImage.descriptorCount = 1;
-            writeDescSetImage.pBufferInfo = nullptr;
-            writeDescSetImage.pImageInfo = &descImageData;
-            writeDescSetImage.pTexelBufferView = nullptr;
+        mMaterialSets.initialize(sizesPerSet, sMaterialSetsPerPool);
+    }
+    
+    // Each draw's model-view-projection matrix gets its own aligned slot
+    VkDeviceSize alignment = Video::Vulkan::getPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment;
+    mUniformStride = ((sizeof(glm::mat4) + alignment - 1) / alignment) * alignment;
+    
+    if(!this->createUniformBuffer(sInitialUniformRegionSize)) {
+        sout << "Could not create uniform buffer" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+bool ShoRendererVk::createUniformBuffer(VkDeviceSize regionSize) {
+    Video::Vulkan::Utils::bufferDestroyAndFree(&mUniformBuffer, &mUniformBufferAllocation);
+    
+    // Regions start on a stride boundary, so every draw's offset stays aligned
+    regionSize = ((regionSize + mUniformStride - 1) / mUniformStride) * mUniformStride;
+    
+    if(!Video::Vulkan::Utils::bufferCreateAndAllocate(regionSize * sMaxFramesInFlight, 
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+        &mUniformBuffer, &mUniformBufferAllocation)) {
+        mUniformRegionSize = 0;
+        return false;
+    }
+    mUniformRegionSize = regionSize;
+    
+    // Every material set points at the old buffer
+    mMaterialSets.clear();
+    return this->updateMaterialSets();
+}
+
+bool ShoRendererVk::updateMaterialSets() {
+    // Once destroyed, a replaced view's handle could be reused by an unrelated view
+    VkImageView view = mTestTexture->getImage()->getView();
+    if(mMaterialView != VK_NULL_HANDLE && mMaterialView != view) {
+        mMaterialSets.forgetImageView(mMaterialView);
+    }
+    mMaterialView = view;
+    
+    // With a dynamic uniform buffer, the offset given here is added to the one given when binding
+    std::vector<DescriptorSetCacheVk::Binding> bindings = {
+        DescriptorSetCacheVk::makeBufferBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 
+            mUniformBuffer, 0, sizeof(glm::mat4)),
+        DescriptorSetCacheVk::makeImageBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 
+            view, mTestTexture->getSamplerHandle(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+    };
+    
+    mDescriptorSet = mMaterialSets.findOrCreate(mDescriptorSetLayout, bindings);
+    return mDescriptorSet != VK_NULL_HANDLE;
+}
+
+void ShoRendererVk::registerPipelines() {
+    mCommandExecutor.clearPipelines();
+    mCommandExecutor.setPipelineLayout(mPipelineLayout);
+    mPipelineId = mCommandExecutor.addPipeline(mPipeline, mDescriptorSet);
+    
+    for(FrameInFlight& frame : mFramesInFlight) {
+        for(RecordingSlot& slot : frame.mRecordingSlots) {
+            slot.mExecutor = mCommandExecutor;
         }
-        
-        std::array<VkWriteDescriptorSet, 2> writeDescSets = {
-            writeDescSetBuffer,
-            writeDescSetImage
-        };
-        
-        vkUpdateDescriptorSets(Video::Vulkan::getLogicalDevice(), writeDescSets.size(), writeDescSets.data(), 0, nullptr);
     }
+}
+
+bool ShoRendererVk::reserveUniforms(VkDeviceSize regionSize) {
+    if(regionSize <= mUniformRegionSize) {
+        return true;
+    }
+    
+    VkDeviceSize newSize = mUniformRegionSize > 0 ? mUniformRegionSize : sInitialUniformRegionSize;
+    while(newSize < regionSize) {
+        newSize *= 2;
+    }
+    
+    Logger::log(Logger::VERBOSE) << "Growing uniform buffer to " << newSize << " bytes per frame" << std::endl;
     
+    // Every frame in flight reads from the buffer, and material sets cannot be freed while any are
+    vkDeviceWaitIdle(Video::Vulkan::getLogicalDevice());
+    if(!this->createUniformBuffer(newSize)) {
+        return false;
+    }
+    
+    this->registerPipelines();
     return true;
 }
 
-bool ShoRendererVk::initializePipeline() {
+bool ShoRendererVk::initializePipelineLayout() {
 
     Logger::Out iout = Logger::log(Logger::INFO);
     Logger::Out vout = Logger::log(Logger::VERBOSE);
@@ -501,33 +442,53 @@ bool ShoRendererVk::initializePipeline() {
     
     VkResult result;
     
-    ShaderResource* shaderVertex = ShaderResource::gallop(Resources::find("TestShader2.vertexShader"));
-    shaderVertex->grab();
-    ShaderResource* shaderFragment = ShaderResource::gallop(Resources::find("TestShader2.fragmentShader"));
-    shaderFragment->grab();
+    VkPipelineLayoutCreateInfo plCstrArgs; {
+        plCstrArgs.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        plCstrArgs.pNext = nullptr;
+        plCstrArgs.flags = 0;
+        
+        //plCstrArgs.setLayoutCount = 0;
+        //plCstrArgs.pSetLayouts = nullptr;
+        plCstrArgs.setLayoutCount = 1;
+        plCstrArgs.pSetLayouts = &mDescriptorSetLayout;
+        plCstrArgs.pushConstantRangeCount = 0;
+        plCstrArgs.pPushConstantRanges = nullptr;
+    }
     
-    std::array<VkPipelineShaderStageCreateInfo, 2> pssCstrArgss = {
-        shaderVertex->getPipelineShaderStageInfo(),
-        shaderFragment->getPipelineShaderStageInfo()
-    };
+    result = vkCreatePipelineLayout(Video::Vulkan::getLogicalDevice(), &plCstrArgs, nullptr, &mPipelineLayout);
     
-    VkViewport viewport; {
-        viewport.x = 0;
-        viewport.y = 0;
-        viewport.width = Video::Vulkan::getSwapchainExtent().width;
-        viewport.height = Video::Vulkan::getSwapchainExtent().height;
-        viewport.minDepth = 0;
-        viewport.maxDepth = 1;
+    if(result != VK_SUCCESS) {
+        sout << "Could not create pipeline layout" << std::endl;
+        return false;
     }
     
-    VkOffset2D scissorsOff; {
-        scissorsOff.x = 0;
-        scissorsOff.y = 0;
-    }
+    return true;
+}
+
+bool ShoRendererVk::initializePipeline() {
+
+    Logger::Out iout = Logger::log(Logger::INFO);
+    Logger::Out vout = Logger::log(Logger::VERBOSE);
+    Logger::Out sout = Logger::log(Logger::SEVERE);
+    
+    std::array<VkPipelineShaderStageCreateInfo, 2> pssCstrArgss = {
+        mShaderVertex->getPipelineShaderStageInfo(),
+        mShaderFragment->getPipelineShaderStageInfo()
+    };
+    
+    // Set while recording instead, so that the same pipeline works for any swapchain extent
+    std::array<VkDynamicState, 2> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
     
-    VkRect2D scissors; {
-        scissors.offset = scissorsOff;
-        scissors.extent = Video::Vulkan::getSwapchainExtent();
+    VkPipelineDynamicStateCreateInfo pdsCargs; {
+        pdsCargs.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        pdsCargs.pNext = nullptr;
+        pdsCargs.flags = 0;
+        
+        pdsCargs.dynamicStateCount = dynamicStates.size();
+        pdsCargs.pDynamicStates = dynamicStates.data();
     }
     
     VkPipelineViewportStateCreateInfo pvsCstrArgs; {
@@ -536,9 +497,9 @@ bool ShoRendererVk::initializePipeline() {
         pvsCstrArgs.flags = 0;
         
         pvsCstrArgs.viewportCount = 1;
-        pvsCstrArgs.pViewports = &viewport;
+        pvsCstrArgs.pViewports = nullptr;
         pvsCstrArgs.scissorCount = 1;
-        pvsCstrArgs.pScissors = &scissors;
+        pvsCstrArgs.pScissors = nullptr;
     }
     
     VkPipelineRasterizationStateCreateInfo prsCstrArgs; {
@@ -618,29 +579,6 @@ bool ShoRendererVk::initializePipeline() {
         pcbsCstrArgs.blendConstants[3] = 0;
     }
     
-    VkPipelineLayoutCreateInfo plCstrArgs; {
-        plCstrArgs.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        plCstrArgs.pNext = nullptr;
-        plCstrArgs.flags = 0;
-        
-        //plCstrArgs.setLayoutCount = 0;
-        //plCstrArgs.pSetLayouts = nullptr;
-        plCstrArgs.setLayoutCount = 1;
-        plCstrArgs.pSetLayouts = &mDescriptorSetLayout;
-        plCstrArgs.pushConstantRangeCount = 0;
-        plCstrArgs.pPushConstantRanges = nullptr;
-    }
-    
-    result = vkCreatePipelineLayout(Video::Vulkan::getLogicalDevice(), &plCstrArgs, nullptr, &mPipelineLayout);
-    
-    if(result != VK_SUCCESS) {
-        sout << "Could not create pipeline layout" << std::endl;
-    
-        shaderVertex->drop();
-        shaderFragment->drop();
-        return false;
-    }
-    
     VkGraphicsPipelineCreateInfo gpCstrArgs; {
         gpCstrArgs.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         gpCstrArgs.pNext = nullptr;
@@ -661,7 +599,7 @@ bool ShoRendererVk::initializePipeline() {
         gpCstrArgs.pMultisampleState = &pmsCstrArgs;
         gpCstrArgs.pDepthStencilState = &dssCargs;
         gpCstrArgs.pColorBlendState = &pcbsCstrArgs;
-        gpCstrArgs.pDynamicState = nullptr;
+        gpCstrArgs.pDynamicState = &pdsCargs;
         gpCstrArgs.pTessellationState = nullptr;
         
         gpCstrArgs.subpass = 0;
@@ -670,54 +608,168 @@ bool ShoRendererVk::initializePipeline() {
         gpCstrArgs.basePipelineIndex = -1;
     }
     
-    result = vkCreateGraphicsPipelines(Video::Vulkan::getLogicalDevice(), VK_NULL_HANDLE, 1, &gpCstrArgs, nullptr, &mPipeline);
-    
-    shaderVertex->drop();
-    shaderVertex = nullptr;
-    shaderFragment->drop();
-    shaderFragment = nullptr;
+    mPipeline = mPipelineStates.findOrCreateGraphicsPipeline(gpCstrArgs);
     
-    if(result != VK_SUCCESS) {
+    if(mPipeline == VK_NULL_HANDLE) {
         sout << "Could not create graphics pipeline" << std::endl;
         return false;
     }
     
+    this->registerPipelines();
+    
+    return true;
+}
+
+bool ShoRendererVk::initializeFramesInFlight() {
+    
+    Logger::Out iout = Logger::log(Logger::INFO);
+    Logger::Out vout = Logger::log(Logger::VERBOSE);
+    Logger::Out sout = Logger::log(Logger::SEVERE);
+    
+    VkResult result;
+    
+    VkCommandBufferAllocateInfo primaryCbaArgs; {
+        primaryCbaArgs.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        primaryCbaArgs.pNext = nullptr;
+        primaryCbaArgs.commandPool = Video::Vulkan::getGraphicsCommandPool();
+        primaryCbaArgs.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        primaryCbaArgs.commandBufferCount = 1;
+    }
+    
+    VkSemaphoreCreateInfo semaphoreCargs; {
+        semaphoreCargs.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreCargs.pNext = nullptr;
+        semaphoreCargs.flags = 0;
+    }
+    
+    // Signaled, so that the first wait on each frame returns immediately
+    VkFenceCreateInfo fenceCargs; {
+        fenceCargs.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceCargs.pNext = nullptr;
+        fenceCargs.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    }
+    
+    VkCommandPoolCreateInfo cpCargs; {
+        cpCargs.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cpCargs.pNext = nullptr;
+        
+        // Every buffer in the pool is re-recorded every frame, so the whole pool is reset at once
+        cpCargs.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        cpCargs.queueFamilyIndex = Video::Vulkan::getGraphicsQueueFamilyIndex();
+    }
+    
+    // A few slots per thread, so that work stealing can even out slots which take longer than others
+    uint32_t numSlots = (Jobs::getNumWorkers() + 1) * 2;
+    
+    for(FrameInFlight& frame : mFramesInFlight) {
+        result = vkAllocateCommandBuffers(Video::Vulkan::getLogicalDevice(), &primaryCbaArgs, &(frame.mGraphicsCmdBuffer));
+        if(result != VK_SUCCESS) {
+            sout << "Could not allocate command buffers" << std::endl;
+            return false;
+        }
+        result = vkCreateSemaphore(Video::Vulkan::getLogicalDevice(), &semaphoreCargs, nullptr, &(frame.mSemImageAvailable));
+        if(result != VK_SUCCESS) {
+            sout << "Could not create image availability semaphore" << std::endl;
+            return false;
+        }
+        result = vkCreateSemaphore(Video::Vulkan::getLogicalDevice(), &semaphoreCargs, nullptr, &(frame.mSemRenderFinished));
+        if(result != VK_SUCCESS) {
+            sout << "Could not create render completion semaphore" << std::endl;
+            return false;
+        }
+        result = vkCreateFence(Video::Vulkan::getLogicalDevice(), &fenceCargs, nullptr, &(frame.mFenceRenderFinished));
+        if(result != VK_SUCCESS) {
+            sout << "Could not create render completion fence" << std::endl;
+            return false;
+        }
+        
+        // Secondary command buffers can only be reused once the frame which executed them has finished too
+        frame.mRecordingSlots.resize(numSlots);
+        for(RecordingSlot& slot : frame.mRecordingSlots) {
+            result = vkCreateCommandPool(Video::Vulkan::getLogicalDevice(), &cpCargs, nullptr, &(slot.mCmdPool));
+            if(result != VK_SUCCESS) {
+                sout << "Could not create recording command pool" << std::endl;
+                return false;
+            }
+            
+            VkCommandBufferAllocateInfo cbaArgs; {
+                cbaArgs.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                cbaArgs.pNext = nullptr;
+                cbaArgs.commandPool = slot.mCmdPool;
+                cbaArgs.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                cbaArgs.commandBufferCount = NUM_RECORDED_PASSES;
+            }
+            result = vkAllocateCommandBuffers(Video::Vulkan::getLogicalDevice(), &cbaArgs, slot.mCmdBuffers);
+            if(result != VK_SUCCESS) {
+                sout << "Could not allocate secondary command buffers" << std::endl;
+                return false;
+            }
+            
+            slot.mExecutor = mCommandExecutor;
+        }
+    }
+    mFrameIndex = 0;
+    
+    mFrameSecondaries.reserve(numSlots * NUM_RECORDED_PASSES);
+    
     return true;
 }
 
 bool ShoRendererVk::cleanup() {
     
+    // Frames may still be in flight
+    vkDeviceWaitIdle(Video::Vulkan::getLogicalDevice());
+    
+    for(FrameInFlight& frame : mFramesInFlight) {
+        // Secondary command buffers are freed with their pools
+        for(RecordingSlot& slot : frame.mRecordingSlots) {
+            vkDestroyCommandPool(Video::Vulkan::getLogicalDevice(), slot.mCmdPool, nullptr);
+        }
+        frame.mRecordingSlots.clear();
+        
+        vkDestroySemaphore(Video::Vulkan::getLogicalDevice(), frame.mSemImageAvailable, nullptr);
+        vkDestroySemaphore(Video::Vulkan::getLogicalDevice(), frame.mSemRenderFinished, nullptr);
+        vkDestroyFence(Video::Vulkan::getLogicalDevice(), frame.mFenceRenderFinished, nullptr);
+        vkFreeCommandBuffers(Video::Vulkan::getLogicalDevice(), Video::Vulkan::getGraphicsCommandPool(), 1, &(frame.mGraphicsCmdBuffer));
+        frame = FrameInFlight();
+    }
+    
     mTestGeom->drop();
     mTestTexture->drop();
     
-    vkFreeMemory(Video::Vulkan::getLogicalDevice(), mUniformBufferMemory, nullptr);
-    vkDestroyBuffer(Video::Vulkan::getLogicalDevice(), mUniformBuffer, nullptr);
+    mShaderVertex->drop();
+    mShaderVertex = nullptr;
+    mShaderFragment->drop();
+    mShaderFragment = nullptr;
     
-    // Descriptor sets are automatically cleaned up with the descriptor pool
-    vkDestroyDescriptorPool(Video::Vulkan::getLogicalDevice(), mDescriptorPool, nullptr);
+    Video::Vulkan::Utils::bufferDestroyAndFree(&mUniformBuffer, &mUniformBufferAllocation);
+    
+    // Descriptor sets are automatically cleaned up with the descriptor pools
+    mMaterialSets.cleanup();
+    mDescriptorSet = VK_NULL_HANDLE;
     vkDestroyDescriptorSetLayout(Video::Vulkan::getLogicalDevice(), mDescriptorSetLayout, nullptr);
     
-    vkDestroyPipeline(Video::Vulkan::getLogicalDevice(), mPipeline, nullptr);
+    // Before the layout and render pass they were created with
+    mPipelineStates.clear();
+    mPipeline = VK_NULL_HANDLE;
     vkDestroyPipelineLayout(Video::Vulkan::getLogicalDevice(), mPipelineLayout, nullptr);
     
-    vkDestroySemaphore(Video::Vulkan::getLogicalDevice(), mSemImageAvailable, nullptr);
+    this->cleanupSwapchainDependents();
+    
+    vkDestroyRenderPass(Video::Vulkan::getLogicalDevice(), mRenderPass, nullptr);
     
+    return true;
+}
+
+void ShoRendererVk::cleanupSwapchainDependents() {
     for(FramebufferSquad& framebufferSquad : mFramebufferSquads) {
         vkDestroyFramebuffer(Video::Vulkan::getLogicalDevice(), framebufferSquad.mFramebuffer, nullptr);
-        vkDestroySemaphore(Video::Vulkan::getLogicalDevice(), framebufferSquad.mSemRenderFinished, nullptr);
-        vkDestroyFence(Video::Vulkan::getLogicalDevice(), framebufferSquad.mFenceRenderFinished, nullptr);
-        vkFreeCommandBuffers(Video::Vulkan::getLogicalDevice(), Video::Vulkan::getGraphicsCommandPool(), 1, &(framebufferSquad.mGraphicsCmdBuffer));
     }
     mFramebufferSquads.clear();
-    mAllFenceRenderFinished.clear();
     
-    vkDestroyImage(Video::Vulkan::getLogicalDevice(), mDepthImage, nullptr);
-    vkFreeMemory(Video::Vulkan::getLogicalDevice(), mDepthImageMemory, nullptr);
     vkDestroyImageView(Video::Vulkan::getLogicalDevice(), mDepthImageView, nullptr);
-    
-    vkDestroyRenderPass(Video::Vulkan::getLogicalDevice(), mRenderPass, nullptr);
-    
-    return true;
+    mDepthImageView = VK_NULL_HANDLE;
+    Video::Vulkan::Utils::imageDestroyAndFree(&mDepthImage, &mDepthImageAllocation);
 }
 
 void ShoRendererVk::renderFrame() {
@@ -732,19 +784,71 @@ void ShoRendererVk::renderFrame() {
     
     VkResult result;
     
+    FrameInFlight& frame = mFramesInFlight[mFrameIndex];
+    
+    // Only the frame being reused has to be finished; the ones after it may still be drawing
+    vkWaitForFences(
+        Video::Vulkan::getLogicalDevice(), 
+        1, &(frame.mFenceRenderFinished), 
+        VK_TRUE, 
+        std::numeric_limits<uint64_t>::max() // Be *very* patient
+        );
+    
+    // Material sets forgotten since sMaxFramesInFlight frames ago are no longer bound by any frame
+    mMaterialSets.update(sMaxFramesInFlight);
+    
+    // Streams in mips requested by earlier frames; images it replaces are kept until no frame in flight can use them
+    Video::Vulkan::getTextureStreamer()->update(sMaxFramesInFlight);
+    if(mTestTexture->getImage()->getView() != mMaterialView) {
+        if(!this->updateMaterialSets()) {
+            sout << "Could not update material set for streamed texture" << std::endl;
+            return;
+        }
+        this->registerPipelines();
+    }
+    
+    // Everything which can fail without a swapchain image is done before acquiring one; afterwards, failing means
+    // having to consume the image available semaphore with submitWithoutDrawing()
+    if(!this->recordSecondaries(frame)) {
+        sout << "Could not record secondary command buffers" << std::endl;
+        return;
+    }
+    
     VkSwapchainKHR swapchain = Video::Vulkan::getSwapchain();
     uint32_t imgIndex;
-    vkAcquireNextImageKHR(
+    result = vkAcquireNextImageKHR(
         Video::Vulkan::getLogicalDevice(), 
         swapchain, 
         std::numeric_limits<uint64_t>::max(), 
-        mSemImageAvailable, 
+        frame.mSemImageAvailable, 
         VK_NULL_HANDLE, &imgIndex);
     
+    // Nothing was acquired and the semaphore is left alone; the swapchain is rebuilt once the window reports its new
+    // size, so skip drawing until then. A suboptimal swapchain can still be drawn to.
+    if(result == VK_ERROR_OUT_OF_DATE_KHR) {
+        vout << "Swapchain out of date, skipping frame" << std::endl;
+        return;
+    }
+    if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        sout << "Could not acquire swapchain image" << std::endl;
+        return;
+    }
+    
     // Note: this block should not be moved into its own method, since it synchronizes with the above call 
     // to vkAquireNextImageKHR
     {
         FramebufferSquad& squad = mFramebufferSquads.at(imgIndex);
+        
+        // Images can be handed back out of order, possibly while an earlier frame is still drawing to this one
+        if(squad.mFenceInFlight != VK_NULL_HANDLE && squad.mFenceInFlight != frame.mFenceRenderFinished) {
+            vkWaitForFences(
+                Video::Vulkan::getLogicalDevice(), 
+                1, &(squad.mFenceInFlight), 
+                VK_TRUE, 
+                std::numeric_limits<uint64_t>::max()
+                );
+        }
+        squad.mFenceInFlight = frame.mFenceRenderFinished;
     
         //
         VkPipelineStageFlags waitFlag = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -756,41 +860,23 @@ void ShoRendererVk::renderFrame() {
             // Basically, tell Vulkan to wait until the image availability semaphore is triggered before it writes 
             // the color information. pWaitDstStageMask specifies this.
             submitArgs.waitSemaphoreCount = 1;
-            submitArgs.pWaitSemaphores = &mSemImageAvailable;
+            submitArgs.pWaitSemaphores = &(frame.mSemImageAvailable);
             submitArgs.pWaitDstStageMask = &waitFlag;
             
             submitArgs.commandBufferCount = 1;
-            submitArgs.pCommandBuffers = &(squad.mGraphicsCmdBuffer);
+            submitArgs.pCommandBuffers = &(frame.mGraphicsCmdBuffer);
             
             submitArgs.signalSemaphoreCount = 1;
-            submitArgs.pSignalSemaphores = &(squad.mSemRenderFinished);
+            submitArgs.pSignalSemaphores = &(frame.mSemRenderFinished);
         }
         
-        /*
-        // Wait for this command buffer to finish
-        vkWaitForFences(
-            Video::Vulkan::getLogicalDevice(), 
-            1, &(squad.mFenceRenderFinished), 
-            VK_TRUE, // Wait for all of them to complete (as opposed to any of them)
-            std::numeric_limits<uint64_t>::max() // Be *very* patient
-            );
-        // [This work only requires that the current command buffer has completed]
-        */
-        
-        // Wait for all the command buffers to finish
-        // TODO: check if this is even necessary. Is it possible for this queue to finish but not earlier ones? 
-        vkWaitForFences(
-            Video::Vulkan::getLogicalDevice(), 
-            mAllFenceRenderFinished.size(), mAllFenceRenderFinished.data(), 
-            VK_TRUE, // Wait for all of them to complete (as opposed to any of them)
-            std::numeric_limits<uint64_t>::max() // Be *very* patient
-            );
-
-        // This must be done only while it is guaranteed that no command buffer is running
+        // Resources loaded since the last frame have their uploads batched up; submit them and make sure they are
+        // done before anything samples them
+        Video::Vulkan::getTransferBatcher()->finish();
+        
+        // Everything written to here belongs to this frame, which the GPU is done with
         {
-            mScenegraph->processAll(std::bind(&ShoRendererVk::modelimapUniformBufferUpdate, this, std::placeholders::_1));
-            
-            VkCommandBuffer cmdBuff = squad.mGraphicsCmdBuffer;
+            VkCommandBuffer cmdBuff = frame.mGraphicsCmdBuffer;
             VkFramebuffer framebuff = squad.mFramebuffer;
             
             // Resetting is not necessary since the buffer is implicitly reset in vkBeginCommandBuffer()
@@ -799,11 +885,16 @@ void ShoRendererVk::renderFrame() {
             VkCommandBufferBeginInfo cbbArgs; {
                 cbbArgs.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
                 cbbArgs.pNext = nullptr;
-                cbbArgs.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+                cbbArgs.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
                 cbbArgs.pInheritanceInfo = nullptr;
             }
             
             result = vkBeginCommandBuffer(cmdBuff, &cbbArgs);
+            if(result != VK_SUCCESS) {
+                sout << "Could not begin command buffer" << std::endl;
+                this->submitWithoutDrawing(frame);
+                return;
+            }
             
             std::array<VkClearValue, 2> clearVals;
             clearVals[0].color = {0, 1, 1, 1};
@@ -820,31 +911,31 @@ void ShoRendererVk::renderFrame() {
                 rpbArgs.pClearValues = clearVals.data();
             }
             
-            vkCmdBeginRenderPass(cmdBuff, &rpbArgs, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBeginRenderPass(cmdBuff, &rpbArgs, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
             
-            vkCmdBindPipeline(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
-            
-            vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mDescriptorSet, 0, nullptr);
-            
-            mScenegraph->processAll(std::bind(&ShoRendererVk::modelimapOpaque, this, std::placeholders::_1, cmdBuff));
+            if(!mFrameSecondaries.empty()) {
+                vkCmdExecuteCommands(cmdBuff, mFrameSecondaries.size(), mFrameSecondaries.data());
+            }
             
             vkCmdEndRenderPass(cmdBuff);
             
             result = vkEndCommandBuffer(cmdBuff);
             if(result != VK_SUCCESS) {
                 sout << "Could not record command buffer" << std::endl;
+                this->submitWithoutDrawing(frame);
                 return;
             }
         }
         
         // Reset the fence so it can be triggered again by the completion of our queue submission
-        vkResetFences(Video::Vulkan::getLogicalDevice(), 1, &(squad.mFenceRenderFinished));
+        vkResetFences(Video::Vulkan::getLogicalDevice(), 1, &(frame.mFenceRenderFinished));
             
         // Submit the rendering queue
-        result = vkQueueSubmit(Video::Vulkan::getGraphicsQueue(), 1, &submitArgs, squad.mFenceRenderFinished);
+        result = vkQueueSubmit(Video::Vulkan::getGraphicsQueue(), 1, &submitArgs, frame.mFenceRenderFinished);
         
         if(result != VK_SUCCESS) {
             Logger::log(Logger::SEVERE) << "Failed to submit render queue" << std::endl;
+            this->submitWithoutDrawing(frame);
             return;
         }
         
@@ -853,7 +944,7 @@ void ShoRendererVk::renderFrame() {
             presentArgs.pNext = nullptr;
             
             presentArgs.waitSemaphoreCount = 1;
-            presentArgs.pWaitSemaphores = &(squad.mSemRenderFinished);
+            presentArgs.pWaitSemaphores = &(frame.mSemRenderFinished);
             
             presentArgs.swapchainCount = 1;
             presentArgs.pSwapchains = &swapchain;
@@ -863,33 +954,51 @@ void ShoRendererVk::renderFrame() {
         
         vkQueuePresentKHR(Video::Vulkan::getDisplayQueue(), &presentArgs);
     }
+    
+    mFrameIndex = (mFrameIndex + 1) % sMaxFramesInFlight;
 }
-void ShoRendererVk::modelimapUniformBufferUpdate(ModelInstance* modeli) {
-    glm::mat4 geomMVP[] = {
-        mCamera.getProjMatrix() * mCamera.getViewMatrix() * glm::mat4()
-    };
-    void* memAddr;
-    vkMapMemory(Video::Vulkan::getLogicalDevice(), mUniformBufferMemory, 0, sizeof(geomMVP), 0, &memAddr);
-    memcpy(memAddr, geomMVP, sizeof(geomMVP));
-    vkUnmapMemory(Video::Vulkan::getLogicalDevice(), mUniformBufferMemory);
+
+void ShoRendererVk::submitWithoutDrawing(FrameInFlight& frame) {
+    VkPipelineStageFlags waitFlag = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitArgs; {
+        submitArgs.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitArgs.pNext = nullptr;
+        submitArgs.waitSemaphoreCount = 1;
+        submitArgs.pWaitSemaphores = &(frame.mSemImageAvailable);
+        submitArgs.pWaitDstStageMask = &waitFlag;
+        submitArgs.commandBufferCount = 0;
+        submitArgs.pCommandBuffers = nullptr;
+        submitArgs.signalSemaphoreCount = 0;
+        submitArgs.pSignalSemaphores = nullptr;
+    }
+    
+    // The fence may or may not have been reset already, depending on where drawing failed
+    vkResetFences(Video::Vulkan::getLogicalDevice(), 1, &(frame.mFenceRenderFinished));
+    VkResult result = vkQueueSubmit(Video::Vulkan::getGraphicsQueue(), 1, &submitArgs, frame.mFenceRenderFinished);
+    if(result != VK_SUCCESS) {
+        Logger::log(Logger::SEVERE) << "Could not release swapchain image semaphore" << std::endl;
+    }
+    
+    // Note that the image is never presented, so it stays acquired until the swapchain is rebuilt
 }
 
-void ShoRendererVk::modelimapDepthPass(ModelInstance* modeli) {
+// Called from job threads; must only write to commands
+void ShoRendererVk::modelimapDepthPass(ModelInstance* modeli, RenderCommandList* commands) {
 }
-void ShoRendererVk::modelimapLightprobe(ModelInstance* modeli) {
+void ShoRendererVk::modelimapLightprobe(ModelInstance* modeli, RenderCommandList* commands) {
 }
 
-void ShoRendererVk::modelimapOpaque(ModelInstance* modeli, VkCommandBuffer cmdBuff) {
+void ShoRendererVk::modelimapOpaque(ModelInstance* modeli, RenderCommandList* commands) {
     /*
     Model* model = modeli->getModel();
     Material* material = model->getMaterial();
     Geometry* geometry = model->getGeometry();
     */
 
-    
-    mTestGeom->cmdBindBuffers(cmdBuff);
-    mTestGeom->cmdDrawIndexed(cmdBuff);
-    
+    // Only the first instance actually binds the buffers
+    commands->bindGeometry(mTestGeom);
+    commands->setModelMatrix(modeli->mModelMatr);
+    commands->drawIndexed();
 }
 
 void ShoRendererVk::modelimapTransparent(ModelInstance* modeli) {
@@ -903,8 +1012,226 @@ void ShoRendererVk::onModeliRemoved(ModelInstance* modeli) {
 }
 
 void ShoRendererVk::rebuildPipeline() {
-    cleanup();
-    initialize();
+    
+    Logger::Out sout = Logger::log(Logger::SEVERE);
+    
+    // Frames in flight may still be drawing to the old framebuffers
+    vkDeviceWaitIdle(Video::Vulkan::getLogicalDevice());
+    
+    this->cleanupSwapchainDependents();
+    
+    // Pipelines are only compatible with the render pass they were created for, which in turn only depends on the
+    // swapchain through its format
+    bool formatChanged = Video::Vulkan::getSwapchainFormat() != mColorFormat;
+    if(formatChanged) {
+        mPipelineStates.clear();
+        mPipeline = VK_NULL_HANDLE;
+        vkDestroyRenderPass(Video::Vulkan::getLogicalDevice(), mRenderPass, nullptr);
+        mRenderPass = VK_NULL_HANDLE;
+    }
+    
+    bool success = 
+        initializeDepthBuffer() && 
+        (!formatChanged || initializeRenderpass()) && 
+        initializeFramebuffers() && 
+        initializePipeline();
+    
+    if(!success) {
+        sout << "Could not rebuild renderer after swapchain change" << std::endl;
+        return;
+    }
+}
+
+PipelineStateCacheVk::Stats ShoRendererVk::getPipelineStats() const {
+    return mPipelineStates.getStats();
+}
+
+bool ShoRendererVk::recordSecondaries(FrameInFlight& frame) {
+    std::vector<RecordingSlot>& slots = frame.mRecordingSlots;
+    
+    mFrameInstances.clear();
+    mScenegraph->processAll([this](ModelInstance* modeli) { mFrameInstances.push_back(modeli); });
+    
+    std::size_t numInstances = mFrameInstances.size();
+    std::size_t numSlots = (numInstances + sMinInstancesPerSlot - 1) / sMinInstancesPerSlot;
+    if(numSlots > slots.size()) numSlots = slots.size();
+    if(numSlots == 0) numSlots = 1;
+    std::size_t instancesPerSlot = (numInstances + numSlots - 1) / numSlots;
+    
+    mFrameCameraLocation = mCamera.calcLocation();
+    mFramePixelsPerUnit = mCamera.getProjMatrix()[1][1] * Video::Vulkan::getSwapchainExtent().height * 0.5f;
+    
+    Jobs::parallelFor(0, numSlots, [this, &slots, numInstances, instancesPerSlot](std::size_t begin, std::size_t end) {
+        for(std::size_t i = begin; i < end; ++ i) {
+            std::size_t first = i * instancesPerSlot;
+            std::size_t last = first + instancesPerSlot;
+            if(first > numInstances) first = numInstances;
+            if(last > numInstances) last = numInstances;
+            this->recordSlotCommands(slots[i], first, last);
+        }
+    }, 1);
+    
+    float coverage = 0.f;
+    for(std::size_t i = 0; i < numSlots; ++ i) {
+        if(slots[i].mTestTextureCoverage > coverage) coverage = slots[i].mTestTextureCoverage;
+    }
+    if(coverage > 0.f) {
+        Video::Vulkan::getTextureStreamer()->requestCoverage(mTestTexture->getImage(), coverage);
+    }
+    
+    // Now that the number of draws is known, lay out where each list writes its matrices
+    VkDeviceSize uniformBytes = 0;
+    for(uint32_t pass = 0; pass < NUM_RECORDED_PASSES; ++ pass) {
+        for(std::size_t i = 0; i < numSlots; ++ i) {
+            RecordingSlot& slot = slots[i];
+            slot.mUniformOffsets[pass] = uniformBytes;
+            uniformBytes += slot.mCommands[pass].getMatrices().size() * mUniformStride;
+        }
+    }
+    if(!this->reserveUniforms(uniformBytes)) {
+        return false;
+    }
+    
+    VkDeviceSize regionOffset = mUniformRegionSize * mFrameIndex;
+    uint8_t* region = static_cast<uint8_t*>(mUniformBufferAllocation.mMapped) + regionOffset;
+    glm::mat4 viewProj = mCamera.getProjMatrix() * mCamera.getViewMatrix();
+    
+    Jobs::parallelFor(0, numSlots, [this, &slots, region, regionOffset, &viewProj](std::size_t begin, std::size_t end) {
+        for(std::size_t i = begin; i < end; ++ i) {
+            this->recordSlotSecondaries(slots[i], region, regionOffset, viewProj);
+        }
+    }, 1);
+    
+    for(std::size_t i = 0; i < numSlots; ++ i) {
+        if(slots[i].mResult != VK_SUCCESS) {
+            return false;
+        }
+    }
+    
+    // Stitched together in pass order, and in instance order within each pass
+    mFrameSecondaries.clear();
+    mCommandStats = RenderCommandList::Stats();
+    for(uint32_t pass = 0; pass < NUM_RECORDED_PASSES; ++ pass) {
+        for(std::size_t i = 0; i < numSlots; ++ i) {
+            const RecordingSlot& slot = slots[i];
+            if(slot.mRecorded[pass]) {
+                mFrameSecondaries.push_back(slot.mCmdBuffers[pass]);
+            }
+            mCommandStats += slot.mCommands[pass].getStats();
+        }
+    }
+    return true;
+}
+
+void ShoRendererVk::recordSlotCommands(RecordingSlot& slot, std::size_t begin, std::size_t end) {
+    for(uint32_t pass = 0; pass < NUM_RECORDED_PASSES; ++ pass) {
+        slot.mCommands[pass].clear();
+    }
+    
+    // Only the opaque pass has a pipeline so far
+    slot.mCommands[RECORDED_PASS_OPAQUE].bindPipeline(mPipelineId);
+    slot.mTestTextureCoverage = 0.f;
+    for(std::size_t i = begin; i < end; ++ i) {
+        ModelInstance* modeli = mFrameInstances[i];
+        this->modelimapDepthPass(modeli, &(slot.mCommands[RECORDED_PASS_DEPTH]));
+        this->modelimapLightprobe(modeli, &(slot.mCommands[RECORDED_PASS_LIGHTPROBE]));
+        this->modelimapOpaque(modeli, &(slot.mCommands[RECORDED_PASS_OPAQUE]));
+        
+        float coverage = this->calcScreenCoverage(modeli);
+        if(coverage > slot.mTestTextureCoverage) slot.mTestTextureCoverage = coverage;
+    }
+}
+
+float ShoRendererVk::calcScreenCoverage(const ModelInstance* modeli) const {
+    BoundingSphere bounds = mTestGeom->getBoundingSphere().transformed(modeli->mModelMatr);
+    if(bounds.isEmpty()) {
+        return 0.f;
+    }
+    
+    // Inside the sphere (or unbounded geometry) could fill the whole screen at any texture resolution
+    float distance = glm::length(bounds.mCenter - mFrameCameraLocation);
+    if(bounds.isInfinite() || distance <= bounds.mRadius) {
+        return std::numeric_limits<float>::max();
+    }
+    
+    // Ignores where on screen the sphere is, which only makes it appear smaller than this
+    return bounds.mRadius * 2.f * mFramePixelsPerUnit / distance;
+}
+
+void ShoRendererVk::recordSlotSecondaries(RecordingSlot& slot, void* uniforms, VkDeviceSize uniformOffset, const glm::mat4& viewProj) {
+    for(uint32_t pass = 0; pass < NUM_RECORDED_PASSES; ++ pass) {
+        slot.mRecorded[pass] = false;
+    }
+    
+    // Safe because the frame which last used this slot has finished
+    slot.mResult = vkResetCommandPool(Video::Vulkan::getLogicalDevice(), slot.mCmdPool, 0);
+    if(slot.mResult != VK_SUCCESS) {
+        return;
+    }
+    
+    VkCommandBufferInheritanceInfo cbiArgs; {
+        cbiArgs.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        cbiArgs.pNext = nullptr;
+        cbiArgs.renderPass = mRenderPass;
+        cbiArgs.subpass = 0;
+        
+        // Not known until after recording, when an image is acquired; naming it would only have been a hint
+        cbiArgs.framebuffer = VK_NULL_HANDLE;
+        cbiArgs.occlusionQueryEnable = VK_FALSE;
+        cbiArgs.queryFlags = 0;
+        cbiArgs.pipelineStatistics = 0;
+    }
+    
+    VkCommandBufferBeginInfo cbbArgs; {
+        cbbArgs.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cbbArgs.pNext = nullptr;
+        cbbArgs.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        cbbArgs.pInheritanceInfo = &cbiArgs;
+    }
+    
+    VkViewport viewport; {
+        viewport.x = 0;
+        viewport.y = 0;
+        viewport.width = Video::Vulkan::getSwapchainExtent().width;
+        viewport.height = Video::Vulkan::getSwapchainExtent().height;
+        viewport.minDepth = 0;
+        viewport.maxDepth = 1;
+    }
+    
+    VkRect2D scissor; {
+        scissor.offset.x = 0;
+        scissor.offset.y = 0;
+        scissor.extent = Video::Vulkan::getSwapchainExtent();
+    }
+    slot.mExecutor.setViewport(viewport, scissor);
+    
+    for(uint32_t pass = 0; pass < NUM_RECORDED_PASSES; ++ pass) {
+        const RenderCommandList& commands = slot.mCommands[pass];
+        if(commands.getStats().mCommands[RenderCommandList::DRAW_INDEXED] == 0) {
+            continue;
+        }
+        
+        VkCommandBuffer cmdBuff = slot.mCmdBuffers[pass];
+        slot.mResult = vkBeginCommandBuffer(cmdBuff, &cbbArgs);
+        if(slot.mResult != VK_SUCCESS) {
+            return;
+        }
+        
+        VkDeviceSize listOffset = slot.mUniformOffsets[pass];
+        slot.mExecutor.setUniformTarget(static_cast<uint8_t*>(uniforms) + listOffset, uniformOffset + listOffset, mUniformStride, viewProj);
+        slot.mExecutor.setCommandBuffer(cmdBuff);
+        slot.mExecutor.execute(commands);
+        
+        slot.mResult = vkEndCommandBuffer(cmdBuff);
+        if(slot.mResult != VK_SUCCESS) {
+            return;
+        }
+        slot.mRecorded[pass] = true;
+    }
+}
+
+const RenderCommandList::Stats& ShoRendererVk::getCommandStats() const {
+    return mCommandStats;
 }
 
 }
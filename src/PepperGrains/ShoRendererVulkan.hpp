@@ -19,6 +19,7 @@
 
 #ifdef PGG_VULKAN
 
+#include <cstddef>
 #include <stdint.h>
 #include <vector>
 
@@ -27,7 +28,12 @@
 #include "ShaderResource.hpp"
 #include "Scenegraph.hpp"
 #include "Camera.hpp"
+#include "DescriptorSetCacheVulkan.hpp"
+#include "DeviceMemoryAllocatorVulkan.hpp"
 #include "Geometry.hpp"
+#include "PipelineStateCacheVulkan.hpp"
+#include "RenderCommandExecutorVulkan.hpp"
+#include "RenderCommandList.hpp"
 #include "Texture.hpp"
 
 namespace pgg {
@@ -36,23 +42,109 @@ class ShoRendererVk {
 private:
     VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
     VkRenderPass mRenderPass = VK_NULL_HANDLE;
-    VkPipeline mPipeline = VK_NULL_HANDLE;
+    
+    /// Swapchain format the render pass was created for
+    VkFormat mColorFormat = VK_FORMAT_UNDEFINED;
+    
+    /// Owns every pipeline, so that rebuilding after a swapchain change can reuse them
+    PipelineStateCacheVk mPipelineStates;
+    VkPipeline mPipeline = VK_NULL_HANDLE; // Owned by mPipelineStates
+    
+    ShaderResource* mShaderVertex = nullptr;
+    ShaderResource* mShaderFragment = nullptr;
     
     VkImage mDepthImage = VK_NULL_HANDLE;
-    VkDeviceMemory mDepthImageMemory = VK_NULL_HANDLE;
+    DeviceMemoryAllocatorVk::Allocation mDepthImageAllocation;
     VkFormat mDepthFormat = VK_FORMAT_END_RANGE;
     VkImageView mDepthImageView = VK_NULL_HANDLE;
     
-    VkSemaphore mSemImageAvailable = VK_NULL_HANDLE;
-    
-    /// Groups together per-swapchain-image objects: a framebuffer, command buffer, and mutexes
+    /// Groups together per-swapchain-image objects
     struct FramebufferSquad {
         /// Associated framebuffer
         VkFramebuffer mFramebuffer = VK_NULL_HANDLE;
         
+        /// Fence of the frame in flight which most recently drew to this image, if any (not owned)
+        VkFence mFenceInFlight = VK_NULL_HANDLE;
+    };
+    
+    /**
+     * Each swapchain image has its own framebuffer, etc.
+     * The indices into this vector correspond to the indices returned by Vulkan when querying the next available
+     * swapchain image.
+     */
+    std::vector<FramebufferSquad> mFramebufferSquads;
+    
+    Geometry* mTestGeom = nullptr;
+    Texture* mTestTexture = nullptr;
+    
+    VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+    
+    /// Material sets never change once written, so any number of frames can share them
+    DescriptorSetCacheVk mMaterialSets;
+    VkDescriptorSet mDescriptorSet = VK_NULL_HANDLE; // Owned by mMaterialSets
+    
+    /// View that mDescriptorSet points at; streaming replaces the test texture's view when its resident mips change
+    VkImageView mMaterialView = VK_NULL_HANDLE;
+    
+    static const uint32_t sMaterialSetsPerPool = 64;
+    
+    /// Pipelines are registered here, then copied into each recording slot's executor
+    RenderCommandExecutorVk mCommandExecutor;
+    uint32_t mPipelineId = 0;
+    
+    /// Draw lists recorded for every model instance, in the order their command buffers are executed
+    enum RecordedPass {
+        RECORDED_PASS_DEPTH,
+        RECORDED_PASS_LIGHTPROBE,
+        RECORDED_PASS_OPAQUE,
+        
+        NUM_RECORDED_PASSES
+    };
+    
+    /**
+     * @brief Records a contiguous range of the frame's model instances into secondary command buffers
+     * Slots are recorded in parallel on the job system, one job per slot, so each has its own command pool (pools
+     * must not be used from two threads at once). The primary command buffer then executes every slot's buffers
+     * for one pass before moving on to the next.
+     */
+    struct RecordingSlot {
+        VkCommandPool mCmdPool = VK_NULL_HANDLE;
+        VkCommandBuffer mCmdBuffers[NUM_RECORDED_PASSES] = {};
+        
+        RenderCommandList mCommands[NUM_RECORDED_PASSES];
+        RenderCommandExecutorVk mExecutor;
+        
+        /// Where each list's model matrices start, within the frame's region of the uniform buffer
+        VkDeviceSize mUniformOffsets[NUM_RECORDED_PASSES] = {};
+        
+        /// Whether mCmdBuffers holds anything to execute this frame; passes without draws are skipped
+        bool mRecorded[NUM_RECORDED_PASSES] = {};
+        
+        VkResult mResult = VK_SUCCESS;
+        
+        /// Largest any of this slot's instances draws the test texture, in pixels across
+        float mTestTextureCoverage = 0.f;
+    };
+    
+    /// Fewest model instances worth giving their own slot
+    static const uint32_t sMinInstancesPerSlot = 512;
+    
+    /// How many frames the CPU may record while the GPU is still drawing earlier ones
+    static const uint32_t sMaxFramesInFlight = 2;
+    
+    /**
+     * @brief Everything written to while recording a frame
+     * Only the frame about to be reused is waited on, so the CPU can record one frame while the GPU draws another.
+     */
+    struct FrameInFlight {
         /// Holds graphics-related commands; i.e. drawing operations
         VkCommandBuffer mGraphicsCmdBuffer = VK_NULL_HANDLE;
         
+        std::vector<RecordingSlot> mRecordingSlots;
+        
+        /// Triggered when the swapchain image to draw to has been acquired
+        VkSemaphore mSemImageAvailable = VK_NULL_HANDLE;
+        
         /**
          * Triggered when the command buffer completes (a swapchain image has been drawn to)
          * Used to synchronize the completion of a swapchain image with presentation on the screen
@@ -61,37 +153,78 @@ private:
         
         /**
          * Triggered when the command buffer completes (a swapchain image has been drawn to)
-         * Used to synchronize (wait until the command buffer completes) before modifying shared memory
+         * Used to synchronize (wait until the command buffer completes) before reusing anything in this frame
          */
         VkFence mFenceRenderFinished = VK_NULL_HANDLE;
     };
+    FrameInFlight mFramesInFlight[sMaxFramesInFlight];
+    uint32_t mFrameIndex = 0;
     
     /**
-     * Each swapchain image has its own framebuffer, etc.
-     * The indices into this vector correspond to the indices returned by Vulkan when querying the next available
-     * swapchain image.
+     * @brief Per-draw uniforms, selected with dynamic offsets
+     * The buffer is split into one region per frame in flight, and each draw takes the next mUniformStride bytes of
+     * its frame's region. This way nothing the CPU writes can still be in use by the GPU.
      */
-    std::vector<FramebufferSquad> mFramebufferSquads;
+    VkBuffer mUniformBuffer = VK_NULL_HANDLE;
+    DeviceMemoryAllocatorVk::Allocation mUniformBufferAllocation;
+    VkDeviceSize mUniformRegionSize = 0;
+    VkDeviceSize mUniformStride = 0;
     
-    /// Holds copies of all mFenceRenderFinished members in mFramebufferSquads
-    std::vector<VkFence> mAllFenceRenderFinished;
+    static const VkDeviceSize sInitialUniformRegionSize = 1 << 20;
     
-    VkBuffer mUniformBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory mUniformBufferMemory = VK_NULL_HANDLE;
+    /// Gathered from the scenegraph at the start of recording, then split up between slots
+    std::vector<ModelInstance*> mFrameInstances;
     
-    Geometry* mTestGeom = nullptr;
-    Texture* mTestTexture = nullptr;
+    /// Camera location and (projection scale * half the screen height) for the frame being recorded
+    glm::vec3 mFrameCameraLocation;
+    float mFramePixelsPerUnit = 0.f;
     
-    VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
-    VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
-    VkDescriptorSet mDescriptorSet;
+    /// Secondary command buffers to execute in the current frame, in order
+    std::vector<VkCommandBuffer> mFrameSecondaries;
+    
+    RenderCommandList::Stats mCommandStats;
     
     bool initializeDepthBuffer();
     bool initializeRenderpass();
     bool initializeFramebuffers();
-    bool initializeSemaphores();
+    bool initializeShaders();
     bool setupTestGeometry();
+    bool initializePipelineLayout();
     bool initializePipeline();
+    bool initializeFramesInFlight();
+    
+    /// Destroys everything sized to the swapchain: the framebuffers and depth image
+    void cleanupSwapchainDependents();
+    
+    /// (Re)creates the uniform buffer with regions of the given size, and finds material sets which point at it
+    bool createUniformBuffer(VkDeviceSize regionSize);
+    
+    /// Looks up the descriptor set for the test material; nothing may be using the previous one
+    bool updateMaterialSets();
+    
+    /// Registers pipelines and their material sets with mCommandExecutor, then copies it into every slot
+    void registerPipelines();
+    
+    /// Grows the uniform buffer if a frame needs more than regionSize bytes; waits for the device to idle if it does
+    bool reserveUniforms(VkDeviceSize regionSize);
+    
+    /**
+     * @brief Records slots across the job system; returns false if any secondary command buffer could not be recorded
+     * Runs before a swapchain image is acquired, so the secondaries do not name a framebuffer.
+     */
+    bool recordSecondaries(FrameInFlight& frame);
+    void recordSlotCommands(RecordingSlot& slot, std::size_t begin, std::size_t end);
+    
+    /// Approximate on-screen diameter of an instance of the test geometry in pixels, for texture streaming
+    float calcScreenCoverage(const ModelInstance* modeli) const;
+    void recordSlotSecondaries(RecordingSlot& slot, void* uniforms, VkDeviceSize uniformOffset, const glm::mat4& viewProj);
+    
+    /**
+     * @brief Submits a batch which only waits on the frame's image available semaphore and signals its fence
+     * For when a frame cannot be drawn after an image was acquired. Leaving the semaphore signaled would make the
+     * next acquire with it invalid, and leaving the fence unsignaled would stall the next use of the frame forever.
+     */
+    void submitWithoutDrawing(FrameInFlight& frame);
     
     Scenegraph* mScenegraph = nullptr;
 public:
@@ -108,22 +241,29 @@ public:
      * @brief Completely renders a frame and displays it onto the screen.
      * 
      * Does the following internally:
+     *  - Waits for the oldest frame in flight, so that its command buffers and uniforms can be safely reused
      *  - Acquire the next swapchain image
-     *  - Synchronizes with GPU so uniform buffers and such can be safely written to
      */
     void renderFrame();
     
-    void modelimapUniformBufferUpdate(ModelInstance* modeli);
-    
-    void modelimapDepthPass(ModelInstance* modeli);
-    void modelimapLightprobe(ModelInstance* modeli);
-    void modelimapOpaque(ModelInstance* modeli, VkCommandBuffer cmdBuff);
+    void modelimapDepthPass(ModelInstance* modeli, RenderCommandList* commands);
+    void modelimapLightprobe(ModelInstance* modeli, RenderCommandList* commands);
+    void modelimapOpaque(ModelInstance* modeli, RenderCommandList* commands);
     void modelimapTransparent(ModelInstance* modeli);
     
     void onModeliAdded(ModelInstance* modeli);
     void onModeliRemoved(ModelInstance* modeli);
     
+    /**
+     * @brief Recreates whatever depends on the swapchain, after it has been rebuilt
+     * Pipelines come out of mPipelineStates, so only a change of swapchain format creates any new ones.
+     */
     void rebuildPipeline();
+    
+    PipelineStateCacheVk::Stats getPipelineStats() const;
+    
+    /// Statistics for the most recently recorded frame, summed over all passes and slots
+    const RenderCommandList::Stats& getCommandStats() const;
 };
 typedef ShoRendererVk ShoRenderer;
 
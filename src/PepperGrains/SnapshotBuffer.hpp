@@ -0,0 +1,107 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_SNAPSHOTBUFFER_HPP
+#define PGG_SNAPSHOTBUFFER_HPP
+
+#include <condition_variable>
+#include <mutex>
+
+namespace pgg {
+
+/**
+ * Double-buffered hand-off of render state from the simulation thread to the render thread.
+ *
+ * The simulation thread fills the back buffer (beginWrite(), then publish()) while the render thread
+ * reads the front buffer (acquire()). The two buffers are swapped when the render thread acquires a
+ * newly published snapshot.
+ *
+ * The render thread never blocks: if nothing new was published, it keeps the snapshot it already has.
+ * The simulation thread blocks in beginWrite() only if it is more than one snapshot ahead of rendering.
+ */
+template <typename T> class SnapshotBuffer {
+private:
+    T mBuffers[2];
+
+    /// Index of the buffer owned by the render thread
+    int mFront;
+
+    /// True when the back buffer holds a published snapshot that has not yet been acquired
+    bool mBackReady;
+
+    /// (Render thread only) True once a published snapshot has been swapped to the front
+    bool mFrontValid;
+
+    std::mutex mMutex;
+    std::condition_variable mBackFreed;
+
+public:
+    SnapshotBuffer()
+    : mFront(0)
+    , mBackReady(false)
+    , mFrontValid(false) { }
+
+    SnapshotBuffer(const SnapshotBuffer&) = delete;
+    SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+    /**
+     * @brief (Simulation thread) Get the back buffer for writing, waiting until the render thread has
+     * taken the previously published snapshot
+     * @return the back buffer, which holds the snapshot from two publishes ago
+     */
+    T& beginWrite() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mBackFreed.wait(lock, [this]() { return !mBackReady; });
+        return mBuffers[1 - mFront];
+    }
+
+    /**
+     * @brief (Simulation thread) Make the back buffer available to the render thread
+     */
+    void publish() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBackReady = true;
+    }
+
+    /**
+     * @brief (Render thread) Swap in the latest published snapshot, if any
+     * @return the front buffer, which remains valid and unchanged until the next call to acquire()
+     */
+    const T& acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(mBackReady) {
+                mFront = 1 - mFront;
+                mBackReady = false;
+                mFrontValid = true;
+            }
+        }
+        mBackFreed.notify_one();
+        return mBuffers[mFront];
+    }
+
+    /**
+     * @brief (Render thread) Check if acquire() has ever returned a published snapshot, rather than a
+     * default-constructed one
+     */
+    bool hasSnapshot() const {
+        return mFrontValid;
+    }
+};
+
+}
+
+#endif // PGG_SNAPSHOTBUFFER_HPP
@@ -178,7 +178,7 @@ void SunLightModel::SharedResources::unload() {
     glDeleteBuffers(1, &mDLightVbo);
     glDeleteVertexArrays(1, &mDLightVao);
 }
-void SunLightModel::SharedResources::render(Renderable::Pass rendPass, const glm::mat4& modelMat, const glm::vec3& lightColor) {
+void SunLightModel::SharedResources::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat, const glm::vec3& lightColor) {
     if(rendPass.mType != Renderable::Pass::Type::GLOBAL_LIGHTS) {
         return;
     }
@@ -187,13 +187,13 @@ void SunLightModel::SharedResources::render(Renderable::Pass rendPass, const glm
     
     glUseProgram(mShaderProg->getHandle());
     
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
     
     glUniform2fv(mDiskHandle, 64, mKernels.disk);
     glUniform1fv(mNearPlaneHandle, 1, rendPass.mCascadeBorders);
     glUniform3fv(mColorHandle, 1, glm::value_ptr(lightColor));
     glUniform3fv(mDirectionHandle, 1, glm::value_ptr(lightDirection));
-    glUniform3fv(mCameraLocHandle, 1, glm::value_ptr(rendPass.mCamera.calcLocation()));
+    glUniform3fv(mCameraLocHandle, 1, glm::value_ptr(rendPass.getConstants().mCameraLocation));
     glUniform4fv(mCascadeFarsHandle, 1, glm::value_ptr(glm::vec4(
         rendPass.mCascadeBorders[1], 
         rendPass.mCascadeBorders[2], 
@@ -245,7 +245,7 @@ void SunLightModel::unload() {
     mSharedRes->drop();
 }
 
-void SunLightModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void SunLightModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
     mSharedRes->render(rendPass, modelMat, mColor);
 }
 
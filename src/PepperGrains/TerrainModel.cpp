@@ -174,7 +174,7 @@ void TerrainModel::unload() {
 
     delete this;
 }
-void TerrainModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void TerrainModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
 
     if(rendPass.mType != Renderable::Pass::Type::GEOMETRY && rendPass.mType != Renderable::Pass::Type::SHADOW) {
         return;
@@ -182,7 +182,7 @@ void TerrainModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat)
     
     glUseProgram(mShaderProg->getHandle());
 
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
 
     glBindVertexArray(mVertexArrayObject);
 
@@ -142,7 +142,7 @@ void TessModel::unload() {
 
     delete this;
 }
-void TessModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void TessModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
     
     if(rendPass.mType != Renderable::Pass::Type::GEOMETRY && rendPass.mType != Renderable::Pass::Type::SHADOW) {
         return;
@@ -150,13 +150,13 @@ void TessModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
     
     glUseProgram(mShaderProg->getHandle());
 
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
     
     glActiveTexture(GL_TEXTURE0 + 0);
     glBindTexture(GL_TEXTURE_2D, mHeightTexture->getHandle());
     glUniform1i(mHeightMap, 0);
 
-    glUniform3fv(mCamPos, 1, glm::value_ptr(rendPass.mCamera.calcLocation()));
+    glUniform3fv(mCamPos, 1, glm::value_ptr(rendPass.getConstants().mCameraLocation));
     glUniform1f(mMinTess, 1.f);
     glUniform1f(mMaxTess, 32.f);
     glUniform1f(mMinDist, 0.5f);
@@ -129,11 +129,11 @@ void TextModel::unload() {
     delete this;
 }
 
-void TextModel::render(Renderable::Pass rendPass, const glm::mat4& modelMat) {
+void TextModel::render(const Renderable::Pass& rendPass, const glm::mat4& modelMat) {
 
     glUseProgram(mShaderProg->getHandle());
     
-    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.mCamera.getViewMatrix(), rendPass.mCamera.getProjMatrix());
+    mShaderProg->bindModelViewProjMatrices(modelMat, rendPass.getConstants());
 
     mFont->bindTextures();
 
@@ -161,6 +161,8 @@ void TextureResource::load() {
         samplerCargs.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         samplerCargs.pNext = nullptr;
         samplerCargs.flags = 0;
+        samplerCargs.magFilter = VK_FILTER_LINEAR;
+        samplerCargs.minFilter = VK_FILTER_LINEAR;
         samplerCargs.addressModeU = toSamplerAddressMode(textureData["wrapX"], VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
         samplerCargs.addressModeV = toSamplerAddressMode(textureData["wrapY"], VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
         samplerCargs.addressModeW = toSamplerAddressMode(textureData["wrapZ"], VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
@@ -173,7 +175,7 @@ void TextureResource::load() {
         samplerCargs.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         samplerCargs.mipLodBias = 0.f;
         samplerCargs.minLod = 0.f;
-        samplerCargs.maxLod = 0.f;
+        samplerCargs.maxLod = static_cast<float>(mImage->getNumMipLevels());
     }
     
     result = vkCreateSampler(Video::Vulkan::getLogicalDevice(), &samplerCargs, nullptr, &mSamplerHandle);
@@ -211,4 +213,23 @@ Image* TextureResource::getImage() const {
     return mImage;
 }
 
+ImageResource* TextureResource::findImageToLoad() const {
+    if(mLoaded) {
+        return nullptr;
+    }
+    
+    Json::Value textureData;
+    {
+        std::ifstream loader(this->getFile().string().c_str());
+        loader >> textureData;
+        loader.close();
+    }
+    
+    Resource* resource = Resources::find(textureData["image"].asString());
+    if(!resource || resource->mResourceType != Resource::Type::IMAGE) {
+        return nullptr;
+    }
+    return static_cast<ImageResource*>(resource);
+}
+
 }
@@ -25,6 +25,8 @@
 
 namespace pgg {
 
+class ImageResource;
+
 class TextureResource : public Texture, public Resource {
 private:
     #ifdef PGG_OPENGL
@@ -56,6 +58,9 @@ public:
     #endif // PGG_VULKAN
     
     Image* getImage() const;
+    
+    /// Image resource that loading this texture would load, without loading either; nullptr if already loaded
+    ImageResource* findImageToLoad() const;
 };
 
 }
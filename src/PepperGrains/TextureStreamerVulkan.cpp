@@ -0,0 +1,339 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifdef PGG_VULKAN
+
+#include "TextureStreamerVulkan.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "DescriptorSetCacheVulkan.hpp"
+#include "ImageResource.hpp"
+#include "Logger.hpp"
+#include "Video.hpp"
+#include "VulkanUtils.hpp"
+
+namespace pgg {
+
+TextureStreamerVk::Stats::Stats()
+: mNumImages(0)
+, mResidentBytes(0)
+, mBudget(0)
+, mNumPromotions(0)
+, mNumEvictions(0)
+, mBytesStreamed(0)
+, mNumFailures(0)
+, mNumReading(0) { }
+
+TextureStreamerVk::TextureStreamerVk() { }
+TextureStreamerVk::~TextureStreamerVk() { }
+
+bool TextureStreamerVk::initialize(VkDeviceSize budget, VkDeviceSize uploadBytesPerUpdate) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    mBudget = budget;
+    mUploadBytesPerUpdate = uploadBytesPerUpdate;
+    mUpdate = 0;
+    mStats = Stats();
+    
+    Logger::log(Logger::VERBOSE) << "Texture streaming budget: " << (mBudget / (1024 * 1024)) << " MiB" << std::endl;
+    return true;
+}
+
+void TextureStreamerVk::cleanup() {
+    // Images unloaded first have no reads left; waiting on any others keeps their jobs from writing to freed memory
+    std::vector<std::unique_ptr<PendingRead> > reads;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(std::pair<const Image* const, Entry>& pair : mEntries) {
+            if(pair.second.mPendingRead) {
+                reads.push_back(std::move(pair.second.mPendingRead));
+            }
+        }
+    }
+    for(std::unique_ptr<PendingRead>& read : reads) {
+        Jobs::wait(&(read->mCounter));
+    }
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    vkDeviceWaitIdle(Video::Vulkan::getLogicalDevice());
+    for(const RetiredImage& retired : mRetired) {
+        this->destroyRetired(retired);
+    }
+    mRetired.clear();
+    mEntries.clear();
+}
+
+void TextureStreamerVk::setBudget(VkDeviceSize budget) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(budget == mBudget) {
+        return;
+    }
+    mBudget = budget;
+    
+    // Changes which failed, such as for want of device memory, may succeed with a different budget
+    for(std::pair<const Image* const, Entry>& pair : mEntries) {
+        pair.second.mRetryUpdate = 0;
+    }
+}
+
+VkDeviceSize TextureStreamerVk::getBudget() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBudget;
+}
+
+void TextureStreamerVk::addImage(ImageResource* image) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    Entry& entry = mEntries[image];
+    entry = Entry();
+    entry.mImage = image;
+}
+
+void TextureStreamerVk::removeImage(ImageResource* image) {
+    std::unique_ptr<PendingRead> read;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        
+        std::unordered_map<const Image*, Entry>::iterator iter = mEntries.find(image);
+        if(iter == mEntries.end()) {
+            return;
+        }
+        read = std::move(iter->second.mPendingRead);
+        
+        // The image destroys its current levels itself; replaced ones are still destroyed from here
+        mEntries.erase(iter);
+    }
+    
+    // The job reads from the image, so it must finish before the image unloads; waiting runs other jobs, which may
+    // need the lock
+    if(read) {
+        Jobs::wait(&(read->mCounter));
+    }
+}
+
+void TextureStreamerVk::requestCoverage(const Image* image, float pixels) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    std::unordered_map<const Image*, Entry>::iterator iter = mEntries.find(image);
+    if(iter == mEntries.end()) {
+        return;
+    }
+    
+    Entry& entry = iter->second;
+    entry.mRequestedCoverage = std::max(entry.mRequestedCoverage, pixels);
+    entry.mRequested = true;
+}
+
+uint32_t TextureStreamerVk::calcDesiredBase(const Entry& entry) const {
+    uint32_t floorLevel = entry.mImage->getMinResidentBaseLevel();
+    
+    bool seen = entry.mLastSeen > 0 && mUpdate - entry.mLastSeen <= sUnseenUpdates;
+    if(!seen || entry.mCoverage <= 0.f) {
+        return floorLevel;
+    }
+    
+    float size = static_cast<float>(std::max(entry.mImage->getWidth(), entry.mImage->getHeight()));
+    if(size <= entry.mCoverage) {
+        return 0;
+    }
+    
+    // Each level halves the size
+    uint32_t level = static_cast<uint32_t>(std::floor(std::log2(size / entry.mCoverage)));
+    return std::min(level, floorLevel);
+}
+
+bool TextureStreamerVk::canStartRead(const Entry& entry) const {
+    return !entry.mPendingRead && entry.mRetryUpdate <= mUpdate;
+}
+
+void TextureStreamerVk::startRead(Entry& entry, uint32_t baseLevel) {
+    entry.mPendingRead.reset(new PendingRead());
+    PendingRead* read = entry.mPendingRead.get();
+    read->mBaseLevel = baseLevel;
+    
+    const ImageResource* image = entry.mImage;
+    Jobs::run([image, read]() {
+        read->mSuccess = image->readCachedLevels(read->mBaseLevel, read->mData);
+    }, &(read->mCounter));
+}
+
+bool TextureStreamerVk::changeResidency(Entry& entry, uint32_t baseLevel, const std::vector<uint8_t>& data) {
+    RetiredImage retired;
+    if(!entry.mImage->changeResidency(baseLevel, data, &retired.mImage, &retired.mView, &retired.mAllocation)) {
+        this->markFailed(entry);
+        return false;
+    }
+    
+    retired.mUpdate = mUpdate;
+    mRetired.push_back(retired);
+    return true;
+}
+
+void TextureStreamerVk::markFailed(Entry& entry) {
+    entry.mRetryUpdate = mUpdate + sFailureRetryUpdates;
+    ++ mStats.mNumFailures;
+}
+
+void TextureStreamerVk::destroyRetired(const RetiredImage& retired) {
+    RetiredImage destroyed = retired;
+    DescriptorSetCacheVk::forgetImageViewInAll(destroyed.mView);
+    vkDestroyImageView(Video::Vulkan::getLogicalDevice(), destroyed.mView, nullptr);
+    Video::Vulkan::Utils::imageDestroyAndFree(&destroyed.mImage, &destroyed.mAllocation);
+}
+
+void TextureStreamerVk::update(uint32_t framesInFlight) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    ++ mUpdate;
+    
+    // Frames recorded before an image was replaced may still sample it until they complete
+    while(!mRetired.empty() && mRetired.front().mUpdate + framesInFlight <= mUpdate) {
+        this->destroyRetired(mRetired.front());
+        mRetired.pop_front();
+    }
+    
+    std::vector<Entry*> order;
+    order.reserve(mEntries.size());
+    for(std::pair<const Image* const, Entry>& pair : mEntries) {
+        Entry& entry = pair.second;
+        if(entry.mRequested) {
+            entry.mCoverage = entry.mRequestedCoverage;
+            entry.mLastSeen = mUpdate;
+        }
+        entry.mRequested = false;
+        entry.mRequestedCoverage = 0.f;
+        order.push_back(&entry);
+    }
+    
+    // Largest on screen first, then whatever is not seen anymore, most recently seen first
+    uint64_t update = mUpdate;
+    std::sort(order.begin(), order.end(), [update](const Entry* a, const Entry* b) {
+        bool seenA = a->mLastSeen > 0 && update - a->mLastSeen <= sUnseenUpdates;
+        bool seenB = b->mLastSeen > 0 && update - b->mLastSeen <= sUnseenUpdates;
+        if(seenA != seenB) {
+            return seenA;
+        }
+        if(seenA && a->mCoverage != b->mCoverage) {
+            return a->mCoverage > b->mCoverage;
+        }
+        return a->mLastSeen > b->mLastSeen;
+    });
+    
+    // The smallest levels are always resident
+    VkDeviceSize used = 0;
+    for(Entry* entry : order) {
+        entry->mTargetBase = entry->mImage->getMinResidentBaseLevel();
+        used += entry->mImage->calcResidentBytes(entry->mTargetBase);
+    }
+    
+    // Give each image the detail it is drawn at, or as much of it as still fits
+    for(Entry* entry : order) {
+        ImageResource* image = entry->mImage;
+        VkDeviceSize floorBytes = image->calcResidentBytes(entry->mTargetBase);
+        for(uint32_t level = this->calcDesiredBase(*entry); level < entry->mTargetBase; ++ level) {
+            VkDeviceSize extra = image->calcResidentBytes(level) - floorBytes;
+            if(used + extra <= mBudget) {
+                entry->mTargetBase = level;
+                used += extra;
+                break;
+            }
+        }
+    }
+    
+    // Spare room lets images keep levels they no longer need, so they are not streamed in again as soon as they are
+    for(Entry* entry : order) {
+        ImageResource* image = entry->mImage;
+        uint32_t current = image->getResidentBaseLevel();
+        if(current < entry->mTargetBase) {
+            VkDeviceSize extra = image->calcResidentBytes(current) - image->calcResidentBytes(entry->mTargetBase);
+            if(used + extra <= mBudget) {
+                entry->mTargetBase = current;
+                used += extra;
+            }
+        }
+    }
+    
+    // Levels read since the last update are used if the image still wants them; otherwise they are read again below
+    for(Entry* entry : order) {
+        if(!entry->mPendingRead || !entry->mPendingRead->mCounter.isDone()) {
+            continue;
+        }
+        std::unique_ptr<PendingRead> read = std::move(entry->mPendingRead);
+        ImageResource* image = entry->mImage;
+        if(!read->mSuccess) {
+            Logger::log(Logger::WARN) << "Could not read cached mip levels of " << image->getName() << std::endl;
+            this->markFailed(*entry);
+            continue;
+        }
+        if(read->mBaseLevel != entry->mTargetBase) {
+            continue;
+        }
+        
+        bool eviction = read->mBaseLevel > image->getResidentBaseLevel();
+        if(this->changeResidency(*entry, read->mBaseLevel, read->mData)) {
+            if(eviction) {
+                ++ mStats.mNumEvictions;
+            } else {
+                ++ mStats.mNumPromotions;
+                mStats.mBytesStreamed += read->mData.size();
+            }
+        }
+    }
+    
+    // Evictions first, so their memory is free for the promotions
+    for(Entry* entry : order) {
+        if(this->canStartRead(*entry) && entry->mTargetBase > entry->mImage->getResidentBaseLevel()) {
+            this->startRead(*entry, entry->mTargetBase);
+        }
+    }
+    
+    // Promotions beyond this update's share are left for later updates, which decide again
+    VkDeviceSize streamed = 0;
+    for(Entry* entry : order) {
+        if(streamed >= mUploadBytesPerUpdate) {
+            break;
+        }
+        if(this->canStartRead(*entry) && entry->mTargetBase < entry->mImage->getResidentBaseLevel()) {
+            this->startRead(*entry, entry->mTargetBase);
+            streamed += entry->mImage->calcResidentBytes(entry->mTargetBase);
+        }
+    }
+    
+    mStats.mNumImages = mEntries.size();
+    mStats.mResidentBytes = 0;
+    mStats.mNumReading = 0;
+    for(Entry* entry : order) {
+        mStats.mResidentBytes += entry->mImage->calcResidentBytes(entry->mImage->getResidentBaseLevel());
+        if(entry->mPendingRead) {
+            ++ mStats.mNumReading;
+        }
+    }
+    mStats.mBudget = mBudget;
+}
+
+TextureStreamerVk::Stats TextureStreamerVk::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+}
+
+#endif // PGG_VULKAN
@@ -0,0 +1,191 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef PGG_TEXTURESTREAMERVULKAN_HPP
+#define PGG_TEXTURESTREAMERVULKAN_HPP
+
+#ifdef PGG_VULKAN
+
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+#include "DeviceMemoryAllocatorVulkan.hpp"
+#include "Jobs.hpp"
+
+namespace pgg {
+
+class Image;
+class ImageResource;
+
+/**
+ * @brief Keeps only as much of each streamed image's mip chain in device memory as it is drawn at, within a budget
+ * 
+ * Streamed images start out with only their smallest levels resident, so that loading is fast. Each frame, the
+ * renderer reports how large images appear on screen with requestCoverage(). update() then gives every image the
+ * level at which one texel covers about one pixel, in order of on-screen size, and evicts the top levels of images
+ * which are smaller or no longer seen when the budget requires it. Levels of unseen images are only evicted when
+ * something else needs the memory.
+ * 
+ * The levels for a change of residency are read from the image cache by a job, and the change is made by the first
+ * update() after the read finishes, if the image still wants those levels. Vulkan images cannot change size once
+ * created, so a change of residency replaces the image (and its view) with a new one. Replaced images are destroyed only after the frames which may still sample them have completed; anything
+ * holding on to a streamed image's view, such as a descriptor set, must look it up again after each update().
+ * 
+ * Thread-safe, though update() must not run while a streamed image is being unloaded.
+ */
+class TextureStreamerVk {
+public:
+    /// Most bytes to stream in during one update(), though at least one image is always promoted
+    static const VkDeviceSize sDefaultUploadBytesPerUpdate = 16 * 1024 * 1024;
+    
+    /// Updates without any request before an image is considered unseen
+    static const uint32_t sUnseenUpdates = 120;
+    
+    /// Updates after a failed residency change before that image is changed again, unless the budget changes first
+    static const uint32_t sFailureRetryUpdates = 300;
+    
+    struct Stats {
+        Stats();
+        
+        uint32_t mNumImages;
+        
+        /// Estimated from the size of the resident levels' data
+        VkDeviceSize mResidentBytes;
+        VkDeviceSize mBudget;
+        
+        uint32_t mNumPromotions;
+        uint32_t mNumEvictions;
+        VkDeviceSize mBytesStreamed;
+        
+        /// Residency changes which could not be made, e.g. because the cached levels could not be read
+        uint32_t mNumFailures;
+        
+        /// Residency changes waiting for their levels to be read
+        uint32_t mNumReading;
+    };
+    
+private:
+    /// Levels being read from the cache by a job
+    struct PendingRead {
+        uint32_t mBaseLevel = 0;
+        std::vector<uint8_t> mData;
+        bool mSuccess = false;
+        
+        /// Done once the job has finished; the read must not be destroyed before then
+        Jobs::Counter mCounter;
+    };
+    
+    struct Entry {
+        ImageResource* mImage = nullptr;
+        
+        /// Largest coverage requested since the last update
+        float mRequestedCoverage = 0.f;
+        bool mRequested = false;
+        
+        /// Coverage as of the most recent update with a request
+        float mCoverage = 0.f;
+        uint64_t mLastSeen = 0;
+        
+        /// Base level chosen during the current update
+        uint32_t mTargetBase = 0;
+        
+        /// Null unless a residency change is waiting on the cache
+        std::unique_ptr<PendingRead> mPendingRead;
+        
+        /// Images which could not be changed are left as they are until this update, rather than retried every update
+        uint64_t mRetryUpdate = 0;
+    };
+    
+    std::unordered_map<const Image*, Entry> mEntries;
+    
+    struct RetiredImage {
+        VkImage mImage;
+        VkImageView mView;
+        DeviceMemoryAllocatorVk::Allocation mAllocation;
+        
+        /// Update during which the image was replaced
+        uint64_t mUpdate;
+    };
+    std::deque<RetiredImage> mRetired;
+    
+    uint64_t mUpdate = 0;
+    
+    VkDeviceSize mBudget = 0;
+    VkDeviceSize mUploadBytesPerUpdate = sDefaultUploadBytesPerUpdate;
+    
+    Stats mStats;
+    
+    std::mutex mMutex;
+    
+    /// Most detailed level worth having resident for the entry, given its coverage
+    uint32_t calcDesiredBase(const Entry& entry) const;
+    
+    /// Whether a read can be started for the entry during the current update
+    bool canStartRead(const Entry& entry) const;
+    void startRead(Entry& entry, uint32_t baseLevel);
+    
+    /// Returns false if the image could not be changed; it keeps its previous residency in that case
+    bool changeResidency(Entry& entry, uint32_t baseLevel, const std::vector<uint8_t>& data);
+    void markFailed(Entry& entry);
+    
+    void destroyRetired(const RetiredImage& retired);
+    
+public:
+    TextureStreamerVk();
+    ~TextureStreamerVk();
+    
+    /// Budget is in bytes of resident level data; must be called after the memory allocator is ready
+    bool initialize(VkDeviceSize budget, VkDeviceSize uploadBytesPerUpdate = sDefaultUploadBytesPerUpdate);
+    
+    /// Waits for the device to idle and destroys every replaced image; streamed images must be unloaded first
+    void cleanup();
+    
+    /// A new budget also lets images whose residency could not be changed be tried again right away
+    void setBudget(VkDeviceSize budget);
+    VkDeviceSize getBudget();
+    
+    /// Called by ImageResource as it loads and unloads; removing waits for the image's read to finish, if it has one
+    void addImage(ImageResource* image);
+    void removeImage(ImageResource* image);
+    
+    /**
+     * @brief Reports that the image is drawn covering about this many pixels across
+     * Requests are combined by taking the largest until the next update(). Images which are not streamed are ignored.
+     */
+    void requestCoverage(const Image* image, float pixels);
+    
+    /**
+     * @brief Destroys replaced images, then changes residency according to the requests since the last update
+     * Changes whose levels were read since the last update are made, and reads are started for new ones.
+     * @param framesInFlight How many frames recorded before this call may still be executing on the device
+     */
+    void update(uint32_t framesInFlight);
+    
+    Stats getStats();
+};
+
+}
+
+#endif // PGG_VULKAN
+
+#endif // PGG_TEXTURESTREAMERVULKAN_HPP
@@ -0,0 +1,433 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "TlsfRangeAllocator.hpp"
+
+#include <cassert>
+
+namespace pgg {
+
+TlsfRangeAllocator::Stats::Stats()
+: mCapacity(0)
+, mUsedBytes(0)
+, mFreeBytes(0)
+, mLargestFreeRange(0)
+, mNumAllocations(0)
+, mNumFreeRanges(0) { }
+
+float TlsfRangeAllocator::Stats::getFragmentation() const {
+    if(mFreeBytes == 0) {
+        return 0.f;
+    }
+    return 1.f - ((float) mLargestFreeRange / (float) mFreeBytes);
+}
+
+TlsfRangeAllocator::Stats& TlsfRangeAllocator::Stats::operator+=(const Stats& other) {
+    mCapacity += other.mCapacity;
+    mUsedBytes += other.mUsedBytes;
+    mFreeBytes += other.mFreeBytes;
+    if(other.mLargestFreeRange > mLargestFreeRange) {
+        mLargestFreeRange = other.mLargestFreeRange;
+    }
+    mNumAllocations += other.mNumAllocations;
+    mNumFreeRanges += other.mNumFreeRanges;
+    return *this;
+}
+
+TlsfRangeAllocator::TlsfRangeAllocator(uint64_t capacity, uint64_t granularity)
+: mCapacity(capacity)
+, mGranularity(granularity < 1 ? 1 : granularity)
+, mUnusedRanges(sNone)
+, mFirstLevelBitmap(0)
+, mUsedBytes(0)
+, mNumAllocations(0) {
+    assert((mGranularity & (mGranularity - 1)) == 0 && "Granularity must be a power of two");
+    
+    for(uint32_t fl = 0; fl < sFirstLevelCount; ++ fl) {
+        mSecondLevelBitmaps[fl] = 0;
+        for(uint32_t sl = 0; sl < sSecondLevelCount; ++ sl) {
+            mFreeLists[fl][sl] = sNone;
+        }
+    }
+    
+    if(mCapacity > 0) {
+        uint32_t index = newRange();
+        Range& range = mRanges[index];
+        range.mOffset = 0;
+        range.mSize = mCapacity;
+        range.mPrevPhys = sNone;
+        range.mNextPhys = sNone;
+        range.mKind = 0;
+        range.mFree = true;
+        insertFree(index);
+    }
+}
+
+TlsfRangeAllocator::~TlsfRangeAllocator() { }
+
+uint32_t TlsfRangeAllocator::log2(uint64_t x) {
+    assert(x > 0);
+    #if defined(__GNUC__)
+    return 63 - __builtin_clzll(x);
+    #else
+    uint32_t result = 0;
+    while(x >>= 1) {
+        ++ result;
+    }
+    return result;
+    #endif
+}
+
+namespace {
+    uint32_t lowestBit(uint64_t x) {
+        assert(x > 0);
+        #if defined(__GNUC__)
+        return __builtin_ctzll(x);
+        #else
+        uint32_t result = 0;
+        while(!(x & 1)) {
+            x >>= 1;
+            ++ result;
+        }
+        return result;
+        #endif
+    }
+    
+    uint64_t alignUp(uint64_t x, uint64_t alignment) {
+        return (x + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+void TlsfRangeAllocator::mapInsert(uint64_t size, uint32_t& fl, uint32_t& sl) {
+    if(size < sSmallSize) {
+        fl = 0;
+        sl = (uint32_t) (size >> (sSmallLog - sSecondLevelLog));
+    } else {
+        uint32_t f = log2(size);
+        fl = f - sSmallLog + 1;
+        sl = (uint32_t) (size >> (f - sSecondLevelLog)) - sSecondLevelCount;
+    }
+}
+
+void TlsfRangeAllocator::mapSearch(uint64_t size, uint32_t& fl, uint32_t& sl) {
+    // Round up to the next list boundary, so that any range in the resulting list is large enough
+    if(size < sSmallSize) {
+        size += (sSmallSize >> sSecondLevelLog) - 1;
+    } else {
+        uint64_t round = (((uint64_t) 1) << (log2(size) - sSecondLevelLog)) - 1;
+        if(size + round > size) {
+            size += round;
+        }
+    }
+    mapInsert(size, fl, sl);
+}
+
+uint32_t TlsfRangeAllocator::newRange() {
+    if(mUnusedRanges != sNone) {
+        uint32_t index = mUnusedRanges;
+        mUnusedRanges = mRanges[index].mNextFree;
+        return index;
+    }
+    mRanges.push_back(Range());
+    return mRanges.size() - 1;
+}
+
+void TlsfRangeAllocator::releaseRange(uint32_t index) {
+    Range& range = mRanges[index];
+    
+    // Marked free, so that freeing a stale handle trips the assertion in free()
+    range.mFree = true;
+    range.mSize = 0;
+    range.mNextFree = mUnusedRanges;
+    mUnusedRanges = index;
+}
+
+void TlsfRangeAllocator::insertFree(uint32_t index) {
+    Range& range = mRanges[index];
+    uint32_t fl, sl;
+    mapInsert(range.mSize, fl, sl);
+    
+    uint32_t head = mFreeLists[fl][sl];
+    range.mPrevFree = sNone;
+    range.mNextFree = head;
+    if(head != sNone) {
+        mRanges[head].mPrevFree = index;
+    }
+    mFreeLists[fl][sl] = index;
+    
+    mFirstLevelBitmap |= ((uint64_t) 1) << fl;
+    mSecondLevelBitmaps[fl] |= 1u << sl;
+}
+
+void TlsfRangeAllocator::removeFree(uint32_t index) {
+    Range& range = mRanges[index];
+    
+    if(range.mPrevFree != sNone) {
+        mRanges[range.mPrevFree].mNextFree = range.mNextFree;
+    } else {
+        uint32_t fl, sl;
+        mapInsert(range.mSize, fl, sl);
+        assert(mFreeLists[fl][sl] == index);
+        
+        mFreeLists[fl][sl] = range.mNextFree;
+        if(range.mNextFree == sNone) {
+            mSecondLevelBitmaps[fl] &= ~(1u << sl);
+            if(!mSecondLevelBitmaps[fl]) {
+                mFirstLevelBitmap &= ~(((uint64_t) 1) << fl);
+            }
+        }
+    }
+    if(range.mNextFree != sNone) {
+        mRanges[range.mNextFree].mPrevFree = range.mPrevFree;
+    }
+}
+
+bool TlsfRangeAllocator::findNonEmptyList(uint32_t& fl, uint32_t& sl) const {
+    if(fl >= sFirstLevelCount) {
+        return false;
+    }
+    
+    uint32_t secondLevel = mSecondLevelBitmaps[fl] & (~0u << sl);
+    if(secondLevel) {
+        sl = lowestBit(secondLevel);
+        return true;
+    }
+    
+    uint64_t firstLevel = (fl + 1 < 64) ? mFirstLevelBitmap & (~((uint64_t) 0) << (fl + 1)) : 0;
+    if(!firstLevel) {
+        return false;
+    }
+    fl = lowestBit(firstLevel);
+    sl = lowestBit(mSecondLevelBitmaps[fl]);
+    return true;
+}
+
+bool TlsfRangeAllocator::onSamePage(uint64_t a, uint64_t b) const {
+    return (a & ~(mGranularity - 1)) == (b & ~(mGranularity - 1));
+}
+
+bool TlsfRangeAllocator::fits(uint32_t index, uint64_t size, uint64_t alignment, uint32_t kind, uint64_t& offset) const {
+    const Range& range = mRanges[index];
+    
+    uint64_t start = alignUp(range.mOffset, alignment);
+    
+    // Free ranges are always merged, so physical neighbours are allocated (if they exist)
+    if(mGranularity > 1 && range.mPrevPhys != sNone) {
+        const Range& prev = mRanges[range.mPrevPhys];
+        if(prev.mKind != kind && onSamePage(prev.mOffset + prev.mSize - 1, start)) {
+            start = alignUp(start, mGranularity);
+        }
+    }
+    
+    uint64_t padding = start - range.mOffset;
+    if(padding > range.mSize || range.mSize - padding < size) {
+        return false;
+    }
+    
+    if(mGranularity > 1 && range.mNextPhys != sNone) {
+        const Range& next = mRanges[range.mNextPhys];
+        if(next.mKind != kind && onSamePage(start + size - 1, next.mOffset)) {
+            return false;
+        }
+    }
+    
+    offset = start;
+    return true;
+}
+
+void TlsfRangeAllocator::take(uint32_t index, uint64_t offset, uint64_t size, uint32_t kind) {
+    removeFree(index);
+    
+    uint64_t start = mRanges[index].mOffset;
+    uint64_t end = start + mRanges[index].mSize;
+    
+    // Note that newRange() may reallocate mRanges, so references are not held across it
+    if(offset > start) {
+        uint32_t front = newRange();
+        Range& padding = mRanges[front];
+        padding.mOffset = start;
+        padding.mSize = offset - start;
+        padding.mPrevPhys = mRanges[index].mPrevPhys;
+        padding.mNextPhys = index;
+        padding.mKind = 0;
+        padding.mFree = true;
+        if(padding.mPrevPhys != sNone) {
+            mRanges[padding.mPrevPhys].mNextPhys = front;
+        }
+        mRanges[index].mPrevPhys = front;
+        insertFree(front);
+    }
+    
+    if(offset + size < end) {
+        uint32_t back = newRange();
+        Range& remainder = mRanges[back];
+        remainder.mOffset = offset + size;
+        remainder.mSize = end - (offset + size);
+        remainder.mPrevPhys = index;
+        remainder.mNextPhys = mRanges[index].mNextPhys;
+        remainder.mKind = 0;
+        remainder.mFree = true;
+        if(remainder.mNextPhys != sNone) {
+            mRanges[remainder.mNextPhys].mPrevPhys = back;
+        }
+        mRanges[index].mNextPhys = back;
+        insertFree(back);
+    }
+    
+    Range& range = mRanges[index];
+    range.mOffset = offset;
+    range.mSize = size;
+    range.mKind = kind;
+    range.mFree = false;
+    
+    mUsedBytes += size;
+    ++ mNumAllocations;
+}
+
+TlsfRangeAllocator::Handle TlsfRangeAllocator::allocate(uint64_t size, uint64_t alignment, uint32_t kind, uint64_t& offset) {
+    if(size == 0) {
+        size = 1;
+    }
+    if(alignment == 0) {
+        alignment = 1;
+    }
+    assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+    
+    if(size > mCapacity - mUsedBytes) {
+        return sInvalidHandle;
+    }
+    
+    // Good fit: start from the first list where the range is certain to fit, even after alignment, so that
+    // the head of the list can almost always be taken right away
+    uint32_t searchFl, searchSl;
+    mapSearch(size + alignment - 1, searchFl, searchSl);
+    
+    uint32_t fl = searchFl;
+    uint32_t sl = searchSl;
+    while(this->findNonEmptyList(fl, sl)) {
+        for(uint32_t index = mFreeLists[fl][sl]; index != sNone; index = mRanges[index].mNextFree) {
+            uint64_t start;
+            if(this->fits(index, size, alignment, kind, start)) {
+                this->take(index, start, size, kind);
+                offset = start;
+                return index;
+            }
+        }
+        
+        ++ sl;
+        if(sl == sSecondLevelCount) {
+            sl = 0;
+            ++ fl;
+        }
+    }
+    
+    // Smaller lists might still hold a range which happens to be large enough
+    mapInsert(size, fl, sl);
+    while(this->findNonEmptyList(fl, sl) && (fl < searchFl || (fl == searchFl && sl < searchSl))) {
+        for(uint32_t index = mFreeLists[fl][sl]; index != sNone; index = mRanges[index].mNextFree) {
+            uint64_t start;
+            if(this->fits(index, size, alignment, kind, start)) {
+                this->take(index, start, size, kind);
+                offset = start;
+                return index;
+            }
+        }
+        
+        ++ sl;
+        if(sl == sSecondLevelCount) {
+            sl = 0;
+            ++ fl;
+        }
+    }
+    
+    return sInvalidHandle;
+}
+
+void TlsfRangeAllocator::free(Handle handle) {
+    assert(handle < mRanges.size() && !mRanges[handle].mFree && "Invalid or already freed range");
+    
+    mUsedBytes -= mRanges[handle].mSize;
+    -- mNumAllocations;
+    
+    mRanges[handle].mFree = true;
+    mRanges[handle].mKind = 0;
+    
+    uint32_t prevIndex = mRanges[handle].mPrevPhys;
+    if(prevIndex != sNone && mRanges[prevIndex].mFree) {
+        this->removeFree(prevIndex);
+        Range& range = mRanges[handle];
+        const Range& prev = mRanges[prevIndex];
+        range.mOffset = prev.mOffset;
+        range.mSize += prev.mSize;
+        range.mPrevPhys = prev.mPrevPhys;
+        if(range.mPrevPhys != sNone) {
+            mRanges[range.mPrevPhys].mNextPhys = handle;
+        }
+        this->releaseRange(prevIndex);
+    }
+    
+    uint32_t nextIndex = mRanges[handle].mNextPhys;
+    if(nextIndex != sNone && mRanges[nextIndex].mFree) {
+        this->removeFree(nextIndex);
+        Range& range = mRanges[handle];
+        const Range& next = mRanges[nextIndex];
+        range.mSize += next.mSize;
+        range.mNextPhys = next.mNextPhys;
+        if(range.mNextPhys != sNone) {
+            mRanges[range.mNextPhys].mPrevPhys = handle;
+        }
+        this->releaseRange(nextIndex);
+    }
+    
+    this->insertFree(handle);
+}
+
+uint64_t TlsfRangeAllocator::getOffset(Handle handle) const { return mRanges[handle].mOffset; }
+uint64_t TlsfRangeAllocator::getSize(Handle handle) const { return mRanges[handle].mSize; }
+
+uint64_t TlsfRangeAllocator::getCapacity() const { return mCapacity; }
+uint64_t TlsfRangeAllocator::getGranularity() const { return mGranularity; }
+bool TlsfRangeAllocator::isEmpty() const { return mNumAllocations == 0; }
+
+TlsfRangeAllocator::Stats TlsfRangeAllocator::getStats() const {
+    Stats stats;
+    stats.mCapacity = mCapacity;
+    stats.mUsedBytes = mUsedBytes;
+    stats.mNumAllocations = mNumAllocations;
+    
+    uint32_t fl = 0;
+    uint32_t sl = 0;
+    while(this->findNonEmptyList(fl, sl)) {
+        for(uint32_t index = mFreeLists[fl][sl]; index != sNone; index = mRanges[index].mNextFree) {
+            const Range& range = mRanges[index];
+            stats.mFreeBytes += range.mSize;
+            if(range.mSize > stats.mLargestFreeRange) {
+                stats.mLargestFreeRange = range.mSize;
+            }
+            ++ stats.mNumFreeRanges;
+        }
+        
+        ++ sl;
+        if(sl == sSecondLevelCount) {
+            sl = 0;
+            ++ fl;
+        }
+    }
+    
+    return stats;
+}
+
+}
@@ -0,0 +1,152 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_TLSFRANGEALLOCATOR_HPP
+#define PGG_TLSFRANGEALLOCATOR_HPP
+
+#include <stdint.h>
+#include <vector>
+
+namespace pgg {
+
+/* Places ranges inside a fixed-size address space using a two-level segregated fit (TLSF) scheme.
+ *
+ * Nothing is ever read or written at the offsets handed out; this only keeps the books, so that it can be
+ * used for any kind of memory which must be sub-allocated (e.g. a single device memory block) and run
+ * without a graphics device.
+ *
+ * Free ranges are kept in lists segregated by size. The first level splits sizes by powers of two and the
+ * second level splits each power of two linearly, so finding a suitable free range takes constant time in the
+ * common case. Freed ranges are merged with free neighbours immediately.
+ *
+ * Each allocated range has a kind. When the granularity is more than one, two ranges of different kinds are
+ * never placed within the same granularity-aligned page (e.g. Vulkan's bufferImageGranularity, which applies
+ * between linear and optimally tiled resources).
+ */
+class TlsfRangeAllocator {
+public:
+    typedef uint32_t Handle;
+    static const Handle sInvalidHandle = 0xffffffffu;
+    
+    struct Stats {
+        Stats();
+        
+        uint64_t mCapacity;
+        uint64_t mUsedBytes;
+        uint64_t mFreeBytes;
+        uint64_t mLargestFreeRange;
+        
+        uint32_t mNumAllocations;
+        uint32_t mNumFreeRanges;
+        
+        // Zero when all free space is in one range, approaching one as it is split into many small ranges
+        float getFragmentation() const;
+        
+        Stats& operator+=(const Stats& other);
+    };
+    
+    TlsfRangeAllocator(uint64_t capacity, uint64_t granularity = 1);
+    ~TlsfRangeAllocator();
+    
+private:
+    // Second level divides each power of two into this many lists
+    static const uint32_t sSecondLevelLog = 4;
+    static const uint32_t sSecondLevelCount = 1 << sSecondLevelLog;
+    
+    // Sizes below this all share the first first-level list, split linearly
+    static const uint32_t sSmallLog = 8;
+    static const uint64_t sSmallSize = 1 << sSmallLog;
+    
+    static const uint32_t sFirstLevelCount = 64 - sSmallLog + 1;
+    
+    static const uint32_t sNone = 0xffffffffu;
+    
+    struct Range {
+        uint64_t mOffset;
+        uint64_t mSize;
+        
+        // Neighbours in the address space
+        uint32_t mPrevPhys;
+        uint32_t mNextPhys;
+        
+        // Neighbours in the free list, only meaningful when free
+        uint32_t mPrevFree;
+        uint32_t mNextFree;
+        
+        uint32_t mKind;
+        bool mFree;
+    };
+    
+    uint64_t mCapacity;
+    uint64_t mGranularity;
+    
+    // Indexed by handle; unused entries are chained through mNextFree starting at mUnusedRanges
+    std::vector<Range> mRanges;
+    uint32_t mUnusedRanges;
+    
+    uint64_t mFirstLevelBitmap;
+    uint32_t mSecondLevelBitmaps[sFirstLevelCount];
+    uint32_t mFreeLists[sFirstLevelCount][sSecondLevelCount];
+    
+    uint64_t mUsedBytes;
+    uint32_t mNumAllocations;
+    
+    static uint32_t log2(uint64_t x);
+    
+    // List which a free range of this size belongs in
+    static void mapInsert(uint64_t size, uint32_t& fl, uint32_t& sl);
+    
+    // First list in which every range is at least this size
+    static void mapSearch(uint64_t size, uint32_t& fl, uint32_t& sl);
+    
+    uint32_t newRange();
+    void releaseRange(uint32_t index);
+    
+    void insertFree(uint32_t index);
+    void removeFree(uint32_t index);
+    
+    // Next non-empty list at or after (fl, sl); returns false if there are none
+    bool findNonEmptyList(uint32_t& fl, uint32_t& sl) const;
+    
+    bool onSamePage(uint64_t a, uint64_t b) const;
+    
+    // Where a range of the given size could be placed within the free range, if anywhere
+    bool fits(uint32_t index, uint64_t size, uint64_t alignment, uint32_t kind, uint64_t& offset) const;
+    
+    // Splits the free range so that [offset, offset + size) becomes allocated
+    void take(uint32_t index, uint64_t offset, uint64_t size, uint32_t kind);
+    
+public:
+    /* Alignment must be a power of two. On success, offset is overwritten with the start of the range.
+     * Returns sInvalidHandle if there is no room.
+     */
+    Handle allocate(uint64_t size, uint64_t alignment, uint32_t kind, uint64_t& offset);
+    void free(Handle handle);
+    
+    uint64_t getOffset(Handle handle) const;
+    uint64_t getSize(Handle handle) const;
+    
+    uint64_t getCapacity() const;
+    uint64_t getGranularity() const;
+    bool isEmpty() const;
+    
+    // Walks the free lists, so this is not constant time
+    Stats getStats() const;
+};
+
+}
+
+#endif // PGG_TLSFRANGEALLOCATOR_HPP
@@ -0,0 +1,477 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef PGG_VULKAN
+
+#include "TransferBatcherVulkan.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "Logger.hpp"
+#include "Video.hpp"
+#include "VulkanUtils.hpp"
+
+namespace pgg {
+
+TransferBatcherVk::Stats::Stats()
+: mNumUploads(0)
+, mBytesStaged(0)
+, mNumSubmits(0)
+, mNumRingStalls(0)
+, mNumOversizeUploads(0) { }
+
+TransferBatcherVk::TransferBatcherVk() { }
+TransferBatcherVk::~TransferBatcherVk() { }
+
+bool TransferBatcherVk::initialize(VkDeviceSize ringSize) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    bool success = Video::Vulkan::Utils::bufferCreateAndAllocate(ringSize, 
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+        &mRingBuffer, &mRingAllocation);
+    
+    if(!success) {
+        Logger::log(Logger::SEVERE) << "Could not create staging ring buffer" << std::endl;
+        return false;
+    }
+    
+    mRingSize = ringSize;
+    mRingHead = 0;
+    mRingTail = 0;
+    mNextSerial = 1;
+    mLastCompleted = 0;
+    mStats = Stats();
+    
+    return true;
+}
+
+void TransferBatcherVk::cleanup() {
+    this->finish();
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    for(Batch* batch : mSpareBatches) {
+        vkFreeCommandBuffers(Video::Vulkan::getLogicalDevice(), Video::Vulkan::getTransferCommandPool(), 1, &(batch->mCmdBuff));
+        vkDestroyFence(Video::Vulkan::getLogicalDevice(), batch->mFence, nullptr);
+        delete batch;
+    }
+    mSpareBatches.clear();
+    
+    if(mRingBuffer != VK_NULL_HANDLE) {
+        Video::Vulkan::Utils::bufferDestroyAndFree(&mRingBuffer, &mRingAllocation);
+    }
+    mRingSize = 0;
+}
+
+TransferBatcherVk::Batch* TransferBatcherVk::beginBatch() {
+    if(mRecording) {
+        return mRecording;
+    }
+    
+    VkResult result;
+    
+    Batch* batch;
+    if(!mSpareBatches.empty()) {
+        batch = mSpareBatches.back();
+        mSpareBatches.pop_back();
+        
+        vkResetFences(Video::Vulkan::getLogicalDevice(), 1, &(batch->mFence));
+    } else {
+        batch = new Batch();
+        
+        VkCommandBufferAllocateInfo cbaArgs; {
+            cbaArgs.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            cbaArgs.pNext = nullptr;
+            cbaArgs.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            cbaArgs.commandPool = Video::Vulkan::getTransferCommandPool();
+            cbaArgs.commandBufferCount = 1;
+        }
+        
+        result = vkAllocateCommandBuffers(Video::Vulkan::getLogicalDevice(), &cbaArgs, &(batch->mCmdBuff));
+        if(result != VK_SUCCESS) {
+            Logger::log(Logger::WARN) << "Could not allocate transfer command buffer" << std::endl;
+            delete batch;
+            return nullptr;
+        }
+        
+        VkFenceCreateInfo fcArgs; {
+            fcArgs.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fcArgs.pNext = nullptr;
+            fcArgs.flags = 0;
+        }
+        
+        result = vkCreateFence(Video::Vulkan::getLogicalDevice(), &fcArgs, nullptr, &(batch->mFence));
+        if(result != VK_SUCCESS) {
+            Logger::log(Logger::WARN) << "Could not create transfer fence" << std::endl;
+            vkFreeCommandBuffers(Video::Vulkan::getLogicalDevice(), Video::Vulkan::getTransferCommandPool(), 1, &(batch->mCmdBuff));
+            delete batch;
+            return nullptr;
+        }
+    }
+    
+    VkCommandBufferBeginInfo cbbArgs; {
+        cbbArgs.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cbbArgs.pNext = nullptr;
+        cbbArgs.pInheritanceInfo = nullptr;
+        cbbArgs.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    }
+    
+    // Implicitly resets the command buffer, since the pool allows it
+    vkBeginCommandBuffer(batch->mCmdBuff, &cbbArgs);
+    
+    batch->mSerial = 0;
+    batch->mRingEnd = mRingHead;
+    
+    mRecording = batch;
+    return batch;
+}
+
+TransferBatcherVk::Serial TransferBatcherVk::submitBatch() {
+    Batch* batch = mRecording;
+    mRecording = nullptr;
+    
+    vkEndCommandBuffer(batch->mCmdBuff);
+    
+    VkSubmitInfo sArgs; {
+        sArgs.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        sArgs.pNext = nullptr;
+        sArgs.commandBufferCount = 1;
+        sArgs.pCommandBuffers = &(batch->mCmdBuff);
+        sArgs.signalSemaphoreCount = 0;
+        sArgs.waitSemaphoreCount = 0;
+    }
+    
+    vkQueueSubmit(Video::Vulkan::getTransferQueue(), 1, &sArgs, batch->mFence);
+    
+    batch->mSerial = mNextSerial ++;
+    batch->mRingEnd = mRingHead;
+    mInFlight.push_back(batch);
+    
+    ++ mStats.mNumSubmits;
+    
+    return batch->mSerial;
+}
+
+bool TransferBatcherVk::retireOldest(bool block) {
+    if(mInFlight.empty()) {
+        return false;
+    }
+    
+    Batch* batch = mInFlight.front();
+    if(block) {
+        vkWaitForFences(
+            Video::Vulkan::getLogicalDevice(), 
+            1, &(batch->mFence), 
+            VK_TRUE, 
+            std::numeric_limits<uint64_t>::max());
+    } else if(vkGetFenceStatus(Video::Vulkan::getLogicalDevice(), batch->mFence) != VK_SUCCESS) {
+        return false;
+    }
+    mInFlight.pop_front();
+    
+    mRingTail = batch->mRingEnd;
+    mLastCompleted = batch->mSerial;
+    
+    for(uint32_t i = 0; i < batch->mOversizeBuffers.size(); ++ i) {
+        Video::Vulkan::Utils::bufferDestroyAndFree(&(batch->mOversizeBuffers[i]), &(batch->mOversizeAllocations[i]));
+    }
+    batch->mOversizeBuffers.clear();
+    batch->mOversizeAllocations.clear();
+    
+    mSpareBatches.push_back(batch);
+    return true;
+}
+
+void TransferBatcherVk::retireCompleted() {
+    while(this->retireOldest(false)) { }
+}
+
+void* TransferBatcherVk::stage(VkDeviceSize size, VkDeviceSize alignment, VkBuffer* buffer, VkDeviceSize* offset) {
+    if(size > mRingSize) {
+        return nullptr;
+    }
+    
+    while(true) {
+        uint64_t phys = mRingHead % mRingSize;
+        
+        // When nothing is using the ring, start again from the beginning so that large uploads always fit
+        if(mRingHead == mRingTail && phys != 0) {
+            mRingHead += mRingSize - phys;
+            mRingTail = mRingHead;
+            phys = 0;
+        }
+        
+        // Alignments need not be powers of two (e.g. three byte texels)
+        uint64_t start = ((phys + alignment - 1) / alignment) * alignment;
+        uint64_t skip = start - phys;
+        
+        // Never split an upload across the end of the ring
+        if(start + size > mRingSize) {
+            skip = mRingSize - phys;
+            start = 0;
+        }
+        
+        if(mRingHead + skip + size - mRingTail <= mRingSize) {
+            mRingHead += skip + size;
+            (*buffer) = mRingBuffer;
+            (*offset) = start;
+            return static_cast<uint8_t*>(mRingAllocation.mMapped) + start;
+        }
+        
+        // Try to make room without waiting first
+        if(this->retireOldest(false)) {
+            continue;
+        }
+        
+        // If nothing is in flight, then the batch being recorded is what is using up the ring
+        if(mInFlight.empty()) {
+            this->submitBatch();
+        }
+        
+        ++ mStats.mNumRingStalls;
+        this->retireOldest(true);
+    }
+}
+
+void* TransferBatcherVk::stageOversize(Batch* batch, VkDeviceSize size, VkBuffer* buffer, VkDeviceSize* offset) {
+    DeviceMemoryAllocatorVk::Allocation allocation;
+    bool success = Video::Vulkan::Utils::bufferCreateAndAllocate(size, 
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+        buffer, &allocation);
+    
+    if(!success) {
+        Logger::log(Logger::WARN) << "Could not create staging buffer for " << size << " byte upload" << std::endl;
+        return nullptr;
+    }
+    
+    batch->mOversizeBuffers.push_back(*buffer);
+    batch->mOversizeAllocations.push_back(allocation);
+    
+    ++ mStats.mNumOversizeUploads;
+    
+    (*offset) = 0;
+    return allocation.mMapped;
+}
+
+namespace {
+    // Buffer offsets for image copies must be multiples of both four and the texel size
+    VkDeviceSize texelCopyAlignment(uint32_t bytesPerTexel) {
+        VkDeviceSize alignment = bytesPerTexel;
+        while(alignment % 4 != 0) {
+            alignment += bytesPerTexel;
+        }
+        return alignment;
+    }
+}
+
+TransferBatcherVk::Batch* TransferBatcherVk::reserveStaging(VkDeviceSize size, VkDeviceSize alignment, void** staged, VkBuffer* src, VkDeviceSize* srcOffset) {
+    // Staging comes first, since making room in the ring may submit the batch being recorded
+    (*staged) = this->stage(size, alignment, src, srcOffset);
+    Batch* batch = this->beginBatch();
+    if(!batch) {
+        return nullptr;
+    }
+    if(!(*staged)) {
+        (*staged) = this->stageOversize(batch, size, src, srcOffset);
+        if(!(*staged)) {
+            return nullptr;
+        }
+    }
+    
+    ++ mStats.mNumUploads;
+    mStats.mBytesStaged += size;
+    
+    return batch;
+}
+
+TransferBatcherVk::Batch* TransferBatcherVk::stageData(const void* data, VkDeviceSize size, VkDeviceSize alignment, VkBuffer* src, VkDeviceSize* srcOffset) {
+    void* staged;
+    Batch* batch = this->reserveStaging(size, alignment, &staged, src, srcOffset);
+    if(!batch) {
+        return nullptr;
+    }
+    
+    std::memcpy(staged, data, size);
+    return batch;
+}
+
+void TransferBatcherVk::uploadBuffer(VkBuffer dest, VkDeviceSize destOffset, const void* data, VkDeviceSize size) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    VkBuffer src;
+    VkDeviceSize srcOffset;
+    Batch* batch = this->stageData(data, size, 4, &src, &srcOffset);
+    if(!batch) {
+        return;
+    }
+    
+    Video::Vulkan::Utils::cmdCopyBuffer(batch->mCmdBuff, src, dest, size, srcOffset, destOffset);
+}
+
+void TransferBatcherVk::uploadImageLevel(
+    VkImage dest, uint32_t mipLevel, 
+    uint32_t width, uint32_t height, uint32_t bytesPerTexel, 
+    const void* data) {
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    VkBuffer src;
+    VkDeviceSize srcOffset;
+    Batch* batch = this->stageData(data, ((VkDeviceSize) width) * height * bytesPerTexel, texelCopyAlignment(bytesPerTexel), &src, &srcOffset);
+    if(!batch) {
+        return;
+    }
+    
+    Video::Vulkan::Utils::cmdCopyBufferToImage(batch->mCmdBuff, src, srcOffset, dest, mipLevel, width, height);
+}
+
+void TransferBatcherVk::changeImageLayout(
+    VkImage img, VkFormat format, 
+    VkImageLayout oldLayout, VkImageLayout newLayout, 
+    uint32_t levelCount) {
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    Batch* batch = this->beginBatch();
+    if(!batch) {
+        return;
+    }
+    
+    Video::Vulkan::Utils::cmdChangeImageLayout(batch->mCmdBuff, img, format, oldLayout, newLayout, levelCount);
+}
+
+void TransferBatcherVk::uploadImage(
+    VkImage dest, VkFormat format, 
+    uint32_t width, uint32_t height, uint32_t bytesPerTexel, 
+    const void* data, 
+    VkImageLayout finalLayout) {
+    
+    this->uploadImageMipChain(dest, format, width, height, 1, bytesPerTexel, false, data, finalLayout);
+}
+
+void TransferBatcherVk::uploadCompressedImage(
+    VkImage dest, VkFormat format, 
+    uint32_t width, uint32_t height, uint32_t bytesPerBlock, 
+    const void* data, 
+    VkImageLayout finalLayout) {
+    
+    this->uploadImageMipChain(dest, format, width, height, 1, bytesPerBlock, true, data, finalLayout);
+}
+
+void TransferBatcherVk::uploadImageMipChain(
+    VkImage dest, VkFormat format, 
+    uint32_t width, uint32_t height, uint32_t levelCount, 
+    uint32_t bytesPerTexel, bool blockCompressed, 
+    const void* data, 
+    VkImageLayout finalLayout) {
+    
+    // Levels are packed tightly in the source, but each one must start at a copyable offset once staged
+    VkDeviceSize alignment = texelCopyAlignment(bytesPerTexel);
+    std::vector<VkBufferImageCopy> regions(levelCount);
+    std::vector<VkDeviceSize> levelSizes(levelCount);
+    VkDeviceSize stagedSize = 0;
+    for(uint32_t level = 0; level < levelCount; ++ level) {
+        // Copies are given in texels; for compressed formats the last block in each row and column may be partial
+        if(blockCompressed) {
+            levelSizes[level] = ((VkDeviceSize) (width + 3) / 4) * ((height + 3) / 4) * bytesPerTexel;
+        } else {
+            levelSizes[level] = ((VkDeviceSize) width) * height * bytesPerTexel;
+        }
+        
+        stagedSize = (stagedSize + alignment - 1) / alignment * alignment;
+        
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = stagedSize;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {width, height, 1};
+        
+        stagedSize += levelSizes[level];
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    // Texels are staged before recording the first transition, so that all three commands end up in the same batch
+    void* staged;
+    VkBuffer src;
+    VkDeviceSize srcOffset;
+    Batch* batch = this->reserveStaging(stagedSize, alignment, &staged, &src, &srcOffset);
+    if(!batch) {
+        return;
+    }
+    
+    const uint8_t* levelData = static_cast<const uint8_t*>(data);
+    for(uint32_t level = 0; level < levelCount; ++ level) {
+        std::memcpy(static_cast<uint8_t*>(staged) + regions[level].bufferOffset, levelData, levelSizes[level]);
+        levelData += levelSizes[level];
+        regions[level].bufferOffset += srcOffset;
+    }
+    
+    Video::Vulkan::Utils::cmdChangeImageLayout(batch->mCmdBuff, dest, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount);
+    vkCmdCopyBufferToImage(batch->mCmdBuff, src, dest, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+    Video::Vulkan::Utils::cmdChangeImageLayout(batch->mCmdBuff, dest, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout, levelCount);
+}
+
+TransferBatcherVk::Serial TransferBatcherVk::flush() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    if(mRecording) {
+        return this->submitBatch();
+    }
+    return mNextSerial - 1;
+}
+
+bool TransferBatcherVk::isComplete(Serial serial) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    this->retireCompleted();
+    return serial <= mLastCompleted;
+}
+
+void TransferBatcherVk::wait(Serial serial) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    while(mLastCompleted < serial && this->retireOldest(true)) { }
+}
+
+void TransferBatcherVk::finish() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    if(mRecording) {
+        this->submitBatch();
+    }
+    while(this->retireOldest(true)) { }
+}
+
+TransferBatcherVk::Stats TransferBatcherVk::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+}
+
+#endif // PGG_VULKAN
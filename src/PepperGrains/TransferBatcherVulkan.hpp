@@ -0,0 +1,217 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_TRANSFERBATCHERVULKAN_HPP
+#define PGG_TRANSFERBATCHERVULKAN_HPP
+
+#ifdef PGG_VULKAN
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <GraphicsApiLibrary.hpp>
+
+#include "DeviceMemoryAllocatorVulkan.hpp"
+
+namespace pgg {
+
+/**
+ * @brief Batches buffer and image uploads into as few transfer queue submissions as possible
+ * 
+ * Source data is copied into a persistently mapped staging ring buffer, and the copies (along with any image layout
+ * transitions) are recorded into a single command buffer. The batch is only submitted when flush() is called or when
+ * the ring runs out of room, and each submission is tracked with its own fence, so loading many resources in a row
+ * does not wait on the GPU between them.
+ * 
+ * Ring space used by a batch is reclaimed once its fence has signaled. Uploads larger than the whole ring are
+ * staged in a temporary buffer which is freed the same way.
+ * 
+ * Anything which reads uploaded resources on another queue must wait for them, e.g. with finish().
+ * 
+ * Thread-safe.
+ */
+class TransferBatcherVk {
+public:
+    static const VkDeviceSize sDefaultRingSize = 32 * 1024 * 1024;
+    
+    /// Identifies a submission; batches complete in the order that they are submitted
+    typedef uint64_t Serial;
+    
+    struct Stats {
+        Stats();
+        
+        uint32_t mNumUploads;
+        VkDeviceSize mBytesStaged;
+        
+        uint32_t mNumSubmits;
+        
+        /// How many times recording had to wait for the GPU to free up ring space
+        uint32_t mNumRingStalls;
+        
+        /// Uploads which did not fit in the ring at all
+        uint32_t mNumOversizeUploads;
+    };
+    
+private:
+    struct Batch {
+        VkCommandBuffer mCmdBuff;
+        VkFence mFence;
+        Serial mSerial;
+        
+        /// Ring position just past the last byte staged for this batch
+        uint64_t mRingEnd;
+        
+        std::vector<VkBuffer> mOversizeBuffers;
+        std::vector<DeviceMemoryAllocatorVk::Allocation> mOversizeAllocations;
+    };
+    
+    VkBuffer mRingBuffer = VK_NULL_HANDLE;
+    DeviceMemoryAllocatorVk::Allocation mRingAllocation;
+    VkDeviceSize mRingSize = 0;
+    
+    /// Positions only ever increase; the physical offset is the position modulo the ring size.
+    /// Everything between the tail and the head is in use by the recording or in-flight batches.
+    uint64_t mRingHead = 0;
+    uint64_t mRingTail = 0;
+    
+    /// Batch currently being recorded into, or nullptr if nothing has been recorded since the last flush
+    Batch* mRecording = nullptr;
+    
+    /// Submitted batches, oldest first
+    std::deque<Batch*> mInFlight;
+    
+    /// Completed batches whose command buffers and fences can be reused
+    std::vector<Batch*> mSpareBatches;
+    
+    Serial mNextSerial = 1;
+    Serial mLastCompleted = 0;
+    
+    Stats mStats;
+    
+    std::mutex mMutex;
+    
+    /// Returns the batch being recorded into, beginning a new one if necessary
+    Batch* beginBatch();
+    
+    Serial submitBatch();
+    
+    /// Frees up the oldest in-flight batch, waiting on it if block is true; returns false if nothing was retired
+    bool retireOldest(bool block);
+    
+    /// Retires every in-flight batch which has already completed
+    void retireCompleted();
+    
+    /// Reserves staging space for the recording batch, returning nullptr if the size can never fit in the ring
+    void* stage(VkDeviceSize size, VkDeviceSize alignment, VkBuffer* buffer, VkDeviceSize* offset);
+    
+    /// Fallback for uploads which are too large for the ring
+    void* stageOversize(Batch* batch, VkDeviceSize size, VkBuffer* buffer, VkDeviceSize* offset);
+    
+    /**
+     * @brief Reserves staging memory for the batch being recorded, starting a batch if necessary
+     * @return The batch to record the copy command into, or nullptr if there was no way to stage the data
+     */
+    Batch* reserveStaging(VkDeviceSize size, VkDeviceSize alignment, void** staged, VkBuffer* src, VkDeviceSize* srcOffset);
+    
+    /// Same as reserveStaging(), also copying the source data in
+    Batch* stageData(const void* data, VkDeviceSize size, VkDeviceSize alignment, VkBuffer* src, VkDeviceSize* srcOffset);
+    
+public:
+    TransferBatcherVk();
+    ~TransferBatcherVk();
+    
+    /// Must be called after the memory allocator and transfer command pool are ready
+    bool initialize(VkDeviceSize ringSize = sDefaultRingSize);
+    
+    /// Waits for everything to complete and frees all resources
+    void cleanup();
+    
+    /**
+     * @brief Records a copy of data into a buffer which has VK_BUFFER_USAGE_TRANSFER_DST_BIT
+     * The source data is copied immediately, so it can be freed as soon as this returns.
+     */
+    void uploadBuffer(VkBuffer dest, VkDeviceSize destOffset, const void* data, VkDeviceSize size);
+    
+    /**
+     * @brief Records a copy of tightly packed texel data into one mip level of an image
+     * The image must already be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, e.g. by calling changeImageLayout().
+     * The source data is copied immediately, so it can be freed as soon as this returns.
+     */
+    void uploadImageLevel(
+        VkImage dest, uint32_t mipLevel, 
+        uint32_t width, uint32_t height, uint32_t bytesPerTexel, 
+        const void* data);
+    
+    /// Records an image layout transition covering the first levelCount mip levels
+    void changeImageLayout(
+        VkImage img, VkFormat format, 
+        VkImageLayout oldLayout, VkImageLayout newLayout, 
+        uint32_t levelCount = 1);
+    
+    /**
+     * @brief Records everything needed to fill a newly created single-level image
+     * Transitions the image to be written, copies the texels and then transitions it to finalLayout.
+     */
+    void uploadImage(
+        VkImage dest, VkFormat format, 
+        uint32_t width, uint32_t height, uint32_t bytesPerTexel, 
+        const void* data, 
+        VkImageLayout finalLayout);
+    
+    /**
+     * @brief Same as uploadImage(), but for block-compressed formats
+     * Data is rows of 4x4 texel blocks of bytesPerBlock each, with partial blocks at the right and bottom edges.
+     */
+    void uploadCompressedImage(
+        VkImage dest, VkFormat format, 
+        uint32_t width, uint32_t height, uint32_t bytesPerBlock, 
+        const void* data, 
+        VkImageLayout finalLayout);
+    
+    /**
+     * @brief Same as uploadImage(), but fills the first levelCount mip levels with a single copy command
+     * Levels are given tightly packed one after another, largest first, each half the size of the one before it
+     * (rounded down, at least 1). For block-compressed formats, bytesPerTexel is the size of a 4x4 block.
+     */
+    void uploadImageMipChain(
+        VkImage dest, VkFormat format, 
+        uint32_t width, uint32_t height, uint32_t levelCount, 
+        uint32_t bytesPerTexel, bool blockCompressed, 
+        const void* data, 
+        VkImageLayout finalLayout);
+    
+    /**
+     * @brief Submits everything recorded so far without waiting for it
+     * @return The serial of the submission, or of the most recent one if nothing new was recorded
+     */
+    Serial flush();
+    
+    bool isComplete(Serial serial);
+    void wait(Serial serial);
+    
+    /// Submits everything recorded so far and waits for all submissions to complete
+    void finish();
+    
+    Stats getStats();
+};
+
+}
+
+#endif // PGG_VULKAN
+
+#endif // PGG_TRANSFERBATCHERVULKAN_HPP
@@ -0,0 +1,510 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "TransformStore.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#include "Jobs.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PGG_TRANSFORMSTORE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace pgg {
+
+namespace {
+
+// Equivalent to translate(t) * mat4_cast(q) * scale(s), without the matrix multiplications
+inline void composeTRS(const glm::vec3& t, const glm::quat& q, const glm::vec3& s, glm::mat4& out) {
+    glm::mat3 rot = glm::mat3_cast(q);
+    out[0] = glm::vec4(rot[0] * s.x, 0.f);
+    out[1] = glm::vec4(rot[1] * s.y, 0.f);
+    out[2] = glm::vec4(rot[2] * s.z, 0.f);
+    out[3] = glm::vec4(t, 1.f);
+}
+
+// out = a * b (column-major); out must not alias b
+inline void multiplyMat4(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+    #ifdef PGG_TRANSFORMSTORE_SSE
+    const float* pa = &a[0][0];
+    const float* pb = &b[0][0];
+    __m128 a0 = _mm_loadu_ps(pa);
+    __m128 a1 = _mm_loadu_ps(pa + 4);
+    __m128 a2 = _mm_loadu_ps(pa + 8);
+    __m128 a3 = _mm_loadu_ps(pa + 12);
+    float* po = &out[0][0];
+    for(int col = 0; col < 4; ++ col) {
+        const float* bc = pb + col * 4;
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+        _mm_storeu_ps(po + col * 4, r);
+    }
+    #else
+    out = a * b;
+    #endif
+}
+
+template <typename T> void permute(std::vector<T>& data, const std::vector<uint32_t>& newToOld) {
+    std::vector<T> permuted;
+    permuted.reserve(newToOld.size());
+    for(uint32_t oldIndex : newToOld) {
+        permuted.push_back(data[oldIndex]);
+    }
+    data.swap(permuted);
+}
+
+} // namespace
+
+const TransformStore::Handle TransformStore::sNullHandle = 0xFFFFFFFF;
+
+// Approximate number of transforms given to each job
+static const uint32_t sParallelGrainSize = 1024;
+
+TransformStore::TransformStore()
+: mOrderDirty(false)
+, mBoundsDirty(false)
+, mNumUpdatedLast(0) {
+}
+
+TransformStore::~TransformStore() {
+}
+
+TransformStore::Handle TransformStore::create() {
+    Handle handle;
+    if(mFreeHandles.empty()) {
+        handle = mHandleToIndex.size();
+        mHandleToIndex.push_back(0);
+    } else {
+        handle = mFreeHandles.back();
+        mFreeHandles.pop_back();
+    }
+
+    // A new root appended to the end is still in pre-order
+    uint32_t index = mParent.size();
+    mHandleToIndex[handle] = index;
+    mLocalTranslation.push_back(glm::vec3(0.f));
+    mLocalOrientation.push_back(glm::quat());
+    mLocalScale.push_back(glm::vec3(1.f));
+    mLocalTransform.push_back(glm::mat4(1.f));
+    mWorldTransform.push_back(glm::mat4(1.f));
+    mParent.push_back(-1);
+    mSubtreeEnd.push_back(index + 1);
+    mLocalDirty.push_back(0);
+    mWorldDirty.push_back(0);
+    mIndexToHandle.push_back(handle);
+    mLocalBounds.push_back(BoundingSphere::getEmpty());
+    mWorldBounds.push_back(BoundingSphere::getEmpty());
+    mSubtreeBounds.push_back(BoundingSphere::getEmpty());
+    return handle;
+}
+
+void TransformStore::destroy(Handle handle) {
+    uint32_t index = mHandleToIndex[handle];
+    assert(mParent[index] == -1 && "Destroying transform which still has a parent");
+    mIndexToHandle[index] = sNullHandle;
+    mFreeHandles.push_back(handle);
+    mBoundsDirty = true;
+
+    // Compacted away during the next rebuild
+    mOrderDirty = true;
+}
+
+void TransformStore::setParent(Handle child, Handle parent) {
+    uint32_t childIndex = mHandleToIndex[child];
+    mParent[childIndex] = parent == sNullHandle ? -1 : (int32_t) mHandleToIndex[parent];
+    mWorldDirty[childIndex] = 1;
+    mOrderDirty = true;
+    mBoundsDirty = true;
+}
+
+void TransformStore::rebuildOrder() {
+    uint32_t oldSize = mParent.size();
+
+    // Children of each transform, as a compressed list which preserves the current relative order
+    std::vector<uint32_t> childStart(oldSize + 1, 0);
+    for(uint32_t i = 0; i < oldSize; ++ i) {
+        if(mIndexToHandle[i] != sNullHandle && mParent[i] >= 0) {
+            ++ childStart[mParent[i] + 1];
+        }
+    }
+    for(uint32_t i = 0; i < oldSize; ++ i) {
+        childStart[i + 1] += childStart[i];
+    }
+    std::vector<uint32_t> childList(childStart[oldSize]);
+    std::vector<uint32_t> childFill(childStart.begin(), childStart.end() - 1);
+    for(uint32_t i = 0; i < oldSize; ++ i) {
+        if(mIndexToHandle[i] != sNullHandle && mParent[i] >= 0) {
+            childList[childFill[mParent[i]] ++] = i;
+        }
+    }
+
+    // Depth-first traversal from every root gives the new pre-order
+    std::vector<uint32_t> newToOld;
+    newToOld.reserve(oldSize);
+    std::vector<uint32_t> stack;
+    for(uint32_t root = 0; root < oldSize; ++ root) {
+        if(mIndexToHandle[root] == sNullHandle || mParent[root] >= 0) continue;
+        stack.push_back(root);
+        while(!stack.empty()) {
+            uint32_t old = stack.back();
+            stack.pop_back();
+            newToOld.push_back(old);
+            for(uint32_t c = childStart[old + 1]; c > childStart[old]; -- c) {
+                stack.push_back(childList[c - 1]);
+            }
+        }
+    }
+    uint32_t newSize = newToOld.size();
+    std::vector<uint32_t> oldToNew(oldSize, 0);
+    for(uint32_t i = 0; i < newSize; ++ i) {
+        oldToNew[newToOld[i]] = i;
+    }
+
+    std::vector<int32_t> newParent(newSize);
+    for(uint32_t i = 0; i < newSize; ++ i) {
+        int32_t oldParent = mParent[newToOld[i]];
+        newParent[i] = oldParent < 0 ? -1 : (int32_t) oldToNew[oldParent];
+    }
+    mParent.swap(newParent);
+
+    permute(mLocalTranslation, newToOld);
+    permute(mLocalOrientation, newToOld);
+    permute(mLocalScale, newToOld);
+    permute(mLocalTransform, newToOld);
+    permute(mWorldTransform, newToOld);
+    permute(mLocalDirty, newToOld);
+    permute(mWorldDirty, newToOld);
+    permute(mIndexToHandle, newToOld);
+    permute(mLocalBounds, newToOld);
+    permute(mWorldBounds, newToOld);
+    permute(mSubtreeBounds, newToOld);
+    for(uint32_t i = 0; i < newSize; ++ i) {
+        mHandleToIndex[mIndexToHandle[i]] = i;
+    }
+
+    // Children always follow their parent, so accumulating backwards gives subtree sizes
+    mSubtreeEnd.assign(newSize, 1);
+    for(uint32_t i = newSize; i -- > 0;) {
+        if(mParent[i] >= 0) {
+            mSubtreeEnd[mParent[i]] += mSubtreeEnd[i];
+        }
+    }
+    for(uint32_t i = 0; i < newSize; ++ i) {
+        mSubtreeEnd[i] += i;
+    }
+
+    // Restore the invariant that dirty transforms have only dirty descendants
+    for(uint32_t i = 0; i < newSize; ++ i) {
+        if(mParent[i] >= 0 && mWorldDirty[mParent[i]]) {
+            mWorldDirty[i] = 1;
+        }
+    }
+
+    mOrderDirty = false;
+}
+
+void TransformStore::markLocalDirty(uint32_t index) {
+    mLocalDirty[index] = 1;
+    this->markWorldDirty(index);
+}
+
+void TransformStore::markWorldDirty(uint32_t index) {
+    // Descendants are made dirty by rebuildOrder()
+    if(mOrderDirty) {
+        mWorldDirty[index] = 1;
+        return;
+    }
+
+    // Already dirty implies all descendants are too
+    if(mWorldDirty[index]) {
+        return;
+    }
+    std::memset(&mWorldDirty[index], 1, mSubtreeEnd[index] - index);
+}
+
+void TransformStore::calcLocalIndex(uint32_t index) {
+    if(!mLocalDirty[index]) {
+        return;
+    }
+    composeTRS(mLocalTranslation[index], mLocalOrientation[index], mLocalScale[index], mLocalTransform[index]);
+    mLocalDirty[index] = 0;
+}
+
+const glm::mat4& TransformStore::calcWorldIndex(uint32_t index) {
+    if(!mWorldDirty[index]) {
+        return mWorldTransform[index];
+    }
+
+    int32_t parent = mParent[index];
+    if(parent >= 0) {
+        this->calcWorldIndex(parent);
+    }
+    this->updateIndex(index);
+
+    // Subtree bounds are only merged in updateAll()
+    mBoundsDirty = true;
+    return mWorldTransform[index];
+}
+
+const glm::vec3& TransformStore::getLocalTranslation(Handle handle) const { return mLocalTranslation[mHandleToIndex[handle]]; }
+const glm::quat& TransformStore::getLocalOrientation(Handle handle) const { return mLocalOrientation[mHandleToIndex[handle]]; }
+const glm::vec3& TransformStore::getLocalScale(Handle handle) const { return mLocalScale[mHandleToIndex[handle]]; }
+
+void TransformStore::setLocalTranslation(Handle handle, const glm::vec3& translation) {
+    uint32_t index = mHandleToIndex[handle];
+    mLocalTranslation[index] = translation;
+    this->markLocalDirty(index);
+}
+void TransformStore::setLocalOrientation(Handle handle, const glm::quat& orientation) {
+    uint32_t index = mHandleToIndex[handle];
+    mLocalOrientation[index] = orientation;
+    this->markLocalDirty(index);
+}
+void TransformStore::setLocalScale(Handle handle, const glm::vec3& scale) {
+    uint32_t index = mHandleToIndex[handle];
+    mLocalScale[index] = scale;
+    this->markLocalDirty(index);
+}
+void TransformStore::setLocalTranslationOrientation(Handle handle, const glm::vec3& translation, const glm::quat& orientation) {
+    uint32_t index = mHandleToIndex[handle];
+    mLocalTranslation[index] = translation;
+    mLocalOrientation[index] = orientation;
+    this->markLocalDirty(index);
+}
+void TransformStore::setLocalTranslationsOrientations(const Handle* handles, const glm::vec3* translations, const glm::quat* orientations, std::size_t count) {
+    mBatchIndices.clear();
+    for(std::size_t i = 0; i < count; ++ i) {
+        if(handles[i] == sNullHandle) continue;
+        uint32_t index = mHandleToIndex[handles[i]];
+        mLocalTranslation[index] = translations[i];
+        mLocalOrientation[index] = orientations[i];
+        mLocalDirty[index] = 1;
+        mBatchIndices.push_back(index);
+    }
+
+    // Descendants are made dirty by rebuildOrder()
+    if(mOrderDirty) {
+        for(uint32_t index : mBatchIndices) {
+            mWorldDirty[index] = 1;
+        }
+        return;
+    }
+
+    if(mBatchIndices.empty()) {
+        return;
+    }
+
+    // Overlapping and adjacent subtrees are merged into runs, each of which is one fill
+    std::sort(mBatchIndices.begin(), mBatchIndices.end());
+    uint32_t runBegin = 0;
+    uint32_t runEnd = 0;
+    for(uint32_t index : mBatchIndices) {
+        if(index > runEnd) {
+            std::memset(&mWorldDirty[0] + runBegin, 1, runEnd - runBegin);
+            runBegin = index;
+        }
+        runEnd = std::max(runEnd, mSubtreeEnd[index]);
+    }
+    std::memset(&mWorldDirty[0] + runBegin, 1, runEnd - runBegin);
+}
+void TransformStore::setLocalBounds(Handle handle, const BoundingSphere& bounds) {
+    uint32_t index = mHandleToIndex[handle];
+    mLocalBounds[index] = bounds;
+    this->markWorldDirty(index);
+}
+
+const glm::mat4& TransformStore::calcLocalTransform(Handle handle) {
+    uint32_t index = mHandleToIndex[handle];
+    this->calcLocalIndex(index);
+    return mLocalTransform[index];
+}
+
+const glm::mat4& TransformStore::calcWorldTransform(Handle handle) {
+    if(mOrderDirty) {
+        this->rebuildOrder();
+    }
+    return this->calcWorldIndex(mHandleToIndex[handle]);
+}
+
+const glm::mat4& TransformStore::getWorldTransform(Handle handle) const {
+    uint32_t index = mHandleToIndex[handle];
+    assert(!mOrderDirty && !mWorldDirty[index] && "World transform read before updateAll()");
+    return mWorldTransform[index];
+}
+
+const BoundingSphere& TransformStore::getWorldBounds(Handle handle) const {
+    return mWorldBounds[mHandleToIndex[handle]];
+}
+const BoundingSphere& TransformStore::getSubtreeBounds(Handle handle) const {
+    return mSubtreeBounds[mHandleToIndex[handle]];
+}
+
+void TransformStore::updateIndex(uint32_t index) {
+    this->calcLocalIndex(index);
+    int32_t parent = mParent[index];
+    if(parent >= 0) {
+        multiplyMat4(mWorldTransform[parent], mLocalTransform[index], mWorldTransform[index]);
+    } else {
+        mWorldTransform[index] = mLocalTransform[index];
+    }
+    mWorldBounds[index] = mLocalBounds[index].transformed(mWorldTransform[index]);
+    mWorldDirty[index] = 0;
+}
+
+void TransformStore::mergeSubtreeBounds(uint32_t begin, uint32_t end) {
+    for(uint32_t index = begin; index < end; ++ index) {
+        mSubtreeBounds[index] = mWorldBounds[index];
+    }
+
+    // Children always follow their parent, so iterating backwards finishes each subtree before its parent
+    for(uint32_t index = end; index -- > begin;) {
+        int32_t parent = mParent[index];
+        if(parent >= (int32_t) begin) {
+            mSubtreeBounds[parent] = BoundingSphere::merge(mSubtreeBounds[parent], mSubtreeBounds[index]);
+        }
+    }
+}
+
+uint32_t TransformStore::updateRange(uint32_t begin, uint32_t end, bool forceBounds) {
+    // Parents always precede children, so each parent's world transform is already final when read
+    uint32_t numUpdated = 0;
+    uint32_t index = begin;
+    while(index < end) {
+        // Skip ahead to the next dirty transform
+        const uint8_t* found = (const uint8_t*) std::memchr(&mWorldDirty[index], 1, end - index);
+        if(!found) {
+            break;
+        }
+        uint32_t dirtyBegin = found - &mWorldDirty[0];
+
+        // All of its descendants are dirty too, so the whole subtree is updated without further checks
+        uint32_t subtreeEnd = mSubtreeEnd[dirtyBegin];
+        for(index = dirtyBegin; index < subtreeEnd; ++ index) {
+            this->updateIndex(index);
+        }
+        numUpdated += subtreeEnd - dirtyBegin;
+    }
+
+    if(numUpdated > 0 || forceBounds) {
+        this->mergeSubtreeBounds(begin, end);
+    }
+    return numUpdated;
+}
+
+uint32_t TransformStore::splitUpdateRanges(uint32_t grainSize) {
+    mUpdateRanges.clear();
+    mSplitStack.clear();
+    mSplitRoots.clear();
+
+    // Each entry is a run of consecutive siblings (roots, initially) whose parent is already up to date
+    uint32_t numUpdated = 0;
+    mSplitStack.push_back(std::make_pair(0u, (uint32_t) mParent.size()));
+    while(!mSplitStack.empty()) {
+        uint32_t siblingsBegin = mSplitStack.back().first;
+        uint32_t siblingsEnd = mSplitStack.back().second;
+        mSplitStack.pop_back();
+
+        // Pack small sibling subtrees together; large ones have their root updated here and are split further
+        uint32_t batchBegin = siblingsBegin;
+        for(uint32_t sibling = siblingsBegin; sibling < siblingsEnd; sibling = mSubtreeEnd[sibling]) {
+            uint32_t subtreeEnd = mSubtreeEnd[sibling];
+            if(subtreeEnd - sibling > grainSize) {
+                if(batchBegin < sibling) {
+                    mUpdateRanges.push_back(std::make_pair(batchBegin, sibling));
+                }
+                if(mWorldDirty[sibling]) {
+                    this->updateIndex(sibling);
+                    ++ numUpdated;
+                }
+                mSplitRoots.push_back(sibling);
+                if(sibling + 1 < subtreeEnd) {
+                    mSplitStack.push_back(std::make_pair(sibling + 1, subtreeEnd));
+                }
+                batchBegin = subtreeEnd;
+            }
+            else if(subtreeEnd - batchBegin > grainSize) {
+                if(batchBegin < sibling) {
+                    mUpdateRanges.push_back(std::make_pair(batchBegin, sibling));
+                }
+                batchBegin = sibling;
+            }
+        }
+        if(batchBegin < siblingsEnd) {
+            mUpdateRanges.push_back(std::make_pair(batchBegin, siblingsEnd));
+        }
+    }
+    return numUpdated;
+}
+
+uint32_t TransformStore::updateAll() {
+    if(mOrderDirty) {
+        this->rebuildOrder();
+    }
+
+    bool forceBounds = mBoundsDirty;
+    mBoundsDirty = false;
+
+    uint32_t numTransforms = mParent.size();
+    if(numTransforms < sParallelGrainSize * 2 || Jobs::getNumWorkers() == 0) {
+        mNumUpdatedLast = this->updateRange(0, numTransforms, forceBounds);
+        return mNumUpdatedLast;
+    }
+
+    // Ranges are independent of each other, so they can be updated in any order on any thread
+    uint32_t numUpdated = this->splitUpdateRanges(sParallelGrainSize);
+    std::atomic<uint32_t> numUpdatedParallel(0);
+    Jobs::parallelFor(0, mUpdateRanges.size(), [this, &numUpdatedParallel, forceBounds](std::size_t begin, std::size_t end) {
+        uint32_t count = 0;
+        for(std::size_t i = begin; i < end; ++ i) {
+            count += this->updateRange(mUpdateRanges[i].first, mUpdateRanges[i].second, forceBounds);
+        }
+        numUpdatedParallel += count;
+    }, 1);
+    numUpdated += numUpdatedParallel;
+
+    // Subtrees which were split up are finished last, deepest first, once all of their children are done
+    if(numUpdated > 0 || forceBounds) {
+        std::sort(mSplitRoots.begin(), mSplitRoots.end());
+        for(std::vector<uint32_t>::reverse_iterator iter = mSplitRoots.rbegin(); iter != mSplitRoots.rend(); ++ iter) {
+            uint32_t root = *iter;
+            BoundingSphere bounds = mWorldBounds[root];
+            for(uint32_t child = root + 1; child < mSubtreeEnd[root]; child = mSubtreeEnd[child]) {
+                bounds = BoundingSphere::merge(bounds, mSubtreeBounds[child]);
+            }
+            mSubtreeBounds[root] = bounds;
+        }
+    }
+
+    mNumUpdatedLast = numUpdated;
+    return mNumUpdatedLast;
+}
+
+uint32_t TransformStore::getNumUpdatedLast() const {
+    return mNumUpdatedLast;
+}
+
+uint32_t TransformStore::size() const {
+    return mParent.size() - (mOrderDirty ? std::count(mIndexToHandle.begin(), mIndexToHandle.end(), sNullHandle) : 0);
+}
+
+}
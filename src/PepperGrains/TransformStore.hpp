@@ -0,0 +1,158 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PGG_TRANSFORMSTORE_HPP
+#define PGG_TRANSFORMSTORE_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "BoundingVolume.hpp"
+
+namespace pgg {
+
+/* Flat structure-of-arrays storage for a transform hierarchy.
+ *
+ * Transforms are stored in pre-order (every parent before its children, and every subtree occupying a
+ * contiguous range), so that all world matrices can be brought up to date in a single linear pass, and
+ * dirtying a subtree is a single contiguous fill.
+ *
+ * updateAll() splits the hierarchy into ranges of independent sibling subtrees and updates them across
+ * the job pool. Within a range, clean transforms are skipped over without being visited individually.
+ *
+ * Each transform may also have a local bounding sphere. updateAll() keeps world-space spheres for each
+ * transform, and for each whole subtree, which allows entire subtrees to be culled at once.
+ *
+ * Transforms are referred to by stable Handles. Indices into the arrays change whenever the hierarchy is
+ * restructured, which is deferred until the next time world transforms are needed.
+ *
+ * References returned by getters remain valid only until the next call that adds or restructures
+ * transforms.
+ */
+class TransformStore {
+public:
+    typedef uint32_t Handle;
+    static const Handle sNullHandle;
+
+    TransformStore();
+    ~TransformStore();
+
+private:
+    // Index space (pre-order when mOrderDirty is false)
+    std::vector<glm::vec3> mLocalTranslation;
+    std::vector<glm::quat> mLocalOrientation;
+    std::vector<glm::vec3> mLocalScale;
+    std::vector<glm::mat4> mLocalTransform;
+    std::vector<glm::mat4> mWorldTransform;
+    std::vector<int32_t> mParent; // -1 for roots
+    std::vector<uint32_t> mSubtreeEnd; // Exclusive; only valid when mOrderDirty is false
+    std::vector<uint8_t> mLocalDirty;
+    std::vector<uint8_t> mWorldDirty; // If set, then also set for all descendants
+    std::vector<Handle> mIndexToHandle; // sNullHandle for destroyed transforms
+    std::vector<BoundingSphere> mLocalBounds;
+    std::vector<BoundingSphere> mWorldBounds; // Valid for clean transforms
+    std::vector<BoundingSphere> mSubtreeBounds; // Only valid after updateAll()
+
+    // Handle space
+    std::vector<uint32_t> mHandleToIndex;
+    std::vector<Handle> mFreeHandles;
+
+    // True when the arrays are no longer in pre-order, or contain destroyed transforms
+    bool mOrderDirty;
+
+    // True when some world bounds changed without going through updateAll()
+    bool mBoundsDirty;
+
+    // Scratch space for updateAll(); ranges of sibling subtrees, whose parents are already up to date
+    std::vector<std::pair<uint32_t, uint32_t> > mUpdateRanges;
+    std::vector<std::pair<uint32_t, uint32_t> > mSplitStack;
+    std::vector<uint32_t> mSplitRoots;
+
+    // Scratch space for setLocalTranslationsOrientations()
+    std::vector<uint32_t> mBatchIndices;
+
+    uint32_t mNumUpdatedLast;
+
+    void rebuildOrder();
+
+    // Returns the number of transforms updated serially while splitting
+    uint32_t splitUpdateRanges(uint32_t grainSize);
+    uint32_t updateRange(uint32_t begin, uint32_t end, bool forceBounds);
+    void mergeSubtreeBounds(uint32_t begin, uint32_t end);
+    void updateIndex(uint32_t index);
+
+    void markLocalDirty(uint32_t index);
+    void markWorldDirty(uint32_t index);
+
+    void calcLocalIndex(uint32_t index);
+    const glm::mat4& calcWorldIndex(uint32_t index);
+
+public:
+    // New transforms have no parent and identity local transform
+    Handle create();
+
+    // The transform should have no parent or children
+    void destroy(Handle handle);
+
+    // Use sNullHandle to detach
+    void setParent(Handle child, Handle parent);
+
+    const glm::vec3& getLocalTranslation(Handle handle) const;
+    const glm::quat& getLocalOrientation(Handle handle) const;
+    const glm::vec3& getLocalScale(Handle handle) const;
+
+    void setLocalTranslation(Handle handle, const glm::vec3& translation);
+    void setLocalOrientation(Handle handle, const glm::quat& orientation);
+    void setLocalScale(Handle handle, const glm::vec3& scale);
+    void setLocalTranslationOrientation(Handle handle, const glm::vec3& translation, const glm::quat& orientation);
+
+    // Same as above for many transforms at once; entries with sNullHandle are skipped. Subtrees are marked
+    // dirty afterwards in index order, so that adjacent ones are filled as a single range.
+    void setLocalTranslationsOrientations(const Handle* handles, const glm::vec3* translations, const glm::quat* orientations, std::size_t count);
+
+    // Bounds of whatever is attached to this transform, in local space; empty by default
+    void setLocalBounds(Handle handle, const BoundingSphere& bounds);
+
+    // Lazily calculates only what is needed for this single transform
+    const glm::mat4& calcLocalTransform(Handle handle);
+    const glm::mat4& calcWorldTransform(Handle handle);
+
+    // Read-only access to a world transform already brought up to date by updateAll()
+    const glm::mat4& getWorldTransform(Handle handle) const;
+
+    // Read-only access to world-space bounds, brought up to date by updateAll()
+    const BoundingSphere& getWorldBounds(Handle handle) const;
+    const BoundingSphere& getSubtreeBounds(Handle handle) const; // Includes all descendants
+
+    // Brings all world transforms up to date, in parallel if the hierarchy is large enough and there are
+    // workers available; returns the number of transforms updated
+    uint32_t updateAll();
+
+    // Result of the most recent updateAll()
+    uint32_t getNumUpdatedLast() const;
+
+    // Number of live transforms
+    uint32_t size() const;
+};
+
+}
+
+#endif // PGG_TRANSFORMSTORE_HPP
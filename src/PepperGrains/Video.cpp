@@ -16,12 +16,20 @@
 
 #include "Video.hpp"
 
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <vector>
 #include <set>
 
 #include "Logger.hpp"
 #include "Engine.hpp"
+#ifdef PGG_VULKAN
+#include "DeviceMemoryAllocatorVulkan.hpp"
+#include "StreamStuff.hpp"
+#include "TextureStreamerVulkan.hpp"
+#include "TransferBatcherVulkan.hpp"
+#endif // PGG_VULKAN
 
 namespace pgg {
 
@@ -195,6 +203,17 @@ namespace Video {
         VkCommandPool mCmdPoolTransfer = VK_NULL_HANDLE;
         VkCommandPool getTransferCommandPool() { return mCmdPoolTransfer; }
         
+        DeviceMemoryAllocatorVk mMemoryAllocator; // Clean up manually
+        DeviceMemoryAllocatorVk* getMemoryAllocator() { return &mMemoryAllocator; }
+        TransferBatcherVk mTransferBatcher; // Clean up manually
+        TransferBatcherVk* getTransferBatcher() { return &mTransferBatcher; }
+        TextureStreamerVk mTextureStreamer; // Clean up manually
+        TextureStreamerVk* getTextureStreamer() { return &mTextureStreamer; }
+        
+        const char* mPipelineCacheFilename = "user/pipeline.cache";
+        VkPipelineCache mPipelineCache = VK_NULL_HANDLE; // Clean up manually
+        VkPipelineCache getPipelineCache() { return mPipelineCache; }
+        
         VkSurfaceCapabilitiesKHR mSurfaceCapabilities;
         VkSurfaceCapabilitiesKHR getSurfaceCapabilities() { return mSurfaceCapabilities; }
         std::vector<VkSurfaceFormatKHR> mAvailableSurfaceFormats;
@@ -866,6 +885,92 @@ namespace Video {
             return true;
         }
         
+        // Data saved by a different driver or device is valid but useless, and some drivers do not check
+        bool isPipelineCacheDataCompatible(const std::vector<uint8_t>& data) {
+            // Header: length, version, vendor ID, device ID, then the cache UUID, all in host byte order
+            const uint32_t headerSize = 16 + VK_UUID_SIZE;
+            if(data.size() < headerSize) {
+                return false;
+            }
+            
+            uint32_t header[4];
+            std::memcpy(header, data.data(), sizeof(header));
+            
+            return header[0] >= headerSize
+                && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                && header[2] == mPhysicalDeviceProperties.vendorID
+                && header[3] == mPhysicalDeviceProperties.deviceID
+                && std::memcmp(data.data() + 16, mPhysicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        
+        bool initializePipelineCache() {
+            Logger::Out vout = Logger::log(Logger::VERBOSE);
+            Logger::Out wout = Logger::log(Logger::WARN);
+            
+            std::vector<uint8_t> data;
+            if(readFileToByteBuffer(mPipelineCacheFilename, data)) {
+                if(isPipelineCacheDataCompatible(data)) {
+                    vout << "Loaded " << data.size() << " bytes of pipeline cache data" << std::endl;
+                } else {
+                    wout << "Ignoring pipeline cache data from another device or driver" << std::endl;
+                    data.clear();
+                }
+            }
+            
+            VkPipelineCacheCreateInfo pcCargs; {
+                pcCargs.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+                pcCargs.pNext = nullptr;
+                pcCargs.flags = 0;
+                pcCargs.initialDataSize = data.size();
+                pcCargs.pInitialData = data.empty() ? nullptr : data.data();
+            }
+            
+            VkResult result = vkCreatePipelineCache(mVkLogicalDevice, &pcCargs, nullptr, &mPipelineCache);
+            if(result != VK_SUCCESS && !data.empty()) {
+                wout << "Could not create pipeline cache from saved data, starting empty" << std::endl;
+                pcCargs.initialDataSize = 0;
+                pcCargs.pInitialData = nullptr;
+                result = vkCreatePipelineCache(mVkLogicalDevice, &pcCargs, nullptr, &mPipelineCache);
+            }
+            
+            return result == VK_SUCCESS;
+        }
+        
+        // Written to a temporary file first so that a crash while saving does not leave a truncated cache
+        void savePipelineCache() {
+            Logger::Out wout = Logger::log(Logger::WARN);
+            
+            std::size_t size = 0;
+            VkResult result = vkGetPipelineCacheData(mVkLogicalDevice, mPipelineCache, &size, nullptr);
+            if(result != VK_SUCCESS || size == 0) {
+                return;
+            }
+            std::vector<uint8_t> data(size);
+            result = vkGetPipelineCacheData(mVkLogicalDevice, mPipelineCache, &size, data.data());
+            if(result != VK_SUCCESS) {
+                wout << "Could not get pipeline cache data" << std::endl;
+                return;
+            }
+            
+            std::string tempFilename = std::string(mPipelineCacheFilename) + ".tmp";
+            {
+                std::ofstream output(tempFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+                if(!output.is_open()) {
+                    wout << "Could not write pipeline cache to " << tempFilename << std::endl;
+                    return;
+                }
+                output.write(reinterpret_cast<const char*>(data.data()), size);
+                if(!output) {
+                    wout << "Could not write pipeline cache to " << tempFilename << std::endl;
+                    return;
+                }
+            }
+            std::remove(mPipelineCacheFilename);
+            if(std::rename(tempFilename.c_str(), mPipelineCacheFilename) != 0) {
+                wout << "Could not replace " << mPipelineCacheFilename << std::endl;
+            }
+        }
+        
         bool initialize() {
             Logger::Out iout = Logger::log(Logger::INFO);
             Logger::Out vout = Logger::log(Logger::VERBOSE);
@@ -1177,7 +1282,7 @@ namespace Video {
                     enabledFeatures.sparseResidencyImage3D = VK_FALSE;
                     enabledFeatures.tessellationShader = VK_FALSE;
                     enabledFeatures.textureCompressionASTC_LDR = VK_FALSE;
-                    enabledFeatures.textureCompressionBC = VK_FALSE;
+                    enabledFeatures.textureCompressionBC = mPhysicalDeviceFeatures.textureCompressionBC; // Used by images when available
                     enabledFeatures.textureCompressionETC2 = VK_FALSE;
                     enabledFeatures.variableMultisampleRate = VK_FALSE;
                     enabledFeatures.vertexPipelineStoresAndAtomics = VK_FALSE;
@@ -1265,6 +1370,37 @@ namespace Video {
                 }
             }
             
+            if(!mMemoryAllocator.initialize(mVkLogicalDevice, mPhysicalDeviceMemoryProperties, mPhysicalDeviceProperties.limits.bufferImageGranularity)) {
+                sout << "Could not initialize device memory allocator" << std::endl;
+                return false;
+            }
+            
+            if(!mTransferBatcher.initialize()) {
+                sout << "Could not initialize transfer batcher" << std::endl;
+                return false;
+            }
+            
+            {
+                // Streamed textures may use up to half of the largest device local heap
+                VkDeviceSize textureBudget = 0;
+                for(uint32_t i = 0; i < mPhysicalDeviceMemoryProperties.memoryHeapCount; ++ i) {
+                    const VkMemoryHeap& heap = mPhysicalDeviceMemoryProperties.memoryHeaps[i];
+                    if((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size / 2 > textureBudget) {
+                        textureBudget = heap.size / 2;
+                    }
+                }
+                
+                if(!mTextureStreamer.initialize(textureBudget)) {
+                    sout << "Could not initialize texture streamer" << std::endl;
+                    return false;
+                }
+            }
+            
+            if(!initializePipelineCache()) {
+                sout << "Could not create pipeline cache" << std::endl;
+                return false;
+            }
+            
             if(!rebuildSwapchain()) {
                 sout << "Fatal error building swapchain" << std::endl;
                 return false;
@@ -1283,6 +1419,9 @@ namespace Video {
             cleanupDebugReportCallback();
             #endif
             
+            mTransferBatcher.cleanup(); // Waits for outstanding uploads; must be before the transfer command pool is destroyed
+            mTextureStreamer.cleanup(); // Destroys images replaced by streaming; must be before the memory allocator is cleaned up
+            
             // Note: Command buffers are freed with the pools
             vkDestroyCommandPool(mVkLogicalDevice, mCmdPoolCompute, nullptr);
             vkDestroyCommandPool(mVkLogicalDevice, mCmdPoolDisplay, nullptr);
@@ -1295,6 +1434,9 @@ namespace Video {
             }
             
             vkDestroySwapchainKHR(mVkLogicalDevice, mVkSwapchain, nullptr); // Swapchain must be destroyed before logical device
+            mMemoryAllocator.cleanup(); // Device memory must be freed before logical device
+            savePipelineCache();
+            vkDestroyPipelineCache(mVkLogicalDevice, mPipelineCache, nullptr);
             vkDestroyDevice(mVkLogicalDevice, nullptr); // Logical device must be destroyed before instance
             vkDestroySurfaceKHR(mVkInstance, mVkSurface, nullptr);
             vkDestroyInstance(mVkInstance, nullptr);
@@ -25,6 +25,13 @@
 #include <WindowInputSystemLibrary.hpp>
 
 namespace pgg {
+
+#ifdef PGG_VULKAN
+class DeviceMemoryAllocatorVk;
+class TextureStreamerVk;
+class TransferBatcherVk;
+#endif // PGG_VULKAN
+
 namespace Video {
     
     #ifdef PGG_OPENGL
@@ -95,6 +102,18 @@ namespace Video {
         VkCommandPool getSparseCommandPool();
         VkCommandPool getTransferCommandPool();
         
+        // All device memory for buffers and images should be allocated through this
+        DeviceMemoryAllocatorVk* getMemoryAllocator();
+        
+        // Uploads to device local resources should be recorded through this
+        TransferBatcherVk* getTransferBatcher();
+        
+        // Decides which mip levels of streamed images are kept in device memory
+        TextureStreamerVk* getTextureStreamer();
+        
+        // Pipelines should be created with this; it is loaded from and saved to disk
+        VkPipelineCache getPipelineCache();
+        
         VkSurfaceCapabilitiesKHR getSurfaceCapabilities();
         const std::vector<VkSurfaceFormatKHR> getAvailableSurfaceFormats();
         const std::vector<VkPresentModeKHR> getAvailablePresentModes();
@@ -119,11 +119,26 @@ void immCopyImage(VkImage src, VkImageLayout srcLayout, VkImage dest, VkImageLay
     Video::Vulkan::Utils::immediateCmdBufferEnd(Video::Vulkan::getTransferQueue(), Video::Vulkan::getTransferCommandPool(), &cmdBuff);
 }
 
-void immChangeImageLayout(VkImage img, VkFormat imgFormat, VkImageLayout oldLayout, VkImageLayout newLayout) {
-    VkCommandBuffer cmdBuff;
-    
-    Video::Vulkan::Utils::immediateCmdBufferBegin(Video::Vulkan::getTransferCommandPool(), &cmdBuff);
+void cmdCopyBufferToImage(VkCommandBuffer cmdBuff, VkBuffer src, VkDeviceSize srcOffset, VkImage dest, uint32_t mipLevel, uint32_t imgWidth, uint32_t imgHeight) {
+    VkBufferImageCopy buffImgCopy; {
+        buffImgCopy.bufferOffset = srcOffset;
+        
+        // Zero means tightly packed
+        buffImgCopy.bufferRowLength = 0;
+        buffImgCopy.bufferImageHeight = 0;
+        
+        buffImgCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        buffImgCopy.imageSubresource.mipLevel = mipLevel;
+        buffImgCopy.imageSubresource.baseArrayLayer = 0;
+        buffImgCopy.imageSubresource.layerCount = 1;
+        buffImgCopy.imageOffset = {0, 0, 0};
+        buffImgCopy.imageExtent = {imgWidth, imgHeight, 1};
+    }
     
+    vkCmdCopyBufferToImage(cmdBuff, src, dest, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffImgCopy);
+}
+
+void cmdChangeImageLayout(VkCommandBuffer cmdBuff, VkImage img, VkFormat imgFormat, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t levelCount) {
     VkImageMemoryBarrier imgMemoryBarrier; {
         imgMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         imgMemoryBarrier.pNext = nullptr;
@@ -143,7 +158,7 @@ void immChangeImageLayout(VkImage img, VkFormat imgFormat, VkImageLayout oldLayo
         imgMemoryBarrier.subresourceRange.baseArrayLayer = 0;
         imgMemoryBarrier.subresourceRange.baseMipLevel = 0;
         imgMemoryBarrier.subresourceRange.layerCount = 1;
-        imgMemoryBarrier.subresourceRange.levelCount = 1;
+        imgMemoryBarrier.subresourceRange.levelCount = levelCount;
     }
     
     if(newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
@@ -227,9 +242,11 @@ void immChangeImageLayout(VkImage img, VkFormat imgFormat, VkImageLayout oldLayo
         }
     }
     
+    // Transitions may share a command buffer with the copies that they separate, so the barrier has to cover
+    // every stage rather than just the top of the pipe
     vkCmdPipelineBarrier(
         cmdBuff, 
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 
         0, // Dependency flags?
         // Generic memory barriers
         0, nullptr, 
@@ -237,10 +254,12 @@ void immChangeImageLayout(VkImage img, VkFormat imgFormat, VkImageLayout oldLayo
         0, nullptr, 
         // Image memory barriers
         1, &imgMemoryBarrier);
-    
-    
+}
+void immChangeImageLayout(VkImage img, VkFormat imgFormat, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t levelCount) {
+    VkCommandBuffer cmdBuff;
+    Video::Vulkan::Utils::immediateCmdBufferBegin(Video::Vulkan::getTransferCommandPool(), &cmdBuff);
+    cmdChangeImageLayout(cmdBuff, img, imgFormat, oldLayout, newLayout, levelCount);
     Video::Vulkan::Utils::immediateCmdBufferEnd(Video::Vulkan::getTransferQueue(), Video::Vulkan::getTransferCommandPool(), &cmdBuff);
-    
 }
 
 bool findSuitableMemoryTypeIndex(uint32_t allowedTypes, VkMemoryPropertyFlags requiredProperties, uint32_t* memTypeIndex) {
@@ -261,7 +280,7 @@ bool bufferCreateAndAllocate(
     VkDeviceSize size, 
     VkBufferUsageFlags usage, 
     VkMemoryPropertyFlags requiredProperties, 
-    VkBuffer* buffer, VkDeviceMemory* bufferMemory) {
+    VkBuffer* buffer, DeviceMemoryAllocatorVk::Allocation* allocation) {
 
     Logger::Out sout = Logger::log(Logger::SEVERE);
     
@@ -287,43 +306,37 @@ bool bufferCreateAndAllocate(
     VkMemoryRequirements bufferMemReq;
     vkGetBufferMemoryRequirements(Video::Vulkan::getLogicalDevice(), *buffer, &bufferMemReq);
     
-    uint32_t memoryTypeIndex;
-    bool success = findSuitableMemoryTypeIndex(bufferMemReq.memoryTypeBits, 
-                requiredProperties,
-                &memoryTypeIndex);
-                
-    if(!success) {
-        sout << "Could not find memory type for buffer" << std::endl;
-        return false;
-    }
-    
-    VkMemoryAllocateInfo allocArgs; {
-        allocArgs.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocArgs.pNext = nullptr;
-        
-        allocArgs.allocationSize = bufferMemReq.size;
-        allocArgs.memoryTypeIndex = memoryTypeIndex;
-    }
-    
-    result = vkAllocateMemory(Video::Vulkan::getLogicalDevice(), &allocArgs, nullptr, bufferMemory);
+    bool success = Video::Vulkan::getMemoryAllocator()->allocate(bufferMemReq, 
+                requiredProperties, 
+                DeviceMemoryAllocatorVk::LINEAR, 
+                allocation);
     
-    if(result != VK_SUCCESS) {
+    if(!success) {
         sout << "Could not allocate memory for buffer" << std::endl;
+        vkDestroyBuffer(Video::Vulkan::getLogicalDevice(), *buffer, nullptr);
+        (*buffer) = VK_NULL_HANDLE;
         return false;
     }
     
-    vkBindBufferMemory(Video::Vulkan::getLogicalDevice(), *buffer, *bufferMemory, 0);
+    vkBindBufferMemory(Video::Vulkan::getLogicalDevice(), *buffer, allocation->mMemory, allocation->mOffset);
     
     return true;
 }
 
+void bufferDestroyAndFree(VkBuffer* buffer, DeviceMemoryAllocatorVk::Allocation* allocation) {
+    vkDestroyBuffer(Video::Vulkan::getLogicalDevice(), *buffer, nullptr);
+    (*buffer) = VK_NULL_HANDLE;
+    Video::Vulkan::getMemoryAllocator()->free(allocation);
+}
+
 bool imageCreateAndAllocate(
     uint32_t width, uint32_t height, 
     VkFormat format, 
     VkImageTiling tilingType, 
     VkImageUsageFlags usage, 
     VkMemoryPropertyFlags requiredProperties, 
-    VkImage* imageHandle, VkDeviceMemory* imageMemory) {
+    VkImage* imageHandle, DeviceMemoryAllocatorVk::Allocation* allocation, 
+    uint32_t mipLevels) {
     
     VkResult result;
     bool success;
@@ -337,7 +350,7 @@ bool imageCreateAndAllocate(
         imageInfo.extent.width = width;
         imageInfo.extent.height = height;
         imageInfo.extent.depth = 1;
-        imageInfo.mipLevels = 1;
+        imageInfo.mipLevels = mipLevels;
         imageInfo.arrayLayers = 1;
         imageInfo.format = format;
         imageInfo.tiling = tilingType;
@@ -357,28 +370,30 @@ bool imageCreateAndAllocate(
     VkMemoryRequirements memReq;
     vkGetImageMemoryRequirements(Video::Vulkan::getLogicalDevice(), *imageHandle, &memReq);
     
-    uint32_t memoryTypeIndex;
-    success = findSuitableMemoryTypeIndex(memReq.memoryTypeBits, requiredProperties, &memoryTypeIndex);
-    
-    VkMemoryAllocateInfo allocInfo; {
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.pNext = nullptr;
-        allocInfo.allocationSize = memReq.size;
-        allocInfo.memoryTypeIndex = memoryTypeIndex;
-    }
-    
-    result = vkAllocateMemory(Video::Vulkan::getLogicalDevice(), &allocInfo, nullptr, imageMemory);
+    // Linear and optimal images must be kept bufferImageGranularity apart when they share memory
+    success = Video::Vulkan::getMemoryAllocator()->allocate(memReq, 
+                requiredProperties, 
+                tilingType == VK_IMAGE_TILING_LINEAR ? DeviceMemoryAllocatorVk::LINEAR : DeviceMemoryAllocatorVk::OPTIMAL, 
+                allocation);
     
-    if(result != VK_SUCCESS) {
+    if(!success) {
         Logger::log(Logger::WARN) << "Could not allocate memory for image" << std::endl;
+        vkDestroyImage(Video::Vulkan::getLogicalDevice(), *imageHandle, nullptr);
+        (*imageHandle) = VK_NULL_HANDLE;
         return false;
     }
     
-    vkBindImageMemory(Video::Vulkan::getLogicalDevice(), *imageHandle, *imageMemory, 0);
+    vkBindImageMemory(Video::Vulkan::getLogicalDevice(), *imageHandle, allocation->mMemory, allocation->mOffset);
     
     return true;
 }
 
+void imageDestroyAndFree(VkImage* imageHandle, DeviceMemoryAllocatorVk::Allocation* allocation) {
+    vkDestroyImage(Video::Vulkan::getLogicalDevice(), *imageHandle, nullptr);
+    (*imageHandle) = VK_NULL_HANDLE;
+    Video::Vulkan::getMemoryAllocator()->free(allocation);
+}
+
 bool imageViewCreate(
     VkImage img, 
     VkFormat imgFormat, 
@@ -23,6 +23,8 @@
 
 #include <GraphicsApiLibrary.hpp>
 
+#include "DeviceMemoryAllocatorVulkan.hpp"
+
 namespace pgg {
 namespace Video {
 namespace Vulkan { 
@@ -125,36 +127,103 @@ void immCopyImage(
     uint32_t imgWidth, uint32_t imgHeight);
 
 /**
- * Part of the immediate function family (prefix "imm"). 
- * Transitions an image's layout.
- * Transparently handles immediate command buffer begining and ending, and chooses appropriate VkQueue.
- * There is no "cmd-" counterpart.
+ * Issues a command to the provide command buffer.
+ * Copies tightly packed texel data from a buffer into one mip level of a 2D image.
+ * 
+ * @param cmdBuff Command buffer to issue command to
+ * @param src The preallocated buffer handle from which the data will be copied
+ * @param srcOffset Offset in src buffer of the first texel; must be a multiple of 4 and of the texel size
+ * @param dest The preallocated image handle to which the data will be copied, in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+ * @param mipLevel Which mip level of dest to write
+ * @param imgWidth Width of the mip level
+ * @param imgHeight Height of the mip level
+ */
+void cmdCopyBufferToImage(
+    VkCommandBuffer cmdBuff, 
+    VkBuffer src, VkDeviceSize srcOffset, 
+    VkImage dest, uint32_t mipLevel, 
+    uint32_t imgWidth, uint32_t imgHeight);
+
+/**
+ * Issues a command to the provide command buffer.
+ * Transitions an image's layout. Waits on all prior commands, so that this can be recorded between copies in the
+ * same command buffer.
+ * 
+ * @param cmdBuff Command buffer to issue command to
+ * @param img The image to change the layout of
+ * @param imgFormat Affects choice of aspect flags
+ * @param oldLayout Current layout
+ * @param newLayout Target layout
+ * @param levelCount How many mip levels, starting from the base level, to transition
+ */
+void cmdChangeImageLayout(
+    VkCommandBuffer cmdBuff, 
+    VkImage img, VkFormat imgFormat, 
+    VkImageLayout oldLayout, VkImageLayout newLayout, 
+    uint32_t levelCount = 1);
+
+/**
+ * Part of the immediate function family (prefix "imm"). Does the same thing as 
+ * cmdChangeImageLayout() 
+ * except it transparently handles immediate command buffer begining and ending, and chooses appropriate VkQueue.
  * 
  * @param img The image to change the layout of
  * @param imgFormat Affects choice of aspect flags
  * @param oldLayout Current layout
  * @param newLayout Target layout
+ * @param levelCount How many mip levels, starting from the base level, to transition
  */
 void immChangeImageLayout(
     VkImage img, VkFormat imgFormat, 
-    VkImageLayout oldLayout, VkImageLayout newLayout);
+    VkImageLayout oldLayout, VkImageLayout newLayout, 
+    uint32_t levelCount = 1);
 
 bool findSuitableMemoryTypeIndex(
     uint32_t allowedTypes, 
     VkMemoryPropertyFlags requiredProperties, 
     uint32_t* memTypeIndex);
+/**
+ * Creates a buffer and binds it to memory sub-allocated from Video::Vulkan::getMemoryAllocator().
+ * If the memory is host visible, allocation->mMapped can be written to directly; do not call vkMapMemory on it.
+ * 
+ * @return True iff successful
+ */
 bool bufferCreateAndAllocate(
     VkDeviceSize size, 
     VkBufferUsageFlags usage, 
     VkMemoryPropertyFlags requiredProperties, 
-    VkBuffer* buffer, VkDeviceMemory* bufferMemory);
+    VkBuffer* buffer, DeviceMemoryAllocatorVk::Allocation* allocation);
+
+/**
+ * Sister method for bufferCreateAndAllocate(). Destroys the buffer and returns its memory to the allocator.
+ * Both are overwritten with null values.
+ */
+void bufferDestroyAndFree(
+    VkBuffer* buffer, DeviceMemoryAllocatorVk::Allocation* allocation);
+
+/**
+ * Creates an image and binds it to memory sub-allocated from Video::Vulkan::getMemoryAllocator().
+ * As with bufferCreateAndAllocate(), host visible memory is already mapped at allocation->mMapped.
+ * 
+ * @param mipLevels Number of mip levels, starting from the full size
+ * @return True iff successful
+ */
 bool imageCreateAndAllocate(
     uint32_t width, uint32_t height, 
     VkFormat format, 
     VkImageTiling tilingType, 
     VkImageUsageFlags usage, 
     VkMemoryPropertyFlags requiredProperties, 
-    VkImage* imageHandle, VkDeviceMemory* imageMemory);
+    VkImage* imageHandle, DeviceMemoryAllocatorVk::Allocation* allocation, 
+    uint32_t mipLevels = 1);
+
+/**
+ * Sister method for imageCreateAndAllocate(). Destroys the image and returns its memory to the allocator.
+ * Both are overwritten with null values.
+ */
+void imageDestroyAndFree(
+    VkImage* imageHandle, DeviceMemoryAllocatorVk::Allocation* allocation);
+
 bool imageViewCreate(
     VkImage img, 
     VkFormat imgFormat, 
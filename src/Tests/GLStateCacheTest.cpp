@@ -0,0 +1,226 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+/* Drives renderer-like passes through GLStateCache into a RecordingGLBackend and checks which calls
+ * actually reach the backend. Needs no GL context.
+ */
+
+#include <cstdlib>
+#include <sstream>
+
+#include "GLBackend.hpp"
+#include "GLStateCache.hpp"
+#include "Logger.hpp"
+
+using namespace pgg;
+
+namespace {
+
+// Values of the GL enums used; they only need to be distinct here
+const GLenum sDepthTest = 0x0B71;
+const GLenum sCullFace = 0x0B44;
+const GLenum sBlend = 0x0BE2;
+const GLenum sStencilTest = 0x0B90;
+const GLenum sLess = 0x0201;
+const GLenum sEqual = 0x0202;
+const GLenum sAlways = 0x0207;
+const GLenum sBack = 0x0405;
+const GLenum sFuncAdd = 0x8006;
+const GLenum sOne = 1;
+const GLenum sFill = 0x1B02;
+
+uint32_t sFailures = 0;
+
+void expect(uint32_t actual, uint32_t expected, const char* what) {
+    if(actual != expected) {
+        Logger::log(Logger::SEVERE) << what << ": expected " << expected << ", got " << actual << std::endl;
+        ++ sFailures;
+    }
+}
+
+void expectCalls(const RecordingGLBackend& backend, RecordingGLBackend::Function function, uint32_t expected, const char* what) {
+    if(backend.getNumCalls(function) != expected) {
+        Logger::log(Logger::SEVERE) << what << ", " << RecordingGLBackend::getFunctionName(function) << ": expected "
+            << expected << " calls, got " << backend.getNumCalls(function) << std::endl;
+        ++ sFailures;
+    }
+}
+
+// Like DeferredRenderer's geometry pass: state set up once, then several models with their own programs
+void geometryPass(GLStateCache& state) {
+    state.depthMask(true);
+    state.enable(sDepthTest);
+    state.depthFunc(sLess);
+    state.disable(sStencilTest);
+    state.enable(sCullFace);
+    state.cullFace(sBack);
+    state.disable(sBlend);
+    state.polygonMode(sFill);
+    
+    // Two models sharing a program, then a third with another
+    for(uint32_t model = 0; model < 3; ++ model) {
+        state.useProgram(model < 2 ? 1 : 2);
+        state.bindVertexArray(10 + model);
+        state.bindTexture2D(0, 20 + model);
+    }
+}
+
+// Like the light pass: one fullscreen draw per light, each setting the same state
+void lightPass(GLStateCache& state, uint32_t numLights) {
+    for(uint32_t light = 0; light < numLights; ++ light) {
+        state.depthMask(false);
+        state.disable(sDepthTest);
+        state.disable(sCullFace);
+        state.enable(sBlend);
+        state.blendEquation(sFuncAdd);
+        state.blendFunc(sOne, sOne);
+        state.useProgram(3);
+        state.bindVertexArray(30);
+        state.bindTexture2D(0, 40);
+        state.bindTexture2D(1, 41);
+        state.bindTexture2D(2, 42);
+    }
+}
+
+void testRepeatedPass() {
+    RecordingGLBackend backend;
+    GLStateCache state(&backend);
+    
+    lightPass(state, 1);
+    expect(backend.getNumCalls(), 14, "First light, issued");
+    expect(state.getStats().mRequested, 11, "First light, requested");
+    expect(state.getStats().mIssued, backend.getNumCalls(), "First light, stats agree with backend");
+    expectCalls(backend, RecordingGLBackend::DISABLE, 2, "First light");
+    expectCalls(backend, RecordingGLBackend::ACTIVE_TEXTURE, 3, "First light");
+    expectCalls(backend, RecordingGLBackend::BIND_TEXTURE_2D, 3, "First light");
+    
+    // Later lights change nothing
+    backend.clear();
+    lightPass(state, 99);
+    expect(backend.getNumCalls(), 0, "Later lights, issued");
+    expect(state.getStats().mRequested, 11 * 100, "All lights, requested");
+    
+    // Everything is passed on again once invalidated, since the state may have been set directly
+    state.invalidate();
+    lightPass(state, 1);
+    expect(backend.getNumCalls(), 14, "After invalidate, issued");
+}
+
+void testPassTransition() {
+    RecordingGLBackend backend;
+    GLStateCache state(&backend);
+    
+    geometryPass(state);
+    expectCalls(backend, RecordingGLBackend::USE_PROGRAM, 2, "Geometry pass");
+    expectCalls(backend, RecordingGLBackend::BIND_VERTEX_ARRAY, 3, "Geometry pass");
+    expectCalls(backend, RecordingGLBackend::ACTIVE_TEXTURE, 1, "Geometry pass");
+    expectCalls(backend, RecordingGLBackend::BIND_TEXTURE_2D, 3, "Geometry pass");
+    expect(backend.getNumCalls(), 17, "Geometry pass, issued");
+    
+    // Only what differs from the geometry pass; depth test and cull face flip, stencil stays disabled
+    backend.clear();
+    lightPass(state, 4);
+    expectCalls(backend, RecordingGLBackend::DEPTH_MASK, 1, "Light pass after geometry");
+    expectCalls(backend, RecordingGLBackend::ENABLE, 1, "Light pass after geometry");
+    expectCalls(backend, RecordingGLBackend::DISABLE, 2, "Light pass after geometry");
+    expectCalls(backend, RecordingGLBackend::DEPTH_FUNC, 0, "Light pass after geometry");
+    expectCalls(backend, RecordingGLBackend::POLYGON_MODE, 0, "Light pass after geometry");
+    
+    // Unit 0 is still active from the geometry pass, so only units 1 and 2 are activated
+    expectCalls(backend, RecordingGLBackend::ACTIVE_TEXTURE, 2, "Light pass after geometry");
+    expectCalls(backend, RecordingGLBackend::BIND_TEXTURE_2D, 3, "Light pass after geometry");
+    
+    // Stencil function only reaches the backend when its arguments change
+    backend.clear();
+    state.stencilFunc(sAlways, 0, 0);
+    state.stencilFunc(sAlways, 0, 0);
+    state.stencilFunc(sEqual, 0, 0xff);
+    state.stencilFunc(sEqual, 1, 0xff);
+    expectCalls(backend, RecordingGLBackend::STENCIL_FUNC, 3, "Stencil function");
+    
+    backend.clear();
+    state.resetBindings();
+    state.resetBindings();
+    expectCalls(backend, RecordingGLBackend::USE_PROGRAM, 1, "Reset bindings");
+    expectCalls(backend, RecordingGLBackend::BIND_VERTEX_ARRAY, 1, "Reset bindings");
+}
+
+void testUntracked() {
+    RecordingGLBackend backend;
+    GLStateCache state(&backend);
+    
+    // Capabilities past the tracked limit are always passed on
+    for(uint32_t i = 0; i < GLStateCache::sMaxTrackedCapabilities; ++ i) {
+        state.enable(0x1000 + i);
+    }
+    backend.clear();
+    state.enable(0x1000);
+    state.enable(0x2000);
+    state.enable(0x2000);
+    expectCalls(backend, RecordingGLBackend::ENABLE, 2, "Untracked capability");
+    
+    // Likewise texture units
+    backend.clear();
+    state.bindTexture2D(GLStateCache::sMaxTrackedTextureUnits, 50);
+    state.bindTexture2D(GLStateCache::sMaxTrackedTextureUnits, 50);
+    expectCalls(backend, RecordingGLBackend::ACTIVE_TEXTURE, 1, "Untracked texture unit");
+    expectCalls(backend, RecordingGLBackend::BIND_TEXTURE_2D, 2, "Untracked texture unit");
+}
+
+void testForwarding() {
+    RecordingGLBackend forwarded(nullptr, false);
+    RecordingGLBackend backend(&forwarded);
+    GLStateCache state(&backend);
+    
+    geometryPass(state);
+    lightPass(state, 2);
+    expect(forwarded.getNumCalls(), backend.getNumCalls(), "Forwarded calls");
+    expect(forwarded.getCalls().size(), 0, "Forwarded log kept without keepLog");
+    expect(backend.getCalls().size(), backend.getNumCalls(), "Log length");
+    
+    // The log lists the calls in order
+    std::stringstream log;
+    backend.writeLog(log);
+    std::string firstLine;
+    std::getline(log, firstLine);
+    if(firstLine != "glDepthMask(0x1)") {
+        Logger::log(Logger::SEVERE) << "First logged call: expected glDepthMask(0x1), got " << firstLine << std::endl;
+        ++ sFailures;
+    }
+    
+    // A new backend knows nothing of the old one's state
+    RecordingGLBackend other;
+    state.setBackend(&other);
+    lightPass(state, 1);
+    expect(other.getNumCalls(), 14, "After setBackend, issued");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    testRepeatedPass();
+    testPassTransition();
+    testUntracked();
+    testForwarding();
+    
+    if(sFailures > 0) {
+        Logger::log(Logger::SEVERE) << sFailures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    Logger::log(Logger::INFO) << "All checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
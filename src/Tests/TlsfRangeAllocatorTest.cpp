@@ -0,0 +1,318 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+/* Checks placement in TlsfRangeAllocator: alignment, splitting and merging of free ranges, separation of
+ * kinds by granularity, running out of space, and the statistics reported.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Logger.hpp"
+#include "TlsfRangeAllocator.hpp"
+
+using namespace pgg;
+
+namespace {
+
+typedef TlsfRangeAllocator::Handle Handle;
+
+uint32_t sFailures = 0;
+
+void check(bool condition, const char* what) {
+    if(!condition) {
+        Logger::log(Logger::SEVERE) << what << std::endl;
+        ++ sFailures;
+    }
+}
+
+void expect(uint64_t actual, uint64_t expected, const char* what) {
+    if(actual != expected) {
+        Logger::log(Logger::SEVERE) << what << ": expected " << expected << ", got " << actual << std::endl;
+        ++ sFailures;
+    }
+}
+
+void expectNear(float actual, float expected, const char* what) {
+    if(std::abs(actual - expected) > 1e-5f) {
+        Logger::log(Logger::SEVERE) << what << ": expected " << expected << ", got " << actual << std::endl;
+        ++ sFailures;
+    }
+}
+
+struct Allocation {
+    Handle mHandle;
+    uint64_t mOffset;
+    uint64_t mSize;
+    uint32_t mKind;
+};
+
+// Allocations must not overlap, and with a granularity, different kinds must not share a page
+bool isValidPlacement(const std::vector<Allocation>& allocations, uint64_t capacity, uint64_t granularity) {
+    for(std::size_t i = 0; i < allocations.size(); ++ i) {
+        const Allocation& a = allocations[i];
+        if(a.mOffset + a.mSize > capacity) {
+            return false;
+        }
+        for(std::size_t j = i + 1; j < allocations.size(); ++ j) {
+            const Allocation& b = allocations[j];
+            if(a.mOffset < b.mOffset + b.mSize && b.mOffset < a.mOffset + a.mSize) {
+                return false;
+            }
+            if(a.mKind != b.mKind) {
+                uint64_t aFirstPage = a.mOffset / granularity;
+                uint64_t aLastPage = (a.mOffset + a.mSize - 1) / granularity;
+                uint64_t bFirstPage = b.mOffset / granularity;
+                uint64_t bLastPage = (b.mOffset + b.mSize - 1) / granularity;
+                if(aFirstPage <= bLastPage && bFirstPage <= aLastPage) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void testAlignment() {
+    TlsfRangeAllocator allocator(1 << 20);
+    uint64_t offset;
+    
+    // Leave the next free byte unaligned
+    check(allocator.allocate(1, 1, 0, offset) != TlsfRangeAllocator::sInvalidHandle, "Alignment: first allocation");
+    
+    std::vector<Allocation> allocations;
+    for(uint64_t alignment = 1; alignment <= 4096; alignment *= 2) {
+        Allocation allocation;
+        allocation.mSize = 3 * alignment + 1;
+        allocation.mKind = 0;
+        allocation.mHandle = allocator.allocate(allocation.mSize, alignment, 0, allocation.mOffset);
+        check(allocation.mHandle != TlsfRangeAllocator::sInvalidHandle, "Alignment: allocation failed");
+        expect(allocation.mOffset % alignment, 0, "Alignment: misaligned offset");
+        expect(allocator.getOffset(allocation.mHandle), allocation.mOffset, "Alignment: getOffset");
+        expect(allocator.getSize(allocation.mHandle), allocation.mSize, "Alignment: getSize");
+        allocations.push_back(allocation);
+    }
+    check(isValidPlacement(allocations, allocator.getCapacity(), 1), "Alignment: allocations overlap");
+}
+
+void testSplitAndMerge() {
+    TlsfRangeAllocator allocator(1024);
+    uint64_t a, b, c;
+    Handle handleA = allocator.allocate(256, 1, 0, a);
+    Handle handleB = allocator.allocate(256, 1, 0, b);
+    Handle handleC = allocator.allocate(256, 1, 0, c);
+    expect(a, 0, "Split: first offset");
+    expect(b, 256, "Split: second offset");
+    expect(c, 512, "Split: third offset");
+    
+    TlsfRangeAllocator::Stats stats = allocator.getStats();
+    expect(stats.mNumFreeRanges, 1, "Split: free ranges");
+    expect(stats.mFreeBytes, 256, "Split: free bytes");
+    
+    // Middle range has allocated neighbours on both sides, so it stays on its own
+    allocator.free(handleB);
+    stats = allocator.getStats();
+    expect(stats.mNumFreeRanges, 2, "Free middle: free ranges");
+    expect(stats.mLargestFreeRange, 256, "Free middle: largest free range");
+    
+    // Merges with the next range
+    allocator.free(handleA);
+    stats = allocator.getStats();
+    expect(stats.mNumFreeRanges, 2, "Free first: free ranges");
+    expect(stats.mLargestFreeRange, 512, "Free first: largest free range");
+    
+    // Merges with both neighbours, leaving one range again
+    allocator.free(handleC);
+    stats = allocator.getStats();
+    expect(stats.mNumFreeRanges, 1, "Free last: free ranges");
+    expect(stats.mLargestFreeRange, 1024, "Free last: largest free range");
+    check(allocator.isEmpty(), "Free last: not empty");
+    
+    uint64_t whole;
+    check(allocator.allocate(1024, 1, 0, whole) != TlsfRangeAllocator::sInvalidHandle && whole == 0, "Merged: whole capacity not allocatable");
+}
+
+void testGranularity() {
+    const uint64_t granularity = 1024;
+    TlsfRangeAllocator allocator(8 * granularity, granularity);
+    uint64_t offset;
+    
+    // Another kind after the first must start on a new page
+    allocator.allocate(100, 1, 0, offset);
+    expect(offset, 0, "Granularity: first offset");
+    allocator.allocate(100, 1, 1, offset);
+    expect(offset, granularity, "Granularity: other kind after");
+    
+    // The same kind may share the page
+    allocator.allocate(100, 1, 0, offset);
+    expect(offset, 100, "Granularity: same kind after");
+    
+    // Leave a hole between two ranges of kind 1 on the second page of another allocator, whose first page is
+    // full: [1024, 1124) kind 1, [1124, 1224) free, [1224, 1324) kind 1
+    TlsfRangeAllocator holed(8 * granularity, granularity);
+    holed.allocate(granularity, 1, 0, offset);
+    holed.allocate(100, 1, 1, offset);
+    Handle hole = holed.allocate(100, 1, 1, offset);
+    expect(offset, granularity + 100, "Granularity: hole offset");
+    holed.allocate(100, 1, 1, offset);
+    holed.free(hole);
+    
+    // Kind 0 cannot go in the hole, and must skip the rest of the second page
+    holed.allocate(50, 1, 0, offset);
+    expect(offset, 2 * granularity, "Granularity: kind 0 next to kind 1");
+    
+    // Kind 1 fits in the hole
+    holed.allocate(50, 1, 1, offset);
+    expect(offset, granularity + 100, "Granularity: kind 1 in hole");
+    
+    // Without the granularity, the same sequence packs tightly
+    TlsfRangeAllocator packed(8 * granularity);
+    packed.allocate(100, 1, 0, offset);
+    packed.allocate(100, 1, 1, offset);
+    expect(offset, 100, "No granularity: other kind after");
+}
+
+void testGranularityRandom() {
+    const uint64_t capacity = 1 << 20;
+    const uint64_t granularity = 4096;
+    TlsfRangeAllocator allocator(capacity, granularity);
+    
+    std::mt19937 random(1234);
+    std::vector<Allocation> allocations;
+    bool valid = true;
+    for(uint32_t step = 0; step < 4000 && valid; ++ step) {
+        if(allocations.empty() || random() % 3 != 0) {
+            Allocation allocation;
+            allocation.mSize = 1 + random() % 8192;
+            allocation.mKind = random() % 2;
+            allocation.mHandle = allocator.allocate(allocation.mSize, (uint64_t) 1 << (random() % 9), allocation.mKind, allocation.mOffset);
+            if(allocation.mHandle != TlsfRangeAllocator::sInvalidHandle) {
+                allocations.push_back(allocation);
+            }
+        } else {
+            std::size_t index = random() % allocations.size();
+            allocator.free(allocations[index].mHandle);
+            allocations[index] = allocations.back();
+            allocations.pop_back();
+        }
+        
+        // Checking every placement is quadratic, so only check now and then
+        if(step % 100 == 0) {
+            valid = isValidPlacement(allocations, capacity, granularity);
+        }
+    }
+    check(valid && isValidPlacement(allocations, capacity, granularity), "Random: invalid placement");
+    
+    for(const Allocation& allocation : allocations) {
+        allocator.free(allocation.mHandle);
+    }
+    TlsfRangeAllocator::Stats stats = allocator.getStats();
+    check(allocator.isEmpty(), "Random: not empty after freeing everything");
+    expect(stats.mNumFreeRanges, 1, "Random: free ranges after freeing everything");
+    expect(stats.mLargestFreeRange, capacity, "Random: largest free range after freeing everything");
+}
+
+void testExhaustion() {
+    TlsfRangeAllocator allocator(1024);
+    uint64_t offset = 12345;
+    
+    expect(allocator.allocate(1025, 1, 0, offset), TlsfRangeAllocator::sInvalidHandle, "Exhaustion: larger than capacity");
+    expect(offset, 12345, "Exhaustion: offset written on failure");
+    
+    // Enough bytes are free, but not once aligned
+    allocator.allocate(1, 1, 0, offset);
+    expect(allocator.allocate(600, 512, 0, offset), TlsfRangeAllocator::sInvalidHandle, "Exhaustion: alignment");
+    
+    for(uint32_t i = 0; i < 3; ++ i) {
+        allocator.allocate(341, 1, 0, offset);
+    }
+    TlsfRangeAllocator::Stats before = allocator.getStats();
+    expect(before.mFreeBytes, 0, "Exhaustion: free bytes when full");
+    expect(allocator.allocate(1, 1, 0, offset), TlsfRangeAllocator::sInvalidHandle, "Exhaustion: full");
+    
+    // Failing must not change anything
+    TlsfRangeAllocator::Stats after = allocator.getStats();
+    expect(after.mUsedBytes, before.mUsedBytes, "Exhaustion: used bytes changed by failure");
+    expect(after.mNumAllocations, before.mNumAllocations, "Exhaustion: allocations changed by failure");
+    
+    // Enough bytes are free, but only on a page shared with another kind
+    TlsfRangeAllocator paged(2048, 1024);
+    paged.allocate(1, 1, 0, offset);
+    expect(paged.allocate(1500, 1, 1, offset), TlsfRangeAllocator::sInvalidHandle, "Exhaustion: granularity");
+    check(paged.allocate(1024, 1, 1, offset) != TlsfRangeAllocator::sInvalidHandle && offset == 1024, "Exhaustion: next page");
+}
+
+void testStats() {
+    TlsfRangeAllocator allocator(1024);
+    expectNear(allocator.getStats().getFragmentation(), 0.f, "Stats: empty fragmentation");
+    
+    std::vector<Handle> handles;
+    uint64_t offset;
+    for(uint32_t i = 0; i < 8; ++ i) {
+        handles.push_back(allocator.allocate(128, 1, 0, offset));
+    }
+    TlsfRangeAllocator::Stats stats = allocator.getStats();
+    expectNear(stats.getFragmentation(), 0.f, "Stats: full fragmentation");
+    expect(stats.mUsedBytes, 1024, "Stats: full used bytes");
+    
+    // Every other range, so that none merge
+    for(uint32_t i = 0; i < 8; i += 2) {
+        allocator.free(handles[i]);
+    }
+    stats = allocator.getStats();
+    expect(stats.mCapacity, 1024, "Stats: capacity");
+    expect(stats.mUsedBytes, 512, "Stats: used bytes");
+    expect(stats.mFreeBytes, 512, "Stats: free bytes");
+    expect(stats.mLargestFreeRange, 128, "Stats: largest free range");
+    expect(stats.mNumAllocations, 4, "Stats: allocations");
+    expect(stats.mNumFreeRanges, 4, "Stats: free ranges");
+    expectNear(stats.getFragmentation(), 0.75f, "Stats: fragmentation");
+    
+    // Freeing one more merges three ranges into one of 384 bytes
+    allocator.free(handles[1]);
+    stats = allocator.getStats();
+    expect(stats.mNumFreeRanges, 3, "Stats: free ranges after merge");
+    expectNear(stats.getFragmentation(), 1.f - 384.f / 640.f, "Stats: fragmentation after merge");
+    
+    // Summed over several allocators, as for device memory blocks
+    TlsfRangeAllocator other(512);
+    TlsfRangeAllocator::Stats total = allocator.getStats();
+    total += other.getStats();
+    expect(total.mCapacity, 1536, "Stats: summed capacity");
+    expect(total.mFreeBytes, 1152, "Stats: summed free bytes");
+    expect(total.mLargestFreeRange, 512, "Stats: summed largest free range");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    testAlignment();
+    testSplitAndMerge();
+    testGranularity();
+    testGranularityRandom();
+    testExhaustion();
+    testStats();
+    
+    if(sFailures > 0) {
+        Logger::log(Logger::SEVERE) << sFailures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    Logger::log(Logger::INFO) << "All checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/*
+   Copyright 2017 James Fong
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+/* Block compresses an image the way ImageResource does and reports the quality and cost of each format.
+ *
+ * Usage: BlockCompressionTool image [BC1|BC3|BC5 ...]
+ * Without formats, every format is tried. Only the full size level is compressed.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "BlockCompression.hpp"
+#include "Jobs.hpp"
+#include "Logger.hpp"
+
+using namespace pgg;
+
+namespace {
+
+const char* getFormatName(BlockCompression::Format format) {
+    switch(format) {
+        case BlockCompression::BC1: return "BC1";
+        case BlockCompression::BC3: return "BC3";
+        case BlockCompression::BC5: return "BC5";
+        default: return "?";
+    }
+}
+
+bool parseFormat(const std::string& name, BlockCompression::Format& format) {
+    for(uint32_t i = 0; i < BlockCompression::NUM_FORMATS; ++ i) {
+        if(name == getFormatName((BlockCompression::Format) i)) {
+            format = (BlockCompression::Format) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2) {
+        Logger::log(Logger::SEVERE) << "Usage: " << argv[0] << " image [BC1|BC3|BC5 ...]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    
+    std::vector<BlockCompression::Format> formats;
+    for(int i = 2; i < argc; ++ i) {
+        BlockCompression::Format format;
+        if(!parseFormat(argv[i], format)) {
+            Logger::log(Logger::SEVERE) << "Unknown format " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+        formats.push_back(format);
+    }
+    if(formats.empty()) {
+        for(uint32_t i = 0; i < BlockCompression::NUM_FORMATS; ++ i) {
+            formats.push_back((BlockCompression::Format) i);
+        }
+    }
+    
+    int width;
+    int height;
+    int components;
+    uint8_t* texels = stbi_load(argv[1], &width, &height, &components, 0);
+    if(!texels) {
+        Logger::log(Logger::SEVERE) << "Could not decode image " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    Logger::log(Logger::INFO) << argv[1] << ": " << width << "x" << height << ", " << components << " components" << std::endl;
+    
+    // Compression runs rows of blocks across the job system
+    Jobs::initialize();
+    
+    for(BlockCompression::Format format : formats) {
+        std::vector<uint8_t> blocks(BlockCompression::calcCompressedSize(format, width, height));
+        
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        BlockCompression::compress(format, texels, width, height, components, blocks.data());
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        
+        double psnr = BlockCompression::calcPsnr(format, texels, width, height, components, blocks.data());
+        Logger::log(Logger::INFO) << getFormatName(format) << ": " << psnr << " dB, " << blocks.size() << " bytes, "
+            << elapsed.count() << " ms" << std::endl;
+    }
+    
+    Jobs::cleanup();
+    stbi_image_free(texels);
+    return EXIT_SUCCESS;
+}